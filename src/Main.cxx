@@ -44,6 +44,8 @@
 #include "playlist/PlaylistRegistry.hxx"
 #include "zeroconf/ZeroconfGlue.hxx"
 #include "decoder/DecoderList.hxx"
+#include "decoder/Cache.hxx"
+#include "decoder/SeekIndex.hxx"
 #include "AudioParser.hxx"
 #include "pcm/PcmConvert.hxx"
 #include "unix/SignalHandlers.hxx"
@@ -303,6 +305,10 @@ initialize_decoder_and_player(const ConfigData &config,
 		throw FormatRuntimeError("buffer size \"%lu\" is too big",
 					 (unsigned long)buffer_size);
 
+	const FloatDuration decoder_lookahead =
+		std::chrono::seconds(config.GetUnsigned(ConfigOption::DECODER_LOOKAHEAD,
+							0));
+
 	const unsigned max_length =
 		config.GetPositive(ConfigOption::MAX_PLAYLIST_LENGTH,
 				   DEFAULT_PLAYLIST_MAX_LENGTH);
@@ -323,6 +329,7 @@ initialize_decoder_and_player(const ConfigData &config,
 					  "default",
 					  max_length,
 					  buffered_chunks,
+					  decoder_lookahead,
 					  configured_audio_format,
 					  replay_gain_config);
 	auto &partition = instance->partitions.back();
@@ -376,6 +383,7 @@ inline void
 Instance::BeginShutdownPartitions() noexcept
 {
 	for (auto &partition : partitions) {
+		partition.load_jobs.clear();
 		partition.pc.Kill();
 		partition.listener.reset();
 	}
@@ -527,7 +535,7 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 	glue_mapper_init(raw_config);
 
 	initPermissions(raw_config);
-	spl_global_init(raw_config);
+	spl_global_init(raw_config, instance->event_loop);
 #ifdef ENABLE_ARCHIVE
 	archive_plugin_init_all();
 #endif
@@ -535,6 +543,8 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 	pcm_convert_global_init(raw_config);
 
 	decoder_plugin_init_all(raw_config);
+	decoder_cache_global_init(raw_config);
+	seek_index_global_init(raw_config);
 
 #ifdef ENABLE_DATABASE
 	const bool create_db = InitDatabaseAndStorage(raw_config);
@@ -639,6 +649,8 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 		delete instance->state_file;
 	}
 
+	spl_global_finish();
+
 	ZeroconfDeinit();
 
 	instance->BeginShutdownPartitions();
@@ -670,6 +682,8 @@ mpd_main_after_fork(const ConfigData &raw_config, const Config &config)
 
 	instance->FinishShutdownPartitions();
 	command_finish();
+	seek_index_global_finish();
+	decoder_cache_global_finish();
 	decoder_plugin_deinit_all();
 #ifdef ENABLE_ARCHIVE
 	archive_plugin_deinit_all();
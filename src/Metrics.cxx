@@ -0,0 +1,76 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Metrics.hxx"
+#include "player/Control.hxx"
+#include "output/Interface.hxx"
+#include "client/Response.hxx"
+#include "tag/Pool.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "util/LatencyHistogram.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
+
+void
+metrics_print_histogram(Response &r, const char *type, const char *name,
+			const LatencyHistogram &h)
+{
+	r.Format("%s: %s\n"
+		 "count: %llu\n"
+		 "sum_us: %llu\n"
+		 "p50_us: %llu\n"
+		 "p90_us: %llu\n"
+		 "p99_us: %llu\n"
+		 "max_us: %llu\n",
+		 type, name,
+		 (unsigned long long)h.GetCount(),
+		 (unsigned long long)h.GetSum(),
+		 (unsigned long long)h.GetPercentile(0.5),
+		 (unsigned long long)h.GetPercentile(0.9),
+		 (unsigned long long)h.GetPercentile(0.99),
+		 (unsigned long long)h.GetMax());
+}
+
+void
+metrics_print(Response &r, const Partition &partition)
+{
+	const Instance &instance = partition.instance;
+
+#ifdef ENABLE_DATABASE
+	metrics_print_histogram(r, "lock", "database", db_lock_wait);
+#endif
+	metrics_print_histogram(r, "lock", "tag_pool", tag_pool_lock_wait);
+	metrics_print_histogram(r, "lock", "player", partition.pc.GetLockWait());
+
+	metrics_print_histogram(r, "event_loop", "main",
+				instance.event_loop.GetBusyTime());
+	metrics_print_histogram(r, "event_loop", "io",
+				instance.io_thread.GetEventLoop().GetBusyTime());
+	metrics_print_histogram(r, "event_loop", "rtio",
+				instance.rtio_thread.GetEventLoop().GetBusyTime());
+
+	r.Format("decoder_underruns: %llu\n"
+		 "output_underruns: %llu\n",
+		 (unsigned long long)partition.pc.GetDecoderUnderruns(),
+		 (unsigned long long)audio_output_underruns.load());
+}
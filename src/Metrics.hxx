@@ -0,0 +1,44 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_METRICS_HXX
+#define MPD_METRICS_HXX
+
+class Response;
+class LatencyHistogram;
+struct Partition;
+
+/**
+ * Print a #LatencyHistogram as a response to the "metrics" command.
+ *
+ * @param type the key of the first line, describing what was
+ * measured
+ * @param name the value of the first line
+ */
+void
+metrics_print_histogram(Response &r, const char *type, const char *name,
+			const LatencyHistogram &h);
+
+/**
+ * Print the lock, event loop and underrun metrics.
+ */
+void
+metrics_print(Response &r, const Partition &partition);
+
+#endif
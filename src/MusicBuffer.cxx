@@ -21,17 +21,105 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 
+#include <new>
+
 #include <assert.h>
 
+/**
+ * Keep at least this number of chunks in the buffer when increasing
+ * the chunk size.
+ */
+static constexpr unsigned MIN_CHUNKS = 32;
+
 MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
+	:memory(size_t(num_chunks) * CHUNK_SIZE),
+	 chunk_size(CHUNK_SIZE),
+	 capacity(memory.size() / CHUNK_SIZE)
+{
+	memory.ForkCow(false);
+}
+
+MusicBuffer::~MusicBuffer() noexcept
+{
+	/* all chunks must be returned explicitly, and this
+	   assertion checks for leaks */
+	assert(n_allocated == 0);
+}
+
+size_t
+MusicBuffer::GetChunkCapacity() const noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	return chunk_size - sizeof(MusicChunk);
+}
+
+inline void
+MusicBuffer::DiscardMemory() noexcept
+{
+	assert(n_allocated == 0);
+
+	n_initialized = 0;
+	memory.Discard();
+	available = nullptr;
+}
+
+bool
+MusicBuffer::SetChunkSize(size_t size) noexcept
+{
+	if (size < CHUNK_SIZE)
+		size = CHUNK_SIZE;
+	else if (size > MAX_CHUNK_SIZE)
+		size = MAX_CHUNK_SIZE;
+
+	while (size > CHUNK_SIZE && memory.size() / size < MIN_CHUNKS)
+		size /= 2;
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (size == chunk_size)
+		return true;
+
+	if (n_allocated > 0)
+		return false;
+
+	/* the free list refers to the old slice layout; start over */
+	n_initialized = 0;
+	available = nullptr;
+
+	chunk_size = size;
+	capacity = memory.size() / size;
+	return true;
 }
 
 MusicChunkPtr
 MusicBuffer::Allocate() noexcept
 {
 	const std::lock_guard<Mutex> protect(mutex);
-	return MusicChunkPtr(buffer.Allocate(), MusicChunkDeleter(*this));
+
+	assert(n_initialized <= capacity);
+	assert(n_allocated <= n_initialized);
+
+	if (available == nullptr) {
+		if (n_initialized == capacity) {
+			/* out of (internal) memory, buffer is full */
+			assert(n_allocated == capacity);
+			return nullptr;
+		}
+
+		available = (FreeSlice *)
+			&memory[size_t(n_initialized++) * chunk_size];
+		available->next = nullptr;
+	}
+
+	/* allocate a slice */
+	uint8_t *slice = (uint8_t *)available;
+	available = available->next;
+	++n_allocated;
+
+	auto *chunk = ::new((void *)slice)
+		MusicChunk(slice + sizeof(MusicChunk),
+			   chunk_size - sizeof(MusicChunk));
+	return MusicChunkPtr(chunk, MusicChunkDeleter(*this));
 }
 
 void
@@ -48,6 +136,22 @@ MusicBuffer::Return(MusicChunk *chunk) noexcept
 	const std::lock_guard<Mutex> protect(mutex);
 
 	assert(!chunk->other || !chunk->other->other);
+	assert(n_allocated > 0);
+	assert((uint8_t *)chunk >= &memory.front() &&
+	       (uint8_t *)chunk <= &memory.back());
+	assert(chunk->capacity == chunk_size - sizeof(MusicChunk));
+
+	/* destruct the object */
+	chunk->~MusicChunk();
+
+	/* insert the slice in the "available" linked list */
+	auto *slice = (FreeSlice *)(void *)chunk;
+	slice->next = available;
+	available = slice;
+	--n_allocated;
 
-	buffer.Free(chunk);
+	/* give memory back to the kernel when the last slice was
+	   freed */
+	if (n_allocated == 0)
+		DiscardMemory();
 }
@@ -21,27 +21,75 @@
 #define MPD_MUSIC_BUFFER_HXX
 
 #include "MusicChunkPtr.hxx"
-#include "util/SliceBuffer.hxx"
+#include "util/HugeAllocator.hxx"
 #include "thread/Mutex.hxx"
+#include "util/Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
 
 /**
  * An allocator for #MusicChunk objects.
+ *
+ * The memory is one huge allocation which is divided into slices of
+ * equal size.  The slice size can be changed at runtime while no
+ * chunk is allocated, see SetChunkSize().
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
+	/**
+	 * A slice which is currently not allocated.  This is stored
+	 * at the beginning of the slice.
+	 */
+	struct FreeSlice {
+		FreeSlice *next;
+	};
+
+	/** a mutex which protects all attributes below */
 	mutable Mutex mutex;
 
-	SliceBuffer<MusicChunk> buffer;
+	HugeArray<uint8_t> memory;
+
+	/**
+	 * The size of each slice, including the #MusicChunk object.
+	 */
+	size_t chunk_size;
+
+	/**
+	 * The number of slices of #chunk_size in #memory.
+	 */
+	unsigned capacity;
+
+	/**
+	 * The number of slices that are initialized.  This is used to
+	 * avoid page faulting on the new allocation, so the kernel
+	 * does not need to reserve physical memory pages.
+	 */
+	unsigned n_initialized = 0;
+
+	/**
+	 * The number of slices currently allocated.
+	 */
+	unsigned n_allocated = 0;
+
+	/**
+	 * Pointer to the first free slice in the chain.
+	 */
+	FreeSlice *available = nullptr;
 
 public:
 	/**
 	 * Creates a new #MusicBuffer object.
 	 *
-	 * @param num_chunks the number of #MusicChunk reserved in
-	 * this buffer
+	 * @param num_chunks the number of #MusicChunk of the default
+	 * size (#CHUNK_SIZE) reserved in this buffer
 	 */
 	explicit MusicBuffer(unsigned num_chunks);
 
+	~MusicBuffer() noexcept;
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
+
 #ifndef NDEBUG
 	/**
 	 * Check whether the buffer is empty.  This call is not
@@ -49,25 +97,49 @@ public:
 	 * object is inaccessible to other threads.
 	 */
 	bool IsEmptyUnsafe() const {
-		return buffer.empty();
+		return n_allocated == 0;
 	}
 #endif
 
 	bool IsFull() const noexcept {
 		const std::lock_guard<Mutex> protect(mutex);
-		return buffer.IsFull();
+		return n_allocated == capacity;
 	}
 
 	/**
-	 * Returns the total number of reserved chunks in this buffer.  This
-	 * is the same value which was passed to the constructor
-	 * music_buffer_new().
+	 * Returns the total number of reserved chunks in this buffer.
+	 * This depends on the current chunk size.
 	 */
 	gcc_pure
 	unsigned GetSize() const noexcept {
-		return buffer.GetCapacity();
+		const std::lock_guard<Mutex> protect(mutex);
+		return capacity;
 	}
 
+	/**
+	 * Returns the number of data bytes in each chunk, i.e. the
+	 * #MusicChunk::capacity of newly allocated chunks.
+	 */
+	gcc_pure
+	size_t GetChunkCapacity() const noexcept;
+
+	/**
+	 * Change the size of all chunks (in bytes, including the
+	 * #MusicChunk header).  The value is clamped to the range
+	 * #CHUNK_SIZE..#MAX_CHUNK_SIZE, and it is reduced if the
+	 * buffer would hold too few chunks.
+	 *
+	 * This is only possible while no chunk is allocated.
+	 * Therefore, during gapless playback, the next song keeps
+	 * the previous song's chunk size; a new size only takes
+	 * effect when a song starts on an empty buffer (after stop,
+	 * or when another song is picked explicitly).
+	 *
+	 * @return false if the buffer is in use and the chunk size
+	 * was not changed
+	 */
+	bool SetChunkSize(size_t size) noexcept;
+
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
 	 * call Return().
@@ -82,6 +154,13 @@ public:
 	 * Allocate() then.
 	 */
 	void Return(MusicChunk *chunk) noexcept;
+
+private:
+	/**
+	 * Give all memory back to the kernel.  Caller must hold the
+	 * mutex, and no chunk may be allocated.
+	 */
+	void DiscardMemory() noexcept;
 };
 
 #endif
@@ -57,7 +57,7 @@ MusicChunk::Write(const AudioFormat af,
 	}
 
 	const size_t frame_size = af.GetFrameSize();
-	size_t num_frames = (sizeof(data) - length) / frame_size;
+	size_t num_frames = (capacity - length) / frame_size;
 	return { data + length, num_frames * frame_size };
 }
 
@@ -66,10 +66,25 @@ MusicChunk::Expand(const AudioFormat af, size_t _length) noexcept
 {
 	const size_t frame_size = af.GetFrameSize();
 
-	assert(length + _length <= sizeof(data));
+	assert(length + _length <= capacity);
 	assert(audio_format == af);
 
 	length += _length;
 
-	return length + frame_size > sizeof(data);
+	return length + frame_size > capacity;
+}
+
+size_t
+ChooseChunkSize(const AudioFormat af) noexcept
+{
+	/* about 16 ms per chunk, which is one minimum-sized chunk
+	   for CD audio */
+	const size_t wanted = af.TimeToSize(std::chrono::milliseconds(16)) +
+		sizeof(MusicChunk);
+
+	size_t size = CHUNK_SIZE;
+	while (size < wanted && size < MAX_CHUNK_SIZE)
+		size *= 2;
+
+	return size;
 }
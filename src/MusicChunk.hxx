@@ -24,6 +24,7 @@
 #include "Chrono.hxx"
 #include "ReplayGainInfo.hxx"
 #include "util/WritableBuffer.hxx"
+#include "util/Compiler.h"
 
 #ifndef NDEBUG
 #include "AudioFormat.hxx"
@@ -34,8 +35,18 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/**
+ * The default (and minimum) size of a #MusicChunk slice in a
+ * #MusicBuffer, including the #MusicChunkInfo header.
+ */
 static constexpr size_t CHUNK_SIZE = 4096;
 
+/**
+ * The maximum size of a #MusicChunk slice; see
+ * MusicBuffer::SetChunkSize().
+ */
+static constexpr size_t MAX_CHUNK_SIZE = 256 * 1024;
+
 struct AudioFormat;
 struct Tag;
 struct MusicChunk;
@@ -66,7 +77,7 @@ struct MusicChunkInfo {
 	float mix_ratio;
 
 	/** number of bytes stored in this chunk */
-	uint16_t length = 0;
+	uint32_t length = 0;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -116,8 +127,17 @@ struct MusicChunkInfo {
  * MusicPipe::Push() caller.
  */
 struct MusicChunk : MusicChunkInfo {
-	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE - sizeof(MusicChunkInfo)];
+	/**
+	 * The data (probably PCM).  This points to the memory
+	 * following this object in its #MusicBuffer slice.
+	 */
+	uint8_t *const data;
+
+	/** the number of bytes which can be stored in #data */
+	const size_t capacity;
+
+	MusicChunk(uint8_t *_data, size_t _capacity) noexcept
+		:data(_data), capacity(_capacity) {}
 
 	/**
 	 * Prepares appending to the music chunk.  Returns a buffer
@@ -146,6 +166,14 @@ struct MusicChunk : MusicChunkInfo {
 	bool Expand(AudioFormat af, size_t length) noexcept;
 };
 
-static_assert(sizeof(MusicChunk) == CHUNK_SIZE, "Wrong size");
+/**
+ * Choose a #MusicChunk slice size (see MusicBuffer::SetChunkSize())
+ * for the given audio format.  High bit rates get larger chunks, so
+ * the number of chunks passed through the #MusicPipe per second stays
+ * small.
+ */
+gcc_const
+size_t
+ChooseChunkSize(AudioFormat af) noexcept;
 
 #endif
@@ -29,6 +29,7 @@ Partition::Partition(Instance &_instance,
 		     const char *_name,
 		     unsigned max_length,
 		     unsigned buffer_chunks,
+		     FloatDuration decoder_lookahead,
 		     AudioFormat configured_audio_format,
 		     const ReplayGainConfig &replay_gain_config)
 	:instance(_instance),
@@ -37,7 +38,7 @@ Partition::Partition(Instance &_instance,
 	 global_events(instance.event_loop, BIND_THIS_METHOD(OnGlobalEvent)),
 	 playlist(max_length, *this),
 	 outputs(*this),
-	 pc(*this, outputs, buffer_chunks,
+	 pc(*this, outputs, buffer_chunks, decoder_lookahead,
 	    configured_audio_format, replay_gain_config)
 {
 	UpdateEffectiveReplayGainMode();
@@ -51,6 +52,45 @@ Partition::EmitIdle(unsigned mask)
 	instance.EmitIdle(mask);
 }
 
+void
+Partition::StartLoadJob(const char *uri,
+			unsigned start_index, unsigned end_index)
+{
+	load_jobs.emplace_back(*this, uri, start_index, end_index);
+
+	try {
+		load_jobs.back().Start();
+	} catch (...) {
+		load_jobs.pop_back();
+		throw;
+	}
+}
+
+void
+Partition::CancelLoadJobs() noexcept
+{
+	for (auto &job : load_jobs)
+		job.Cancel();
+}
+
+void
+Partition::OnLoadJobFinished(PlaylistLoadJob &job) noexcept
+{
+	load_jobs.remove_if([&job](const PlaylistLoadJob &i){
+			return &i == &job;
+		});
+}
+
+void
+Partition::OnLoadJobError(std::exception_ptr error) noexcept
+{
+	load_error = std::move(error);
+
+	/* clients watch the "player" subsystem for changes of the
+	   "error" attribute */
+	EmitIdle(IDLE_PLAYER);
+}
+
 void
 Partition::UpdateEffectiveReplayGainMode()
 {
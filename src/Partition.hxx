@@ -27,6 +27,7 @@
 #include "mixer/Listener.hxx"
 #include "player/Control.hxx"
 #include "player/Listener.hxx"
+#include "playlist/PlaylistLoadJob.hxx"
 #include "ReplayGainMode.hxx"
 #include "SingleMode.hxx"
 #include "Chrono.hxx"
@@ -34,6 +35,8 @@
 
 #include <string>
 #include <memory>
+#include <list>
+#include <exception>
 
 struct Instance;
 class MultipleOutputs;
@@ -65,10 +68,23 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
+	/**
+	 * Background "load" jobs which are still running.
+	 */
+	std::list<PlaylistLoadJob> load_jobs;
+
+	/**
+	 * The error of the most recent failed background "load"
+	 * job.  It is reported by "status" (unless there is a player
+	 * error) and cleared by "clearerror".
+	 */
+	std::exception_ptr load_error;
+
 	Partition(Instance &_instance,
 		  const char *_name,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
+		  FloatDuration decoder_lookahead,
 		  AudioFormat configured_audio_format,
 		  const ReplayGainConfig &replay_gain_config);
 
@@ -81,6 +97,7 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 	void EmitIdle(unsigned mask);
 
 	void ClearQueue() {
+		CancelLoadJobs();
 		playlist.Clear(pc);
 	}
 
@@ -89,6 +106,31 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 		return playlist.AppendURI(pc, loader, uri_utf8);
 	}
 
+	/**
+	 * Load a playlist into the queue in the background (see
+	 * #PlaylistLoadJob).
+	 *
+	 * Throws on error.
+	 */
+	void StartLoadJob(const char *uri,
+			  unsigned start_index, unsigned end_index);
+
+	/**
+	 * Stop all background "load" jobs from appending more songs.
+	 */
+	void CancelLoadJobs() noexcept;
+
+	/**
+	 * Called by #PlaylistLoadJob when it has finished.  This
+	 * destroys the job.
+	 */
+	void OnLoadJobFinished(PlaylistLoadJob &job) noexcept;
+
+	/**
+	 * Called by #PlaylistLoadJob when it has failed.
+	 */
+	void OnLoadJobError(std::exception_ptr error) noexcept;
+
 	void DeletePosition(unsigned position) {
 		playlist.DeletePosition(pc, position);
 	}
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "PlaylistFile.hxx"
+#include "PlaylistFileCache.hxx"
 #include "PlaylistSave.hxx"
 #include "PlaylistError.hxx"
 #include "db/PlaylistInfo.hxx"
@@ -26,7 +27,6 @@
 #include "song/DetachedSong.hxx"
 #include "SongLoader.hxx"
 #include "Mapper.hxx"
-#include "fs/io/TextFile.hxx"
 #include "fs/io/FileOutputStream.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "config/Data.hxx"
@@ -39,6 +39,7 @@
 #include "fs/FileSystem.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/DirectoryReader.hxx"
+#include "Log.hxx"
 #include "util/Macros.hxx"
 #include "util/StringCompare.hxx"
 #include "util/UriUtil.hxx"
@@ -49,13 +50,13 @@
 #include <string.h>
 #include <errno.h>
 
-static const char PLAYLIST_COMMENT = '#';
-
 static unsigned playlist_max_length;
 bool playlist_saveAbsolutePaths = DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS;
 
+static PlaylistFileCache *spl_cache;
+
 void
-spl_global_init(const ConfigData &config)
+spl_global_init(const ConfigData &config, EventLoop &event_loop)
 {
 	playlist_max_length =
 		config.GetPositive(ConfigOption::MAX_PLAYLIST_LENGTH,
@@ -64,6 +65,16 @@ spl_global_init(const ConfigData &config)
 	playlist_saveAbsolutePaths =
 		config.GetBool(ConfigOption::SAVE_ABSOLUTE_PATHS,
 			       DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS);
+
+	spl_cache = new PlaylistFileCache(event_loop, playlist_max_length);
+}
+
+void
+spl_global_finish() noexcept
+{
+	spl_cache->FlushAll();
+	delete spl_cache;
+	spl_cache = nullptr;
 }
 
 bool
@@ -162,6 +173,11 @@ ListPlaylistFiles()
 	const auto &parent_path_fs = spl_map();
 	assert(!parent_path_fs.IsNull());
 
+	/* write pending modifications, or else the modification
+	   times would be wrong */
+	assert(spl_cache != nullptr);
+	spl_cache->FlushAll();
+
 	DirectoryReader reader(parent_path_fs);
 
 	PlaylistInfo info;
@@ -174,108 +190,74 @@ ListPlaylistFiles()
 	return list;
 }
 
-static void
-SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path)
-{
-	assert(utf8path != nullptr);
+PlaylistFileContents
+LoadPlaylistFile(const char *utf8path)
+try {
+	assert(spl_cache != nullptr);
 
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
-	FileOutputStream fos(path_fs);
-	BufferedOutputStream bos(fos);
-
-	for (const auto &uri_utf8 : contents)
-		playlist_print_uri(bos, uri_utf8.c_str());
-
-	bos.Flush();
-
-	fos.Commit();
+	return spl_cache->Get(utf8path, path_fs).contents;
+} catch (const std::system_error &e) {
+	if (IsFileNotFound(e))
+		throw PlaylistError::NoSuchList();
+	throw;
 }
 
-PlaylistFileContents
-LoadPlaylistFile(const char *utf8path)
+void
+spl_visit(const char *utf8path, const SongLoader &loader, bool detail,
+	  const PlaylistFileCache::VisitFunction &f)
 try {
-	PlaylistFileContents contents;
+	assert(spl_cache != nullptr);
 
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
-	TextFile file(path_fs);
-
-	char *s;
-	while ((s = file.ReadLine()) != nullptr) {
-		if (*s == 0 || *s == PLAYLIST_COMMENT)
-			continue;
-
-#ifdef _UNICODE
-		/* on Windows, playlists always contain UTF-8, because
-		   its "narrow" charset (i.e. CP_ACP) is incapable of
-		   storing all Unicode paths */
-		const auto path = AllocatedPath::FromUTF8(s);
-		if (path.IsNull())
-			continue;
-#else
-		const Path path = Path::FromFS(s);
-#endif
-
-		std::string uri_utf8;
-
-		if (!uri_has_scheme(s)) {
-#ifdef ENABLE_DATABASE
-			uri_utf8 = map_fs_to_utf8(path);
-			if (uri_utf8.empty()) {
-				if (path.IsAbsolute()) {
-					uri_utf8 = path.ToUTF8();
-					if (uri_utf8.empty())
-						continue;
-				} else
-					continue;
-			}
-#else
-			continue;
-#endif
-		} else {
-			uri_utf8 = path.ToUTF8();
-			if (uri_utf8.empty())
-				continue;
-		}
-
-		contents.emplace_back(std::move(uri_utf8));
-		if (contents.size() >= playlist_max_length)
-			break;
-	}
-
-	return contents;
+	auto &entry = spl_cache->Get(utf8path, path_fs);
+	spl_cache->VisitSongs(entry, loader, detail, f);
 } catch (const std::system_error &e) {
 	if (IsFileNotFound(e))
 		throw PlaylistError::NoSuchList();
 	throw;
 }
 
+void
+spl_flush(const char *utf8path) noexcept
+try {
+	if (spl_cache != nullptr)
+		spl_cache->Flush(utf8path);
+} catch (...) {
+	/* the journal is kept; the caller reads the file without
+	   the pending modifications */
+	LogError(std::current_exception());
+}
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest)
-{
+try {
 	if (src == dest)
 		/* this doesn't check whether the playlist exists, but
 		   what the hell.. */
 		return;
 
-	auto contents = LoadPlaylistFile(utf8path);
+	assert(spl_cache != nullptr);
 
-	if (src >= contents.size() || dest >= contents.size())
-		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
+	const auto path_fs = spl_map_to_fs(utf8path);
+	assert(!path_fs.IsNull());
 
-	const auto src_i = std::next(contents.begin(), src);
-	auto value = std::move(*src_i);
-	contents.erase(src_i);
+	auto &entry = spl_cache->Get(utf8path, path_fs);
 
-	const auto dest_i = std::next(contents.begin(), dest);
-	contents.insert(dest_i, std::move(value));
+	if (src >= entry.contents.size() || dest >= entry.contents.size())
+		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
-	SavePlaylistFile(contents, utf8path);
+	spl_cache->Move(entry, src, dest);
 
 	idle_add(IDLE_STORED_PLAYLIST);
+} catch (const std::system_error &e) {
+	if (IsFileNotFound(e))
+		throw PlaylistError::NoSuchList();
+	throw;
 }
 
 void
@@ -284,6 +266,9 @@ spl_clear(const char *utf8path)
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	assert(spl_cache != nullptr);
+	spl_cache->Remove(utf8path, path_fs);
+
 	try {
 		TruncateFile(path_fs);
 	} catch (const std::system_error &e) {
@@ -303,6 +288,9 @@ spl_delete(const char *name_utf8)
 	const auto path_fs = spl_map_to_fs(name_utf8);
 	assert(!path_fs.IsNull());
 
+	assert(spl_cache != nullptr);
+	spl_cache->Remove(name_utf8, path_fs);
+
 	try {
 		RemoveFile(path_fs);
 	} catch (const std::system_error &e) {
@@ -318,16 +306,24 @@ spl_delete(const char *name_utf8)
 
 void
 spl_remove_index(const char *utf8path, unsigned pos)
-{
-	auto contents = LoadPlaylistFile(utf8path);
+try {
+	assert(spl_cache != nullptr);
 
-	if (pos >= contents.size())
+	const auto path_fs = spl_map_to_fs(utf8path);
+	assert(!path_fs.IsNull());
+
+	auto &entry = spl_cache->Get(utf8path, path_fs);
+
+	if (pos >= entry.contents.size())
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
-	contents.erase(std::next(contents.begin(), pos));
+	spl_cache->Delete(entry, pos);
 
-	SavePlaylistFile(contents, utf8path);
 	idle_add(IDLE_STORED_PLAYLIST);
+} catch (const std::system_error &e) {
+	if (IsFileNotFound(e))
+		throw PlaylistError::NoSuchList();
+	throw;
 }
 
 void
@@ -336,6 +332,17 @@ try {
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	assert(spl_cache != nullptr);
+	auto *entry = spl_cache->Find(utf8path, path_fs);
+	if (entry != nullptr) {
+		if (entry->contents.size() >= playlist_max_length)
+			throw PlaylistError(PlaylistResult::TOO_LARGE,
+					    "Stored playlist is too large");
+
+		/* append to the up-to-date file */
+		spl_cache->Flush(utf8path);
+	}
+
 	FileOutputStream fos(path_fs, FileOutputStream::Mode::APPEND_OR_CREATE);
 
 	if (fos.Tell() / (MPD_PATH_MAX + 1) >= playlist_max_length)
@@ -349,6 +356,12 @@ try {
 	bos.Flush();
 	fos.Commit();
 
+	if (entry != nullptr) {
+		entry->Insert(entry->contents.size(),
+			      song.GetURI());
+		spl_cache->Committed(*entry);
+	}
+
 	idle_add(IDLE_STORED_PLAYLIST);
 } catch (const std::system_error &e) {
 	if (IsFileNotFound(e))
@@ -392,5 +405,11 @@ spl_rename(const char *utf8from, const char *utf8to)
 	const auto to_path_fs = spl_map_to_fs(utf8to);
 	assert(!to_path_fs.IsNull());
 
+	assert(spl_cache != nullptr);
+	spl_cache->Flush(utf8from);
+
 	spl_rename_internal(from_path_fs, to_path_fs);
+
+	spl_cache->Remove(utf8from, from_path_fs);
+	spl_cache->Remove(utf8to, to_path_fs);
 }
@@ -22,8 +22,10 @@
 
 #include <vector>
 #include <string>
+#include <functional>
 
 struct ConfigData;
+class EventLoop;
 class DetachedSong;
 class SongLoader;
 class PlaylistVector;
@@ -37,7 +39,13 @@ extern bool playlist_saveAbsolutePaths;
  * Perform some global initialization, e.g. load configuration values.
  */
 void
-spl_global_init(const ConfigData &config);
+spl_global_init(const ConfigData &config, EventLoop &event_loop);
+
+/**
+ * Write pending modifications and free global resources.
+ */
+void
+spl_global_finish() noexcept;
 
 /**
  * Determines whether the specified string is a valid name for a
@@ -58,6 +66,29 @@ ListPlaylistFiles();
 PlaylistFileContents
 LoadPlaylistFile(const char *utf8path);
 
+/**
+ * Invoke a function for each song of the stored playlist.  This uses
+ * an in-memory copy of the playlist which is kept across calls, and
+ * songs from the database are resolved only once (until the database
+ * gets modified).
+ *
+ * Throws #std::runtime_error on error.
+ *
+ * @param detail true if the songs shall be resolved (i.e. tags
+ * loaded); the second parameter of #f is true if that was successful
+ */
+void
+spl_visit(const char *utf8path, const SongLoader &loader, bool detail,
+	  const std::function<void(const DetachedSong &song,
+				   bool resolved)> &f);
+
+/**
+ * Write pending modifications of the specified stored playlist to
+ * its file.  This must be called before the file is read directly.
+ */
+void
+spl_flush(const char *utf8path) noexcept;
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest);
 
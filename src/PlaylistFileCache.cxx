@@ -0,0 +1,574 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PlaylistFileCache.hxx"
+#include "PlaylistSave.hxx"
+#include "PlaylistError.hxx"
+#include "playlist/PlaylistSong.hxx"
+#include "song/DetachedSong.hxx"
+#include "SongLoader.hxx"
+#include "Mapper.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/Traits.hxx"
+#include "util/UriUtil.hxx"
+#include "util/Domain.hxx"
+#include "util/Fnv1aHash.hxx"
+#include "util/StringBuffer.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr Domain playlist_cache_domain("playlist_cache");
+
+static const char PLAYLIST_COMMENT = '#';
+
+/**
+ * The maximum number of playlists kept in memory.
+ */
+static constexpr std::size_t MAX_ENTRIES = 8;
+
+/**
+ * How long to wait after an edit before rewriting the m3u file?
+ */
+static constexpr std::chrono::steady_clock::duration FLUSH_DELAY =
+	std::chrono::seconds(2);
+
+/**
+ * The journal of "foo.m3u" is "foo.m3u.journal".  Its first line
+ * identifies the contents of the m3u file it applies to: "# HASH".
+ * Each following line is one edit: "d POSITION" or "m FROM TO".
+ */
+static AllocatedPath
+GetJournalPath(Path path_fs) noexcept
+{
+	return AllocatedPath::FromFS(PathTraitsFS::string(path_fs.c_str()) +
+				     PATH_LITERAL(".journal"));
+}
+
+/**
+ * Format the first line of a journal.  The hash of the contents is
+ * used instead of the file's modification time, because the latter
+ * has a resolution of one second, and a rewrite which keeps the size
+ * (e.g. after a move) may not change either.
+ */
+static StringBuffer<32>
+FormatJournalHeader(const PlaylistFileContents &contents) noexcept
+{
+	Fnv1aHash hash;
+	for (const auto &uri : contents)
+		hash.Update(uri.c_str(), uri.length() + 1);
+
+	StringBuffer<32> buffer;
+	snprintf(buffer.data(), buffer.capacity(), "# %016llx",
+		 (unsigned long long)hash.Get());
+	return buffer;
+}
+
+static PlaylistFileContents
+ReadPlaylistFile(Path path_fs, unsigned max_length)
+{
+	PlaylistFileContents contents;
+
+	TextFile file(path_fs);
+
+	char *s;
+	while ((s = file.ReadLine()) != nullptr) {
+		if (*s == 0 || *s == PLAYLIST_COMMENT)
+			continue;
+
+#ifdef _UNICODE
+		/* on Windows, playlists always contain UTF-8, because
+		   its "narrow" charset (i.e. CP_ACP) is incapable of
+		   storing all Unicode paths */
+		const auto path = AllocatedPath::FromUTF8(s);
+		if (path.IsNull())
+			continue;
+#else
+		const Path path = Path::FromFS(s);
+#endif
+
+		std::string uri_utf8;
+
+		if (!uri_has_scheme(s)) {
+#ifdef ENABLE_DATABASE
+			uri_utf8 = map_fs_to_utf8(path);
+			if (uri_utf8.empty()) {
+				if (path.IsAbsolute()) {
+					uri_utf8 = path.ToUTF8();
+					if (uri_utf8.empty())
+						continue;
+				} else
+					continue;
+			}
+#else
+			continue;
+#endif
+		} else {
+			uri_utf8 = path.ToUTF8();
+			if (uri_utf8.empty())
+				continue;
+		}
+
+		contents.emplace_back(std::move(uri_utf8));
+		if (contents.size() >= max_length)
+			break;
+	}
+
+	return contents;
+}
+
+static void
+WritePlaylistFile(const PlaylistFileContents &contents, Path path_fs)
+{
+	FileOutputStream fos(path_fs);
+	BufferedOutputStream bos(fos);
+
+	for (const auto &uri_utf8 : contents)
+		playlist_print_uri(bos, uri_utf8.c_str());
+
+	bos.Flush();
+
+	fos.Commit();
+}
+
+PlaylistFileCache::Entry::~Entry() noexcept = default;
+
+void
+PlaylistFileCache::Entry::Insert(unsigned position, std::string &&uri)
+{
+	assert(position <= contents.size());
+
+	contents.emplace(std::next(contents.begin(), position),
+			 std::move(uri));
+
+	if (!songs.empty())
+		songs.emplace(std::next(songs.begin(), position));
+}
+
+void
+PlaylistFileCache::Entry::Erase(unsigned position) noexcept
+{
+	assert(position < contents.size());
+
+	contents.erase(std::next(contents.begin(), position));
+
+	if (!songs.empty())
+		songs.erase(std::next(songs.begin(), position));
+}
+
+void
+PlaylistFileCache::Entry::Move(unsigned from, unsigned to) noexcept
+{
+	assert(from < contents.size());
+	assert(to < contents.size());
+
+	auto value = std::move(contents[from]);
+	std::unique_ptr<DetachedSong> song;
+	if (!songs.empty())
+		song = std::move(songs[from]);
+
+	Erase(from);
+	Insert(to, std::move(value));
+	if (!songs.empty())
+		songs[to] = std::move(song);
+}
+
+bool
+PlaylistFileCache::Entry::Replay(const char *record) noexcept
+{
+	const unsigned n = contents.size();
+	char *end;
+
+	switch (record[0]) {
+	case 'd': {
+		const unsigned long position = strtoul(record + 1, &end, 10);
+		if (end == record + 1 || *end != 0 || position >= n)
+			return false;
+
+		Erase(position);
+		return true;
+	}
+
+	case 'm': {
+		const unsigned long from = strtoul(record + 1, &end, 10);
+		if (end == record + 1 || from >= n)
+			return false;
+
+		const char *p = end;
+		const unsigned long to = strtoul(p, &end, 10);
+		if (end == p || *end != 0 || to >= n)
+			return false;
+
+		Move(from, to);
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+PlaylistFileCache::PlaylistFileCache(EventLoop &_loop,
+				     unsigned _max_length) noexcept
+	:max_length(_max_length),
+	 flush_timer(_loop, BIND_THIS_METHOD(OnFlushTimer)) {}
+
+PlaylistFileCache::~PlaylistFileCache() noexcept = default;
+
+PlaylistFileCache::Entry *
+PlaylistFileCache::Find(const char *name_utf8, Path path_fs) noexcept
+{
+	auto i = map.find(name_utf8);
+	if (i == map.end())
+		return nullptr;
+
+	auto &entry = i->second;
+
+	FileInfo fi;
+	if (!GetFileInfo(path_fs, fi) ||
+	    fi.GetModificationTime() != entry.mtime ||
+	    fi.GetSize() != entry.size) {
+		/* the file was modified or deleted by somebody
+		   else */
+		map.erase(i);
+		return nullptr;
+	}
+
+	entry.last_used = ++clock;
+	return &entry;
+}
+
+PlaylistFileCache::Entry &
+PlaylistFileCache::Get(const char *name_utf8, Path path_fs)
+{
+	auto *entry = Find(name_utf8, path_fs);
+	if (entry != nullptr)
+		return *entry;
+
+	FileInfo fi;
+	if (!GetFileInfo(path_fs, fi) || !fi.IsRegular())
+		throw PlaylistError::NoSuchList();
+
+	return Load(name_utf8, path_fs, fi);
+}
+
+PlaylistFileCache::Entry &
+PlaylistFileCache::Load(const char *name_utf8, Path path_fs,
+			const FileInfo &fi)
+{
+	Entry new_entry;
+	new_entry.contents = ReadPlaylistFile(path_fs, max_length);
+	new_entry.path = AllocatedPath(path_fs);
+	new_entry.mtime = fi.GetModificationTime();
+	new_entry.size = fi.GetSize();
+	new_entry.last_used = ++clock;
+
+	auto &entry = map[name_utf8];
+	entry = std::move(new_entry);
+
+	LoadJournal(entry);
+	Shrink(entry);
+	return entry;
+}
+
+void
+PlaylistFileCache::LoadJournal(Entry &entry) noexcept
+{
+	const auto journal_path = GetJournalPath(entry.path);
+	if (!FileExists(journal_path))
+		return;
+
+	unsigned n = 0;
+
+	try {
+		TextFile file(journal_path);
+
+		const char *line = file.ReadLine();
+		if (line != nullptr &&
+		    strcmp(line, FormatJournalHeader(entry.contents)) == 0) {
+			/* a truncated or otherwise bad record (e.g.
+			   after a crash) ends the journal */
+			while ((line = file.ReadLine()) != nullptr &&
+			       entry.Replay(line))
+				++n;
+		} else
+			FormatWarning(playlist_cache_domain,
+				      "Discarding journal of modified playlist %s",
+				      entry.path.ToUTF8().c_str());
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+
+	if (n > 0) {
+		/* write the m3u file right away, because new
+		   records must not be appended after a bad one */
+		entry.dirty = true;
+		try {
+			FlushEntry(entry);
+		} catch (...) {
+			LogError(std::current_exception());
+			if (!flush_timer.IsActive())
+				flush_timer.Schedule(FLUSH_DELAY);
+		}
+
+		return;
+	}
+
+	try {
+		RemoveFile(journal_path);
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
+void
+PlaylistFileCache::AppendJournal(Entry &entry, const char *record)
+{
+	const auto journal_path = GetJournalPath(entry.path);
+
+	/* the first record creates the journal, replacing a stale
+	   one */
+	FileOutputStream fos(journal_path,
+			     entry.dirty
+			     ? FileOutputStream::Mode::APPEND_EXISTING
+			     : FileOutputStream::Mode::CREATE);
+	BufferedOutputStream bos(fos);
+
+	if (!entry.dirty)
+		bos.Format("%s\n",
+			   FormatJournalHeader(entry.contents).c_str());
+
+	bos.Format("%s\n", record);
+	bos.Flush();
+	fos.Commit();
+
+	entry.dirty = true;
+	if (!flush_timer.IsActive())
+		flush_timer.Schedule(FLUSH_DELAY);
+}
+
+void
+PlaylistFileCache::Delete(Entry &entry, unsigned position)
+{
+	assert(position < entry.contents.size());
+
+	char record[32];
+	snprintf(record, sizeof(record), "d %u", position);
+	AppendJournal(entry, record);
+
+	entry.Erase(position);
+}
+
+void
+PlaylistFileCache::Move(Entry &entry, unsigned from, unsigned to)
+{
+	assert(from < entry.contents.size());
+	assert(to < entry.contents.size());
+
+	char record[32];
+	snprintf(record, sizeof(record), "m %u %u", from, to);
+	AppendJournal(entry, record);
+
+	entry.Move(from, to);
+}
+
+void
+PlaylistFileCache::FlushEntry(Entry &entry)
+{
+	assert(entry.dirty);
+
+	WritePlaylistFile(entry.contents, entry.path);
+	Committed(entry);
+
+	/* the journal refers to the old contents now, and would be
+	   discarded by LoadJournal() anyway */
+	entry.dirty = false;
+	RemoveFile(GetJournalPath(entry.path));
+}
+
+void
+PlaylistFileCache::Flush(const char *name_utf8)
+{
+	auto i = map.find(name_utf8);
+	if (i != map.end() && i->second.dirty)
+		FlushEntry(i->second);
+}
+
+void
+PlaylistFileCache::FlushAll() noexcept
+{
+	flush_timer.Cancel();
+
+	for (auto &i : map) {
+		if (!i.second.dirty)
+			continue;
+
+		try {
+			FlushEntry(i.second);
+		} catch (...) {
+			/* the journal is kept; the next flush (or
+			   the next startup) tries again */
+			FormatError(std::current_exception(),
+				    "Failed to save playlist \"%s\"",
+				    i.first.c_str());
+		}
+	}
+}
+
+void
+PlaylistFileCache::OnFlushTimer() noexcept
+{
+	FlushAll();
+}
+
+void
+PlaylistFileCache::Committed(Entry &entry) noexcept
+{
+	FileInfo fi;
+	if (GetFileInfo(entry.path, fi)) {
+		entry.mtime = fi.GetModificationTime();
+		entry.size = fi.GetSize();
+	} else
+		/* make sure the next Find() call reloads it */
+		entry.size = ~uint64_t(0);
+}
+
+void
+PlaylistFileCache::Remove(const char *name_utf8, Path path_fs) noexcept
+{
+	map.erase(name_utf8);
+
+	const auto journal_path = GetJournalPath(path_fs);
+	if (FileExists(journal_path)) {
+		try {
+			RemoveFile(journal_path);
+		} catch (...) {
+			LogError(std::current_exception());
+		}
+	}
+}
+
+void
+PlaylistFileCache::Shrink(const Entry &keep) noexcept
+{
+	while (map.size() > MAX_ENTRIES) {
+		auto oldest = map.end();
+		for (auto i = map.begin(); i != map.end(); ++i)
+			if (&i->second != &keep &&
+			    (oldest == map.end() ||
+			     i->second.last_used < oldest->second.last_used))
+				oldest = i;
+
+		if (oldest == map.end())
+			break;
+
+		if (oldest->second.dirty) {
+			/* on error, the journal is kept and replayed
+			   by the next Load() */
+			try {
+				FlushEntry(oldest->second);
+			} catch (...) {
+				LogError(std::current_exception());
+			}
+		}
+
+		map.erase(oldest);
+	}
+}
+
+const DetachedSong *
+PlaylistFileCache::ResolveSong(Entry &entry, unsigned position,
+			       const SongLoader &loader,
+			       DetachedSong &buffer) noexcept
+{
+	const char *uri = entry.contents[position].c_str();
+
+	/* only songs from the database are cacheable; everything
+	   else depends on the client's permissions */
+	if (!entry.songs.empty() &&
+	    !uri_has_scheme(uri) && !PathTraitsUTF8::IsAbsolute(uri)) {
+		auto &song = entry.songs[position];
+		if (song == nullptr) {
+			if (!playlist_check_translate_song(buffer, nullptr,
+							   loader))
+				return nullptr;
+
+			song = std::make_unique<DetachedSong>(std::move(buffer));
+		}
+
+		return song.get();
+	}
+
+	return playlist_check_translate_song(buffer, nullptr, loader)
+		? &buffer
+		: nullptr;
+}
+
+void
+PlaylistFileCache::VisitSongs(Entry &entry, const SongLoader &loader,
+			      bool detail, const VisitFunction &f)
+{
+	if (detail) {
+#ifdef ENABLE_DATABASE
+		const Database *db = loader.GetDatabase();
+		if (db != nullptr) {
+			const auto stamp = db->GetUpdateStamp();
+			if (stamp != entry.songs_stamp) {
+				/* the database was modified; the
+				   cached songs may be stale */
+				entry.songs.clear();
+				entry.songs_stamp = stamp;
+			}
+
+			if (entry.songs.empty())
+				entry.songs.resize(entry.contents.size());
+		} else
+#endif
+			entry.songs.clear();
+	}
+
+	for (unsigned i = 0; i < entry.contents.size(); ++i) {
+		DetachedSong buffer(entry.contents[i]);
+
+		if (!detail) {
+			f(buffer, false);
+			continue;
+		}
+
+		const DetachedSong *song = ResolveSong(entry, i, loader,
+						       buffer);
+		if (song != nullptr)
+			f(*song, true);
+		else
+			f(buffer, false);
+	}
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PLAYLIST_FILE_CACHE_HXX
+#define MPD_PLAYLIST_FILE_CACHE_HXX
+
+#include "PlaylistFile.hxx"
+#include "event/TimerEvent.hxx"
+#include "fs/AllocatedPath.hxx"
+
+#include <map>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+class Path;
+class FileInfo;
+class EventLoop;
+class DetachedSong;
+class SongLoader;
+
+/**
+ * An in-memory index of stored playlist files.  Each loaded playlist
+ * keeps its song list (already converted to UTF-8 URIs), so
+ * random-access edits don't need to parse the file again.
+ *
+ * Before an edit is reported as successful, it is appended to a
+ * journal file next to the m3u file (see Delete() and Move()); this
+ * is one short write, no matter how large the playlist is.  The m3u
+ * file is rewritten after a short delay, which coalesces a burst of
+ * edits into one write, and then the journal is deleted.  A journal
+ * left over by a crash is replayed by the next Get() call.
+ *
+ * This class is not thread-safe; all methods must be called from the
+ * #EventLoop thread.
+ */
+class PlaylistFileCache final {
+public:
+	/**
+	 * @param resolved true if the song was resolved successfully
+	 * and its details (e.g. tags) are available
+	 */
+	typedef std::function<void(const DetachedSong &song,
+				   bool resolved)> VisitFunction;
+
+	struct Entry {
+		PlaylistFileContents contents;
+
+		/**
+		 * Resolved songs for "listplaylistinfo", indexed like
+		 * #contents.  Only database songs are cached here,
+		 * because they do not depend on the client's
+		 * permissions; nullptr means "not resolved (yet)".
+		 * This vector is empty if nothing was resolved.
+		 */
+		std::vector<std::unique_ptr<DetachedSong>> songs;
+
+		/**
+		 * The database update stamp which was current when
+		 * #songs was filled.
+		 */
+		std::chrono::system_clock::time_point songs_stamp;
+
+		/**
+		 * The m3u file.
+		 */
+		AllocatedPath path = nullptr;
+
+		/**
+		 * Modification time and size of the file when it was
+		 * last read or written by us.  If they differ, the
+		 * file was edited externally and needs to be reloaded.
+		 * The journal does not touch the m3u file, so this
+		 * check works for dirty entries, too.
+		 */
+		std::chrono::system_clock::time_point mtime;
+		uint64_t size;
+
+		/**
+		 * Does the journal contain edits which have not yet
+		 * been written to the m3u file?
+		 */
+		bool dirty = false;
+
+		/**
+		 * The value of #PlaylistFileCache::clock when this
+		 * entry was last used; for the LRU eviction.
+		 */
+		unsigned last_used;
+
+		Entry() = default;
+		Entry(const Entry &) = delete;
+		Entry &operator=(const Entry &) = delete;
+
+		Entry(Entry &&) = default;
+		Entry &operator=(Entry &&) = default;
+
+		~Entry() noexcept;
+
+		void Insert(unsigned position, std::string &&uri);
+		void Erase(unsigned position) noexcept;
+		void Move(unsigned from, unsigned to) noexcept;
+
+		/**
+		 * Apply one journal record.
+		 *
+		 * @return false if the record is malformed or does not
+		 * fit the contents
+		 */
+		bool Replay(const char *record) noexcept;
+	};
+
+private:
+	/**
+	 * The maximum number of entries in a playlist file.
+	 */
+	const unsigned max_length;
+
+	typedef std::map<std::string, Entry> Map;
+
+	/**
+	 * Cached playlists, by name (UTF-8, without suffix).
+	 */
+	Map map;
+
+	unsigned clock = 0;
+
+	TimerEvent flush_timer;
+
+public:
+	PlaylistFileCache(EventLoop &_loop, unsigned _max_length) noexcept;
+
+	/**
+	 * Note: this does not flush dirty entries; call FlushAll()
+	 * before.  Their journals stay on disk anyway.
+	 */
+	~PlaylistFileCache() noexcept;
+
+	PlaylistFileCache(const PlaylistFileCache &) = delete;
+	PlaylistFileCache &operator=(const PlaylistFileCache &) = delete;
+
+	unsigned GetMaxLength() const noexcept {
+		return max_length;
+	}
+
+	/**
+	 * Look up a playlist, and load it from the file if it is not
+	 * cached or if the file was modified since it was cached.
+	 *
+	 * Throws #PlaylistError (NO_SUCH_LIST) if the file does not
+	 * exist, or #std::runtime_error on I/O error.
+	 */
+	Entry &Get(const char *name_utf8, Path path_fs);
+
+	/**
+	 * Look up a playlist without loading it.  Returns nullptr if
+	 * it is not cached or if the cached copy is stale.
+	 */
+	Entry *Find(const char *name_utf8, Path path_fs) noexcept;
+
+	/**
+	 * Delete a song from the playlist.  The edit is written to
+	 * the journal before this method returns; on error, the
+	 * exception is thrown and nothing is changed.
+	 */
+	void Delete(Entry &entry, unsigned position);
+
+	/**
+	 * Move a song within the playlist.  Like Delete(), the edit
+	 * is journaled before this method returns.
+	 */
+	void Move(Entry &entry, unsigned from, unsigned to);
+
+	/**
+	 * Write pending edits of the given playlist to its m3u file.
+	 * This must be called before the file is accessed directly.
+	 *
+	 * Throws on error; the journal is kept then.
+	 */
+	void Flush(const char *name_utf8);
+
+	/**
+	 * Write all pending edits.  Errors are logged, and the
+	 * affected journals are kept.
+	 */
+	void FlushAll() noexcept;
+
+	/**
+	 * The file has been written by the caller (and #contents
+	 * matches it); remember its new modification time.
+	 */
+	void Committed(Entry &entry) noexcept;
+
+	/**
+	 * Remove the playlist from the cache and delete its journal,
+	 * discarding pending edits.  This is used when the file is
+	 * deleted or truncated.
+	 */
+	void Remove(const char *name_utf8, Path path_fs) noexcept;
+
+	/**
+	 * Resolve the songs of the given entry for printing.  Songs
+	 * from the database are cached in #Entry::songs until the
+	 * database gets modified.
+	 *
+	 * @param detail if false, then songs are not resolved at all
+	 * and #f receives just the URIs
+	 */
+	void VisitSongs(Entry &entry, const SongLoader &loader,
+			bool detail, const VisitFunction &f);
+
+private:
+	Entry &Load(const char *name_utf8, Path path_fs,
+		    const FileInfo &fi);
+
+	/**
+	 * Replay the journal of a freshly loaded entry, or delete
+	 * it if it belongs to an older version of the m3u file.
+	 */
+	void LoadJournal(Entry &entry) noexcept;
+
+	/**
+	 * Append a record to the journal of the given entry, and
+	 * schedule the flush.
+	 */
+	void AppendJournal(Entry &entry, const char *record);
+
+	void FlushEntry(Entry &entry);
+
+	void OnFlushTimer() noexcept;
+
+	const DetachedSong *ResolveSong(Entry &entry, unsigned position,
+					const SongLoader &loader,
+					DetachedSong &buffer) noexcept;
+
+	/**
+	 * Drop the least recently used entries until there are no
+	 * more than #MAX_ENTRIES, except for the given one.  Dirty
+	 * entries are flushed before.
+	 */
+	void Shrink(const Entry &keep) noexcept;
+};
+
+#endif
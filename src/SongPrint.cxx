@@ -30,6 +30,9 @@
 #include "fs/Traits.hxx"
 #include "util/ChronoUtil.hxx"
 #include "util/UriUtil.hxx"
+#include "system/ByteOrder.hxx"
+
+#include <string>
 
 #define SONG_FILE "file: "
 
@@ -46,15 +49,22 @@ song_print_uri(Response &r, const char *uri, bool base) noexcept
 			uri = allocated.c_str();
 	}
 
-	r.Format(SONG_FILE "%s\n", uri);
+	r.WriteField(FrameField::SONG, "file", uri);
 }
 
 void
 song_print_uri(Response &r, const LightSong &song, bool base) noexcept
 {
-	if (!base && song.directory != nullptr)
-		r.Format(SONG_FILE "%s/%s\n", song.directory, song.uri);
-	else
+	if (!base && song.directory != nullptr) {
+		if (r.IsBinary()) {
+			std::string uri(song.directory);
+			uri.push_back('/');
+			uri.append(song.uri);
+			r.WriteField(FrameField::SONG, "file", uri.c_str());
+		} else
+			r.Format(SONG_FILE "%s/%s\n",
+				 song.directory, song.uri);
+	} else
 		song_print_uri(r, song.uri, base);
 }
 
@@ -70,7 +80,15 @@ PrintRange(Response &r, SongTime start_time, SongTime end_time) noexcept
 	const unsigned start_ms = start_time.ToMS();
 	const unsigned end_ms = end_time.ToMS();
 
-	if (end_ms > 0)
+	if (r.IsBinary()) {
+		if (start_ms > 0 || end_ms > 0) {
+			const uint32_t value[2] = {
+				ToBE32(start_ms), ToBE32(end_ms),
+			};
+			r.WriteBinaryField(FrameField::RANGE,
+					   value, sizeof(value));
+		}
+	} else if (end_ms > 0)
 		r.Format("Range: %u.%03u-%u.%03u\n",
 			 start_ms / 1000,
 			 start_ms % 1000,
@@ -90,10 +108,11 @@ song_print_info(Response &r, const LightSong &song, bool base) noexcept
 	PrintRange(r, song.start_time, song.end_time);
 
 	if (!IsNegative(song.mtime))
-		time_print(r, "Last-Modified", song.mtime);
+		time_print_last_modified(r, song.mtime);
 
 	if (song.audio_format.IsDefined())
-		r.Format("Format: %s\n", ToString(song.audio_format).c_str());
+		r.WriteField(FrameField::FORMAT, "Format",
+			     ToString(song.audio_format).c_str());
 
 	tag_print(r, song.tag);
 }
@@ -106,14 +125,9 @@ song_print_info(Response &r, const DetachedSong &song, bool base) noexcept
 	PrintRange(r, song.GetStartTime(), song.GetEndTime());
 
 	if (!IsNegative(song.GetLastModified()))
-		time_print(r, "Last-Modified", song.GetLastModified());
+		time_print_last_modified(r, song.GetLastModified());
 
 	tag_print_values(r, song.GetTag());
 
-	const auto duration = song.GetDuration();
-	if (!duration.IsNegative())
-		r.Format("Time: %i\n"
-			 "duration: %1.3f\n",
-			 duration.RoundS(),
-			 duration.ToDoubleS());
+	tag_print_duration(r, song.GetDuration());
 }
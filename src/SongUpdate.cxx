@@ -156,8 +156,8 @@ DetachedSong::LoadFile(Path path) noexcept
 	if (!ScanFileTagsWithGeneric(path, tag_builder))
 		return false;
 
-	mtime = fi.GetModificationTime();
-	tag_builder.Commit(tag);
+	SetLastModified(fi.GetModificationTime());
+	tag_builder.Commit(WritableTag());
 	return true;
 }
 
@@ -173,11 +173,11 @@ DetachedSong::Update() noexcept
 		return LoadFile(path_fs);
 	} else if (IsRemote()) {
 		TagBuilder tag_builder;
-		if (!tag_stream_scan(uri.c_str(), tag_builder))
+		if (!tag_stream_scan(GetURI(), tag_builder))
 			return false;
 
-		mtime = std::chrono::system_clock::time_point::min();
-		tag_builder.Commit(tag);
+		SetLastModified(std::chrono::system_clock::time_point::min());
+		tag_builder.Commit(WritableTag());
 		return true;
 	} else
 		// TODO: implement
@@ -22,6 +22,7 @@
 #include "tag/Tag.hxx"
 #include "tag/Settings.hxx"
 #include "client/Response.hxx"
+#include "system/ByteOrder.hxx"
 
 void
 tag_print_types(Response &r) noexcept
@@ -34,7 +35,7 @@ tag_print_types(Response &r) noexcept
 void
 tag_print(Response &r, TagType type, const char *value) noexcept
 {
-	r.Format("%s: %s\n", tag_item_names[type], value);
+	r.WriteTag(type, value);
 }
 
 void
@@ -47,13 +48,25 @@ tag_print_values(Response &r, const Tag &tag) noexcept
 }
 
 void
-tag_print(Response &r, const Tag &tag) noexcept
+tag_print_duration(Response &r, SignedSongTime duration) noexcept
 {
-	if (!tag.duration.IsNegative())
+	if (duration.IsNegative())
+		return;
+
+	if (r.IsBinary()) {
+		const uint32_t value = ToBE32(duration.ToMS());
+		r.WriteBinaryField(FrameField::DURATION,
+				   &value, sizeof(value));
+	} else
 		r.Format("Time: %i\n"
 			 "duration: %1.3f\n",
-			 tag.duration.RoundS(),
-			 tag.duration.ToDoubleS());
+			 duration.RoundS(),
+			 duration.ToDoubleS());
+}
 
+void
+tag_print(Response &r, const Tag &tag) noexcept
+{
+	tag_print_duration(r, tag.duration);
 	tag_print_values(r, tag);
 }
@@ -26,6 +26,7 @@ enum TagType : uint8_t;
 
 struct Tag;
 class Response;
+class SignedSongTime;
 
 void
 tag_print_types(Response &response) noexcept;
@@ -36,6 +37,13 @@ tag_print(Response &response, TagType type, const char *value) noexcept;
 void
 tag_print_values(Response &response, const Tag &tag) noexcept;
 
+/**
+ * Print the "Time" and "duration" attributes, unless the duration is
+ * negative (i.e. unknown).
+ */
+void
+tag_print_duration(Response &response, SignedSongTime duration) noexcept;
+
 void
 tag_print(Response &response, const Tag &tag) noexcept;
 
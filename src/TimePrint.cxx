@@ -21,6 +21,9 @@
 #include "TimePrint.hxx"
 #include "client/Response.hxx"
 #include "util/TimeISO8601.hxx"
+#include "system/ByteOrder.hxx"
+
+#include <stdint.h>
 
 void
 time_print(Response &r, const char *name,
@@ -36,3 +39,16 @@ time_print(Response &r, const char *name,
 
 	r.Format("%s: %s\n", name, s.c_str());
 }
+
+void
+time_print_last_modified(Response &r,
+			 std::chrono::system_clock::time_point t)
+{
+	if (r.IsBinary()) {
+		const uint64_t value =
+			ToBE64(std::chrono::system_clock::to_time_t(t));
+		r.WriteBinaryField(FrameField::LAST_MODIFIED,
+				   &value, sizeof(value));
+	} else
+		time_print(r, "Last-Modified", t);
+}
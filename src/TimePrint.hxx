@@ -33,4 +33,11 @@ void
 time_print(Response &r, const char *name,
 	   std::chrono::system_clock::time_point t);
 
+/**
+ * Write the "Last-Modified" attribute of a song or directory.
+ */
+void
+time_print_last_modified(Response &r,
+			 std::chrono::system_clock::time_point t);
+
 #endif
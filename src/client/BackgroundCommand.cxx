@@ -0,0 +1,244 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "BackgroundCommand.hxx"
+#include "WorkerPool.hxx"
+#include "BackgroundCommandHandler.hxx"
+#include "ClientInternal.hxx"
+#include "command/AllCommands.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+/**
+ * The worker thread waits for the main thread when this many bytes
+ * are pending.  The main thread hands the pending output to an
+ * empty socket buffer, therefore this is also limited to half of
+ * #client_max_output_buffer_size.
+ */
+static constexpr size_t MAX_PENDING = 256 * 1024;
+
+gcc_pure
+static size_t
+GetMaxPending() noexcept
+{
+	return std::min(MAX_PENDING, client_max_output_buffer_size / 2);
+}
+
+/**
+ * The command being executed by the current worker thread.
+ */
+static thread_local BackgroundCommand *current_command;
+
+BackgroundCommand::BackgroundCommand(CommandWorkerPool &_pool,
+				     Client &_client,
+				     BackgroundCommandHandler &_handler,
+				     const char *_line, size_t length,
+				     unsigned _list_index) noexcept
+	:pool(_pool), client(_client), handler(_handler),
+	 defer(client.GetInstance().event_loop, BIND_THIS_METHOD(OnDeferred)),
+	 line(_line, length), binary(client.binary),
+	 list_index(_list_index)
+{
+}
+
+BackgroundCommand *
+BackgroundCommand::GetCurrent() noexcept
+{
+	return current_command;
+}
+
+BackgroundCommand::~BackgroundCommand() noexcept
+{
+	pool.Cancel(*this);
+}
+
+void
+BackgroundCommand::Start()
+{
+	pool.Push(*this);
+}
+
+void
+BackgroundCommand::Cancel() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		cancel = true;
+		output.clear();
+		drained_cond.signal();
+	}
+
+	const std::lock_guard<Mutex> protect(pool.mutex);
+	if (state == State::QUEUED) {
+		/* not yet started: finish it right now */
+		pool.queue.remove(this);
+		state = State::DONE;
+		result = CommandResult::CLOSE;
+		SetFinished();
+	}
+}
+
+void
+BackgroundCommand::SetFinished() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		finished = true;
+	}
+
+	defer.Schedule();
+}
+
+bool
+BackgroundCommand::Write(const void *data, size_t length) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (cancel || overflow)
+		return false;
+
+	if (output.size() + length > client_max_output_buffer_size) {
+		overflow = true;
+		output.clear();
+		defer.Schedule();
+		return false;
+	}
+
+	output.append((const char *)data, length);
+
+	/* hand the output over to the main thread in pieces, to keep
+	   the memory usage low while a large response is being
+	   generated */
+	if (output.size() >= GetMaxPending() / 4) {
+		defer.Schedule();
+
+#ifdef ENABLE_DATABASE
+		if (holding_db_lock())
+			/* don't block other threads which need the
+			   database lock; the database walk calls
+			   db_yield(), which waits in Yield() after
+			   releasing the lock */
+			return !cancel;
+#endif
+
+		WaitDrained();
+	}
+
+	return !cancel;
+}
+
+inline void
+BackgroundCommand::WaitDrained() noexcept
+{
+	const size_t max_pending = GetMaxPending();
+	if (output.size() < max_pending || cancel)
+		return;
+
+	/* this may take forever if the client doesn't read; let
+	   the pool run other commands meanwhile (unlocking our mutex
+	   first, because the pool calls SetFinished() with its own
+	   mutex held) */
+	{
+		const ScopeUnlock unlock(mutex);
+		pool.BeginWait();
+	}
+
+	while (output.size() >= max_pending && !cancel)
+		drained_cond.wait(mutex);
+
+	{
+		const ScopeUnlock unlock(mutex);
+		pool.EndWait();
+	}
+}
+
+#ifdef ENABLE_DATABASE
+
+bool
+BackgroundCommand::ShouldYield() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	return !cancel && output.size() >= GetMaxPending();
+}
+
+void
+BackgroundCommand::Yield() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	WaitDrained();
+}
+
+#endif
+
+bool
+BackgroundCommand::TakeOutput(std::string &dest) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	dest.swap(output);
+	drained_cond.signal();
+	return finished;
+}
+
+bool
+BackgroundCommand::HasOverflowed() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+	return overflow;
+}
+
+void
+BackgroundCommand::Run() noexcept
+{
+	FormatDebug(client_domain, "[%u] process command \"%s\" in background",
+		    client.num, line.c_str());
+
+	current_command = this;
+#ifdef ENABLE_DATABASE
+	db_yield_handler = this;
+#endif
+
+	try {
+		result = binary
+			? command_process_frame(client, list_index,
+						&line.front(), line.size())
+			: command_process(client, list_index, &line.front());
+	} catch (...) {
+		LogError(std::current_exception());
+		result = CommandResult::CLOSE;
+	}
+
+	current_command = nullptr;
+#ifdef ENABLE_DATABASE
+	db_yield_handler = nullptr;
+#endif
+
+	FormatDebug(client_domain, "[%u] command returned %i",
+		    client.num, int(result));
+}
+
+void
+BackgroundCommand::OnDeferred() noexcept
+{
+	/* this call may destroy this object */
+	handler.OnBackgroundCommandReady(*this);
+}
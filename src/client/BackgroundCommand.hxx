@@ -0,0 +1,235 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_BACKGROUND_COMMAND_HXX
+#define MPD_CLIENT_BACKGROUND_COMMAND_HXX
+
+#include "check.h"
+#include "command/CommandResult.hxx"
+#include "event/DeferEvent.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
+
+#include <string>
+
+#include <stddef.h>
+
+class Client;
+class CommandWorkerPool;
+class BackgroundCommandHandler;
+
+/**
+ * A command which is executed by a #CommandWorkerPool thread.  The
+ * response is collected in a buffer and handed over to the main
+ * thread, which appends it to the client's output buffer.  When the
+ * client does not read fast enough, the worker thread waits, which
+ * keeps the memory usage per client bounded for any response size.
+ * It never waits while holding the database lock; instead, the
+ * database walk releases the lock at the next song or directory (see
+ * db_yield()).
+ *
+ * The handler decides when to take the output; e.g. #CommandPipeline
+ * lets only one command at a time send its response, and the others
+ * wait for their turn.
+ *
+ * The object is owned by its #BackgroundCommandHandler.  Its
+ * destructor cancels the command and waits for the worker thread to
+ * release it; the handler normally destroys it only after it has
+ * finished, so this blocks only during shutdown.
+ */
+class BackgroundCommand final
+#ifdef ENABLE_DATABASE
+	: DatabaseYieldHandler
+#endif
+{
+	friend class CommandWorkerPool;
+
+	CommandWorkerPool &pool;
+
+	Client &client;
+
+	BackgroundCommandHandler &handler;
+
+	/**
+	 * Invokes BackgroundCommandHandler::OnBackgroundCommandReady()
+	 * in the main thread when there is new output, or when the
+	 * command has finished.
+	 */
+	DeferEvent defer;
+
+	/**
+	 * A copy of the command line (or the #FrameType::COMMAND
+	 * payload); command_process() modifies it.
+	 */
+	std::string line;
+
+	/**
+	 * Was the command received in binary mode?
+	 */
+	const bool binary;
+
+	/**
+	 * The position in the command list; used for error messages.
+	 */
+	const unsigned list_index;
+
+	/**
+	 * Protected by CommandWorkerPool::mutex.
+	 */
+	enum class State {
+		QUEUED,
+		RUNNING,
+		DONE,
+	} state = State::QUEUED;
+
+	/**
+	 * Protects the following attributes.  Each command has its
+	 * own lock, so worker threads producing output do not contend
+	 * with each other.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled when the main thread has taken the #output, or
+	 * when the command has been cancelled.
+	 */
+	Cond drained_cond;
+
+	/**
+	 * Has the worker thread returned from Run()?
+	 */
+	bool finished = false;
+
+	/**
+	 * Set by the main thread when the client has gone away; the
+	 * remaining output is discarded.
+	 */
+	bool cancel = false;
+
+	/**
+	 * Set when the response has exceeded
+	 * #client_max_output_buffer_size.
+	 */
+	bool overflow = false;
+
+	/**
+	 * Output which has not yet been taken by the main thread.
+	 */
+	std::string output;
+
+	CommandResult result;
+
+public:
+	BackgroundCommand(CommandWorkerPool &_pool, Client &_client,
+			  BackgroundCommandHandler &_handler,
+			  const char *_line, size_t length,
+			  unsigned _list_index) noexcept;
+	~BackgroundCommand() noexcept;
+
+	BackgroundCommand(const BackgroundCommand &) = delete;
+	BackgroundCommand &operator=(const BackgroundCommand &) = delete;
+
+	/**
+	 * Returns the command which is being executed by the current
+	 * thread, or nullptr if this is not a worker thread.
+	 */
+	static BackgroundCommand *GetCurrent() noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void Start();
+
+	/**
+	 * Discard all output.  A command which has not been started
+	 * yet is removed from the queue; a running one continues
+	 * until the database visitor finishes.
+	 */
+	void Cancel() noexcept;
+
+	/**
+	 * Ask the main thread to call OnBackgroundCommandReady()
+	 * again, e.g. after the socket's output buffer has been
+	 * drained.
+	 */
+	void Wake() noexcept {
+		defer.Schedule();
+	}
+
+	/**
+	 * Append response data.  Called by Client::Write() in the
+	 * worker thread.  Blocks while too much output is pending.
+	 *
+	 * @return false if the data was discarded
+	 */
+	bool Write(const void *data, size_t length) noexcept;
+
+	/**
+	 * Move the output which was produced so far to the given
+	 * string.  Main thread only.
+	 *
+	 * @return true if the command has finished
+	 */
+	bool TakeOutput(std::string &dest) noexcept;
+
+	/**
+	 * Has the response exceeded the output buffer size limit?
+	 * Main thread only.
+	 */
+	bool HasOverflowed() noexcept;
+
+	/**
+	 * The result of command_process().  Only valid after
+	 * TakeOutput() has returned true.
+	 */
+	CommandResult GetResult() const noexcept {
+		return result;
+	}
+
+private:
+	/* called by CommandWorkerPool::Run() */
+	void Run() noexcept;
+
+	/**
+	 * Wait until the main thread has taken the #output or the
+	 * command has been cancelled.  Caller must lock the #mutex.
+	 */
+	void WaitDrained() noexcept;
+
+	/**
+	 * Called by #CommandWorkerPool (with its mutex locked) after
+	 * Run() has returned, or when a queued command is cancelled.
+	 */
+	void SetFinished() noexcept;
+
+	/* DeferEvent callback */
+	void OnDeferred() noexcept;
+
+#ifdef ENABLE_DATABASE
+	/* virtual methods from class DatabaseYieldHandler */
+	bool ShouldYield() noexcept override;
+	void Yield() noexcept override;
+#endif
+};
+
+#endif
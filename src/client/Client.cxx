@@ -19,12 +19,29 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "BackgroundCommand.hxx"
+#include "Pipeline.hxx"
+
+#ifdef ENABLE_ZLIB
+#include "Compression.hxx"
+#endif
 #include "util/Domain.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 
 const Domain client_domain("client");
 
+Client::~Client() noexcept
+{
+	/* wait for the worker thread before anything it may use
+	   gets destroyed */
+	background_command.reset();
+	pipeline.reset();
+
+	if (FullyBufferedSocket::IsDefined())
+		FullyBufferedSocket::Close();
+}
+
 Instance &
 Client::GetInstance() noexcept
 {
@@ -22,7 +22,11 @@
 
 #include "check.h"
 #include "ClientMessage.hxx"
+#include "Cursor.hxx"
+#include "BackgroundCommandHandler.hxx"
 #include "command/CommandListBuilder.hxx"
+#include "command/CommandResult.hxx"
+#include "protocol/BinaryFrame.hxx"
 #include "tag/Mask.hxx"
 #include "event/FullyBufferedSocket.hxx"
 #include "event/TimerEvent.hxx"
@@ -34,6 +38,7 @@
 #include <set>
 #include <string>
 #include <list>
+#include <memory>
 
 #include <stddef.h>
 
@@ -42,20 +47,55 @@ class SocketAddress;
 class UniqueSocketDescriptor;
 class EventLoop;
 class Path;
+class FileDescriptor;
 struct Instance;
 struct Partition;
 class PlayerControl;
 struct playlist;
 class Database;
 class Storage;
+class BackgroundCommand;
+class CommandPipeline;
+class IdleResponseCache;
+class ClientCompression;
 
 class Client final
-	: FullyBufferedSocket,
+	: FullyBufferedSocket, BackgroundCommandHandler,
 	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
 	TimerEvent timeout_event;
 
 	Partition *partition;
 
+	/**
+	 * The command which is currently being executed by a
+	 * #CommandWorkerPool thread.  While this is set, no input is
+	 * processed.
+	 */
+	std::unique_ptr<BackgroundCommand> background_command;
+
+	/**
+	 * The command list which is currently being executed in
+	 * pipeline mode.  While this is set, no input is processed.
+	 */
+	std::unique_ptr<CommandPipeline> pipeline;
+
+	friend class CommandPipeline;
+
+#ifdef ENABLE_ZLIB
+	/**
+	 * Set by the "compress" command; compression will be enabled
+	 * after its "OK" response has been sent.
+	 */
+	bool compression_requested = false;
+
+	/**
+	 * Non-nullptr if the client has enabled compression.
+	 */
+	std::unique_ptr<ClientCompression> compression;
+
+	friend class ClientCompression;
+#endif
+
 public:
 	unsigned permission;
 
@@ -66,6 +106,12 @@ public:
 
 	const unsigned int num;	/* client number */
 
+	/**
+	 * Has the client switched to the binary framed protocol with
+	 * the "binarymode" command?
+	 */
+	bool binary = false;
+
 	/** is this client waiting for an "idle" response? */
 	bool idle_waiting = false;
 
@@ -97,15 +143,17 @@ public:
 	 */
 	std::list<ClientMessage> messages;
 
+	/**
+	 * Query results which are being fetched page by page.
+	 */
+	CursorTable cursors;
+
 	Client(EventLoop &loop, Partition &partition,
 	       UniqueSocketDescriptor fd, int uid,
 	       unsigned _permission,
 	       int num) noexcept;
 
-	~Client() noexcept {
-		if (FullyBufferedSocket::IsDefined())
-			FullyBufferedSocket::Close();
-	}
+	~Client() noexcept;
 
 	bool IsConnected() const noexcept {
 		return FullyBufferedSocket::IsDefined();
@@ -126,6 +174,38 @@ public:
 	 */
 	bool Write(const char *data);
 
+	/**
+	 * Write a binary protocol frame (see #FrameHeader).
+	 */
+	bool WriteFrame(FrameType type, uint8_t id,
+			const void *data, size_t length);
+
+#ifndef _WIN32
+	/**
+	 * Write a portion of a regular file.  If possible, the data
+	 * is transferred with sendfile() from the file to the socket,
+	 * without copying it through the output buffer.
+	 *
+	 * If the file cannot be read, the response cannot be
+	 * completed, and the client is closed.
+	 */
+	bool WriteFile(FileDescriptor file, off_t offset, size_t length);
+#endif
+
+#ifdef ENABLE_ZLIB
+	bool IsCompressed() const noexcept {
+		return compression != nullptr;
+	}
+
+	/**
+	 * Compress all input and output after the response to the
+	 * current command.
+	 */
+	void RequestCompression() noexcept {
+		compression_requested = true;
+	}
+#endif
+
 	/**
 	 * returns the uid of the client process, or a negative value
 	 * if the uid is unknown
@@ -154,6 +234,13 @@ public:
 	 * Send "idle" response to this client.
 	 */
 	void IdleNotify() noexcept;
+	void IdleNotify(IdleResponseCache &cache) noexcept;
+
+	/**
+	 * @param cache responses shared with other clients which are
+	 * notified about the same event
+	 */
+	void IdleAdd(unsigned flags, IdleResponseCache &cache) noexcept;
 	void IdleAdd(unsigned flags) noexcept;
 	bool IdleWait(unsigned flags) noexcept;
 
@@ -227,12 +314,110 @@ public:
 	gcc_pure
 	const Storage *GetStorage() const noexcept;
 
+	/**
+	 * Attempt to execute the given command line (or
+	 * #FrameType::COMMAND payload in binary mode) in a
+	 * #CommandWorkerPool thread.
+	 *
+	 * @return true if the command has been started, false if it
+	 * must be executed synchronously
+	 */
+	bool StartBackgroundCommand(const char *line, size_t length) noexcept;
+
+	/**
+	 * May the given command line be executed by a
+	 * #CommandWorkerPool thread?
+	 */
+	gcc_pure
+	bool CanRunInBackground(const char *line) const noexcept;
+
+	/**
+	 * Execute a command list in pipeline mode (see
+	 * #CommandPipeline).
+	 *
+	 * @return #CommandResult::BACKGROUND if commands are still
+	 * running in the worker pool
+	 */
+	CommandResult StartPipeline(std::list<std::string> &&list) noexcept;
+
+	/**
+	 * Discard the output of all commands running in the
+	 * #CommandWorkerPool, without waiting for them.  Called
+	 * before destroying many clients at once, to let their
+	 * commands finish concurrently.
+	 */
+	void CancelAsyncCommands() noexcept;
+
 private:
+	/**
+	 * Send all pending output to the socket.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	bool FlushOutput() noexcept;
+
+#ifdef ENABLE_ZLIB
+	void EnableCompression() noexcept;
+
+	/**
+	 * Called by #ClientCompression to write compressed data to the
+	 * output buffer.
+	 */
+	bool WriteCompressed(const void *data, size_t length) noexcept {
+		return FullyBufferedSocket::Write(data, length);
+	}
+
+	/**
+	 * Decompress received data and process the commands in it.
+	 */
+	InputResult OnCompressedInput(void *data, size_t length) noexcept;
+
+	/**
+	 * Process the commands in the #ClientCompression input
+	 * buffer.
+	 *
+	 * @return #InputResult::MORE if the buffer does not contain a
+	 * complete command
+	 */
+	InputResult ProcessDecompressedInput() noexcept;
+#endif
+
+	/**
+	 * Mark a portion of the buffer passed to ProcessInput() as
+	 * consumed.
+	 */
+	void ConsumeProtocolInput(size_t nbytes) noexcept;
+
+	/**
+	 * Parse and execute one command from the given (uncompressed)
+	 * input.
+	 */
+	InputResult ProcessInput(char *p, size_t length) noexcept;
+
+	/**
+	 * Called by #CommandPipeline when its background commands
+	 * have finished.  May destroy this object.
+	 */
+	void OnPipelineReady() noexcept;
+
+	/**
+	 * A command which was executed asynchronously has finished:
+	 * send "OK" or close the connection, and resume processing
+	 * input.  May destroy this object.
+	 */
+	void OnAsyncCommandFinished(CommandResult result) noexcept;
+
+	/* virtual methods from class BackgroundCommandHandler */
+	void OnBackgroundCommandReady(BackgroundCommand &cmd) noexcept override;
+
 	/* virtual methods from class BufferedSocket */
 	InputResult OnSocketInput(void *data, size_t length) noexcept override;
 	void OnSocketError(std::exception_ptr ep) noexcept override;
 	void OnSocketClosed() noexcept override;
 
+	/* virtual methods from class FullyBufferedSocket */
+	void OnSocketOutputDrained() noexcept override;
+
 	/* callback for TimerEvent */
 	void OnTimeout() noexcept;
 };
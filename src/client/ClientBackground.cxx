@@ -0,0 +1,242 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientInternal.hxx"
+#include "ClientList.hxx"
+#include "BackgroundCommand.hxx"
+#include "Pipeline.hxx"
+#include "command/AllCommands.hxx"
+#include "protocol/Result.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#endif
+
+bool
+Client::CanRunInBackground(const char *line) const noexcept
+{
+#ifdef ENABLE_DATABASE
+	if (!command_may_run_in_background(line))
+		return false;
+
+	const Database *db = GetDatabase();
+	return db != nullptr && db->GetPlugin().IsThreadSafe();
+#else
+	(void)line;
+	return false;
+#endif
+}
+
+bool
+Client::StartBackgroundCommand(const char *line, size_t length) noexcept
+{
+	assert(background_command == nullptr);
+
+	if (!CanRunInBackground(line))
+		return false;
+
+	auto &pool = partition->instance.client_list->GetWorkerPool();
+	background_command.reset(new BackgroundCommand(pool, *this, *this,
+						       line, length, 0));
+
+	try {
+		background_command->Start();
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to start worker thread");
+		background_command.reset();
+		return false;
+	}
+
+	return true;
+}
+
+CommandResult
+Client::StartPipeline(std::list<std::string> &&list) noexcept
+{
+	assert(pipeline == nullptr);
+
+	auto &pool = partition->instance.client_list->GetWorkerPool();
+	pipeline.reset(new CommandPipeline(*this, pool, std::move(list)));
+
+	const CommandResult result = pipeline->Run();
+	if (result != CommandResult::BACKGROUND && pipeline->IsIdle())
+		pipeline.reset();
+
+	/* if the pipeline is stopped while commands are still
+	   running, Close() waits for them */
+	return result;
+}
+
+void
+Client::CancelAsyncCommands() noexcept
+{
+	if (background_command != nullptr)
+		background_command->Cancel();
+
+	if (pipeline != nullptr)
+		pipeline->Cancel();
+}
+
+void
+Client::OnPipelineReady() noexcept
+{
+	assert(pipeline != nullptr);
+	assert(pipeline->IsIdle());
+
+	if (IsExpired()) {
+		pipeline.reset();
+		Close();
+		return;
+	}
+
+	const CommandResult result = pipeline->Run();
+	if (result == CommandResult::BACKGROUND)
+		return;
+
+	if (pipeline->IsIdle())
+		pipeline.reset();
+
+	OnAsyncCommandFinished(result);
+}
+
+void
+Client::OnBackgroundCommandReady(gcc_unused BackgroundCommand &cmd) noexcept
+{
+	assert(background_command != nullptr);
+	assert(&cmd == background_command.get());
+
+	if (!IsExpired() && !IsOutputEmpty())
+		/* the client is slow; wait for
+		   OnSocketOutputDrained() */
+		return;
+
+	std::string data;
+	const bool finished = background_command->TakeOutput(data);
+
+	if (!IsExpired()) {
+		if (background_command->HasOverflowed()) {
+			FormatWarning(client_domain,
+				      "[%u] output buffer size is "
+				      "larger than the max (%lu)",
+				      num,
+				      (unsigned long)client_max_output_buffer_size);
+			background_command->Cancel();
+			SetExpired();
+		} else if (!data.empty())
+			Write(data.data(), data.size());
+	}
+
+	if (!finished)
+		return;
+
+	const CommandResult result = background_command->GetResult();
+	background_command.reset();
+
+	OnAsyncCommandFinished(result);
+}
+
+void
+Client::OnAsyncCommandFinished(CommandResult result) noexcept
+{
+	if (IsExpired()) {
+		Close();
+		return;
+	}
+
+	switch (result) {
+	case CommandResult::OK:
+		command_success(*this);
+		break;
+
+	case CommandResult::IDLE:
+	case CommandResult::ERROR:
+	case CommandResult::BACKGROUND:
+		break;
+
+	case CommandResult::KILL:
+		partition->instance.Break();
+		Close();
+		return;
+
+	case CommandResult::FINISH:
+		if (FlushOutput())
+			Close();
+		return;
+
+	case CommandResult::CLOSE:
+		Close();
+		return;
+	}
+
+	if (IsExpired()) {
+		Close();
+		return;
+	}
+
+	/* process the commands which were received in the
+	   meantime */
+	timeout_event.Schedule(client_timeout);
+
+#ifdef ENABLE_ZLIB
+	if (compression_requested) {
+		EnableCompression();
+		if (IsExpired()) {
+			Close();
+			return;
+		}
+	}
+
+	if (compression != nullptr) {
+		/* commands which have already been decompressed are
+		   not in the socket's input buffer */
+		switch (ProcessDecompressedInput()) {
+		case InputResult::MORE:
+			break;
+
+		case InputResult::AGAIN:
+		case InputResult::PAUSE:
+		case InputResult::CLOSED:
+			return;
+		}
+	}
+#endif
+
+	ResumeInput();
+}
+
+void
+Client::OnSocketOutputDrained() noexcept
+{
+	if (background_command != nullptr) {
+		/* the client is still reading; don't let it time
+		   out */
+		timeout_event.Schedule(client_timeout);
+
+		background_command->Wake();
+	} else if (pipeline != nullptr && !pipeline->IsIdle()) {
+		timeout_event.Schedule(client_timeout);
+		pipeline->OnOutputDrained();
+	}
+}
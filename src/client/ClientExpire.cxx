@@ -34,6 +34,13 @@ Client::SetExpired() noexcept
 void
 Client::OnTimeout() noexcept
 {
+	if ((background_command != nullptr || pipeline != nullptr) &&
+	    !IsExpired() && IsOutputEmpty()) {
+		/* the client is waiting for a (slow) response */
+		timeout_event.Schedule(client_timeout);
+		return;
+	}
+
 	if (!IsExpired()) {
 		assert(!idle_waiting);
 		FormatDebug(client_domain, "[%u] timeout", num);
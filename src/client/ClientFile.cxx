@@ -19,12 +19,72 @@
 
 #include "config.h"
 #include "Client.hxx"
+#include "BackgroundCommand.hxx"
+#include "Log.hxx"
 #include "protocol/Ack.hxx"
 #include "fs/Path.hxx"
 #include "fs/FileInfo.hxx"
+#include "system/FileDescriptor.hxx"
+#include "system/Error.hxx"
+#include "util/Domain.hxx"
+
+#include <algorithm>
 
 #include <unistd.h>
 
+#ifndef _WIN32
+
+static constexpr Domain client_file_domain("client_file");
+
+bool
+Client::WriteFile(FileDescriptor file, off_t offset, size_t length)
+{
+#ifdef __linux__
+	if (BackgroundCommand::GetCurrent() == nullptr && !IsExpired()
+#ifdef ENABLE_ZLIB
+	    && compression == nullptr
+#endif
+	    ) {
+		const auto nbytes = SendFile(file, offset, length);
+		if (nbytes < 0)
+			/* the socket has been closed */
+			return false;
+
+		offset += nbytes;
+		length -= nbytes;
+	}
+#endif
+
+	/* copy the rest through the output buffer; this happens if
+	   the socket is not ready, if the output needs to be
+	   compressed or if a worker thread runs the command */
+	while (length > 0) {
+		char buffer[8192];
+		const auto nbytes = pread(file.Get(), buffer,
+					  std::min(length, sizeof(buffer)),
+					  offset);
+		if (nbytes <= 0) {
+			if (nbytes < 0)
+				LogError(MakeErrno("Failed to read file"));
+			else
+				LogError(client_file_domain,
+					 "File was truncated while sending it");
+			SetExpired();
+			return false;
+		}
+
+		if (!Write(buffer, nbytes))
+			return false;
+
+		offset += nbytes;
+		length -= nbytes;
+	}
+
+	return true;
+}
+
+#endif
+
 void
 Client::AllowFile(Path path_fs) const
 {
@@ -19,25 +19,54 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
-#include "Response.hxx"
+#include "IdleCache.hxx"
 #include "Idle.hxx"
+#include "protocol/BinaryFrame.hxx"
 
 #include <assert.h>
 
-static void
-WriteIdleResponse(Response &r, unsigned flags) noexcept
+static std::string
+RenderIdleResponse(unsigned flags, bool binary)
 {
+	std::string text;
+
 	const char *const*idle_names = idle_get_names();
 	for (unsigned i = 0; idle_names[i]; ++i) {
-		if (flags & (1 << i))
-			r.Format("changed: %s\n", idle_names[i]);
+		if (flags & (1 << i)) {
+			text.append("changed: ");
+			text.append(idle_names[i]);
+			text.push_back('\n');
+		}
+	}
+
+	if (!binary) {
+		text.append("OK\n");
+		return text;
 	}
 
-	r.Write("OK\n");
+	const FrameHeader text_header(FrameType::TEXT, 0, text.size());
+	const FrameHeader ok_header(FrameType::OK, 0, 0);
+
+	std::string response((const char *)&text_header,
+			     sizeof(text_header));
+	response.append(text);
+	response.append((const char *)&ok_header, sizeof(ok_header));
+	return response;
+}
+
+const std::string &
+IdleResponseCache::Get(unsigned flags, bool binary)
+{
+	for (const auto &i : items)
+		if (i.flags == flags && i.binary == binary)
+			return i.response;
+
+	items.emplace_front(flags, binary, RenderIdleResponse(flags, binary));
+	return items.front().response;
 }
 
 void
-Client::IdleNotify() noexcept
+Client::IdleNotify(IdleResponseCache &cache) noexcept
 {
 	assert(idle_waiting);
 	assert(idle_flags != 0);
@@ -45,21 +74,41 @@ Client::IdleNotify() noexcept
 	unsigned flags = std::exchange(idle_flags, 0) & idle_subscriptions;
 	idle_waiting = false;
 
-	Response r(*this, 0);
-	WriteIdleResponse(r, flags);
+	try {
+		const auto &response = cache.Get(flags, binary);
+		Write(response.data(), response.size());
+	} catch (...) {
+		/* out of memory */
+		SetExpired();
+		return;
+	}
 
 	timeout_event.Schedule(client_timeout);
 }
 
 void
-Client::IdleAdd(unsigned flags) noexcept
+Client::IdleNotify() noexcept
+{
+	IdleResponseCache cache;
+	IdleNotify(cache);
+}
+
+void
+Client::IdleAdd(unsigned flags, IdleResponseCache &cache) noexcept
 {
 	if (IsExpired())
 		return;
 
 	idle_flags |= flags;
 	if (idle_waiting && (idle_flags & idle_subscriptions))
-		IdleNotify();
+		IdleNotify(cache);
+}
+
+void
+Client::IdleAdd(unsigned flags) noexcept
+{
+	IdleResponseCache cache;
+	IdleAdd(flags, cache);
 }
 
 bool
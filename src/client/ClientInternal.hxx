@@ -38,4 +38,10 @@ extern size_t client_max_output_buffer_size;
 CommandResult
 client_process_line(Client &client, char *line);
 
+/**
+ * Process the payload of a #FrameType::COMMAND frame in binary mode.
+ */
+CommandResult
+client_process_frame(Client &client, char *payload, size_t length);
+
 #endif
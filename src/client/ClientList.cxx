@@ -20,6 +20,7 @@
 #include "config.h"
 #include "ClientList.hxx"
 #include "ClientInternal.hxx"
+#include "IdleCache.hxx"
 #include "util/DeleteDisposer.hxx"
 
 #include <assert.h>
@@ -35,6 +36,11 @@ ClientList::Remove(Client &client)
 void
 ClientList::CloseAll()
 {
+	/* stop all worker threads first, so the client destructors
+	   don't wait for them one after another */
+	for (auto &client : list)
+		client.CancelAsyncCommands();
+
 	list.clear_and_dispose(DeleteDisposer());
 }
 
@@ -43,6 +49,10 @@ ClientList::IdleAdd(unsigned flags)
 {
 	assert(flags != 0);
 
+	/* clients which wait for the same flags share one
+	   pre-rendered response */
+	IdleResponseCache cache;
+
 	for (auto &client : list)
-		client.IdleAdd(flags);
+		client.IdleAdd(flags, cache);
 }
@@ -21,6 +21,7 @@
 #define MPD_CLIENT_LIST_HXX
 
 #include "Client.hxx"
+#include "WorkerPool.hxx"
 
 #include <boost/intrusive/list.hpp>
 
@@ -32,6 +33,8 @@ class ClientList {
 
 	List list;
 
+	CommandWorkerPool worker_pool;
+
 public:
 	ClientList(unsigned _max_size)
 		:max_size(_max_size) {}
@@ -51,6 +54,10 @@ public:
 		return list.size() >= max_size;
 	}
 
+	CommandWorkerPool &GetWorkerPool() {
+		return worker_pool;
+	}
+
 	void Add(Client &client) {
 		list.push_front(client);
 	}
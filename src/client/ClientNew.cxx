@@ -19,6 +19,12 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "BackgroundCommand.hxx"
+#include "Pipeline.hxx"
+
+#ifdef ENABLE_ZLIB
+#include "Compression.hxx"
+#endif
 #include "ClientList.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
@@ -108,6 +114,22 @@ client_new(EventLoop &loop, Partition &partition,
 void
 Client::Close() noexcept
 {
+	if (background_command != nullptr) {
+		/* a worker thread still uses this object;
+		   OnBackgroundCommandReady() will call this method
+		   again when it is done */
+		background_command->Cancel();
+		SetExpired();
+		return;
+	}
+
+	if (pipeline != nullptr && !pipeline->IsIdle()) {
+		/* same for OnPipelineReady() */
+		pipeline->Cancel();
+		SetExpired();
+		return;
+	}
+
 	partition->instance.client_list->Remove(*this);
 
 	SetExpired();
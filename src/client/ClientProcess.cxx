@@ -25,8 +25,11 @@
 #include "util/StringAPI.hxx"
 #include "util/CharUtil.hxx"
 
+#include <string.h>
+
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
 #define CLIENT_LIST_OK_MODE_BEGIN "command_list_ok_begin"
+#define CLIENT_LIST_PIPELINE_MODE_BEGIN "command_list_pipeline_begin"
 #define CLIENT_LIST_MODE_END "command_list_end"
 
 static CommandResult
@@ -51,23 +54,29 @@ client_process_command_list(Client &client, bool list_ok,
 	return ret;
 }
 
+static CommandResult
+client_process_noidle(Client &client)
+{
+	if (client.idle_waiting) {
+		/* send empty idle response and leave idle mode */
+		client.idle_waiting = false;
+		command_success(client);
+	}
+
+	/* do nothing if the client wasn't idling: the client has
+	   already received the full idle response from
+	   client_idle_notify(), which he can now evaluate */
+
+	return CommandResult::OK;
+}
+
 CommandResult
 client_process_line(Client &client, char *line)
 {
 	CommandResult ret;
 
 	if (StringIsEqual(line, "noidle")) {
-		if (client.idle_waiting) {
-			/* send empty idle response and leave idle mode */
-			client.idle_waiting = false;
-			command_success(client);
-		}
-
-		/* do nothing if the client wasn't idling: the client
-		   has already received the full idle response from
-		   client_idle_notify(), which he can now evaluate */
-
-		return CommandResult::OK;
+		return client_process_noidle(client);
 	} else if (client.idle_waiting) {
 		/* during idle mode, clients must not send anything
 		   except "noidle" */
@@ -85,6 +94,20 @@ client_process_line(Client &client, char *line)
 
 			auto &&cmd_list = client.cmd_list.Commit();
 
+			if (client.cmd_list.IsPipelineMode()) {
+				ret = client.StartPipeline(std::move(cmd_list));
+				client.cmd_list.Reset();
+
+				if (ret == CommandResult::CLOSE ||
+				    client.IsExpired())
+					return CommandResult::CLOSE;
+
+				if (ret == CommandResult::OK)
+					command_success(client);
+
+				return ret;
+			}
+
 			ret = client_process_command_list(client,
 							  client.cmd_list.IsOKMode(),
 							  std::move(cmd_list));
@@ -119,6 +142,10 @@ client_process_line(Client &client, char *line)
 		} else if (StringIsEqual(line, CLIENT_LIST_OK_MODE_BEGIN)) {
 			client.cmd_list.Begin(true);
 			ret = CommandResult::OK;
+		} else if (StringIsEqual(line,
+					 CLIENT_LIST_PIPELINE_MODE_BEGIN)) {
+			client.cmd_list.BeginPipeline();
+			ret = CommandResult::OK;
 		} else if (IsUpperAlphaASCII(*line)) {
 			/* no valid MPD command begins with an upper
 			   case letter; this could be a badly routed
@@ -127,6 +154,9 @@ client_process_line(Client &client, char *line)
 				      "[%u] malformed command \"%s\"",
 				      client.num, line);
 			ret = CommandResult::CLOSE;
+		} else if (client.StartBackgroundCommand(line,
+							 strlen(line))) {
+			ret = CommandResult::BACKGROUND;
 		} else {
 			FormatDebug(client_domain,
 				    "[%u] process command \"%s\"",
@@ -147,3 +177,41 @@ client_process_line(Client &client, char *line)
 
 	return ret;
 }
+
+CommandResult
+client_process_frame(Client &client, char *payload, size_t length)
+{
+	static constexpr char noidle[] = "noidle";
+
+	if (length == sizeof(noidle) &&
+	    memcmp(payload, noidle, sizeof(noidle)) == 0) {
+		return client_process_noidle(client);
+	} else if (client.idle_waiting) {
+		FormatWarning(client_domain,
+			      "[%u] command frame during idle",
+			      client.num);
+		return CommandResult::CLOSE;
+	}
+
+	/* malformed frames are rejected by
+	   command_process_frame() */
+	if (length > 0 && payload[length - 1] == 0 &&
+	    client.StartBackgroundCommand(payload, length))
+		return CommandResult::BACKGROUND;
+
+	FormatDebug(client_domain, "[%u] process command frame \"%s\"",
+		    client.num, length > 0 && payload[length - 1] == 0
+		    ? payload : "");
+	CommandResult ret = command_process_frame(client, 0,
+						  payload, length);
+	FormatDebug(client_domain, "[%u] command returned %i",
+		    client.num, int(ret));
+
+	if (ret == CommandResult::CLOSE || client.IsExpired())
+		return CommandResult::CLOSE;
+
+	if (ret == CommandResult::OK)
+		command_success(client);
+
+	return ret;
+}
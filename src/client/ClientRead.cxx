@@ -23,41 +23,172 @@
 #include "Instance.hxx"
 #include "event/Loop.hxx"
 #include "util/StringStrip.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_ZLIB
+#include "Compression.hxx"
+#endif
 
 #include <string.h>
 
+inline void
+Client::ConsumeProtocolInput(size_t nbytes) noexcept
+{
+#ifdef ENABLE_ZLIB
+	if (compression != nullptr) {
+		compression->ConsumeInput(nbytes);
+		return;
+	}
+#endif
+
+	BufferedSocket::ConsumeInput(nbytes);
+}
+
+#ifdef ENABLE_ZLIB
+
+void
+Client::EnableCompression() noexcept
+{
+	compression_requested = false;
+
+	try {
+		auto &loop = BufferedSocket::GetEventLoop();
+		compression.reset(new ClientCompression(loop, *this));
+	} catch (...) {
+		LogError(std::current_exception(),
+			 "Failed to enable compression");
+		SetExpired();
+	}
+}
+
+BufferedSocket::InputResult
+Client::ProcessDecompressedInput() noexcept
+{
+	while (true) {
+		const auto r = compression->ReadInput();
+		if (r.empty())
+			return InputResult::MORE;
+
+		const auto result = ProcessInput(r.data, r.size);
+		if (result != InputResult::AGAIN)
+			return result;
+	}
+}
+
+BufferedSocket::InputResult
+Client::OnCompressedInput(void *data, size_t length) noexcept
+{
+	size_t nbytes;
+
+	try {
+		nbytes = compression->Decompress(data, length);
+	} catch (...) {
+		FormatError(std::current_exception(),
+			    "[%u] failed to decompress input", num);
+		Close();
+		return InputResult::CLOSED;
+	}
+
+	BufferedSocket::ConsumeInput(nbytes);
+
+	const auto result = ProcessDecompressedInput();
+	if (result != InputResult::MORE)
+		return result;
+
+	if (compression->IsInputFull()) {
+		FormatWarning(client_domain,
+			      "[%u] decompressed input buffer is full", num);
+		Close();
+		return InputResult::CLOSED;
+	}
+
+	/* if not all of the input could be decompressed, come back
+	   to decompress the rest */
+	return nbytes < length
+		? InputResult::AGAIN
+		: InputResult::MORE;
+}
+
+#endif
+
 BufferedSocket::InputResult
 Client::OnSocketInput(void *data, size_t length) noexcept
 {
-	char *p = (char *)data;
-	char *newline = (char *)memchr(p, '\n', length);
-	if (newline == nullptr)
-		return InputResult::MORE;
+	if (background_command != nullptr || pipeline != nullptr)
+		/* wait for OnAsyncCommandFinished() */
+		return InputResult::PAUSE;
+
+#ifdef ENABLE_ZLIB
+	if (compression != nullptr)
+		return OnCompressedInput(data, length);
+#endif
+
+	return ProcessInput((char *)data, length);
+}
+
+BufferedSocket::InputResult
+Client::ProcessInput(char *p, size_t length) noexcept
+{
+	CommandResult result;
+
+	if (binary) {
+		if (length < sizeof(FrameHeader))
+			return InputResult::MORE;
+
+		FrameHeader header;
+		memcpy(&header, p, sizeof(header));
+
+		if (header.type != FrameType::COMMAND) {
+			FormatWarning(client_domain,
+				      "[%u] malformed frame", num);
+			Close();
+			return InputResult::CLOSED;
+		}
+
+		const size_t payload_length = header.GetLength();
+		if (length - sizeof(header) < payload_length)
+			return InputResult::MORE;
+
+		timeout_event.Schedule(client_timeout);
 
-	timeout_event.Schedule(client_timeout);
+		ConsumeProtocolInput(sizeof(header) + payload_length);
 
-	BufferedSocket::ConsumeInput(newline + 1 - p);
+		result = client_process_frame(*this, p + sizeof(header),
+					      payload_length);
+	} else {
+		char *newline = (char *)memchr(p, '\n', length);
+		if (newline == nullptr)
+			return InputResult::MORE;
 
-	/* skip whitespace at the end of the line */
-	char *end = StripRight(p, newline);
+		timeout_event.Schedule(client_timeout);
 
-	/* terminate the string at the end of the line */
-	*end = 0;
+		ConsumeProtocolInput(newline + 1 - p);
+
+		/* skip whitespace at the end of the line */
+		char *end = StripRight(p, newline);
+
+		/* terminate the string at the end of the line */
+		*end = 0;
+
+		result = client_process_line(*this, p);
+	}
 
-	CommandResult result = client_process_line(*this, p);
 	switch (result) {
 	case CommandResult::OK:
 	case CommandResult::IDLE:
 	case CommandResult::ERROR:
 		break;
 
+	case CommandResult::BACKGROUND:
+		return InputResult::PAUSE;
+
 	case CommandResult::KILL:
 		partition->instance.Break();
 		Close();
 		return InputResult::CLOSED;
 
 	case CommandResult::FINISH:
-		if (Flush())
+		if (FlushOutput())
 			Close();
 		return InputResult::CLOSED;
 
@@ -66,6 +197,13 @@ Client::OnSocketInput(void *data, size_t length) noexcept
 		return InputResult::CLOSED;
 	}
 
+#ifdef ENABLE_ZLIB
+	if (compression_requested)
+		/* the "OK" response to "compress" has been sent;
+		   everything after it is compressed */
+		EnableCompression();
+#endif
+
 	if (IsExpired()) {
 		Close();
 		return InputResult::CLOSED;
@@ -19,14 +19,56 @@
 
 #include "config.h"
 #include "Client.hxx"
+#include "BackgroundCommand.hxx"
+
+#ifdef ENABLE_ZLIB
+#include "Compression.hxx"
+#endif
 
 #include <string.h>
 
 bool
 Client::Write(const void *data, size_t length)
 {
+	BackgroundCommand *background = BackgroundCommand::GetCurrent();
+	if (background != nullptr)
+		/* called by a worker thread */
+		return background->Write(data, length);
+
 	/* if the client is going to be closed, do nothing */
-	return !IsExpired() && FullyBufferedSocket::Write(data, length);
+	if (IsExpired())
+		return false;
+
+#ifdef ENABLE_ZLIB
+	if (compression != nullptr) {
+		try {
+			compression->Compress(data, length);
+			return true;
+		} catch (...) {
+			SetExpired();
+			return false;
+		}
+	}
+#endif
+
+	return FullyBufferedSocket::Write(data, length);
+}
+
+bool
+Client::FlushOutput() noexcept
+{
+#ifdef ENABLE_ZLIB
+	if (compression != nullptr) {
+		try {
+			compression->Flush();
+		} catch (...) {
+			SetExpired();
+			return false;
+		}
+	}
+#endif
+
+	return Flush();
 }
 
 bool
@@ -34,3 +76,12 @@ Client::Write(const char *data)
 {
 	return Write(data, strlen(data));
 }
+
+bool
+Client::WriteFrame(FrameType type, uint8_t id,
+		   const void *data, size_t length)
+{
+	const FrameHeader header(type, id, length);
+	return Write(&header, sizeof(header)) &&
+		(length == 0 || Write(data, length));
+}
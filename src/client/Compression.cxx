@@ -0,0 +1,120 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Compression.hxx"
+#include "Client.hxx"
+#include "lib/zlib/Error.hxx"
+
+#include <stdexcept>
+
+/**
+ * The zlib compression level.  Protocol responses are very
+ * redundant, and the fastest level already compresses them well,
+ * without making the main thread a bottleneck.
+ */
+static constexpr int COMPRESSION_LEVEL = Z_BEST_SPEED;
+
+ClientCompression::ClientCompression(EventLoop &loop, Client &_client)
+	:client(_client),
+	 deflater(*this, COMPRESSION_LEVEL),
+	 flush_event(loop, BIND_THIS_METHOD(OnDeferredFlush))
+{
+	inflater.next_in = nullptr;
+	inflater.avail_in = 0;
+	inflater.zalloc = Z_NULL;
+	inflater.zfree = Z_NULL;
+	inflater.opaque = Z_NULL;
+
+	constexpr int windowBits = 15;
+	constexpr int gzip_encoding = 16;
+
+	int result = inflateInit2(&inflater, windowBits | gzip_encoding);
+	if (result != Z_OK)
+		throw ZlibError(result);
+}
+
+ClientCompression::~ClientCompression() noexcept
+{
+	inflateEnd(&inflater);
+}
+
+void
+ClientCompression::Write(const void *data, size_t length)
+{
+	if (!client.WriteCompressed(data, length))
+		throw std::runtime_error("Failed to write compressed output");
+}
+
+void
+ClientCompression::Compress(const void *data, size_t length)
+{
+	deflater.Write(data, length);
+
+	if (!dirty) {
+		dirty = true;
+		flush_event.Schedule();
+	}
+}
+
+void
+ClientCompression::Flush()
+{
+	if (!dirty)
+		return;
+
+	dirty = false;
+	flush_event.Cancel();
+	deflater.SyncFlush();
+}
+
+void
+ClientCompression::OnDeferredFlush() noexcept
+{
+	try {
+		Flush();
+	} catch (...) {
+		/* the error has already been logged by
+		   FullyBufferedSocket::Write() */
+		client.SetExpired();
+	}
+}
+
+size_t
+ClientCompression::Decompress(const void *data, size_t length)
+{
+	auto w = input.Write();
+	if (w.empty())
+		return 0;
+
+	/* zlib's API requires non-const input pointer */
+	inflater.next_in = (Bytef *)const_cast<void *>(data);
+	inflater.avail_in = length;
+	inflater.next_out = (Bytef *)w.data;
+	inflater.avail_out = w.size;
+
+	int result = inflate(&inflater, Z_SYNC_FLUSH);
+	if (result == Z_STREAM_END)
+		throw std::runtime_error("Compressed stream ended");
+	else if (result != Z_OK && result != Z_BUF_ERROR)
+		throw ZlibError(result);
+
+	input.Append((char *)inflater.next_out - w.data);
+	return length - inflater.avail_in;
+}
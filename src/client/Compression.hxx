@@ -0,0 +1,122 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_COMPRESSION_HXX
+#define MPD_CLIENT_COMPRESSION_HXX
+
+#include "check.h"
+#include "fs/io/OutputStream.hxx"
+#include "fs/io/GzipOutputStream.hxx"
+#include "event/DeferEvent.hxx"
+#include "util/StaticFifoBuffer.hxx"
+
+#include <zlib.h>
+
+#include <stddef.h>
+
+class Client;
+
+/**
+ * The state of a connection which has enabled compression with the
+ * "compress" command.  Both directions are "gzip" streams.
+ *
+ * Output is compressed into the client's output buffer; after each
+ * event loop iteration, a sync flush makes everything written so far
+ * available to the client, so response boundaries are preserved.
+ * Input is decompressed into a separate buffer which is parsed
+ * instead of the socket's input buffer.
+ */
+class ClientCompression final : OutputStream {
+	Client &client;
+
+	GzipOutputStream deflater;
+
+	z_stream inflater;
+
+	/**
+	 * Decompressed input which has not yet been parsed.
+	 */
+	StaticFifoBuffer<char, 8192> input;
+
+	/**
+	 * Invokes OnDeferredFlush() after output has been written.
+	 */
+	DeferEvent flush_event;
+
+	/**
+	 * Was data passed to the deflater since the last flush?
+	 */
+	bool dirty = false;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	ClientCompression(EventLoop &loop, Client &_client);
+	~ClientCompression() noexcept;
+
+	ClientCompression(const ClientCompression &) = delete;
+	ClientCompression &operator=(const ClientCompression &) = delete;
+
+	/**
+	 * Compress response data.
+	 *
+	 * Throws on error.
+	 */
+	void Compress(const void *data, size_t length);
+
+	/**
+	 * Pass all pending compressed data to the output buffer now.
+	 *
+	 * Throws on error.
+	 */
+	void Flush();
+
+	/**
+	 * Decompress received data into the input buffer.
+	 *
+	 * Throws on error.
+	 *
+	 * @return the number of bytes which were consumed from the
+	 * given buffer
+	 */
+	size_t Decompress(const void *data, size_t length);
+
+	StaticFifoBuffer<char, 8192>::Range ReadInput() noexcept {
+		return input.Read();
+	}
+
+	void ConsumeInput(size_t nbytes) noexcept {
+		input.Consume(nbytes);
+	}
+
+	bool IsInputFull() const noexcept {
+		return input.IsFull();
+	}
+
+private:
+	/* virtual methods from class OutputStream; receives compressed
+	   data from #deflater */
+	void Write(const void *data, size_t length) override;
+
+	/* DeferEvent callback */
+	void OnDeferredFlush() noexcept;
+};
+
+#endif
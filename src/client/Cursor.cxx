@@ -0,0 +1,112 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Cursor.hxx"
+#include "protocol/Ack.hxx"
+
+bool
+ResponseCursor::Read(Response &r, unsigned n)
+{
+	const bool more = Produce(r, position, n);
+	position += n;
+	return more;
+}
+
+std::atomic_uint CursorTable::n_total;
+
+CursorTable::~CursorTable() noexcept
+{
+	n_total -= cursors.size();
+}
+
+unsigned
+CursorTable::Add(std::unique_ptr<ResponseCursor> &&cursor)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (cursors.size() >= MAX_CURSORS)
+		throw ProtocolError(ACK_ERROR_ARG, "Too many cursors");
+
+	if (++n_total > MAX_TOTAL_CURSORS) {
+		--n_total;
+		throw ProtocolError(ACK_ERROR_ARG,
+				    "Too many cursors on this server");
+	}
+
+	/* skip ids which are still in use after a wraparound */
+	while (next_id == 0 || cursors.find(next_id) != cursors.end())
+		++next_id;
+
+	const unsigned id = next_id++;
+	cursors.emplace(id, std::move(cursor));
+	return id;
+}
+
+std::unique_ptr<ResponseCursor>
+CursorTable::Take(unsigned id, bool binary)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = cursors.find(id);
+	if (i == cursors.end())
+		throw ProtocolError(ACK_ERROR_NO_EXIST, "No such cursor");
+
+	if (!i->second)
+		throw ProtocolError(ACK_ERROR_ARG, "Cursor is busy");
+
+	if (i->second->IsBinary() != binary)
+		throw ProtocolError(ACK_ERROR_ARG,
+				    "Cursor was created in a different protocol mode");
+
+	return std::move(i->second);
+}
+
+void
+CursorTable::Return(unsigned id,
+		    std::unique_ptr<ResponseCursor> &&cursor) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = cursors.find(id);
+	if (i == cursors.end())
+		/* removed by "closecursor" in the meantime */
+		return;
+
+	if (cursor) {
+		i->second = std::move(cursor);
+	} else {
+		cursors.erase(i);
+		--n_total;
+	}
+}
+
+void
+CursorTable::Remove(unsigned id)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	auto i = cursors.find(id);
+	if (i == cursors.end())
+		throw ProtocolError(ACK_ERROR_NO_EXIST, "No such cursor");
+
+	cursors.erase(i);
+	--n_total;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_CLIENT_CURSOR_HXX
+#define MPD_CLIENT_CURSOR_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+#include <stddef.h>
+
+class Response;
+
+/**
+ * A query response which is sent to the client in pages (see the
+ * "cursor" argument of "find"/"search"/"list" and the "fetch"
+ * command).
+ *
+ * Each page is produced by the #Produce() implementation, which
+ * either continues the query after the last item sent, or copies
+ * from a result collected when the cursor was created.  A cursor is
+ * bound to the state it was created in; if that has changed, it
+ * fails instead of returning an inconsistent result.
+ */
+class ResponseCursor {
+	/**
+	 * The index of the next item to be sent.
+	 */
+	unsigned position = 0;
+
+	/**
+	 * Was the cursor created in binary mode?
+	 */
+	const bool binary;
+
+public:
+	explicit ResponseCursor(bool _binary) noexcept
+		:binary(_binary) {}
+
+	virtual ~ResponseCursor() noexcept = default;
+
+	ResponseCursor(const ResponseCursor &) = delete;
+	ResponseCursor &operator=(const ResponseCursor &) = delete;
+
+	bool IsBinary() const noexcept {
+		return binary;
+	}
+
+	unsigned GetPosition() const noexcept {
+		return position;
+	}
+
+	/**
+	 * Send the next (up to) #n items to the response and advance
+	 * the position.
+	 *
+	 * Throws on error.
+	 *
+	 * @return true if there are more items
+	 */
+	bool Read(Response &r, unsigned n);
+
+protected:
+	/**
+	 * Send the items [offset, offset+count).  This is called with
+	 * consecutive ranges.
+	 *
+	 * Throws on error.
+	 *
+	 * @return true if there are more items after them
+	 */
+	virtual bool Produce(Response &r,
+			     unsigned offset, unsigned count) = 0;
+};
+
+/**
+ * The #ResponseCursor objects owned by one client.  "fetch" may run
+ * in a worker thread; therefore all methods are thread-safe.
+ */
+class CursorTable {
+	/**
+	 * The maximum number of cursors per client.
+	 */
+	static constexpr size_t MAX_CURSORS = 16;
+
+	/**
+	 * The maximum number of cursors of all clients.
+	 */
+	static constexpr unsigned MAX_TOTAL_CURSORS = 1024;
+
+	/**
+	 * The number of cursors of all clients.
+	 */
+	static std::atomic_uint n_total;
+
+	Mutex mutex;
+
+	/**
+	 * A nullptr value means the cursor is being read by Take().
+	 */
+	std::map<unsigned, std::unique_ptr<ResponseCursor>> cursors;
+
+	unsigned next_id = 1;
+
+public:
+	CursorTable() = default;
+	~CursorTable() noexcept;
+
+	CursorTable(const CursorTable &) = delete;
+	CursorTable &operator=(const CursorTable &) = delete;
+
+	/**
+	 * Register a new cursor.
+	 *
+	 * Throws #ProtocolError if the client (or the whole server)
+	 * has too many cursors.
+	 *
+	 * @return the new cursor id
+	 */
+	unsigned Add(std::unique_ptr<ResponseCursor> &&cursor);
+
+	/**
+	 * Borrow a cursor to send a page.  Pass it back with Return().
+	 *
+	 * Throws #ProtocolError if there is no such cursor, if it is
+	 * already in use or if it was created in a different protocol
+	 * mode.
+	 */
+	std::unique_ptr<ResponseCursor> Take(unsigned id, bool binary);
+
+	/**
+	 * Give back a cursor which was obtained with Take().  Pass
+	 * nullptr to delete it, e.g. because it is exhausted.
+	 */
+	void Return(unsigned id,
+		    std::unique_ptr<ResponseCursor> &&cursor) noexcept;
+
+	/**
+	 * Throws #ProtocolError if there is no such cursor.
+	 */
+	void Remove(unsigned id);
+};
+
+#endif
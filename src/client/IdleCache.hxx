@@ -0,0 +1,58 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_IDLE_CACHE_HXX
+#define MPD_CLIENT_IDLE_CACHE_HXX
+
+#include "check.h"
+
+#include <forward_list>
+#include <string>
+
+/**
+ * Pre-rendered "idle" responses.  During one ClientList::IdleAdd()
+ * call, all clients waiting for the same idle flags share one
+ * response, instead of formatting it for each client.
+ */
+class IdleResponseCache {
+	struct Item {
+		unsigned flags;
+		bool binary;
+		std::string response;
+
+		Item(unsigned _flags, bool _binary, std::string &&_response)
+			:flags(_flags), binary(_binary),
+			 response(std::move(_response)) {}
+	};
+
+	/**
+	 * There are usually very few distinct flag sets, therefore a
+	 * list is good enough.
+	 */
+	std::forward_list<Item> items;
+
+public:
+	/**
+	 * Returns the complete response (including "OK") for the
+	 * given idle flags, rendering it if necessary.
+	 */
+	const std::string &Get(unsigned flags, bool binary);
+};
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Pipeline.hxx"
+#include "ClientInternal.hxx"
+#include "Response.hxx"
+#include "command/AllCommands.hxx"
+#include "util/CharUtil.hxx"
+#include "util/StringStrip.hxx"
+#include "Log.hxx"
+
+#include <string.h>
+
+/**
+ * The maximum number of background commands of one pipeline which
+ * run at the same time.  Only one of them can send its response
+ * while the others buffer theirs, and a long pipeline shall not
+ * occupy the whole #CommandWorkerPool.
+ */
+static constexpr std::size_t MAX_RUNNING = 2;
+
+static void
+WriteRequestId(Client &client, const char *id, size_t length) noexcept
+{
+	client.Write("request_id: ");
+	client.Write(id, length);
+	client.Write("\n");
+}
+
+CommandResult
+CommandPipeline::Run() noexcept
+{
+	while (!commands.empty()) {
+		if (stop != CommandResult::OK)
+			return stop;
+
+		/* split the request id from the command */
+		char *const id = &commands.front()[0];
+		char *id_end = id;
+		while (*id_end != 0 && !IsWhitespaceNotNull(*id_end))
+			++id_end;
+
+		char *const cmd = StripLeft(id_end);
+
+		if (client.CanRunInBackground(cmd)) {
+			if (running.size() >= MAX_RUNNING)
+				/* continue in Remove() */
+				return CommandResult::BACKGROUND;
+
+			running.emplace_back(std::string(id, id_end),
+					     pool, client, *this,
+					     cmd, strlen(cmd), next_index);
+
+			try {
+				running.back().command.Start();
+				commands.pop_front();
+				++next_index;
+				continue;
+			} catch (...) {
+				LogError(std::current_exception(),
+					 "Failed to start worker thread");
+				running.pop_back();
+			}
+		}
+
+		if (!running.empty())
+			/* this command may modify state which is used
+			   by the running commands; wait for them */
+			return CommandResult::BACKGROUND;
+
+		const unsigned index = next_index++;
+
+		WriteRequestId(client, id, id_end - id);
+
+		CommandResult ret;
+		if (*cmd == 0) {
+			Response r(client, index);
+			r.Error(ACK_ERROR_UNKNOWN, "No command given");
+			ret = CommandResult::ERROR;
+		} else {
+			FormatDebug(client_domain,
+				    "[%u] process pipelined command \"%s\"",
+				    client.num, cmd);
+			ret = command_process(client, index, cmd);
+		}
+
+		commands.pop_front();
+
+		if (client.IsExpired())
+			return CommandResult::CLOSE;
+
+		switch (ret) {
+		case CommandResult::OK:
+			client.Write("list_OK\n");
+			break;
+
+		case CommandResult::ERROR:
+			/* unlike a normal command list, continue after
+			   an error */
+			break;
+
+		default:
+			return ret;
+		}
+	}
+
+	if (stop != CommandResult::OK)
+		return stop;
+
+	return running.empty()
+		? CommandResult::OK
+		: CommandResult::BACKGROUND;
+}
+
+void
+CommandPipeline::Cancel() noexcept
+{
+	for (auto &i : running)
+		i.command.Cancel();
+}
+
+void
+CommandPipeline::Remove(std::list<Running>::iterator i) noexcept
+{
+	if (active == &*i)
+		active = nullptr;
+
+	running.erase(i);
+
+	if (running.empty()) {
+		/* this call may destroy this object */
+		client.OnPipelineReady();
+		return;
+	}
+
+	if (!client.IsExpired())
+		/* start the next background command; this returns
+		   #CommandResult::BACKGROUND because others are
+		   still running, and OnPipelineReady() will pick up
+		   the result */
+		Run();
+
+	if (active == nullptr)
+		/* let the next command send its response */
+		for (auto &j : running)
+			j.command.Wake();
+}
+
+void
+CommandPipeline::OnBackgroundCommandReady(BackgroundCommand &cmd) noexcept
+{
+	auto i = running.begin();
+	while (&i->command != &cmd)
+		++i;
+
+	std::string output;
+
+	if (client.IsExpired()) {
+		/* discard everything, wait for all commands to
+		   finish */
+		if (cmd.TakeOutput(output))
+			Remove(i);
+		return;
+	}
+
+	if (active == nullptr) {
+		active = &*i;
+		WriteRequestId(client, i->id.data(), i->id.length());
+	} else if (active != &*i)
+		/* another command is sending its response; this one
+		   waits in BackgroundCommand::Write() when it has
+		   produced too much output */
+		return;
+
+	if (!client.IsOutputEmpty())
+		/* the client is slow; wait for OnOutputDrained() */
+		return;
+
+	const bool finished = cmd.TakeOutput(output);
+
+	if (cmd.HasOverflowed()) {
+		FormatWarning(client_domain,
+			      "[%u] output buffer size is "
+			      "larger than the max (%lu)",
+			      client.num,
+			      (unsigned long)client_max_output_buffer_size);
+		Cancel();
+		client.SetExpired();
+	} else if (!output.empty())
+		client.Write(output.data(), output.size());
+
+	if (!finished)
+		return;
+
+	if (!client.IsExpired()) {
+		const CommandResult result = cmd.GetResult();
+		if (result == CommandResult::OK)
+			client.Write("list_OK\n");
+		else if (result != CommandResult::ERROR)
+			stop = result;
+	}
+
+	/* this call may destroy this object */
+	Remove(i);
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_PIPELINE_HXX
+#define MPD_CLIENT_PIPELINE_HXX
+
+#include "check.h"
+#include "BackgroundCommand.hxx"
+#include "BackgroundCommandHandler.hxx"
+#include "command/CommandResult.hxx"
+
+#include <list>
+#include <string>
+
+class Client;
+class CommandWorkerPool;
+
+/**
+ * Executes a command list in pipeline mode
+ * ("command_list_pipeline_begin").  Each command is prefixed with a
+ * request id chosen by the client, and each response is prefixed with
+ * a "request_id" line and terminated with "list_OK" or "ACK".  Unlike
+ * a normal command list, a failed command does not abort the list.
+ *
+ * Consecutive commands which may run in background (see
+ * command_may_run_in_background()) are executed concurrently by the
+ * #CommandWorkerPool, but only a few at a time.  One of them at a time sends its response
+ * while it runs; the others wait when they have produced too much
+ * output, until it is their turn.  All other commands are executed in the main thread;
+ * before one of them, the pipeline waits for the background commands
+ * to finish, because it may modify client state which they use.
+ *
+ * The object is owned by its #Client.
+ */
+class CommandPipeline final : BackgroundCommandHandler {
+	Client &client;
+
+	CommandWorkerPool &pool;
+
+	/**
+	 * The commands which have not been started yet.
+	 */
+	std::list<std::string> commands;
+
+	/**
+	 * The index of the next command in the list; used for error
+	 * messages.
+	 */
+	unsigned next_index = 0;
+
+	struct Running {
+		const std::string id;
+
+		BackgroundCommand command;
+
+		template<typename... Args>
+		Running(std::string &&_id, Args&&... args) noexcept
+			:id(std::move(_id)),
+			 command(std::forward<Args>(args)...) {}
+	};
+
+	/**
+	 * The commands which are being executed by the worker pool.
+	 */
+	std::list<Running> running;
+
+	/**
+	 * The element of #running which currently sends its response
+	 * to the client, or nullptr.
+	 */
+	Running *active = nullptr;
+
+	/**
+	 * A result which stops the pipeline, e.g. #CommandResult::CLOSE
+	 * reported by a background command.
+	 */
+	CommandResult stop = CommandResult::OK;
+
+public:
+	CommandPipeline(Client &_client, CommandWorkerPool &_pool,
+			std::list<std::string> &&_commands) noexcept
+		:client(_client), pool(_pool),
+		 commands(std::move(_commands)) {}
+
+	/**
+	 * Are no commands running in the worker pool?
+	 */
+	bool IsIdle() const noexcept {
+		return running.empty();
+	}
+
+	/**
+	 * Execute commands until the pipeline must wait for
+	 * background commands, or until the list is finished.
+	 *
+	 * @return #CommandResult::BACKGROUND if the pipeline waits
+	 * for the worker pool; Client::OnPipelineReady() will be
+	 * called.  #CommandResult::OK if all commands have been
+	 * executed.  Any other value stops the pipeline.
+	 */
+	CommandResult Run() noexcept;
+
+	/**
+	 * Discard the output of all running commands.
+	 */
+	void Cancel() noexcept;
+
+	/**
+	 * The client's output buffer has become empty; continue
+	 * sending the active command's response.
+	 */
+	void OnOutputDrained() noexcept {
+		if (active != nullptr)
+			active->command.Wake();
+	}
+
+private:
+	/**
+	 * Remove a finished command.  May destroy this object.
+	 */
+	void Remove(std::list<Running>::iterator i) noexcept;
+
+	/* virtual methods from class BackgroundCommandHandler */
+	void OnBackgroundCommandReady(BackgroundCommand &cmd) noexcept override;
+};
+
+#endif
@@ -20,27 +20,56 @@
 #include "config.h"
 #include "Response.hxx"
 #include "Client.hxx"
+#include "tag/Type.h"
 #include "util/FormatString.hxx"
 #include "util/AllocatedString.hxx"
 
+#include <assert.h>
+#include <string.h>
+
 TagMask
 Response::GetTagMask() const noexcept
 {
 	return GetClient().tag_mask;
 }
 
+bool
+Response::IsBinary() const noexcept
+{
+	return client.binary;
+}
+
 bool
 Response::Write(const void *data, size_t length)
 {
+	if (client.binary)
+		return client.WriteFrame(FrameType::TEXT, 0, data, length);
+
 	return client.Write(data, length);
 }
 
 bool
 Response::Write(const char *data)
 {
-	return client.Write(data);
+	return Write(data, strlen(data));
 }
 
+#ifndef _WIN32
+
+bool
+Response::WriteFile(FileDescriptor fd, off_t offset, size_t length)
+{
+	if (client.binary) {
+		const FrameHeader header(FrameType::TEXT, 0, length);
+		if (!client.Write(&header, sizeof(header)))
+			return false;
+	}
+
+	return client.WriteFile(fd, offset, length);
+}
+
+#endif
+
 bool
 Response::FormatV(const char *fmt, va_list args)
 {
@@ -57,6 +86,35 @@ Response::Format(const char *fmt, ...)
 	return success;
 }
 
+bool
+Response::WriteTag(TagType type, const char *value)
+{
+	if (client.binary)
+		return client.WriteFrame(FrameType::TAG, type,
+					 value, strlen(value));
+
+	return Format("%s: %s\n", tag_item_names[type], value);
+}
+
+bool
+Response::WriteField(FrameField field, const char *name, const char *value)
+{
+	if (client.binary)
+		return WriteBinaryField(field, value, strlen(value));
+
+	return Format("%s: %s\n", name, value);
+}
+
+bool
+Response::WriteBinaryField(FrameField field,
+			   const void *value, size_t length)
+{
+	assert(client.binary);
+
+	return client.WriteFrame(FrameType::FIELD, uint8_t(field),
+				 value, length);
+}
+
 void
 Response::Error(enum ack code, const char *msg)
 {
@@ -66,13 +124,20 @@ Response::Error(enum ack code, const char *msg)
 void
 Response::FormatError(enum ack code, const char *fmt, ...)
 {
-	Format("ACK [%i@%u] {%s} ",
-	       (int)code, list_index, command);
-
 	va_list args;
 	va_start(args, fmt);
-	FormatV(fmt, args);
+	const auto msg = FormatStringV(fmt, args);
 	va_end(args);
 
-	Write("\n");
+	const auto line = FormatString("ACK [%i@%u] {%s} %s",
+				       (int)code, list_index, command,
+				       msg.c_str());
+
+	if (client.binary)
+		client.WriteFrame(FrameType::ACK, 0,
+				  line.c_str(), strlen(line.c_str()));
+	else {
+		client.Write(line.c_str());
+		client.Write("\n");
+	}
 }
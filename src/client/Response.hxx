@@ -22,12 +22,19 @@
 
 #include "check.h"
 #include "protocol/Ack.hxx"
+#include "protocol/BinaryFrame.hxx"
 #include "util/Compiler.h"
 
 #include <stddef.h>
 #include <stdarg.h>
 
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+enum TagType : uint8_t;
 class Client;
+class FileDescriptor;
 class TagMask;
 
 class Response {
@@ -72,11 +79,51 @@ public:
 		command = _command;
 	}
 
+	/**
+	 * Is the client in binary mode (see "binarymode")?  Then the
+	 * Write*() methods generate #FrameHeader frames.
+	 */
+	gcc_pure
+	bool IsBinary() const noexcept;
+
+	/**
+	 * Write raw response text (a #FrameType::TEXT frame in binary
+	 * mode).
+	 */
 	bool Write(const void *data, size_t length);
 	bool Write(const char *data);
 	bool FormatV(const char *fmt, va_list args);
 	bool Format(const char *fmt, ...);
 
+#ifndef _WIN32
+	/**
+	 * Write a portion of a regular file as raw response data (a
+	 * #FrameType::TEXT frame in binary mode).  See
+	 * Client::WriteFile().
+	 */
+	bool WriteFile(FileDescriptor fd, off_t offset, size_t length);
+#endif
+
+	/**
+	 * Write a tag value: a "name: value" line or a
+	 * #FrameType::TAG frame.
+	 */
+	bool WriteTag(TagType type, const char *value);
+
+	/**
+	 * Write a string attribute: a "name: value" line or a
+	 * #FrameType::FIELD frame.
+	 */
+	bool WriteField(FrameField field, const char *name,
+			const char *value);
+
+	/**
+	 * Write a #FrameType::FIELD frame with a binary value.  Only
+	 * allowed in binary mode.
+	 */
+	bool WriteBinaryField(FrameField field,
+			      const void *value, size_t length);
+
 	void Error(enum ack code, const char *msg);
 	void FormatError(enum ack code, const char *fmt, ...);
 };
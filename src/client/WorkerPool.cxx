@@ -0,0 +1,168 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "WorkerPool.hxx"
+#include "BackgroundCommand.hxx"
+#include "thread/Name.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+CommandWorkerPool::~CommandWorkerPool() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		assert(queue.empty());
+		quit = true;
+		cond.broadcast();
+	}
+
+	for (auto &thread : threads)
+		thread.Join();
+}
+
+void
+CommandWorkerPool::StartThread()
+{
+	threads.emplace_back(BIND_THIS_METHOD(Run));
+
+	try {
+		threads.back().Start();
+	} catch (...) {
+		threads.pop_back();
+		throw;
+	}
+}
+
+void
+CommandWorkerPool::Push(BackgroundCommand &cmd)
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	if (n_idle == 0 && threads.size() - n_waiting < MAX_THREADS) {
+		try {
+			StartThread();
+		} catch (...) {
+			/* if there is at least one thread, it will
+			   eventually pick up the command */
+			if (threads.empty())
+				throw;
+		}
+	}
+
+	queue.push_back(&cmd);
+	cond.signal();
+}
+
+void
+CommandWorkerPool::Cancel(BackgroundCommand &cmd) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	switch (cmd.state) {
+	case BackgroundCommand::State::QUEUED:
+		queue.remove(&cmd);
+		cmd.state = BackgroundCommand::State::DONE;
+		break;
+
+	case BackgroundCommand::State::RUNNING:
+		while (cmd.state == BackgroundCommand::State::RUNNING)
+			finished_cond.wait(mutex);
+		break;
+
+	case BackgroundCommand::State::DONE:
+		break;
+	}
+}
+
+void
+CommandWorkerPool::BeginWait() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	++n_waiting;
+
+	if (queue.empty() || !HasCapacity())
+		return;
+
+	if (n_idle > 0)
+		/* an idle thread may have been held back by the
+		   limit */
+		cond.signal();
+	else {
+		try {
+			StartThread();
+		} catch (...) {
+			/* the queued commands run when this one
+			   continues */
+			LogError(std::current_exception(),
+				 "Failed to start worker thread");
+		}
+	}
+}
+
+void
+CommandWorkerPool::EndWait() noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	/* this may exceed the limit for a moment, until one of the
+	   running commands finishes */
+	assert(n_waiting > 0);
+	--n_waiting;
+}
+
+void
+CommandWorkerPool::Run() noexcept
+{
+	SetThreadName("command");
+
+	const std::lock_guard<Mutex> protect(mutex);
+
+	while (!quit) {
+		if (queue.empty() || !HasCapacity()) {
+			++n_idle;
+			cond.wait(mutex);
+			--n_idle;
+			continue;
+		}
+
+		BackgroundCommand &cmd = *queue.front();
+		queue.pop_front();
+
+		cmd.state = BackgroundCommand::State::RUNNING;
+		++n_running;
+
+		{
+			const ScopeUnlock unlock(mutex);
+			cmd.Run();
+		}
+
+		--n_running;
+		cmd.state = BackgroundCommand::State::DONE;
+		cmd.SetFinished();
+		finished_cond.broadcast();
+
+		if (!queue.empty() && n_idle > 0)
+			/* an idle thread may have been held back by
+			   the limit */
+			cond.signal();
+	}
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_WORKER_POOL_HXX
+#define MPD_CLIENT_WORKER_POOL_HXX
+
+#include "check.h"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <list>
+
+class BackgroundCommand;
+
+/**
+ * A small pool of threads which execute #BackgroundCommand instances,
+ * i.e. expensive client commands which would otherwise block the main
+ * thread.  Threads are started on demand.
+ *
+ * A thread which waits for a slow client (see BeginWait()) does not
+ * count against #MAX_THREADS; another thread may run a queued
+ * command meanwhile, so clients which don't read their responses
+ * cannot starve the others.  The number of such threads is bounded
+ * by the number of clients.
+ */
+class CommandWorkerPool {
+	friend class BackgroundCommand;
+
+	/**
+	 * The maximum number of threads running commands, not
+	 * counting those which wait for a client.
+	 */
+	static constexpr unsigned MAX_THREADS = 2;
+
+	/**
+	 * Protects all attributes of this object and
+	 * BackgroundCommand::state.  It is not held while a command
+	 * runs or produces output.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled when a command has been queued, or when the pool
+	 * shall be shut down.
+	 */
+	Cond cond;
+
+	/**
+	 * Signalled when a command has finished.
+	 */
+	Cond finished_cond;
+
+	std::list<Thread> threads;
+
+	/**
+	 * Commands waiting for a worker thread.
+	 */
+	std::list<BackgroundCommand *> queue;
+
+	/**
+	 * The number of threads waiting for a command.
+	 */
+	unsigned n_idle = 0;
+
+	/**
+	 * The number of threads running a command, including
+	 * #n_waiting.
+	 */
+	unsigned n_running = 0;
+
+	/**
+	 * The number of threads whose command waits for its client
+	 * to read the response.
+	 */
+	unsigned n_waiting = 0;
+
+	bool quit = false;
+
+public:
+	CommandWorkerPool() = default;
+
+	/**
+	 * Stops and joins all threads.  No command may be pending.
+	 */
+	~CommandWorkerPool() noexcept;
+
+	CommandWorkerPool(const CommandWorkerPool &) = delete;
+	CommandWorkerPool &operator=(const CommandWorkerPool &) = delete;
+
+	/**
+	 * Enqueue a command, starting a new thread if necessary.
+	 *
+	 * Throws on error.
+	 */
+	void Push(BackgroundCommand &cmd);
+
+	/**
+	 * Remove a command from the queue.  If it is already running,
+	 * wait for it to finish.  After returning, no worker thread
+	 * refers to the command anymore.
+	 *
+	 * Call BackgroundCommand::Cancel() first, which does not
+	 * block, to make a running command finish quickly.
+	 */
+	void Cancel(BackgroundCommand &cmd) noexcept;
+
+	/**
+	 * The current worker thread is going to wait for its client;
+	 * let another thread run a queued command meanwhile.  Must be
+	 * followed by EndWait().
+	 */
+	void BeginWait() noexcept;
+
+	void EndWait() noexcept;
+
+private:
+	/**
+	 * May the pool run one more command now?
+	 */
+	bool HasCapacity() const noexcept {
+		return n_running - n_waiting < MAX_THREADS;
+	}
+
+	/**
+	 * Start a new thread.  Caller must lock the #mutex.
+	 *
+	 * Throws on error.
+	 */
+	void StartThread();
+
+	/* the Thread callback */
+	void Run() noexcept;
+};
+
+#endif
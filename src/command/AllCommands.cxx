@@ -39,9 +39,13 @@
 #include "Partition.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "Metrics.hxx"
+#include "util/LatencyHistogram.hxx"
+#include "util/ScopeExit.hxx"
 #include "util/Macros.hxx"
 #include "util/Tokenizer.hxx"
 #include "util/StringAPI.hxx"
+#include "util/CharUtil.hxx"
 
 #ifdef ENABLE_SQLITE
 #include "StickerCommands.hxx"
@@ -85,12 +89,19 @@ static constexpr struct command commands[] = {
 	{ "addid", PERMISSION_ADD, 1, 2, handle_addid },
 	{ "addtagid", PERMISSION_ADD, 3, 3, handle_addtagid },
 	{ "albumart", PERMISSION_READ, 2, 2, handle_album_art },
+	{ "binarymode", PERMISSION_NONE, 0, 0, handle_binarymode },
 	{ "channels", PERMISSION_READ, 0, 0, handle_channels },
 	{ "clear", PERMISSION_CONTROL, 0, 0, handle_clear },
 	{ "clearerror", PERMISSION_CONTROL, 0, 0, handle_clearerror },
 	{ "cleartagid", PERMISSION_ADD, 1, 2, handle_cleartagid },
 	{ "close", PERMISSION_NONE, -1, -1, handle_close },
+#ifdef ENABLE_DATABASE
+	{ "closecursor", PERMISSION_READ, 1, 1, handle_closecursor },
+#endif
 	{ "commands", PERMISSION_NONE, 0, 0, handle_commands },
+#ifdef ENABLE_ZLIB
+	{ "compress", PERMISSION_NONE, 1, 1, handle_compress },
+#endif
 	{ "config", PERMISSION_ADMIN, 0, 0, handle_config },
 	{ "consume", PERMISSION_CONTROL, 1, 1, handle_consume },
 #ifdef ENABLE_DATABASE
@@ -104,6 +115,7 @@ static constexpr struct command commands[] = {
 	{ "disableoutput", PERMISSION_ADMIN, 1, 1, handle_disableoutput },
 	{ "enableoutput", PERMISSION_ADMIN, 1, 1, handle_enableoutput },
 #ifdef ENABLE_DATABASE
+	{ "fetch", PERMISSION_READ, 2, 2, handle_fetch },
 	{ "find", PERMISSION_READ, 1, -1, handle_find },
 	{ "findadd", PERMISSION_ADD, 1, -1, handle_findadd},
 #endif
@@ -127,6 +139,7 @@ static constexpr struct command commands[] = {
 	{ "listplaylists", PERMISSION_READ, 0, 0, handle_listplaylists },
 	{ "load", PERMISSION_ADD, 1, 2, handle_load },
 	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo },
+	{ "metrics", PERMISSION_READ, 0, 0, handle_metrics },
 	{ "mixrampdb", PERMISSION_CONTROL, 1, 1, handle_mixrampdb },
 	{ "mixrampdelay", PERMISSION_CONTROL, 1, 1, handle_mixrampdelay },
 #ifdef ENABLE_DATABASE
@@ -206,6 +219,12 @@ static constexpr struct command commands[] = {
 
 static constexpr unsigned num_commands = ARRAY_SIZE(commands);
 
+/**
+ * The execution time of each command handler, indexed like
+ * #commands.
+ */
+static LatencyHistogram command_latency[num_commands];
+
 static bool
 command_available(gcc_unused const Partition &partition,
 		  gcc_unused const struct command *cmd)
@@ -275,6 +294,15 @@ handle_not_commands(Client &client, gcc_unused Request request, Response &r)
 	return PrintUnavailableCommands(r, client.GetPermission());
 }
 
+void
+command_print_latencies(Response &r)
+{
+	for (unsigned i = 0; i < num_commands; ++i)
+		if (command_latency[i].GetCount() > 0)
+			metrics_print_histogram(r, "command", commands[i].cmd,
+						command_latency[i]);
+}
+
 void
 command_init()
 {
@@ -364,6 +392,64 @@ command_checked_lookup(Response &r, unsigned permission,
 	return cmd;
 }
 
+/**
+ * Look up and invoke the command handler.
+ */
+static CommandResult
+command_invoke(Client &client, Response &r,
+	       const char *cmd_name, Request args)
+{
+	const struct command *cmd =
+		command_checked_lookup(r, client.GetPermission(),
+				       cmd_name, args);
+
+	if (cmd == nullptr)
+		return CommandResult::ERROR;
+
+	const auto start = std::chrono::steady_clock::now();
+	AtScopeExit(cmd, start) {
+		command_latency[cmd - commands].Add(std::chrono::steady_clock::now() - start);
+	};
+
+	return cmd->handler(client, args, r);
+}
+
+#ifdef ENABLE_DATABASE
+
+bool
+command_may_run_in_background(const char *line) noexcept
+{
+	/* these commands only read the database (with
+	   Database::Visit() or Database::VisitUniqueTags()) and
+	   the client's own attributes, but may take a long time on
+	   a large database */
+	static constexpr const char *background_commands[] = {
+		"count",
+		"fetch",
+		"find",
+		"list",
+		"listall",
+		"listallinfo",
+		"search",
+	};
+
+	const char *end = line;
+	while (IsLowerAlphaASCII(*end))
+		++end;
+
+	if (*end != 0 && !IsWhitespaceNotNull(*end))
+		return false;
+
+	const size_t length = end - line;
+	for (const char *name : background_commands)
+		if (strlen(name) == length && memcmp(name, line, length) == 0)
+			return true;
+
+	return false;
+}
+
+#endif
+
 CommandResult
 command_process(Client &client, unsigned num, char *line)
 try {
@@ -409,17 +495,47 @@ try {
 		argv[args.size++] = a;
 	}
 
-	/* look up and invoke the command handler */
+	return command_invoke(client, r, cmd_name, args);
+} catch (const std::exception &e) {
+	Response r(client, num);
+	PrintError(r, std::current_exception());
+	return CommandResult::ERROR;
+}
 
-	const struct command *cmd =
-		command_checked_lookup(r, client.GetPermission(),
-				       cmd_name, args);
+CommandResult
+command_process_frame(Client &client, unsigned num,
+		      char *payload, size_t length)
+try {
+	Response r(client, num);
 
-	CommandResult ret = cmd
-		? cmd->handler(client, args, r)
-		: CommandResult::ERROR;
+	if (length == 0 || payload[length - 1] != 0) {
+		r.Error(ACK_ERROR_UNKNOWN, "Malformed command frame");
+		/* this client does not speak the MPD protocol; kick
+		   the connection */
+		return CommandResult::FINISH;
+	}
+
+	/* the payload is already split into null-terminated words;
+	   no unquoting is necessary */
+
+	const char *const end = payload + length;
+	const char *cmd_name = payload;
+	char *p = payload + strlen(payload) + 1;
+
+	char *argv[COMMAND_ARGV_MAX];
+	Request args(argv, 0);
+
+	while (p < end) {
+		if (args.size == COMMAND_ARGV_MAX) {
+			r.Error(ACK_ERROR_ARG, "Too many arguments");
+			return CommandResult::ERROR;
+		}
+
+		argv[args.size++] = p;
+		p += strlen(p) + 1;
+	}
 
-	return ret;
+	return command_invoke(client, r, cmd_name, args);
 } catch (const std::exception &e) {
 	Response r(client, num);
 	PrintError(r, std::current_exception());
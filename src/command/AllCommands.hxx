@@ -21,8 +21,12 @@
 #define MPD_ALL_COMMANDS_HXX
 
 #include "CommandResult.hxx"
+#include "util/Compiler.h"
+
+#include <stddef.h>
 
 class Client;
+class Response;
 
 void
 command_init();
@@ -30,7 +34,32 @@ command_init();
 void
 command_finish();
 
+/**
+ * Print the execution time histogram of each command which has
+ * been used (for the "metrics" command).
+ */
+void
+command_print_latencies(Response &r);
+
+/**
+ * May the given command line be executed by a #CommandWorkerPool
+ * thread?  This applies to some read-only database commands which
+ * may take a long time.
+ */
+gcc_pure
+bool
+command_may_run_in_background(const char *line) noexcept;
+
 CommandResult
 command_process(Client &client, unsigned num, char *line);
 
+/**
+ * Process the payload of a #FrameType::COMMAND frame received in
+ * binary mode: the command name and its arguments, each terminated
+ * with a null byte.
+ */
+CommandResult
+command_process_frame(Client &client, unsigned num,
+		      char *payload, size_t length);
+
 #endif
@@ -41,6 +41,42 @@ handle_ping(gcc_unused Client &client, gcc_unused Request args,
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_binarymode(Client &client, gcc_unused Request args, Response &r)
+{
+	if (client.cmd_list.IsActive()) {
+		r.Error(ACK_ERROR_UNKNOWN,
+			"Not allowed in a command list");
+		return CommandResult::ERROR;
+	}
+
+	/* the "OK" response is already a binary frame */
+	client.binary = true;
+	return CommandResult::OK;
+}
+
+#ifdef ENABLE_ZLIB
+
+CommandResult
+handle_compress(Client &client, Request args, Response &r)
+{
+	if (!StringIsEqual(args.front(), "gzip")) {
+		r.Error(ACK_ERROR_ARG, "Unsupported compression method");
+		return CommandResult::ERROR;
+	}
+
+	if (client.IsCompressed()) {
+		r.Error(ACK_ERROR_UNKNOWN, "Compression is already enabled");
+		return CommandResult::ERROR;
+	}
+
+	/* the "OK" response is not compressed yet */
+	client.RequestCompression();
+	return CommandResult::OK;
+}
+
+#endif
+
 CommandResult
 handle_password(Client &client, Request args, Response &r)
 {
@@ -32,6 +32,14 @@ handle_close(Client &client, Request request, Response &response);
 CommandResult
 handle_ping(Client &client, Request request, Response &response);
 
+CommandResult
+handle_binarymode(Client &client, Request request, Response &response);
+
+#ifdef ENABLE_ZLIB
+CommandResult
+handle_compress(Client &client, Request request, Response &response);
+#endif
+
 CommandResult
 handle_password(Client &client, Request request, Response &response);
 
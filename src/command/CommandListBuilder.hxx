@@ -44,6 +44,12 @@ class CommandListBuilder {
 		 * Enabled in "list_OK" mode.
 		 */
 		OK = true,
+
+		/**
+		 * Enabled in pipeline mode; each command is prefixed
+		 * with a request id (see #CommandPipeline).
+		 */
+		PIPELINE,
 	} mode = Mode::DISABLED;
 
 	/**
@@ -70,7 +76,16 @@ public:
 	bool IsOKMode() const {
 		assert(IsActive());
 
-		return (bool)mode;
+		return mode == Mode::OK;
+	}
+
+	/**
+	 * Is the object in pipeline mode?
+	 */
+	bool IsPipelineMode() const {
+		assert(IsActive());
+
+		return mode == Mode::PIPELINE;
 	}
 
 	/**
@@ -89,6 +104,17 @@ public:
 		size = 0;
 	}
 
+	/**
+	 * Begin building a command list in pipeline mode.
+	 */
+	void BeginPipeline() {
+		assert(list.empty());
+		assert(mode == Mode::DISABLED);
+
+		mode = Mode::PIPELINE;
+		size = 0;
+	}
+
 	/**
 	 * @return false if the list is full
 	 */
@@ -62,6 +62,14 @@ enum class CommandResult {
 	 * The MPD process shall be shut down.
 	 */
 	KILL,
+
+	/**
+	 * The command is being executed by a #CommandWorkerPool
+	 * thread.  No more input shall be processed until it has
+	 * finished; Client::OnBackgroundCommandReady() sends the
+	 * response.
+	 */
+	BACKGROUND,
 };
 
 #endif
@@ -25,20 +25,34 @@
 #include "db/DatabasePrint.hxx"
 #include "db/Count.hxx"
 #include "db/Selection.hxx"
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/DatabaseError.hxx"
 #include "CommandError.hxx"
 #include "protocol/RangeArg.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/Cursor.hxx"
+#include "protocol/Ack.hxx"
+#include "Partition.hxx"
+#include "SongPrint.hxx"
 #include "tag/ParseName.hxx"
 #include "tag/Mask.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Exception.hxx"
 #include "util/StringAPI.hxx"
+#include "util/ScopeExit.hxx"
 #include "util/ASCII.hxx"
 #include "song/Filter.hxx"
+#include "song/DetachedSong.hxx"
+#include "song/LightSong.hxx"
+#include "tag/Tag.hxx"
 #include "BulkEdit.hxx"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <vector>
 
 CommandResult
 handle_listfiles_db(Client &client, Response &r, const char *uri)
@@ -71,9 +85,270 @@ ParseSortTag(const char *s)
 	return tag;
 }
 
+/**
+ * Parse the optional "cursor PAGESIZE" arguments at the end of the
+ * request.
+ *
+ * @return the page size or 0 if no cursor was requested
+ */
+static unsigned
+ParseCursorArg(Request &args)
+{
+	if (args.size < 2 || !StringIsEqual(args[args.size - 2], "cursor"))
+		return 0;
+
+	const unsigned page_size = args.ParseUnsigned(args.size - 1);
+	if (page_size == 0)
+		throw ProtocolError(ACK_ERROR_ARG, "Zero page size");
+
+	args.pop_back();
+	args.pop_back();
+	return page_size;
+}
+
+/**
+ * The maximum number of songs or tag values kept in memory by all
+ * #SongSnapshotCursor and #UniqueTagsCursor instances.
+ */
+static constexpr std::size_t MAX_SNAPSHOT_ITEMS = 256 * 1024;
+
+/**
+ * The number of songs or tag values kept by all snapshot cursors.
+ */
+static std::atomic_size_t snapshot_items;
+
+/**
+ * Accounts for the items a cursor keeps in memory.
+ */
+class SnapshotReservation {
+	std::size_t n = 0;
+
+public:
+	SnapshotReservation() = default;
+
+	~SnapshotReservation() noexcept {
+		snapshot_items -= n;
+	}
+
+	SnapshotReservation(const SnapshotReservation &) = delete;
+	SnapshotReservation &operator=(const SnapshotReservation &) = delete;
+
+	/**
+	 * Throws #ProtocolError if the server-wide limit is
+	 * exceeded.
+	 */
+	void Add() {
+		if (++snapshot_items > MAX_SNAPSHOT_ITEMS) {
+			--snapshot_items;
+			throw ProtocolError(ACK_ERROR_ARG,
+					    "Result too large for a cursor");
+		}
+
+		++n;
+	}
+};
+
+/**
+ * A cursor on a database query.  It remembers the database's update
+ * stamp, and fails with #DatabaseErrorCode::CONFLICT when the
+ * database has been updated since, instead of returning pages from
+ * different versions; the client then starts a new query.
+ */
+class DatabaseCursor : public ResponseCursor {
+	Partition &partition;
+
+	const std::chrono::system_clock::time_point stamp;
+
+protected:
+	DatabaseCursor(bool _binary, Partition &_partition)
+		:ResponseCursor(_binary), partition(_partition),
+		 stamp(partition.GetDatabaseOrThrow().GetUpdateStamp()) {}
+
+	/**
+	 * Throws if the database is not available or has been
+	 * updated.
+	 */
+	const Database &GetDatabase() const {
+		const Database &db = partition.GetDatabaseOrThrow();
+		if (db.GetUpdateStamp() != stamp)
+			throw DatabaseError(DatabaseErrorCode::CONFLICT,
+					    "Database has been updated");
+
+		return db;
+	}
+};
+
+/**
+ * A "find"/"search" cursor for an unsorted result from a database
+ * which supports DatabaseSelection::after.  Each page continues the
+ * walk after the last song of the previous page, therefore its cost
+ * depends on the page size, not on the position.
+ */
+class SelectionCursor final : public DatabaseCursor {
+	const SongFilter filter;
+
+	DatabaseSelection selection;
+
+	/**
+	 * The URI of the last song which was sent.
+	 */
+	std::string last;
+
+public:
+	SelectionCursor(bool _binary, Partition &_partition,
+			SongFilter &&_filter,
+			const DatabaseSelection &_selection)
+		:DatabaseCursor(_binary, _partition),
+		 filter(std::move(_filter)), selection(_selection) {
+		selection.filter = &filter;
+	}
+
+protected:
+	bool Produce(Response &r, unsigned offset, unsigned count) override {
+		const Database &db = GetDatabase();
+
+		const RangeArg window = selection.window;
+		const unsigned size = window.end - window.start;
+		if (offset >= size)
+			return false;
+
+		/* narrow the window down to this page plus one song,
+		   which tells whether there are more */
+		DatabaseSelection page(selection);
+		if (offset > 0) {
+			page.after = last;
+			page.window.start = 0;
+		}
+
+		page.window.end = page.window.start +
+			std::min<uint64_t>(uint64_t(count) + 1,
+					   size - offset);
+
+		return db_selection_print_page(r, db, page, true, false,
+					       count, last);
+	}
+};
+
+/**
+ * A "find"/"search" cursor for a sorted result (or a database which
+ * does not support DatabaseSelection::after).  The result is copied
+ * when the cursor is created.
+ */
+class SongSnapshotCursor final : public DatabaseCursor {
+	SnapshotReservation reservation;
+
+	std::vector<DetachedSong> songs;
+
+public:
+	SongSnapshotCursor(bool _binary, Partition &_partition,
+			   const DatabaseSelection &selection)
+		:DatabaseCursor(_binary, _partition) {
+		const Database &db = GetDatabase();
+		db.Visit(selection, [this](const LightSong &song){
+				reservation.Add();
+				songs.emplace_back(song);
+			});
+	}
+
+protected:
+	bool Produce(Response &r, unsigned offset, unsigned count) override {
+		GetDatabase();
+
+		const std::size_t end =
+			std::min<uint64_t>(uint64_t(offset) + count,
+					   songs.size());
+		for (std::size_t i = offset; i < end; ++i)
+			song_print_info(r, songs[i]);
+
+		return end < songs.size();
+	}
+};
+
+/**
+ * A "list" cursor.  The unique values are copied when the cursor is
+ * created (they are collected in a set anyway).
+ */
+class UniqueTagsCursor final : public DatabaseCursor {
+	const TagType type;
+
+	SnapshotReservation reservation;
+
+	std::vector<Tag> tags;
+
+public:
+	UniqueTagsCursor(bool _binary, Partition &_partition,
+			 const SongFilter *filter,
+			 TagType _type, TagMask group_mask)
+		:DatabaseCursor(_binary, _partition), type(_type) {
+		const Database &db = GetDatabase();
+		const DatabaseSelection selection("", true, filter);
+		db.VisitUniqueTags(selection, type, group_mask,
+				   [this](const Tag &tag){
+					   reservation.Add();
+					   tags.emplace_back(tag);
+				   });
+	}
+
+protected:
+	bool Produce(Response &r, unsigned offset, unsigned count) override {
+		GetDatabase();
+
+		const std::size_t end =
+			std::min<uint64_t>(uint64_t(offset) + count,
+					   tags.size());
+		for (std::size_t i = offset; i < end; ++i)
+			PrintUniqueTag(r, type, tags[i]);
+
+		return end < tags.size();
+	}
+};
+
+/**
+ * Send the next page of a cursor.  If there are more items, the page
+ * is followed by "cursor: ID"; otherwise, the cursor is deleted.
+ */
+static CommandResult
+SendPage(Client &client, Response &r, unsigned id, unsigned count)
+{
+	auto cursor = client.cursors.Take(id, r.IsBinary());
+	AtScopeExit(&client, id, &cursor) {
+		client.cursors.Return(id, std::move(cursor));
+	};
+
+	bool more;
+	try {
+		more = cursor->Read(r, count);
+	} catch (...) {
+		/* e.g. the database has been updated; the client
+		   needs to start over */
+		cursor.reset();
+		throw;
+	}
+
+	if (more)
+		r.Format("cursor: %u\n", id);
+	else
+		cursor.reset();
+
+	return CommandResult::OK;
+}
+
+/**
+ * Register a new cursor and send its first page.
+ */
+static CommandResult
+SendFirstPage(Client &client, Response &r,
+	      std::unique_ptr<ResponseCursor> &&cursor, unsigned page_size)
+{
+	const unsigned id = client.cursors.Add(std::move(cursor));
+	return SendPage(client, r, id, page_size);
+}
+
 static CommandResult
 handle_match(Client &client, Request args, Response &r, bool fold_case)
 {
+	const unsigned page_size = ParseCursorArg(args);
+
 	RangeArg window = RangeArg::All();
 	if (args.size >= 2 && StringIsEqual(args[args.size - 2], "window")) {
 		window = args.ParseRange(args.size - 1);
@@ -112,6 +387,22 @@ handle_match(Client &client, Request args, Response &r, bool fold_case)
 	selection.sort = sort;
 	selection.descending = descending;
 
+	if (page_size > 0) {
+		auto &partition = client.GetPartition();
+		std::unique_ptr<ResponseCursor> cursor;
+		if (sort == TAG_NUM_OF_ITEM_TYPES &&
+		    partition.GetDatabaseOrThrow().GetPlugin().SupportsResume())
+			cursor = std::make_unique<SelectionCursor>(r.IsBinary(),
+								   partition,
+								   std::move(filter),
+								   selection);
+		else
+			cursor = std::make_unique<SongSnapshotCursor>(r.IsBinary(),
+								      partition,
+								      selection);
+		return SendFirstPage(client, r, std::move(cursor), page_size);
+	}
+
 	db_selection_print(r, client.GetPartition(),
 			   selection, true, false);
 	return CommandResult::OK;
@@ -266,6 +557,8 @@ handle_list(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 
+	const unsigned page_size = ParseCursorArg(args);
+
 	std::unique_ptr<SongFilter> filter;
 	TagMask group_mask = TagMask::None();
 
@@ -315,11 +608,39 @@ handle_list(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 
+	if (page_size > 0) {
+		auto cursor = std::make_unique<UniqueTagsCursor>(r.IsBinary(),
+								 client.GetPartition(),
+								 filter.get(),
+								 tagType, group_mask);
+		return SendFirstPage(client, r, std::move(cursor), page_size);
+	}
+
 	PrintUniqueTags(r, client.GetPartition(),
 			tagType, group_mask, filter.get());
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_fetch(Client &client, Request args, Response &r)
+{
+	const unsigned id = args.ParseUnsigned(0);
+	const unsigned count = args.ParseUnsigned(1);
+	if (count == 0) {
+		r.Error(ACK_ERROR_ARG, "Zero page size");
+		return CommandResult::ERROR;
+	}
+
+	return SendPage(client, r, id, count);
+}
+
+CommandResult
+handle_closecursor(Client &client, Request args, gcc_unused Response &r)
+{
+	client.cursors.Remove(args.ParseUnsigned(0));
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_listallinfo(Client &client, Request args, Response &r)
 {
@@ -59,4 +59,10 @@ handle_list(Client &client, Request request, Response &response);
 CommandResult
 handle_listallinfo(Client &client, Request request, Response &response);
 
+CommandResult
+handle_fetch(Client &client, Request request, Response &response);
+
+CommandResult
+handle_closecursor(Client &client, Request request, Response &response);
+
 #endif
@@ -40,9 +40,13 @@
 #include "LocateUri.hxx"
 #include "TimePrint.hxx"
 #include "thread/Mutex.hxx"
+#include "system/UniqueFileDescriptor.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
 #include <inttypes.h> /* for PRIu64 */
+#include <sys/stat.h>
 
 gcc_pure
 static bool
@@ -235,8 +239,20 @@ handle_read_comments(Client &client, Request args, Response &r)
 	gcc_unreachable();
 }
 
+static constexpr char const * art_names[] = {
+	"cover.png",
+	"cover.jpg",
+	"cover.tiff",
+	"cover.bmp"
+};
+
 /**
- * Searches for the files listed in #artnames in the UTF8 folder
+ * The maximum number of bytes sent in one "albumart" response.
+ */
+static constexpr size_t ART_CHUNK_SIZE = 8192;
+
+/**
+ * Searches for the files listed in #art_names in the UTF8 folder
  * URI #directory. This can be a local path or protocol-based
  * URI that #InputStream supports. Returns the first successfully
  * opened file or #nullptr on failure.
@@ -244,13 +260,6 @@ handle_read_comments(Client &client, Request args, Response &r)
 static InputStreamPtr
 find_stream_art(const char *directory, Mutex &mutex)
 {
-	static constexpr char const * art_names[] = {
-		"cover.png",
-		"cover.jpg",
-		"cover.tiff",
-		"cover.bmp"
-	};
-
 	for(const auto name: art_names) {
 		std::string art_file = PathTraitsUTF8::Build(directory, name);
 
@@ -281,12 +290,11 @@ read_stream_art(Response &r, const char *uri, size_t offset)
 
 	const offset_type art_file_size = is->GetSize();
 
-	constexpr size_t CHUNK_SIZE = 8192;
-	uint8_t buffer[CHUNK_SIZE];
+	uint8_t buffer[ART_CHUNK_SIZE];
 	size_t read_size;
 
 	is->Seek(offset);
-	read_size = is->Read(&buffer, CHUNK_SIZE);
+	read_size = is->Read(&buffer, ART_CHUNK_SIZE);
 
 	r.Format("size: %" PRIoffset "\n"
 			 "binary: %u\n",
@@ -300,6 +308,75 @@ read_stream_art(Response &r, const char *uri, size_t offset)
 	return CommandResult::OK;
 }
 
+#ifndef _WIN32
+
+/**
+ * Like find_stream_art(), but look for a regular file in a local
+ * directory.
+ */
+static UniqueFileDescriptor
+find_local_art(Path directory_fs)
+{
+	for (const auto name : art_names) {
+		const auto art_file = AllocatedPath::Build(directory_fs, name);
+
+		UniqueFileDescriptor fd;
+		if (!fd.OpenReadOnly(art_file.c_str()))
+			continue;
+
+		struct stat st;
+		if (fstat(fd.Get(), &st) == 0 && S_ISREG(st.st_mode))
+			return fd;
+	}
+
+	return UniqueFileDescriptor();
+}
+
+/**
+ * Send album art from a local file.  Unlike read_stream_art(), this
+ * does not copy the file contents (see Client::WriteFile()).
+ */
+static CommandResult
+read_local_art(Response &r, Path path_fs, size_t offset)
+{
+	const auto fd = find_local_art(path_fs.GetDirectoryName());
+	if (!fd.IsDefined()) {
+		r.Error(ACK_ERROR_NO_EXIST, "No file exists");
+		return CommandResult::ERROR;
+	}
+
+	const off_t art_file_size = fd.GetSize();
+	if (art_file_size < 0) {
+		r.Error(ACK_ERROR_NO_EXIST, "Cannot get size for stream");
+		return CommandResult::ERROR;
+	}
+
+	if (offset > uint64_t(art_file_size)) {
+		r.Error(ACK_ERROR_ARG, "Offset too large");
+		return CommandResult::ERROR;
+	}
+
+	const size_t read_size = std::min<uint64_t>(art_file_size - offset,
+						     ART_CHUNK_SIZE);
+
+	r.Format("size: %" PRIu64 "\n"
+		 "binary: %zu\n",
+		 uint64_t(art_file_size),
+		 read_size);
+
+	if (!r.WriteFile(fd, offset, read_size))
+		/* the connection has failed or the file was
+		   truncated; the announced binary chunk cannot be
+		   completed, so the client must be disconnected */
+		return CommandResult::CLOSE;
+
+	r.Write("\n");
+
+	return CommandResult::OK;
+}
+
+#endif
+
 #ifdef ENABLE_DATABASE
 static CommandResult
 read_db_art(Client &client, Response &r, const char *uri, const uint64_t offset)
@@ -309,6 +386,13 @@ read_db_art(Client &client, Response &r, const char *uri, const uint64_t offset)
 		r.Error(ACK_ERROR_NO_EXIST, "No database");
 		return CommandResult::ERROR;
 	}
+
+#ifndef _WIN32
+	const auto path_fs = storage->MapFS(uri);
+	if (!path_fs.IsNull())
+		return read_local_art(r, path_fs, offset);
+#endif
+
 	std::string uri2 = storage->MapUTF8(uri);
 	return read_stream_art(r, uri2.c_str(), offset);
 }
@@ -330,8 +414,13 @@ handle_album_art(Client &client, Request args, Response &r)
 
 	switch (located_uri.type) {
 	case LocatedUri::Type::ABSOLUTE:
+		return read_stream_art(r, located_uri.canonical_uri, offset);
 	case LocatedUri::Type::PATH:
+#ifndef _WIN32
+		return read_local_art(r, located_uri.path, offset);
+#else
 		return read_stream_art(r, located_uri.canonical_uri, offset);
+#endif
 	case LocatedUri::Type::RELATIVE:
 #ifdef ENABLE_DATABASE
 		return read_db_art(client, r, located_uri.canonical_uri, offset);
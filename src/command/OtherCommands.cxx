@@ -40,6 +40,8 @@
 #include "util/StringAPI.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "Stats.hxx"
+#include "Metrics.hxx"
+#include "AllCommands.hxx"
 #include "PlaylistFile.hxx"
 #include "db/PlaylistVector.hxx"
 #include "client/Client.hxx"
@@ -367,6 +369,14 @@ handle_stats(Client &client, gcc_unused Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_metrics(Client &client, gcc_unused Request args, Response &r)
+{
+	command_print_latencies(r);
+	metrics_print(r, client.GetPartition());
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_config(Client &client, gcc_unused Request args, Response &r)
 {
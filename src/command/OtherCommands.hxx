@@ -56,6 +56,9 @@ handle_volume(Client &client, Request request, Response &response);
 CommandResult
 handle_stats(Client &client, Request request, Response &response);
 
+CommandResult
+handle_metrics(Client &client, Request request, Response &response);
+
 CommandResult
 handle_config(Client &client, Request request, Response &response);
 
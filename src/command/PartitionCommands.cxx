@@ -102,6 +102,7 @@ handle_newpartition(Client &client, Request request, Response &response)
 					 // TODO: use real configuration
 					 16384,
 					 1024,
+					 FloatDuration::zero(),
 					 AudioFormat::Undefined(),
 					 ReplayGainConfig());
 	auto &partition = instance.partitions.back();
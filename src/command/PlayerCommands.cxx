@@ -200,6 +200,10 @@ handle_status(Client &client, gcc_unused Request args, Response &r)
 
 	try {
 		pc.LockCheckRethrowError();
+
+		const auto &load_error = client.GetPartition().load_error;
+		if (load_error)
+			std::rethrow_exception(load_error);
 	} catch (...) {
 		r.Format(COMMAND_STATUS_ERROR ": %s\n",
 			 GetFullMessage(std::current_exception()).c_str());
@@ -279,6 +283,7 @@ handle_clearerror(Client &client, gcc_unused Request args,
 		  gcc_unused Response &r)
 {
 	client.GetPlayerControl().LockClearError();
+	client.GetPartition().load_error = nullptr;
 	return CommandResult::OK;
 }
 
@@ -29,6 +29,7 @@
 #include "SongLoader.hxx"
 #include "BulkEdit.hxx"
 #include "playlist/PlaylistQueue.hxx"
+#include "playlist/PlaylistLoadJob.hxx"
 #include "playlist/Print.hxx"
 #include "TimePrint.hxx"
 #include "client/Client.hxx"
@@ -68,6 +69,14 @@ handle_load(Client &client, Request args, gcc_unused Response &r)
 {
 	RangeArg range = args.ParseOptional(1, RangeArg::All());
 
+	if (PlaylistLoadJob::IsSuitable(args.front())) {
+		/* remote playlists are downloaded and parsed in
+		   the background */
+		client.GetPartition().StartLoadJob(args.front(),
+						   range.start, range.end);
+		return CommandResult::OK;
+	}
+
 	const ScopeBulkEdit bulk_edit(client.GetPartition());
 
 	const SongLoader loader(client);
@@ -59,6 +59,11 @@ enum class ConfigOption {
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
 	AUDIO_BUFFER_SIZE,
+	DECODER_LOOKAHEAD,
+	DECODER_CACHE_DIRECTORY,
+	DECODER_CACHE_SIZE,
+	SEEK_INDEX_DIRECTORY,
+	SEEK_INDEX_SIZE,
 	BUFFER_BEFORE_PLAY,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
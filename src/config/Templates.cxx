@@ -54,6 +54,11 @@ const ConfigTemplate config_param_templates[] = {
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
 	{ "audio_buffer_size" },
+	{ "decoder_lookahead" },
+	{ "decoder_cache_directory" },
+	{ "decoder_cache_size" },
+	{ "seek_index_directory" },
+	{ "seek_index_size" },
 	{ "buffer_before_play", false, true },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
@@ -22,6 +22,23 @@
 
 Mutex db_mutex;
 
-#ifndef NDEBUG
-ThreadId db_mutex_holder;
-#endif
+LatencyHistogram db_lock_wait;
+
+unsigned db_serial;
+
+std::atomic<ThreadId> db_mutex_holder;
+
+thread_local DatabaseYieldHandler *db_yield_handler;
+
+void
+db_yield() noexcept
+{
+	assert(holding_db_lock());
+
+	DatabaseYieldHandler *handler = db_yield_handler;
+	if (handler == nullptr || !handler->ShouldYield())
+		return;
+
+	const ScopeDatabaseUnlock unlock;
+	handler->Yield();
+}
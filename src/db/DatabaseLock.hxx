@@ -28,30 +28,50 @@
 
 #include "check.h"
 #include "thread/Mutex.hxx"
+#include "thread/Id.hxx"
+#include "util/LatencyHistogram.hxx"
 #include "util/Compiler.h"
 
+#include <atomic>
+#include <chrono>
+
 #include <assert.h>
 
 extern Mutex db_mutex;
 
-#ifndef NDEBUG
+/**
+ * Time spent waiting for a contended #db_mutex.
+ */
+extern LatencyHistogram db_lock_wait;
 
-#include "thread/Id.hxx"
+/**
+ * Incremented whenever songs or directories are removed from the
+ * database or reordered; a thread which has released the lock in the
+ * middle of a walk uses it to find out whether its pointers and
+ * iterators are still valid.  Protected by #db_mutex.
+ */
+extern unsigned db_serial;
 
-extern ThreadId db_mutex_holder;
+/**
+ * The thread which holds #db_mutex.  This is atomic because
+ * holding_db_lock() reads it without the lock.
+ */
+extern std::atomic<ThreadId> db_mutex_holder;
 
 /**
  * Does the current thread hold the database lock?
+ *
+ * Only the holder stores its own id in #db_mutex_holder, therefore a
+ * relaxed load is enough to answer this question for the current
+ * thread.
  */
 gcc_pure
 static inline bool
 holding_db_lock() noexcept
 {
-	return db_mutex_holder.IsInside();
+	return db_mutex_holder.load(std::memory_order_relaxed).IsInside();
 }
 
-#endif
-
 /**
  * Obtain the global database lock.  This is needed before
  * dereferencing a #song or #directory.  It is not recursive.
@@ -61,12 +81,15 @@ db_lock(void)
 {
 	assert(!holding_db_lock());
 
-	db_mutex.lock();
+	if (!db_mutex.try_lock()) {
+		const auto start = std::chrono::steady_clock::now();
+		db_mutex.lock();
+		db_lock_wait.Add(std::chrono::steady_clock::now() - start);
+	}
 
-	assert(db_mutex_holder.IsNull());
-#ifndef NDEBUG
-	db_mutex_holder = ThreadId::GetCurrent();
-#endif
+	assert(db_mutex_holder.load(std::memory_order_relaxed).IsNull());
+	db_mutex_holder.store(ThreadId::GetCurrent(),
+			      std::memory_order_relaxed);
 }
 
 /**
@@ -76,13 +99,57 @@ static inline void
 db_unlock(void)
 {
 	assert(holding_db_lock());
-#ifndef NDEBUG
-	db_mutex_holder = ThreadId::Null();
-#endif
+	db_mutex_holder.store(ThreadId::Null(), std::memory_order_relaxed);
 
 	db_mutex.unlock();
 }
 
+/**
+ * Note that songs or directories have been removed or reordered.
+ * Caller must hold the database lock.
+ */
+static inline void
+db_modified() noexcept
+{
+	assert(holding_db_lock());
+
+	++db_serial;
+}
+
+/**
+ * A thread which walks the database may install this in
+ * #db_yield_handler to be able to wait for something else (e.g. a
+ * slow client) without blocking other threads which need the
+ * database lock.
+ */
+class DatabaseYieldHandler {
+public:
+	/**
+	 * Does the thread want to wait?  Called with the database
+	 * lock held.
+	 */
+	virtual bool ShouldYield() noexcept = 0;
+
+	/**
+	 * Wait; called without the database lock.
+	 */
+	virtual void Yield() noexcept = 0;
+};
+
+extern thread_local DatabaseYieldHandler *db_yield_handler;
+
+/**
+ * Called by database walks at points where the lock may be released
+ * temporarily; if the current thread's #db_yield_handler asks for it,
+ * release the lock, wait and lock it again.
+ *
+ * If #db_serial has changed after this call, the database has been
+ * modified in the meantime, and the caller must look up its
+ * pointers again.
+ */
+void
+db_yield() noexcept;
+
 class ScopeDatabaseLock {
 	bool locked = true;
 
@@ -38,6 +38,19 @@ struct DatabasePlugin {
 	 */
 	static constexpr unsigned FLAG_REQUIRE_STORAGE = 0x1;
 
+	/**
+	 * The methods Visit(), VisitUniqueTags() and GetStats() may
+	 * be called from any thread, concurrently with the main
+	 * thread.
+	 */
+	static constexpr unsigned FLAG_THREAD_SAFE = 0x2;
+
+	/**
+	 * Visit() supports DatabaseSelection::after without scanning
+	 * the songs before that position.
+	 */
+	static constexpr unsigned FLAG_RESUME = 0x4;
+
 	const char *name;
 
 	unsigned flags;
@@ -60,6 +73,14 @@ struct DatabasePlugin {
 	constexpr bool RequireStorage() const {
 		return flags & FLAG_REQUIRE_STORAGE;
 	}
+
+	constexpr bool IsThreadSafe() const {
+		return flags & FLAG_THREAD_SAFE;
+	}
+
+	constexpr bool SupportsResume() const {
+		return flags & FLAG_RESUME;
+	}
 };
 
 #endif
@@ -37,6 +37,7 @@
 #include "fs/Traits.hxx"
 #include "util/ChronoUtil.hxx"
 
+#include <algorithm>
 #include <functional>
 
 gcc_pure
@@ -52,8 +53,8 @@ static void
 PrintDirectoryURI(Response &r, bool base,
 		  const LightDirectory &directory) noexcept
 {
-	r.Format("directory: %s\n",
-		 ApplyBaseFlag(directory.GetPath(), base));
+	r.WriteField(FrameField::DIRECTORY, "directory",
+		     ApplyBaseFlag(directory.GetPath(), base));
 }
 
 static void
@@ -72,7 +73,7 @@ PrintDirectoryFull(Response &r, bool base,
 		PrintDirectoryURI(r, base, directory);
 
 		if (!IsNegative(directory.mtime))
-			time_print(r, "Last-Modified", directory.mtime);
+			time_print_last_modified(r, directory.mtime);
 	}
 }
 
@@ -166,6 +167,38 @@ db_selection_print(Response &r, Partition &partition,
 	db.Visit(selection, d, s, p);
 }
 
+bool
+db_selection_print_page(Response &r, const Database &db,
+			const DatabaseSelection &selection,
+			bool full, bool base,
+			unsigned count, std::string &last)
+{
+	/**
+	 * Thrown by the song visitor to stop the walk after the
+	 * first song which does not fit on this page.
+	 */
+	struct PageFull {};
+
+	unsigned n = 0;
+	const auto print = full ? PrintSongFull : PrintSongBrief;
+	VisitSong s = [&r, base, count, print, &n, &last](const LightSong &song){
+		if (n >= count)
+			throw PageFull();
+
+		++n;
+		print(r, base, song);
+		last = song.GetURI();
+	};
+
+	try {
+		db.Visit(selection, VisitDirectory(), s, VisitPlaylist());
+	} catch (PageFull) {
+		return true;
+	}
+
+	return false;
+}
+
 static void
 PrintSongURIVisitor(Response &r, const LightSong &song) noexcept
 {
@@ -186,7 +219,7 @@ PrintSongUris(Response &r, Partition &partition,
 	db.Visit(selection, f);
 }
 
-static void
+void
 PrintUniqueTag(Response &r, TagType tag_type,
 	       const Tag &tag) noexcept
 {
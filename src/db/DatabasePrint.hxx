@@ -20,10 +20,14 @@
 #ifndef MPD_DB_PRINT_H
 #define MPD_DB_PRINT_H
 
+#include <string>
+
 #include <stdint.h>
 
 enum TagType : uint8_t;
 class TagMask;
+struct Tag;
+class Database;
 class SongFilter;
 struct DatabaseSelection;
 struct RangeArg;
@@ -39,6 +43,23 @@ db_selection_print(Response &r, Partition &partition,
 		   const DatabaseSelection &selection,
 		   bool full, bool base);
 
+/**
+ * Print one page of the songs matched by a selection (for a
+ * #ResponseCursor).  The walk stops at the first song after this
+ * page, which tells whether there are more.  Directories and
+ * playlists are not printed.
+ *
+ * @param count the maximum number of songs to be printed
+ * @param last receives the URI of the last printed song, for
+ * DatabaseSelection::after of the next page
+ * @return true if there are more songs after this page
+ */
+bool
+db_selection_print_page(Response &r, const Database &db,
+			const DatabaseSelection &selection,
+			bool full, bool base,
+			unsigned count, std::string &last);
+
 void
 PrintSongUris(Response &r, Partition &partition,
 	      const SongFilter *filter);
@@ -48,4 +69,11 @@ PrintUniqueTags(Response &r, Partition &partition,
 		TagType type, TagMask group_mask,
 		const SongFilter *filter);
 
+/**
+ * Print one item of PrintUniqueTags(), e.g. from a copy kept by a
+ * #ResponseCursor.
+ */
+void
+PrintUniqueTag(Response &r, TagType tag_type, const Tag &tag) noexcept;
+
 #endif
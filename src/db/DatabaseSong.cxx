@@ -38,7 +38,7 @@ DatabaseDetachSong(const Storage *storage, const LightSong &song)
 		detached.SetRealURI(storage->MapUTF8(uri.c_str()));
 	}
 
-	return detached;
+	return DetachedSong::Intern(std::move(detached));
 }
 
 DetachedSong
@@ -57,6 +57,14 @@ struct DatabaseSelection {
 	 */
 	bool recursive;
 
+	/**
+	 * If not empty, then skip all songs up to and including the
+	 * one with this URI, i.e. continue a previous walk which
+	 * ended there.  Only supported by plugins with
+	 * DatabasePlugin::FLAG_RESUME, and not together with #sort.
+	 */
+	std::string after;
+
 	DatabaseSelection(const char *_uri, bool _recursive,
 			  const SongFilter *_filter=nullptr) noexcept;
 
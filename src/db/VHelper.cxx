@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "VHelper.hxx"
+#include "DatabaseLock.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
 #include "song/Filter.hxx"
@@ -127,7 +128,12 @@ DatabaseVisitorHelper::Commit()
 	songs.erase(songs.begin(),
 		    std::next(songs.begin(), selection.window.start));
 
-	/* now pass all songs to the original visitor callback */
-	for (const auto &song : songs)
+	/* now pass all songs to the original visitor callback; they
+	   are copies, so the database may change while we wait for
+	   the client */
+	for (const auto &song : songs) {
+		if (holding_db_lock())
+			db_yield();
 		original_visit_song((LightSong)song);
+	}
 }
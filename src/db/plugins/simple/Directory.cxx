@@ -26,6 +26,7 @@
 #include "song/LightSong.hxx"
 #include "db/Uri.hxx"
 #include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
 #include "db/Interface.hxx"
 #include "db/Selection.hxx"
 #include "song/Filter.hxx"
@@ -33,6 +34,9 @@
 #include "fs/Traits.hxx"
 #include "util/Alloc.hxx"
 #include "util/DeleteDisposer.hxx"
+#include "util/StringCompare.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
 #include <string.h>
@@ -46,8 +50,6 @@ Directory::Directory(std::string &&_path_utf8, Directory *_parent)
 
 Directory::~Directory()
 {
-	delete mounted_database;
-
 	songs.clear_and_dispose(Song::Disposer());
 	children.clear_and_dispose(DeleteDisposer());
 }
@@ -58,6 +60,7 @@ Directory::Delete()
 	assert(holding_db_lock());
 	assert(parent != nullptr);
 
+	db_modified();
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
 					   DeleteDisposer());
 }
@@ -107,10 +110,11 @@ Directory::PruneEmpty() noexcept
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty() && !child->IsMount())
+		if (child->IsEmpty() && !child->IsMount()) {
+			db_modified();
 			child = children.erase_and_dispose(child,
 							   DeleteDisposer());
-		else
+		} else
 			++child;
 	}
 }
@@ -177,6 +181,7 @@ Directory::RemoveSong(Song *song) noexcept
 	assert(song != nullptr);
 	assert(song->parent == this);
 
+	db_modified();
 	songs.erase(songs.iterator_to(*song));
 }
 
@@ -208,56 +213,312 @@ Directory::Sort() noexcept
 {
 	assert(holding_db_lock());
 
-	children.sort(directory_cmp);
-	song_list_sort(songs);
+	/* don't invalidate the iterators of concurrent walks if
+	   nothing changes (which is the common case after an
+	   update) */
+	bool modified = song_list_sort(songs);
+
+	if (!std::is_sorted(children.begin(), children.end(),
+			    directory_cmp)) {
+		children.sort(directory_cmp);
+		modified = true;
+	}
+
+	if (modified)
+		db_modified();
 
 	for (auto &child : children)
 		child.Sort();
 }
 
+/**
+ * Find the position where an interrupted iteration over a list of
+ * songs or directories resumes after the database has been modified
+ * by another thread: right after the entry which was visited last,
+ * or (if that one was deleted) at its former index.
+ *
+ * @param last_name the name of the entry visited last; empty if
+ * none was visited yet
+ * @param position the index of the next entry before the
+ * modification; updated to the index of the returned iterator
+ */
+template<typename L, typename N>
+static typename L::const_iterator
+ResumeList(const L &list, N get_name,
+	   const std::string &last_name, std::size_t &position) noexcept
+{
+	if (!last_name.empty()) {
+		std::size_t i = 0;
+		for (auto it = list.begin(); it != list.end(); ++it, ++i) {
+			if (last_name == get_name(*it)) {
+				position = i + 1;
+				return std::next(it);
+			}
+		}
+	}
+
+	auto it = list.begin();
+	std::size_t i = 0;
+	while (i < position && it != list.end()) {
+		++it;
+		++i;
+	}
+
+	position = i;
+	return it;
+}
+
+/**
+ * Walks a directory tree.  db_yield() may release the lock, and
+ * another thread may delete, add or reorder songs and directories
+ * meanwhile (see #db_serial).  After that, pointers and iterators
+ * into the tree are invalid; each level looks up its directory
+ * again by its path, and resumes after the entry it visited last.
+ * An entry which was added or moved before the resume position is
+ * missed, but nothing is visited twice and no error is reported to
+ * a client just because it was slow.
+ *
+ * The same mechanism starts a walk after a given song (see
+ * DatabaseSelection::after); only the directories on the path to
+ * that song are scanned, not everything before it.
+ */
+class DirectoryWalker {
+	const Directory &root;
+
+	const bool recursive;
+	const SongFilter *const filter;
+
+	const VisitDirectory &visit_directory;
+	const VisitSong &visit_song;
+	const VisitPlaylist &visit_playlist;
+
+public:
+	DirectoryWalker(const Directory &_root,
+			bool _recursive, const SongFilter *_filter,
+			const VisitDirectory &_visit_directory,
+			const VisitSong &_visit_song,
+			const VisitPlaylist &_visit_playlist) noexcept
+		:root(_root), recursive(_recursive), filter(_filter),
+		 visit_directory(_visit_directory),
+		 visit_song(_visit_song),
+		 visit_playlist(_visit_playlist) {}
+
+	/**
+	 * @param resume if not nullptr, then skip everything up to
+	 * and including the song with this URI, which is inside the
+	 * given directory
+	 */
+	void Walk(const Directory *directory,
+		  const char *resume=nullptr) const;
+
+private:
+	/**
+	 * Look up the directory with the given path after the
+	 * database has been modified.
+	 *
+	 * @return the directory or nullptr if it was deleted
+	 */
+	gcc_pure
+	const Directory *Lookup(const std::string &path) const noexcept {
+		auto r = const_cast<Directory &>(root).LookupDirectory(path.c_str());
+		return r.uri == nullptr ? r.directory : nullptr;
+	}
+};
+
+/**
+ * Throw the error which is reported when the entry where a walk
+ * shall resume (see DatabaseSelection::after) does not exist
+ * anymore.
+ */
+[[noreturn]]
+static void
+ThrowResumeConflict()
+{
+	throw DatabaseError(DatabaseErrorCode::CONFLICT,
+			    "Database has been modified");
+}
+
 void
-Directory::Walk(bool recursive, const SongFilter *filter,
-		VisitDirectory visit_directory, VisitSong visit_song,
-		VisitPlaylist visit_playlist) const
+DirectoryWalker::Walk(const Directory *directory, const char *resume) const
 {
-	if (IsMount()) {
-		assert(IsEmpty());
+	if (directory->IsMount()) {
+		assert(directory->IsEmpty());
+
+		/* the directory may be unmounted and deleted while
+		   the lock is released; the reference keeps the
+		   database alive */
+		auto db = directory->mounted_database;
+		const std::string base = directory->GetPath();
+
+		DatabaseSelection selection("", recursive, filter);
+		if (resume != nullptr)
+			/* WalkMount() strips the mount point */
+			selection.after = resume;
 
 		/* TODO: eliminate this unlock/lock; it is necessary
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
 		const ScopeDatabaseUnlock unlock;
-		WalkMount(GetPath(), *mounted_database,
-			  "", DatabaseSelection("", recursive, filter),
+		WalkMount(base.c_str(), *db, "", selection,
 			  visit_directory, visit_song,
 			  visit_playlist);
+
+		/* if this was the last reference, close the database
+		   without holding the lock */
+		db.reset();
 		return;
 	}
 
-	if (visit_song) {
-		for (auto &song : songs){
+	const std::string path = directory->GetPath();
+	unsigned serial = db_serial;
+
+	std::string last_name;
+	std::size_t position = 0;
+
+	/* the name of the child which contains the resume
+	   position */
+	std::string resume_child;
+
+	if (resume != nullptr) {
+		/* the path of #resume relative to this directory */
+		const char *rest = path.empty()
+			? resume
+			: resume + path.length() + 1;
+		const char *slash = strchr(rest, '/');
+		if (slash == nullptr) {
+			/* continue after this song */
+			if (directory->FindSong(rest) == nullptr)
+				ThrowResumeConflict();
+
+			last_name = rest;
+		} else
+			/* all songs and playlists of this directory
+			   have been visited */
+			resume_child.assign(rest, slash);
+	}
+
+	if (visit_song && resume_child.empty()) {
+		auto i = directory->songs.begin();
+		if (!last_name.empty())
+			i = ResumeList(directory->songs,
+				       [](const Song &song){
+					       return song.uri;
+				       },
+				       last_name, position);
+
+		while (true) {
+			/* a slow client may let us wait here */
+			db_yield();
+
+			if (db_serial != serial) {
+				serial = db_serial;
+				directory = Lookup(path);
+				if (directory == nullptr)
+					return;
+
+				i = ResumeList(directory->songs,
+					       [](const Song &song){
+						       return song.uri;
+					       },
+					       last_name, position);
+			}
+
+			if (i == directory->songs.end())
+				break;
+
+			const Song &song = *i++;
+			++position;
+			last_name.assign(song.uri);
+
 			const LightSong song2 = song.Export();
 			if (filter == nullptr || filter->Match(song2))
 				visit_song(song2);
 		}
 	}
 
-	if (visit_playlist) {
-		for (const PlaylistInfo &p : playlists)
-			visit_playlist(p, Export());
+	if (visit_playlist && resume_child.empty()) {
+		for (const PlaylistInfo &p : directory->playlists)
+			visit_playlist(p, directory->Export());
+	}
+
+	last_name.clear();
+	position = 0;
+
+	auto i = directory->children.begin();
+
+	if (!resume_child.empty() && recursive) {
+		const Directory *child =
+			directory->FindChild(resume_child.c_str());
+		if (child == nullptr)
+			ThrowResumeConflict();
+
+		/* this child has been visited already; continue
+		   inside it, and then with its next sibling */
+		last_name = std::move(resume_child);
+		i = ResumeList(directory->children,
+			       [](const Directory &c){
+				       return c.GetName();
+			       },
+			       last_name, position);
+		Walk(child, resume);
 	}
 
-	for (auto &child : children) {
+	while (true) {
+		db_yield();
+
+		/* this also catches modifications while walking the
+		   previous child */
+		if (db_serial != serial) {
+			serial = db_serial;
+			directory = Lookup(path);
+			if (directory == nullptr)
+				return;
+
+			i = ResumeList(directory->children,
+				       [](const Directory &child){
+					       return child.GetName();
+				       },
+				       last_name, position);
+		}
+
+		if (i == directory->children.end())
+			break;
+
+		const Directory &child = *i++;
+		++position;
+		last_name.assign(child.GetName());
+
 		if (visit_directory)
 			visit_directory(child.Export());
 
 		if (recursive)
-			child.Walk(recursive, filter,
-				   visit_directory, visit_song,
-				   visit_playlist);
+			Walk(&child);
 	}
 }
 
+void
+Directory::Walk(bool recursive, const SongFilter *filter,
+		VisitDirectory visit_directory, VisitSong visit_song,
+		VisitPlaylist visit_playlist,
+		const char *after) const
+{
+	const Directory *r = this;
+	while (!r->IsRoot())
+		r = r->parent;
+
+	if (after != nullptr &&
+	    !IsRoot() &&
+	    (!StringStartsWith(after, path.c_str()) ||
+	     after[path.length()] != '/'))
+		/* not inside this directory */
+		ThrowResumeConflict();
+
+	const DirectoryWalker walker(*r, recursive, filter,
+				     visit_directory, visit_song,
+				     visit_playlist);
+	walker.Walk(this, after);
+}
+
 LightDirectory
 Directory::Export() const noexcept
 {
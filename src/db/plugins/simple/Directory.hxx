@@ -28,6 +28,7 @@
 
 #include <boost/intrusive/list.hpp>
 
+#include <memory>
 #include <string>
 
 /**
@@ -96,8 +97,13 @@ struct Directory {
 	/**
 	 * If this is not nullptr, then this directory does not really
 	 * exist, but is a mount point for another #Database.
+	 *
+	 * A thread which walks the mounted database without holding
+	 * #db_mutex copies this pointer (with the lock held) to keep
+	 * it alive; after an unmount, the last reference closes and
+	 * deletes it.
 	 */
-	Database *mounted_database = nullptr;
+	std::shared_ptr<Database> mounted_database;
 
 public:
 	Directory(std::string &&_path_utf8, Directory *_parent);
@@ -266,10 +272,15 @@ public:
 
 	/**
 	 * Caller must lock #db_mutex.
+	 *
+	 * @param after if not nullptr, then resume after the song
+	 * with this URI (see DatabaseSelection::after); throws
+	 * #DatabaseError (CONFLICT) if it does not exist
 	 */
 	void Walk(bool recursive, const SongFilter *match,
 		  VisitDirectory visit_directory, VisitSong visit_song,
-		  VisitPlaylist visit_playlist) const;
+		  VisitPlaylist visit_playlist,
+		  const char *after=nullptr) const;
 
 	gcc_pure
 	LightDirectory Export() const noexcept;
@@ -25,6 +25,7 @@
 #include "db/LightDirectory.hxx"
 #include "db/Interface.hxx"
 #include "fs/Traits.hxx"
+#include "util/StringCompare.hxx"
 
 #include <string>
 
@@ -91,6 +92,16 @@ WalkMount(const char *base, const Database &db,
 	DatabaseSelection selection(old_selection);
 	selection.uri = uri;
 
+	if (!selection.after.empty() && base != nullptr) {
+		/* the mounted database doesn't know its own
+		   location */
+		const char *after = StringAfterPrefix(selection.after.c_str(),
+						      base);
+		if (after != nullptr && *after == '/')
+			selection.after.erase(0, after + 1 -
+					      selection.after.c_str());
+	}
+
 	SongFilter prefix_filter;
 
 	if (base != nullptr && selection.filter != nullptr) {
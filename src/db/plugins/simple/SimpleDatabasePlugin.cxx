@@ -286,10 +286,14 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 	auto r = root->LookupDirectory(selection.uri.c_str());
 
 	if (r.directory->IsMount()) {
-		/* pass the request and the remaining uri to the mounted database */
+		/* pass the request and the remaining uri to the
+		   mounted database; the reference keeps it alive if
+		   it gets unmounted meanwhile */
+		const auto db = r.directory->mounted_database;
+		const std::string base = r.directory->GetPath();
 		protect.unlock();
 
-		WalkMount(r.directory->GetPath(), *(r.directory->mounted_database),
+		WalkMount(base.c_str(), *db,
 			  (r.uri == nullptr)?"":r.uri, selection,
 			  visit_directory, visit_song, visit_playlist);
 
@@ -301,12 +305,16 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 	if (r.uri == nullptr) {
 		/* it's a directory */
 
-		if (selection.recursive && visit_directory)
+		const bool resume = !selection.after.empty();
+		assert(!resume || selection.sort == TAG_NUM_OF_ITEM_TYPES);
+
+		if (selection.recursive && visit_directory && !resume)
 			visit_directory(r.directory->Export());
 
 		r.directory->Walk(selection.recursive, selection.filter,
 				  visit_directory, visit_song,
-				  visit_playlist);
+				  visit_playlist,
+				  resume ? selection.after.c_str() : nullptr);
 		helper.Commit();
 		return;
 	}
@@ -390,6 +398,16 @@ SimpleDatabase::Save()
 		mtime = fi.GetModificationTime();
 }
 
+/**
+ * The deleter of Directory::mounted_database.
+ */
+static void
+CloseDatabase(Database *db) noexcept
+{
+	db->Close();
+	delete db;
+}
+
 void
 SimpleDatabase::Mount(const char *uri, Database *db)
 {
@@ -412,7 +430,7 @@ SimpleDatabase::Mount(const char *uri, Database *db)
 				    "Parent not found");
 
 	Directory *mnt = r.directory->CreateChild(r.uri);
-	mnt->mounted_database = db;
+	mnt->mounted_database = std::shared_ptr<Database>(db, CloseDatabase);
 }
 
 static constexpr bool
@@ -462,7 +480,7 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri)
 	}
 }
 
-inline Database *
+inline std::shared_ptr<Database>
 SimpleDatabase::LockUmountSteal(const char *uri) noexcept
 {
 	ScopeDatabaseLock protect;
@@ -471,8 +489,7 @@ SimpleDatabase::LockUmountSteal(const char *uri) noexcept
 	if (r.uri != nullptr || !r.directory->IsMount())
 		return nullptr;
 
-	Database *db = r.directory->mounted_database;
-	r.directory->mounted_database = nullptr;
+	auto db = std::move(r.directory->mounted_database);
 	r.directory->Delete();
 
 	return db;
@@ -481,17 +498,14 @@ SimpleDatabase::LockUmountSteal(const char *uri) noexcept
 bool
 SimpleDatabase::Unmount(const char *uri) noexcept
 {
-	Database *db = LockUmountSteal(uri);
-	if (db == nullptr)
-		return false;
-
-	db->Close();
-	delete db;
-	return true;
+	/* if a walk in another thread still uses the database, the
+	   last reference closes and deletes it */
+	return LockUmountSteal(uri) != nullptr;
 }
 
 const DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE|DatabasePlugin::FLAG_THREAD_SAFE|
+	DatabasePlugin::FLAG_RESUME,
 	SimpleDatabase::Create,
 };
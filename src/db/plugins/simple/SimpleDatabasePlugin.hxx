@@ -28,6 +28,7 @@
 #include "util/Compiler.h"
 
 #include <cassert>
+#include <memory>
 
 struct ConfigBlock;
 struct Directory;
@@ -142,7 +143,7 @@ private:
 	 */
 	void Load();
 
-	Database *LockUmountSteal(const char *uri) noexcept;
+	std::shared_ptr<Database> LockUmountSteal(const char *uri) noexcept;
 };
 
 extern const DatabasePlugin simple_db_plugin;
@@ -23,6 +23,8 @@
 #include "tag/Tag.hxx"
 #include "lib/icu/Collate.hxx"
 
+#include <algorithm>
+
 #include <stdlib.h>
 
 static int
@@ -100,8 +102,12 @@ song_cmp(const Song &a, const Song &b) noexcept
 	return IcuCollate(a.uri, b.uri) < 0;
 }
 
-void
+bool
 song_list_sort(SongList &songs) noexcept
 {
+	if (std::is_sorted(songs.begin(), songs.end(), song_cmp))
+		return false;
+
 	songs.sort(song_cmp);
+	return true;
 }
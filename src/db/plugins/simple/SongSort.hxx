@@ -22,7 +22,11 @@
 
 #include "Song.hxx"
 
-void
+/**
+ * @return true if the order was changed, false if the list was
+ * already sorted
+ */
+bool
 song_list_sort(SongList &songs) noexcept;
 
 #endif
@@ -89,6 +89,13 @@ LockNeedChunks(DecoderControl &dc) noexcept
 	return need_chunks(dc);
 }
 
+static bool
+LockIsLookaheadFull(const DecoderControl &dc) noexcept
+{
+	const std::lock_guard<Mutex> protect(dc.mutex);
+	return dc.IsLookaheadFull();
+}
+
 MusicChunk *
 DecoderBridge::GetChunk() noexcept
 {
@@ -98,13 +105,17 @@ DecoderBridge::GetChunk() noexcept
 		return current_chunk.get();
 
 	do {
-		current_chunk = dc.buffer->Allocate();
-		if (current_chunk != nullptr) {
-			current_chunk->replay_gain_serial = replay_gain_serial;
-			if (replay_gain_serial != 0)
-				current_chunk->replay_gain_info = replay_gain_info;
-
-			return current_chunk.get();
+		/* a decode-ahead decoder pauses here until the player
+		   lifts the limit (see DecoderControl::lookahead) */
+		if (!LockIsLookaheadFull(dc)) {
+			current_chunk = dc.buffer->Allocate();
+			if (current_chunk != nullptr) {
+				current_chunk->replay_gain_serial = replay_gain_serial;
+				if (replay_gain_serial != 0)
+					current_chunk->replay_gain_info = replay_gain_info;
+
+				return current_chunk.get();
+			}
 		}
 
 		cmd = LockNeedChunks(dc);
@@ -113,6 +124,25 @@ DecoderBridge::GetChunk() noexcept
 	return nullptr;
 }
 
+void
+DecoderBridge::RecordChunk(const MusicChunk &chunk) noexcept
+{
+	assert(cache_writer != nullptr);
+
+	if (!cache_writer->IsOpen() &&
+	    !cache_writer->Open(dc.out_audio_format, dc.total_time)) {
+		cache_writer.reset();
+		return;
+	}
+
+	if (!cache_writer->Append({chunk.data, chunk.length})) {
+		cache_writer.reset();
+		return;
+	}
+
+	cache_writer->SetBitRate(chunk.bit_rate);
+}
+
 void
 DecoderBridge::FlushChunk()
 {
@@ -122,6 +152,9 @@ DecoderBridge::FlushChunk()
 	assert(current_chunk != nullptr);
 
 	auto chunk = std::move(current_chunk);
+	if (cache_writer != nullptr && chunk->length > 0)
+		RecordChunk(*chunk);
+
 	if (!chunk->IsEmpty())
 		dc.pipe->Push(std::move(chunk));
 
@@ -150,6 +183,10 @@ DecoderBridge::PrepareInitialSeek()
 		if (!dc.seekable) {
 			/* seeking is not possible */
 			initial_seek_pending = false;
+
+			/* the data does not begin at the start
+			   position; don't cache it */
+			cache_writer.reset();
 			return false;
 		}
 
@@ -250,6 +287,16 @@ DecoderBridge::Ready(const AudioFormat audio_format,
 	{
 		const std::lock_guard<Mutex> protect(dc.mutex);
 		dc.SetReady(audio_format, seekable, duration);
+
+		/* choose a chunk size for this song's bit rate; this
+		   is only possible if the previous song's chunks are
+		   all gone (i.e. not during gapless playback), and it
+		   must be done before the player sees the new state
+		   (see Player::CheckDecoderStartup()) */
+		if (!dc.buffer->SetChunkSize(ChooseChunkSize(dc.out_audio_format)))
+			FormatDebug(decoder_domain,
+				    "buffer in use, keeping chunk size %zu",
+				    dc.buffer->GetChunkCapacity());
 	}
 
 	if (dc.in_audio_format != dc.out_audio_format) {
@@ -302,6 +349,9 @@ DecoderBridge::CommandFinished()
 
 		current_chunk.reset();
 
+		/* the data after the seek cannot be cached */
+		cache_writer.reset();
+
 		dc.pipe->Clear();
 
 		if (convert != nullptr)
@@ -345,6 +395,7 @@ DecoderBridge::SeekError()
 		/* d'oh, we can't seek to the sub-song start position,
 		   what now? - no idea, ignoring the problem for now. */
 		initial_seek_running = false;
+		cache_writer.reset();
 		return;
 	}
 
@@ -540,6 +591,101 @@ DecoderBridge::SubmitData(InputStream *is,
 	return cmd;
 }
 
+WritableBuffer<void>
+DecoderBridge::GetWriteBuffer(InputStream *is)
+{
+	assert(dc.state == DecoderState::DECODE);
+	assert(dc.pipe != nullptr);
+
+	if (convert != nullptr)
+		/* the data needs to be converted first; only
+		   SubmitData() can do that */
+		return nullptr;
+
+	if (LockGetVirtualCommand() != DecoderCommand::NONE)
+		return nullptr;
+
+	assert(!initial_seek_pending);
+	assert(!initial_seek_running);
+
+	/* send stream tags; this must be done before lending a
+	   chunk, because it flushes the current one */
+
+	if (UpdateStreamTag(is)) {
+		const auto cmd = decoder_tag != nullptr
+			? DoSendTag(*Tag::Merge(*decoder_tag, *stream_tag))
+			: DoSendTag(*stream_tag);
+		if (cmd != DecoderCommand::NONE)
+			return nullptr;
+	}
+
+	const size_t frame_size = dc.out_audio_format.GetFrameSize();
+	size_t max_frames = SIZE_MAX / frame_size;
+
+	if (dc.end_time.IsPositive()) {
+		/* enforce the given end time */
+
+		const uint64_t end_frame =
+			dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate);
+		if (absolute_frame >= end_frame)
+			/* let SubmitData() return STOP */
+			return nullptr;
+
+		max_frames = std::min<uint64_t>(max_frames,
+						end_frame - absolute_frame);
+	}
+
+	while (true) {
+		auto *chunk = GetChunk();
+		if (chunk == nullptr)
+			return nullptr;
+
+		/* the bit rate is set by CommitData() */
+		auto dest = chunk->Write(dc.out_audio_format,
+					 SongTime::Cast(timestamp) -
+					 dc.song->GetStartTime(),
+					 0);
+		if (dest.empty()) {
+			/* the chunk is full, flush it */
+			FlushChunk();
+			continue;
+		}
+
+		dest.size = std::min(dest.size, max_frames * frame_size);
+		return dest;
+	}
+}
+
+DecoderCommand
+DecoderBridge::CommitData(size_t length, uint16_t kbit_rate)
+{
+	assert(dc.state == DecoderState::DECODE);
+	assert(current_chunk != nullptr);
+	assert(convert == nullptr);
+	assert(length % dc.out_audio_format.GetFrameSize() == 0);
+
+	if (length == 0)
+		return LockGetVirtualCommand();
+
+	auto &chunk = *current_chunk;
+	if (chunk.length == 0)
+		chunk.bit_rate = kbit_rate;
+
+	if (chunk.Expand(dc.out_audio_format, length))
+		/* the chunk is full, flush it */
+		FlushChunk();
+
+	timestamp += dc.out_audio_format.SizeToTime<FloatDuration>(length);
+	absolute_frame += length / dc.out_audio_format.GetFrameSize();
+
+	if (dc.end_time.IsPositive() &&
+	    absolute_frame >= dc.end_time.ToScale<uint64_t>(dc.in_audio_format.sample_rate))
+		/* the end of the range has been reached */
+		return DecoderCommand::STOP;
+
+	return LockGetVirtualCommand();
+}
+
 DecoderCommand
 DecoderBridge::SubmitTag(InputStream *is, Tag &&tag)
 {
@@ -579,6 +725,9 @@ DecoderBridge::SubmitTag(InputStream *is, Tag &&tag)
 void
 DecoderBridge::SubmitReplayGain(const ReplayGainInfo *new_replay_gain_info)
 {
+	if (cache_writer != nullptr)
+		cache_writer->SetReplayGain(new_replay_gain_info);
+
 	if (new_replay_gain_info != nullptr) {
 		static unsigned serial;
 		if (++serial == 0)
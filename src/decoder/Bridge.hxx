@@ -21,6 +21,7 @@
 #define MPD_DECODER_BRIDGE_HXX
 
 #include "Client.hxx"
+#include "Cache.hxx"
 #include "ReplayGainInfo.hxx"
 #include "MusicChunkPtr.hxx"
 
@@ -100,6 +101,21 @@ public:
 	 */
 	unsigned replay_gain_serial = 0;
 
+	/**
+	 * If not nullptr, then all decoded data is recorded into a
+	 * new #DecoderCache entry.  It is discarded when the data
+	 * stops being contiguous (e.g. after a seek).
+	 */
+	std::unique_ptr<DecoderCacheWriter> cache_writer;
+
+	/**
+	 * Has the decoder plugin read its #InputStream until the end?
+	 * This verifies a #cache_writer recording if the song's
+	 * duration is unknown.  It is always false for plugins which
+	 * decode files.
+	 */
+	bool input_eof = false;
+
 	/**
 	 * An error has occurred (in DecoderAPI.cxx), and the plugin
 	 * will be asked to stop.
@@ -152,6 +168,8 @@ public:
 	DecoderCommand SubmitData(InputStream *is,
 				  const void *data, size_t length,
 				  uint16_t kbit_rate) override;
+	WritableBuffer<void> GetWriteBuffer(InputStream *is) override;
+	DecoderCommand CommitData(size_t length, uint16_t kbit_rate) override;
 	DecoderCommand SubmitTag(InputStream *is, Tag &&tag) override ;
 	void SubmitReplayGain(const ReplayGainInfo *replay_gain_info) override;
 	void SubmitMixRamp(MixRampInfo &&mix_ramp) override;
@@ -177,6 +195,11 @@ private:
 	 */
 	DecoderCommand DoSendTag(const Tag &tag);
 
+	/**
+	 * Append the chunk's data to the #cache_writer.
+	 */
+	void RecordChunk(const MusicChunk &chunk) noexcept;
+
 	bool UpdateStreamTag(InputStream *is);
 };
 
@@ -0,0 +1,609 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Cache.hxx"
+#include "config/Data.hxx"
+#include "config/Option.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "util/Domain.hxx"
+#include "util/Fnv1aHash.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static constexpr Domain decoder_cache_domain("decoder_cache");
+
+static constexpr char header_magic[8] = {'M', 'P', 'D', 'P', 'C', 'M', 'C', '1'};
+static constexpr char trailer_magic[8] = {'M', 'P', 'D', 'P', 'C', 'M', 'E', '1'};
+
+/**
+ * The PCM data begins at this file offset; the space before it holds
+ * the #CacheHeader and the URI.
+ */
+static constexpr size_t DATA_OFFSET = 4096;
+
+/**
+ * A #DecoderCacheWriter reserves space in the #DecoderCache in steps
+ * of this size, to avoid locking the mutex for each chunk.
+ */
+static constexpr uint64_t RESERVE_STEP = 1024 * 1024;
+
+/**
+ * The tolerated difference between the recorded duration and the
+ * duration announced by the decoder plugin; see
+ * DecoderCacheWriter::IsComplete().
+ */
+static constexpr SongTime DURATION_TOLERANCE = SongTime::FromMS(100);
+
+/**
+ * The cache is private to this host, therefore all integers are
+ * stored in host byte order.
+ */
+struct CacheHeader {
+	char magic[sizeof(header_magic)];
+
+	int64_t mtime;
+	uint32_t start_ms, end_ms;
+	int32_t duration_ms;
+
+	uint32_t sample_rate;
+	uint8_t format, channels;
+
+	uint8_t configured_format, configured_channels;
+	uint32_t configured_sample_rate;
+
+	uint32_t uri_length;
+};
+
+struct CacheTrailer {
+	uint64_t pcm_size;
+
+	ReplayGainInfo replay_gain_info;
+	uint8_t has_replay_gain;
+	uint8_t reserved;
+	uint16_t kbit_rate;
+
+	char magic[sizeof(trailer_magic)];
+};
+
+static DecoderCache *decoder_cache;
+
+static void
+FillKey(CacheHeader &h, const DecoderCacheKey &key) noexcept
+{
+	h.mtime = std::chrono::system_clock::to_time_t(key.mtime);
+	h.start_ms = key.start_time.ToMS();
+	h.end_ms = key.end_time.ToMS();
+	h.configured_format = uint8_t(key.configured_audio_format.format);
+	h.configured_channels = key.configured_audio_format.channels;
+	h.configured_sample_rate = key.configured_audio_format.sample_rate;
+	h.uri_length = key.uri.length();
+}
+
+std::string
+DecoderCacheKey::GetFileName() const noexcept
+{
+	CacheHeader h;
+	memset(&h, 0, sizeof(h));
+	FillKey(h, *this);
+
+	Fnv1aHash hash;
+	hash.Update(uri.data(), uri.length());
+	hash.Update(&h, sizeof(h));
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%016llx.pcm",
+		 (unsigned long long)hash.Get());
+	return buffer;
+}
+
+gcc_pure
+static bool
+IsCacheFileName(const std::string &name) noexcept
+{
+	return name.length() == 20 &&
+		name.compare(16, 4, ".pcm") == 0 &&
+		std::all_of(name.begin(), name.begin() + 16,
+			    [](char ch){
+				    return (ch >= '0' && ch <= '9') ||
+					    (ch >= 'a' && ch <= 'f');
+			    });
+}
+
+DecoderCacheFile::~DecoderCacheFile() noexcept
+{
+#ifndef _WIN32
+	munmap(address, size);
+#endif
+}
+
+bool
+DecoderCacheFile::Parse(const DecoderCacheKey &key) noexcept
+{
+	if (size < DATA_OFFSET + sizeof(CacheTrailer))
+		return false;
+
+	const uint8_t *const p = (const uint8_t *)address;
+
+	CacheHeader h, expected;
+	memcpy(&h, p, sizeof(h));
+	memset(&expected, 0, sizeof(expected));
+	FillKey(expected, key);
+
+	if (memcmp(h.magic, header_magic, sizeof(h.magic)) != 0 ||
+	    h.mtime != expected.mtime ||
+	    h.start_ms != expected.start_ms ||
+	    h.end_ms != expected.end_ms ||
+	    h.configured_format != expected.configured_format ||
+	    h.configured_channels != expected.configured_channels ||
+	    h.configured_sample_rate != expected.configured_sample_rate ||
+	    h.uri_length != expected.uri_length ||
+	    sizeof(h) + h.uri_length > DATA_OFFSET ||
+	    memcmp(p + sizeof(h), key.uri.data(), h.uri_length) != 0)
+		/* a hash collision or a corrupt file */
+		return false;
+
+	CacheTrailer t;
+	memcpy(&t, p + size - sizeof(t), sizeof(t));
+	if (memcmp(t.magic, trailer_magic, sizeof(t.magic)) != 0 ||
+	    t.pcm_size != size - DATA_OFFSET - sizeof(t))
+		return false;
+
+	audio_format = AudioFormat(h.sample_rate, SampleFormat(h.format),
+				   h.channels);
+	if (!audio_format.IsValid() ||
+	    t.pcm_size % audio_format.GetFrameSize() != 0)
+		return false;
+
+	duration = SignedSongTime::FromMS(h.duration_ms);
+	pcm = {p + DATA_OFFSET, size_t(t.pcm_size)};
+	replay_gain_info = t.replay_gain_info;
+	has_replay_gain = t.has_replay_gain != 0;
+	kbit_rate = t.kbit_rate;
+	return true;
+}
+
+DecoderCacheWriter::DecoderCacheWriter(DecoderCache &_cache,
+				       DecoderCacheKey &&_key,
+				       Path path, uint64_t _max_pcm_size)
+	:cache(_cache), key(std::move(_key)),
+	 os(path),
+	 max_pcm_size(_max_pcm_size)
+{
+	replay_gain_info.Clear();
+}
+
+DecoderCacheWriter::~DecoderCacheWriter() noexcept
+{
+	if (reserved > 0)
+		cache.Release(reserved);
+}
+
+bool
+DecoderCacheWriter::Reserve(uint64_t file_size) noexcept
+{
+	if (file_size <= reserved)
+		return true;
+
+	const uint64_t max_file_size =
+		DATA_OFFSET + max_pcm_size + sizeof(CacheTrailer);
+	const uint64_t new_reserved =
+		std::min(std::max(file_size, reserved + RESERVE_STEP),
+			 max_file_size);
+	if (file_size > new_reserved ||
+	    !cache.Reserve(new_reserved - reserved))
+		return false;
+
+	reserved = new_reserved;
+	return true;
+}
+
+bool
+DecoderCacheWriter::Open(AudioFormat _audio_format,
+			 SignedSongTime duration) noexcept
+try {
+	assert(!open);
+
+	uint8_t buffer[DATA_OFFSET];
+	memset(buffer, 0, sizeof(buffer));
+
+	CacheHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, header_magic, sizeof(h.magic));
+	FillKey(h, key);
+	h.duration_ms = duration.ToMS();
+	h.sample_rate = _audio_format.sample_rate;
+	h.format = uint8_t(_audio_format.format);
+	h.channels = _audio_format.channels;
+
+	if (sizeof(h) + key.uri.length() > sizeof(buffer))
+		/* URI too long */
+		return false;
+
+	if (!Reserve(DATA_OFFSET + sizeof(CacheTrailer)))
+		return false;
+
+	memcpy(buffer, &h, sizeof(h));
+	memcpy(buffer + sizeof(h), key.uri.data(), key.uri.length());
+	os.Write(buffer, sizeof(buffer));
+
+	open = true;
+	audio_format = _audio_format;
+	return true;
+} catch (...) {
+	LogError(std::current_exception());
+	return false;
+}
+
+bool
+DecoderCacheWriter::Append(ConstBuffer<void> data) noexcept
+try {
+	assert(open);
+
+	pcm_size += data.size;
+	if (pcm_size > max_pcm_size ||
+	    !Reserve(DATA_OFFSET + pcm_size + sizeof(CacheTrailer)))
+		return false;
+
+	os.Write(data.data, data.size);
+	return true;
+} catch (...) {
+	LogError(std::current_exception());
+	return false;
+}
+
+bool
+DecoderCacheWriter::IsComplete(SongTime expected_duration) const noexcept
+{
+	assert(open);
+
+	const auto duration =
+		SongTime::FromScale<uint64_t>(pcm_size / audio_format.GetFrameSize(),
+					      audio_format.sample_rate);
+	return duration + DURATION_TOLERANCE >= expected_duration &&
+		duration <= expected_duration + DURATION_TOLERANCE;
+}
+
+void
+DecoderCacheWriter::Commit() noexcept
+try {
+	assert(open);
+
+	CacheTrailer t;
+	memset(&t, 0, sizeof(t));
+	t.pcm_size = pcm_size;
+	t.replay_gain_info = replay_gain_info;
+	t.has_replay_gain = has_replay_gain;
+	t.kbit_rate = kbit_rate;
+	memcpy(t.magic, trailer_magic, sizeof(t.magic));
+	os.Write(&t, sizeof(t));
+
+	os.Commit();
+
+	cache.Add(key.GetFileName(), DATA_OFFSET + pcm_size + sizeof(t),
+		  reserved);
+	reserved = 0;
+} catch (...) {
+	LogError(std::current_exception());
+}
+
+DecoderCache::DecoderCache(AllocatedPath &&_directory, uint64_t _max_size)
+	:directory(std::move(_directory)), max_size(_max_size)
+{
+	Load();
+}
+
+void
+DecoderCache::Load()
+{
+	struct Item {
+		std::string name;
+		uint64_t size;
+		std::chrono::system_clock::time_point mtime;
+	};
+
+	std::vector<Item> items;
+
+	DirectoryReader reader(directory);
+	while (reader.ReadEntry()) {
+		std::string name = reader.GetEntry().ToUTF8();
+		if (!IsCacheFileName(name))
+			continue;
+
+		FileInfo fi;
+		if (!GetFileInfo(AllocatedPath::Build(directory, reader.GetEntry()),
+				 fi) ||
+		    !fi.IsRegular())
+			continue;
+
+		items.push_back({std::move(name), fi.GetSize(),
+				 fi.GetModificationTime()});
+	}
+
+	/* the most recently used file (see Touch()) first */
+	std::sort(items.begin(), items.end(),
+		  [](const Item &a, const Item &b){
+			  return a.mtime > b.mtime;
+		  });
+
+	for (auto &i : items) {
+		lru.push_back({std::move(i.name), i.size});
+		index.emplace(lru.back().name, std::prev(lru.end()));
+		total_size += i.size;
+	}
+
+	std::vector<std::string> garbage;
+	Evict(garbage);
+	Delete(garbage);
+
+	FormatDebug(decoder_cache_domain, "%zu entries, %llu kB",
+		    lru.size(), (unsigned long long)(total_size / 1024));
+}
+
+void
+DecoderCache::Touch(const std::string &name) noexcept
+{
+	auto i = index.find(name);
+	if (i != index.end())
+		lru.splice(lru.begin(), lru, i->second);
+}
+
+std::string
+DecoderCache::Remove(std::list<Entry>::iterator i) noexcept
+{
+	std::string name = std::move(i->name);
+	total_size -= i->size;
+	index.erase(name);
+	lru.erase(i);
+	return name;
+}
+
+void
+DecoderCache::Evict(std::vector<std::string> &garbage, size_t keep) noexcept
+{
+	while (total_size + recording_size > max_size && lru.size() > keep)
+		garbage.emplace_back(Remove(std::prev(lru.end())));
+}
+
+void
+DecoderCache::Delete(const std::string &name) noexcept
+{
+	const auto path = AllocatedPath::Build(directory,
+					       AllocatedPath::FromUTF8(name.c_str()));
+	try {
+		RemoveFile(path);
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
+void
+DecoderCache::Delete(const std::vector<std::string> &garbage) noexcept
+{
+	for (const auto &name : garbage)
+		Delete(name);
+}
+
+bool
+DecoderCache::Reserve(uint64_t size) noexcept
+{
+	std::vector<std::string> garbage;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		recording_size += size;
+		Evict(garbage);
+
+		if (total_size + recording_size > max_size) {
+			/* the other recordings occupy the space */
+			recording_size -= size;
+			return false;
+		}
+	}
+
+	Delete(garbage);
+	return true;
+}
+
+void
+DecoderCache::Release(uint64_t size) noexcept
+{
+	const std::lock_guard<Mutex> protect(mutex);
+
+	assert(recording_size >= size);
+	recording_size -= size;
+}
+
+void
+DecoderCache::Add(const std::string &name, uint64_t size,
+		  uint64_t reserved) noexcept
+{
+	std::vector<std::string> garbage;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+
+		assert(recording_size >= reserved);
+		recording_size -= reserved;
+
+		auto i = index.find(name);
+		if (i != index.end()) {
+			/* replaced an existing file */
+			total_size -= i->second->size;
+			i->second->size = size;
+			lru.splice(lru.begin(), lru, i->second);
+		} else {
+			lru.push_front({name, size});
+			index.emplace(name, lru.begin());
+		}
+
+		total_size += size;
+
+		/* evict the least recently used entries, but never
+		   the new one */
+		Evict(garbage, 1);
+	}
+
+	/* unlink the evicted files after unlocking the mutex, so
+	   other decoder threads are not blocked by disk I/O; if one
+	   of them commits a new file with the same name meanwhile,
+	   it will be deleted, but Open() will then notice that it is
+	   missing */
+	Delete(garbage);
+}
+
+std::unique_ptr<DecoderCacheFile>
+DecoderCache::Open(const DecoderCacheKey &key) noexcept
+{
+#ifdef _WIN32
+	(void)key;
+	return nullptr;
+#else
+	const auto name = key.GetFileName();
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		if (index.find(name) == index.end())
+			return nullptr;
+	}
+
+	const auto path = AllocatedPath::Build(directory,
+					       AllocatedPath::FromUTF8(name.c_str()));
+	int fd = open(path.c_str(), O_RDONLY|O_CLOEXEC);
+	if (fd < 0) {
+		if (errno == ENOENT) {
+			/* the file has been deleted; forget the stale
+			   entry */
+			const std::lock_guard<Mutex> protect(mutex);
+			auto i = index.find(name);
+			if (i != index.end())
+				Remove(i->second);
+		}
+
+		return nullptr;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+		close(fd);
+		return nullptr;
+	}
+
+	const size_t size = st.st_size;
+	void *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (address == MAP_FAILED) {
+		close(fd);
+		return nullptr;
+	}
+
+	/* update the modification time so the LRU order survives a
+	   restart */
+	futimens(fd, nullptr);
+	close(fd);
+
+	madvise(address, size, MADV_SEQUENTIAL);
+
+	auto file = std::make_unique<DecoderCacheFile>(address, size);
+	if (!file->Parse(key)) {
+		FormatWarning(decoder_cache_domain,
+			      "Discarding invalid cache file %s",
+			      name.c_str());
+
+		{
+			const std::lock_guard<Mutex> protect(mutex);
+			auto i = index.find(name);
+			if (i == index.end())
+				return nullptr;
+
+			Remove(i->second);
+		}
+
+		Delete(name);
+		return nullptr;
+	}
+
+	const std::lock_guard<Mutex> protect(mutex);
+	Touch(name);
+	return file;
+#endif
+}
+
+std::unique_ptr<DecoderCacheWriter>
+DecoderCache::Create(DecoderCacheKey &&key) noexcept
+try {
+	const auto path = AllocatedPath::Build(directory,
+					       AllocatedPath::FromUTF8(key.GetFileName().c_str()));
+
+	/* a single song may not use more than half of the cache */
+	return std::make_unique<DecoderCacheWriter>(*this, std::move(key),
+						    path, max_size / 2);
+} catch (...) {
+	LogError(std::current_exception());
+	return nullptr;
+}
+
+void
+decoder_cache_global_init(const ConfigData &config)
+{
+	auto directory = config.GetPath(ConfigOption::DECODER_CACHE_DIRECTORY);
+	if (directory.IsNull())
+		return;
+
+#ifdef _WIN32
+	throw std::runtime_error("decoder_cache_directory is not supported on this platform");
+#else
+	const uint64_t max_size =
+		uint64_t(config.GetPositive(ConfigOption::DECODER_CACHE_SIZE,
+					    1024 * 1024)) * 1024;
+
+	decoder_cache = new DecoderCache(std::move(directory), max_size);
+#endif
+}
+
+void
+decoder_cache_global_finish() noexcept
+{
+	delete decoder_cache;
+	decoder_cache = nullptr;
+}
+
+DecoderCache *
+decoder_cache_get() noexcept
+{
+	return decoder_cache;
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DECODER_CACHE_HXX
+#define MPD_DECODER_CACHE_HXX
+
+#include "AudioFormat.hxx"
+#include "Chrono.hxx"
+#include "ReplayGainInfo.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+struct ConfigData;
+class DecoderCache;
+
+/**
+ * Identifies one decoded song in the #DecoderCache.  An entry is only
+ * valid as long as the file's modification time and the configured
+ * output format are unchanged.
+ */
+struct DecoderCacheKey {
+	std::string uri;
+
+	std::chrono::system_clock::time_point mtime;
+
+	/**
+	 * The sub-song range (e.g. a CUE track); zero means "whole
+	 * file".
+	 */
+	SongTime start_time, end_time;
+
+	/**
+	 * The "audio_output_format" setting at the time the song was
+	 * decoded; the cached data has already been converted to it.
+	 */
+	AudioFormat configured_audio_format;
+
+	gcc_pure
+	std::string GetFileName() const noexcept;
+};
+
+/**
+ * A cache entry opened for reading.  The whole file is mapped into
+ * memory; the data stays valid even if the entry gets evicted while
+ * it is being played.
+ */
+class DecoderCacheFile {
+	void *const address;
+	const size_t size;
+
+public:
+	AudioFormat audio_format;
+
+	SignedSongTime duration;
+
+	/**
+	 * The PCM data (in #audio_format), starting at the key's
+	 * start time.
+	 */
+	ConstBuffer<uint8_t> pcm;
+
+	ReplayGainInfo replay_gain_info;
+	bool has_replay_gain;
+
+	uint16_t kbit_rate;
+
+	DecoderCacheFile(void *_address, size_t _size) noexcept
+		:address(_address), size(_size) {}
+
+	~DecoderCacheFile() noexcept;
+
+	DecoderCacheFile(const DecoderCacheFile &) = delete;
+	DecoderCacheFile &operator=(const DecoderCacheFile &) = delete;
+
+	/**
+	 * Parse and verify the header and the trailer.
+	 *
+	 * @return false if the file is corrupt or does not belong to
+	 * the given key
+	 */
+	bool Parse(const DecoderCacheKey &key) noexcept;
+};
+
+/**
+ * Records the output of a decoder into a new cache entry.  The entry
+ * becomes visible only after Commit(); destructing the object without
+ * committing discards it.
+ */
+class DecoderCacheWriter {
+	DecoderCache &cache;
+
+	const DecoderCacheKey key;
+
+	FileOutputStream os;
+
+	/**
+	 * The maximum number of PCM bytes; if the song is larger,
+	 * recording is aborted, because it would evict too much of
+	 * the cache.
+	 */
+	const uint64_t max_pcm_size;
+
+	uint64_t pcm_size = 0;
+
+	/**
+	 * The number of bytes reserved with DecoderCache::Reserve().
+	 * This is always at least the size of the file written so
+	 * far.
+	 */
+	uint64_t reserved = 0;
+
+	AudioFormat audio_format;
+
+	ReplayGainInfo replay_gain_info;
+	bool has_replay_gain = false;
+
+	uint16_t kbit_rate = 0;
+
+	/**
+	 * Has the header been written?
+	 */
+	bool open = false;
+
+public:
+	DecoderCacheWriter(DecoderCache &_cache, DecoderCacheKey &&_key,
+			   Path path, uint64_t _max_pcm_size);
+
+	~DecoderCacheWriter() noexcept;
+
+	/**
+	 * Write the header.  Must be called before the first
+	 * Append().
+	 *
+	 * @return false on error; the writer must be discarded then
+	 */
+	bool Open(AudioFormat _audio_format,
+		  SignedSongTime duration) noexcept;
+
+	bool IsOpen() const noexcept {
+		return open;
+	}
+
+	/**
+	 * Append PCM data.
+	 *
+	 * @return false on error or if the song is too large; the
+	 * writer must be discarded then
+	 */
+	bool Append(ConstBuffer<void> data) noexcept;
+
+	void SetReplayGain(const ReplayGainInfo *info) noexcept {
+		has_replay_gain = info != nullptr;
+		if (has_replay_gain)
+			replay_gain_info = *info;
+	}
+
+	void SetBitRate(uint16_t _kbit_rate) noexcept {
+		if (_kbit_rate > 0)
+			kbit_rate = _kbit_rate;
+	}
+
+	/**
+	 * Does the recorded PCM data cover the given duration?  A
+	 * small difference is tolerated, because the duration
+	 * reported by some decoder plugins is only an estimate.
+	 */
+	gcc_pure
+	bool IsComplete(SongTime expected_duration) const noexcept;
+
+	/**
+	 * Write the trailer and add the file to the cache.
+	 */
+	void Commit() noexcept;
+
+private:
+	/**
+	 * Reserve space in the #DecoderCache for a file of the
+	 * given size.
+	 *
+	 * @return false if the cache is full
+	 */
+	bool Reserve(uint64_t file_size) noexcept;
+};
+
+/**
+ * A disk-backed cache of decoded PCM data, so songs which are
+ * played repeatedly do not need to be decoded again.  The least
+ * recently used entries are deleted when the total size exceeds the
+ * configured limit.  To keep it in memory, point the directory to a
+ * "tmpfs".
+ *
+ * This object is thread-safe; it is used by all decoder threads.
+ */
+class DecoderCache {
+	friend class DecoderCacheWriter;
+
+	const AllocatedPath directory;
+
+	const uint64_t max_size;
+
+	Mutex mutex;
+
+	struct Entry {
+		std::string name;
+		uint64_t size;
+	};
+
+	/**
+	 * All entries; the most recently used one is at the front.
+	 */
+	std::list<Entry> lru;
+
+	std::map<std::string, std::list<Entry>::iterator> index;
+
+	/**
+	 * The sum of all #Entry::size values.
+	 */
+	uint64_t total_size = 0;
+
+	/**
+	 * The space reserved by all #DecoderCacheWriter instances
+	 * which have not been committed yet.  This counts against
+	 * #max_size, just like #total_size.
+	 */
+	uint64_t recording_size = 0;
+
+public:
+	DecoderCache(AllocatedPath &&_directory, uint64_t _max_size);
+
+	DecoderCache(const DecoderCache &) = delete;
+	DecoderCache &operator=(const DecoderCache &) = delete;
+
+	/**
+	 * Look up an entry and map it into memory.
+	 *
+	 * @return the entry or nullptr if there is none (or if it
+	 * could not be loaded)
+	 */
+	std::unique_ptr<DecoderCacheFile> Open(const DecoderCacheKey &key) noexcept;
+
+	/**
+	 * Begin recording a new entry.
+	 *
+	 * @return the writer or nullptr on error
+	 */
+	std::unique_ptr<DecoderCacheWriter> Create(DecoderCacheKey &&key) noexcept;
+
+private:
+	void Load();
+
+	void Touch(const std::string &name) noexcept;
+
+	/**
+	 * Reserve space for a recording, evicting old entries if
+	 * necessary.
+	 *
+	 * @return false if the space could not be reserved because
+	 * other recordings occupy it
+	 */
+	bool Reserve(uint64_t size) noexcept;
+
+	/**
+	 * Return space reserved with Reserve() which has not been
+	 * committed.
+	 */
+	void Release(uint64_t size) noexcept;
+
+	/**
+	 * Register a committed file, replacing its reservation, and
+	 * evict old entries until the size limit is satisfied.
+	 */
+	void Add(const std::string &name, uint64_t size,
+		 uint64_t reserved) noexcept;
+
+	/**
+	 * Evict the least recently used entries until the size limit
+	 * is satisfied, but keep at least the given number of
+	 * entries.  Caller must lock the mutex.
+	 *
+	 * @param garbage the names of the evicted files are appended
+	 * here; they must be passed to Delete() after the mutex has
+	 * been unlocked
+	 */
+	void Evict(std::vector<std::string> &garbage,
+		   size_t keep=0) noexcept;
+
+	/**
+	 * Remove an entry from the index.  Caller must lock the
+	 * mutex.
+	 *
+	 * @return the name of the file, which must be passed to
+	 * Delete() after the mutex has been unlocked
+	 */
+	std::string Remove(std::list<Entry>::iterator i) noexcept;
+
+	/**
+	 * Delete the given files.  This does disk I/O, therefore the
+	 * caller must not lock the mutex.
+	 */
+	void Delete(const std::vector<std::string> &garbage) noexcept;
+
+	void Delete(const std::string &name) noexcept;
+};
+
+/**
+ * Create the global #DecoderCache if "decoder_cache_directory" is
+ * configured.
+ *
+ * Throws on error.
+ */
+void
+decoder_cache_global_init(const ConfigData &config);
+
+void
+decoder_cache_global_finish() noexcept;
+
+/**
+ * @return the global #DecoderCache or nullptr if the cache is
+ * disabled
+ */
+gcc_pure
+DecoderCache *
+decoder_cache_get() noexcept;
+
+#endif
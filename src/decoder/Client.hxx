@@ -24,6 +24,7 @@
 #include "Command.hxx"
 #include "Chrono.hxx"
 #include "input/Ptr.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Compiler.h"
 
 #include <stdint.h>
@@ -138,6 +139,41 @@ public:
 		return SubmitData(&is, data, length, kbit_rate);
 	}
 
+	/**
+	 * Obtain a buffer where the decoder plugin can write decoded
+	 * data (in the audio format passed to Ready()) directly,
+	 * instead of passing its own buffer to SubmitData(), which
+	 * saves copying the data.  After writing, call CommitData().
+	 * The buffer becomes invalid when any other method except
+	 * Read() is called.
+	 *
+	 * The returned buffer is empty if this is not possible at
+	 * the moment, e.g. because the data needs to be converted or
+	 * because a command is pending; the decoder plugin must then
+	 * fall back to SubmitData().
+	 *
+	 * @param is an input stream which is buffering while we are waiting
+	 * for the player
+	 * @return a buffer whose size is a multiple of the frame size
+	 */
+	virtual WritableBuffer<void> GetWriteBuffer(InputStream *is) = 0;
+
+	WritableBuffer<void> GetWriteBuffer(InputStream &is) {
+		return GetWriteBuffer(&is);
+	}
+
+	/**
+	 * Submit data which was written to the buffer returned by
+	 * GetWriteBuffer().
+	 *
+	 * @param length the number of bytes which were written; must
+	 * be a multiple of the frame size
+	 * @return the current command, or DecoderCommand::NONE if there is no
+	 * command pending
+	 */
+	virtual DecoderCommand CommitData(size_t length,
+					  uint16_t kbit_rate) = 0;
+
 	/**
 	 * This function is called by the decoder plugin when it has
 	 * successfully decoded a tag.
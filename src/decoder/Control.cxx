@@ -20,6 +20,7 @@
 #include "config.h"
 #include "Control.hxx"
 #include "MusicPipe.hxx"
+#include "MusicBuffer.hxx"
 #include "song/DetachedSong.hxx"
 
 #include <stdexcept>
@@ -71,6 +72,25 @@ DecoderControl::SetReady(const AudioFormat audio_format,
 	client_cond.signal();
 }
 
+bool
+DecoderControl::IsLookaheadFull() const noexcept
+{
+	if (lookahead <= FloatDuration::zero() ||
+	    state != DecoderState::DECODE)
+		return false;
+
+	const unsigned n = pipe->GetSize();
+
+	/* never occupy more than half of the buffer, or the current
+	   song's decoder may starve */
+	if (n >= buffer->GetSize() / 2)
+		return true;
+
+	const auto chunk_duration =
+		out_audio_format.SizeToTime<FloatDuration>(buffer->GetChunkCapacity());
+	return n * chunk_duration >= lookahead;
+}
+
 bool
 DecoderControl::IsCurrentSong(const DetachedSong &_song) const noexcept
 {
@@ -161,6 +161,17 @@ struct DecoderControl final : InputStreamHandler {
 	 */
 	std::shared_ptr<MusicPipe> pipe;
 
+	/**
+	 * If positive, then this decoder decodes a queued song ahead
+	 * of time, while another decoder is still busy with the
+	 * current song.  It stops filling its #pipe after this
+	 * duration (or half of the #MusicBuffer), until the player
+	 * thread clears this attribute.
+	 *
+	 * Protected by #mutex.
+	 */
+	FloatDuration lookahead = FloatDuration::zero();
+
 	const ReplayGainConfig replay_gain_config;
 	ReplayGainMode replay_gain_mode = ReplayGainMode::OFF;
 
@@ -248,6 +259,15 @@ struct DecoderControl final : InputStreamHandler {
 		return IsStarting();
 	}
 
+	/**
+	 * Has the #pipe of a decode-ahead decoder reached the
+	 * #lookahead limit?
+	 *
+	 * Caller must hold the lock.
+	 */
+	gcc_pure
+	bool IsLookaheadFull() const noexcept;
+
 	bool HasFailed() const noexcept {
 		assert(command == DecoderCommand::NONE);
 
@@ -430,6 +450,17 @@ public:
 	 */
 	void CycleMixRamp() noexcept;
 
+	/**
+	 * Copy mixramp_end and the ReplayGain value of the given
+	 * decoder's song to the "previous" attributes.  This is used
+	 * after decoding ahead, because the previous song was
+	 * decoded by the other decoder.
+	 */
+	void InheritPrevious(const DecoderControl &other) noexcept {
+		previous_mix_ramp = other.mix_ramp;
+		replay_gain_prev_db = other.replay_gain_db;
+	}
+
 private:
 	void RunThread() noexcept;
 
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PluginCache.hxx"
+#include "thread/Mutex.hxx"
+
+#include <map>
+#include <string>
+
+#include <string.h>
+
+/**
+ * Limit the number of records per map, to keep clients from growing
+ * it without bounds by playing random URIs.
+ */
+static constexpr size_t MAX_ITEMS = 256;
+
+typedef std::map<std::string, const DecoderPlugin *> PluginMap;
+
+static Mutex decoder_plugin_cache_mutex;
+static PluginMap decoder_plugin_cache_uris, decoder_plugin_cache_hosts;
+
+/**
+ * Extract "scheme://host[:port]" from the URI, omitting credentials.
+ *
+ * @return the key or an empty string if the URI has no host
+ */
+static std::string
+GetHostKey(const char *uri)
+{
+	const char *host = strstr(uri, "://");
+	if (host == nullptr)
+		return std::string();
+
+	const std::string scheme(uri, host + 3);
+	host += 3;
+
+	const char *end = strchr(host, '/');
+	if (end == nullptr)
+		end = host + strlen(host);
+
+	const char *at = (const char *)memchr(host, '@', end - host);
+	if (at != nullptr)
+		host = at + 1;
+
+	if (host == end)
+		return std::string();
+
+	return scheme + std::string(host, end);
+}
+
+gcc_pure
+static const DecoderPlugin *
+Lookup(const PluginMap &map, const std::string &key) noexcept
+{
+	auto i = map.find(key);
+	return i != map.end() ? i->second : nullptr;
+}
+
+static void
+Remember(PluginMap &map, std::string &&key, const DecoderPlugin &plugin)
+{
+	if (key.empty())
+		return;
+
+	if (map.size() >= MAX_ITEMS && map.find(key) == map.end())
+		/* no LRU bookkeeping; stale records are cheap, the
+		   worst case is one wasted probe */
+		map.erase(map.begin());
+
+	map[std::move(key)] = &plugin;
+}
+
+static void
+Forget(PluginMap &map, const std::string &key,
+       const DecoderPlugin &plugin) noexcept
+{
+	auto i = map.find(key);
+	if (i != map.end() && i->second == &plugin)
+		map.erase(i);
+}
+
+const DecoderPlugin *
+decoder_plugin_cache_lookup_uri(const char *uri) noexcept
+try {
+	const std::lock_guard<Mutex> protect(decoder_plugin_cache_mutex);
+	return Lookup(decoder_plugin_cache_uris, uri);
+} catch (const std::bad_alloc &) {
+	return nullptr;
+}
+
+const DecoderPlugin *
+decoder_plugin_cache_lookup_host(const char *uri) noexcept
+try {
+	const std::lock_guard<Mutex> protect(decoder_plugin_cache_mutex);
+	return Lookup(decoder_plugin_cache_hosts, GetHostKey(uri));
+} catch (const std::bad_alloc &) {
+	return nullptr;
+}
+
+void
+decoder_plugin_cache_remember(const char *uri,
+			      const DecoderPlugin &plugin) noexcept
+try {
+	const std::lock_guard<Mutex> protect(decoder_plugin_cache_mutex);
+
+	Remember(decoder_plugin_cache_uris, uri, plugin);
+	Remember(decoder_plugin_cache_hosts, GetHostKey(uri), plugin);
+} catch (const std::bad_alloc &) {
+}
+
+void
+decoder_plugin_cache_forget(const char *uri,
+			    const DecoderPlugin &plugin) noexcept
+try {
+	const std::lock_guard<Mutex> protect(decoder_plugin_cache_mutex);
+
+	Forget(decoder_plugin_cache_uris, uri, plugin);
+	Forget(decoder_plugin_cache_hosts, GetHostKey(uri), plugin);
+} catch (const std::bad_alloc &) {
+}
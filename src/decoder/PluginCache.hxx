@@ -0,0 +1,72 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_PLUGIN_CACHE_HXX
+#define MPD_DECODER_PLUGIN_CACHE_HXX
+
+#include "util/Compiler.h"
+
+struct DecoderPlugin;
+
+/*
+ * This library remembers which decoder plugin was able to decode a
+ * remote stream, so the next attempt can skip probing the plugins
+ * which do not match.  There are two kinds of records: the plugin
+ * which decoded a URI, and the plugin which last succeeded on a
+ * stream from the same host, because a server which sends a wrong
+ * MIME type usually does so for all of its streams.  The latter is
+ * only a weak hint.
+ *
+ * All functions are thread-safe.
+ */
+
+/**
+ * @return the decoder plugin which has decoded this URI, or nullptr
+ * if nothing is known about this URI
+ */
+gcc_pure
+const DecoderPlugin *
+decoder_plugin_cache_lookup_uri(const char *uri) noexcept;
+
+/**
+ * @return the decoder plugin which has last decoded a stream from
+ * the host of this URI, or nullptr if nothing is known about the
+ * host
+ */
+gcc_pure
+const DecoderPlugin *
+decoder_plugin_cache_lookup_host(const char *uri) noexcept;
+
+/**
+ * Remember that the given plugin has successfully decoded the
+ * stream.
+ */
+void
+decoder_plugin_cache_remember(const char *uri,
+			      const DecoderPlugin &plugin) noexcept;
+
+/**
+ * The given plugin has failed to decode the stream; forget all
+ * records which would suggest it for this URI.
+ */
+void
+decoder_plugin_cache_forget(const char *uri,
+			    const DecoderPlugin &plugin) noexcept;
+
+#endif
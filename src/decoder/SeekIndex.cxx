@@ -0,0 +1,319 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "SeekIndex.hxx"
+#include "input/InputStream.hxx"
+#include "config/Data.hxx"
+#include "config/Option.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/Traits.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Fnv1aHash.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+static constexpr Domain seek_index_domain("seek_index");
+
+static constexpr char seek_index_magic[8] = {'M', 'P', 'D', 'S', 'I', 'D', 'X', '2'};
+
+/**
+ * The on-disk format is private to this host, therefore all integers
+ * are stored in host byte order.  The header is followed by the URI
+ * and the table of offsets.
+ */
+struct SeekIndexHeader {
+	char magic[sizeof(seek_index_magic)];
+
+	uint64_t size;
+	int64_t mtime;
+
+	uint32_t sample_rate, samples_per_frame;
+	uint64_t n_frames;
+
+	uint32_t uri_length;
+	uint32_t n_offsets;
+};
+
+static AllocatedPath *seek_index_directory;
+
+/**
+ * The maximum total size of all files in #seek_index_directory.
+ */
+static uint64_t seek_index_max_size;
+
+/**
+ * Serializes PruneSeekIndexDirectory() calls from concurrent
+ * decoder threads.
+ */
+static Mutex seek_index_prune_mutex;
+
+SeekIndex::Position
+SeekIndex::Lookup(uint64_t frame) const noexcept
+{
+	assert(!offsets.empty());
+
+	const size_t i = std::min<uint64_t>(frame / STRIDE,
+					    offsets.size() - 1);
+	return {i * uint64_t(STRIDE), offsets[i]};
+}
+
+bool
+SeekIndex::CanStore(const InputStream &is) noexcept
+{
+	/* only local files have a reliable modification time which
+	   tells us when the index is stale */
+	return seek_index_directory != nullptr &&
+		PathTraitsUTF8::IsAbsolute(is.GetURI()) &&
+		is.KnownSize();
+}
+
+/**
+ * Fill the key fields of the header and determine the cache file
+ * name.
+ *
+ * @return the file path or nullptr if the stream cannot be indexed
+ * persistently
+ */
+static AllocatedPath
+GetSeekIndexPath(const InputStream &is, SeekIndexHeader &h)
+{
+	if (!SeekIndex::CanStore(is))
+		return nullptr;
+
+	const char *uri = is.GetURI();
+
+	FileInfo fi;
+	if (!GetFileInfo(AllocatedPath::FromUTF8(uri), fi) ||
+	    fi.GetSize() != is.GetSize())
+		return nullptr;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, seek_index_magic, sizeof(h.magic));
+	h.size = is.GetSize();
+	h.mtime = std::chrono::system_clock::to_time_t(fi.GetModificationTime());
+	h.uri_length = strlen(uri);
+
+	Fnv1aHash hash;
+	hash.Update(uri, h.uri_length);
+	hash.Update(&h, sizeof(h));
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.idx",
+		 (unsigned long long)hash.Get());
+	return AllocatedPath::Build(*seek_index_directory,
+				    AllocatedPath::FromUTF8(name));
+}
+
+std::unique_ptr<SeekIndex>
+SeekIndex::Load(const InputStream &is) noexcept
+try {
+	SeekIndexHeader expected;
+	const auto path = GetSeekIndexPath(is, expected);
+	if (path.IsNull())
+		return nullptr;
+
+	FileReader reader(path);
+
+	SeekIndexHeader h;
+	if (reader.Read(&h, sizeof(h)) != sizeof(h) ||
+	    memcmp(h.magic, expected.magic, sizeof(h.magic)) != 0 ||
+	    h.size != expected.size || h.mtime != expected.mtime ||
+	    h.uri_length != expected.uri_length ||
+	    h.sample_rate == 0 || h.samples_per_frame == 0 ||
+	    h.n_offsets != (h.n_frames + STRIDE - 1) / STRIDE ||
+	    h.n_offsets == 0)
+		return nullptr;
+
+	std::string uri(h.uri_length, '\0');
+	if (reader.Read(&uri.front(), uri.length()) != uri.length() ||
+	    uri != is.GetURI())
+		/* hash collision */
+		return nullptr;
+
+	auto index = std::make_unique<SeekIndex>(h.sample_rate,
+						 h.samples_per_frame);
+	index->n_frames = h.n_frames;
+	index->offsets.resize(h.n_offsets);
+
+	const size_t nbytes = h.n_offsets * sizeof(offset_type);
+	if (reader.Read(&index->offsets.front(), nbytes) != nbytes)
+		return nullptr;
+
+#ifndef _WIN32
+	/* update the modification time, which is the LRU order of
+	   PruneSeekIndexDirectory() */
+	futimens(reader.GetFD().Get(), nullptr);
+#endif
+
+	return index;
+} catch (...) {
+	/* no index file (or an I/O error) */
+	return nullptr;
+}
+
+gcc_pure
+static bool
+IsSeekIndexFileName(const std::string &name) noexcept
+{
+	return name.length() == 20 &&
+		name.compare(16, 4, ".idx") == 0 &&
+		std::all_of(name.begin(), name.begin() + 16,
+			    [](char ch){
+				    return (ch >= '0' && ch <= '9') ||
+					    (ch >= 'a' && ch <= 'f');
+			    });
+}
+
+/**
+ * Delete the least recently used index files until the directory
+ * size is below #seek_index_max_size.  This also gets rid of stale
+ * index files, whose song has been modified or deleted, because
+ * they are never loaded again.
+ *
+ * @param keep a file which shall not be deleted (the one just
+ * written, which may have the same modification time as older
+ * ones), or nullptr
+ */
+static void
+PruneSeekIndexDirectory(const AllocatedPath *keep=nullptr)
+{
+	struct Item {
+		AllocatedPath path;
+		uint64_t size;
+		std::chrono::system_clock::time_point mtime;
+	};
+
+	const std::lock_guard<Mutex> protect(seek_index_prune_mutex);
+
+	std::vector<Item> items;
+	uint64_t total_size = 0;
+
+	DirectoryReader reader(*seek_index_directory);
+	while (reader.ReadEntry()) {
+		if (!IsSeekIndexFileName(reader.GetEntry().ToUTF8()))
+			continue;
+
+		auto path = AllocatedPath::Build(*seek_index_directory,
+						 reader.GetEntry());
+		FileInfo fi;
+		if (!GetFileInfo(path, fi) || !fi.IsRegular())
+			continue;
+
+		items.push_back({std::move(path), fi.GetSize(),
+				 fi.GetModificationTime()});
+		total_size += fi.GetSize();
+	}
+
+	if (total_size <= seek_index_max_size)
+		return;
+
+	/* the least recently used file (see SeekIndex::Load())
+	   first */
+	std::sort(items.begin(), items.end(),
+		  [](const Item &a, const Item &b){
+			  return a.mtime < b.mtime;
+		  });
+
+	unsigned n_deleted = 0;
+	for (const auto &i : items) {
+		if (total_size <= seek_index_max_size)
+			break;
+
+		if (keep != nullptr && i.path == *keep)
+			continue;
+
+		RemoveFile(i.path);
+		total_size -= i.size;
+		++n_deleted;
+	}
+
+	FormatDebug(seek_index_domain, "deleted %u index files", n_deleted);
+}
+
+void
+SeekIndex::Store(const InputStream &is) const noexcept
+try {
+	assert(!IsEmpty());
+
+	SeekIndexHeader h;
+	const auto path = GetSeekIndexPath(is, h);
+	if (path.IsNull())
+		return;
+
+	h.sample_rate = sample_rate;
+	h.samples_per_frame = samples_per_frame;
+	h.n_frames = n_frames;
+	h.n_offsets = offsets.size();
+
+	FileOutputStream os(path);
+	os.Write(&h, sizeof(h));
+	os.Write(is.GetURI(), h.uri_length);
+	os.Write(&offsets.front(), offsets.size() * sizeof(offsets.front()));
+	os.Commit();
+
+	PruneSeekIndexDirectory(&path);
+} catch (...) {
+	LogError(std::current_exception());
+}
+
+void
+seek_index_global_init(const ConfigData &config)
+{
+	auto directory = config.GetPath(ConfigOption::SEEK_INDEX_DIRECTORY);
+	if (directory.IsNull())
+		return;
+
+	seek_index_max_size =
+		uint64_t(config.GetPositive(ConfigOption::SEEK_INDEX_SIZE,
+					    64 * 1024)) * 1024;
+	seek_index_directory = new AllocatedPath(std::move(directory));
+
+	try {
+		PruneSeekIndexDirectory();
+	} catch (...) {
+		LogError(std::current_exception());
+	}
+}
+
+void
+seek_index_global_finish() noexcept
+{
+	delete seek_index_directory;
+	seek_index_directory = nullptr;
+}
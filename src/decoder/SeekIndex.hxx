@@ -0,0 +1,139 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DECODER_SEEK_INDEX_HXX
+#define MPD_DECODER_SEEK_INDEX_HXX
+
+#include "Chrono.hxx"
+#include "input/Offset.hxx"
+#include "util/Compiler.h"
+
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+struct ConfigData;
+class InputStream;
+
+/**
+ * A compact table of frame offsets for formats which consist of
+ * frames with a constant number of samples (MP3, AAC-ADTS) but have
+ * no usable index of their own.  Only every #STRIDE-th frame offset
+ * is stored; to seek to a frame in between, the decoder walks over
+ * the headers of the frames preceding it.
+ */
+class SeekIndex {
+public:
+	/**
+	 * With 4, a seek walks over at most 3 frame headers, and the
+	 * table is about 0.5% of the size of a 128 kbit/s MP3 file.
+	 */
+	static constexpr unsigned STRIDE = 4;
+
+	/**
+	 * An indexed frame.
+	 */
+	struct Position {
+		uint64_t frame;
+		offset_type offset;
+	};
+
+private:
+	unsigned sample_rate, samples_per_frame;
+
+	uint64_t n_frames = 0;
+
+	std::vector<offset_type> offsets;
+
+public:
+	SeekIndex(unsigned _sample_rate, unsigned _samples_per_frame) noexcept
+		:sample_rate(_sample_rate),
+		 samples_per_frame(_samples_per_frame) {}
+
+	unsigned GetSampleRate() const noexcept {
+		return sample_rate;
+	}
+
+	unsigned GetSamplesPerFrame() const noexcept {
+		return samples_per_frame;
+	}
+
+	uint64_t GetFrameCount() const noexcept {
+		return n_frames;
+	}
+
+	bool IsEmpty() const noexcept {
+		return n_frames == 0;
+	}
+
+	SongTime GetDuration() const noexcept {
+		return SongTime::FromScale<uint64_t>(n_frames * samples_per_frame,
+						     sample_rate);
+	}
+
+	/**
+	 * Register the next frame.  Must be called for every frame
+	 * of the stream, in order.
+	 */
+	void Append(offset_type offset) noexcept {
+		if (n_frames % STRIDE == 0)
+			offsets.push_back(offset);
+		++n_frames;
+	}
+
+	/**
+	 * Find the last indexed frame at or before the given frame
+	 * number.
+	 */
+	gcc_pure
+	Position Lookup(uint64_t frame) const noexcept;
+
+	/**
+	 * Can an index of this stream be stored in the on-disk
+	 * cache?
+	 */
+	gcc_pure
+	static bool CanStore(const InputStream &is) noexcept;
+
+	/**
+	 * Load the index of the given stream from the on-disk cache.
+	 *
+	 * @return the index or nullptr if there is none
+	 */
+	static std::unique_ptr<SeekIndex> Load(const InputStream &is) noexcept;
+
+	/**
+	 * Save this index to the on-disk cache.  This is a no-op if
+	 * the cache is disabled or if the stream is not a local file.
+	 */
+	void Store(const InputStream &is) const noexcept;
+};
+
+/**
+ * Enable the on-disk cache if "seek_index_directory" is configured.
+ */
+void
+seek_index_global_init(const ConfigData &config);
+
+void
+seek_index_global_finish() noexcept;
+
+#endif
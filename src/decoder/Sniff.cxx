@@ -0,0 +1,265 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Sniff.hxx"
+
+#include <stdint.h>
+#include <string.h>
+
+gcc_pure
+static bool
+HasMagic(const uint8_t *data, size_t size, size_t offset,
+	 const char *magic) noexcept
+{
+	const size_t length = strlen(magic);
+	return size >= offset + length &&
+		memcmp(data + offset, magic, length) == 0;
+}
+
+/**
+ * Determine the size of an ID3v2 tag at the beginning of the buffer.
+ *
+ * @return the size of the tag including its header (and footer), or
+ * 0 if there is no ID3v2 tag
+ */
+gcc_pure
+static size_t
+GetId3v2Size(const uint8_t *data, size_t size) noexcept
+{
+	if (size < 10 || !HasMagic(data, size, 0, "ID3") ||
+	    ((data[6] | data[7] | data[8] | data[9]) & 0x80) != 0)
+		return 0;
+
+	/* the size is a "synchsafe" integer: 4*7 bits */
+	size_t tag_size = 10 + ((size_t(data[6]) << 21) |
+				(size_t(data[7]) << 14) |
+				(size_t(data[8]) << 7) |
+				size_t(data[9]));
+
+	if (data[5] & 0x10)
+		/* footer present */
+		tag_size += 10;
+
+	return tag_size;
+}
+
+/**
+ * Parse an MPEG audio (layer I-III) frame header.
+ *
+ * @return the length of the frame in bytes, or 0 if this is not a
+ * valid frame header
+ */
+gcc_pure
+static size_t
+GetMpegFrameLength(const uint8_t *p) noexcept
+{
+	static constexpr uint16_t bitrates[5][16] = {
+		/* MPEG 1, layer I */
+		{ 0, 32, 64, 96, 128, 160, 192, 224,
+		  256, 288, 320, 352, 384, 416, 448, 0 },
+		/* MPEG 1, layer II */
+		{ 0, 32, 48, 56, 64, 80, 96, 112,
+		  128, 160, 192, 224, 256, 320, 384, 0 },
+		/* MPEG 1, layer III */
+		{ 0, 32, 40, 48, 56, 64, 80, 96,
+		  112, 128, 160, 192, 224, 256, 320, 0 },
+		/* MPEG 2/2.5, layer I */
+		{ 0, 32, 48, 56, 64, 80, 96, 112,
+		  128, 144, 160, 176, 192, 224, 256, 0 },
+		/* MPEG 2/2.5, layer II and III */
+		{ 0, 8, 16, 24, 32, 40, 48, 56,
+		  64, 80, 96, 112, 128, 144, 160, 0 },
+	};
+
+	static constexpr unsigned sample_rates[3] = { 44100, 48000, 32000 };
+
+	if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0)
+		return 0;
+
+	/* 0 = MPEG 2.5, 1 = reserved, 2 = MPEG 2, 3 = MPEG 1 */
+	const unsigned version = (p[1] >> 3) & 0x3;
+	/* 1 = layer III, 2 = layer II, 3 = layer I */
+	const unsigned layer = 4 - ((p[1] >> 1) & 0x3);
+	const unsigned bitrate_index = p[2] >> 4;
+	const unsigned sample_rate_index = (p[2] >> 2) & 0x3;
+	const unsigned padding = (p[2] >> 1) & 0x1;
+
+	if (version == 1 || layer == 4 ||
+	    sample_rate_index == 3)
+		return 0;
+
+	const bool mpeg1 = version == 3;
+	const unsigned bitrate_table = mpeg1
+		? layer - 1
+		: (layer == 1 ? 3 : 4);
+	const unsigned bitrate = bitrates[bitrate_table][bitrate_index] * 1000;
+	if (bitrate == 0)
+		/* "free" bitrate is not supported here */
+		return 0;
+
+	unsigned sample_rate = sample_rates[sample_rate_index];
+	if (version == 2)
+		sample_rate /= 2;
+	else if (version == 0)
+		sample_rate /= 4;
+
+	if (layer == 1)
+		return (12 * bitrate / sample_rate + padding) * 4;
+	else if (layer == 3 && !mpeg1)
+		return 72 * bitrate / sample_rate + padding;
+	else
+		return 144 * bitrate / sample_rate + padding;
+}
+
+/**
+ * Parse an AAC ADTS frame header.
+ *
+ * @return the length of the frame in bytes, or 0 if this is not a
+ * valid frame header
+ */
+gcc_pure
+static size_t
+GetAdtsFrameLength(const uint8_t *p) noexcept
+{
+	if (p[0] != 0xff || (p[1] & 0xf6) != 0xf0 ||
+	    ((p[2] >> 2) & 0xf) >= 13)
+		return 0;
+
+	const size_t length = (size_t(p[3] & 0x3) << 11) |
+		(size_t(p[4]) << 3) |
+		(p[5] >> 5);
+	return length >= 7 ? length : 0;
+}
+
+/**
+ * Look for two consecutive frames.  A single sync word is too weak
+ * as a signature, because it occurs randomly in all kinds of data.
+ * Streams do not necessarily start at a frame boundary, so the whole
+ * buffer is scanned.
+ */
+template<typename F>
+gcc_pure
+static bool
+FindFramePair(const uint8_t *data, size_t size, F get_frame_length) noexcept
+{
+	static constexpr size_t HEADER_SIZE = 6;
+
+	for (size_t i = 0; i + HEADER_SIZE <= size; ++i) {
+		if (data[i] != 0xff)
+			continue;
+
+		const size_t length = get_frame_length(data + i);
+		if (length == 0)
+			continue;
+
+		const size_t next = i + length;
+		if (next + HEADER_SIZE > size)
+			/* may be a false sync with a large frame size;
+			   a real frame may still follow */
+			continue;
+
+		if (get_frame_length(data + next) > 0 &&
+		    /* same version and layer */
+		    data[next + 1] == data[i + 1])
+			return true;
+	}
+
+	return false;
+}
+
+gcc_pure
+static const char *
+SniffOgg(const uint8_t *data, size_t size) noexcept
+{
+	/* the first page contains only the codec's identification
+	   header; it begins after the segment table */
+	if (size < 27)
+		return "ogg";
+
+	const size_t packet = 27 + data[26];
+	if (HasMagic(data, size, packet, "OpusHead"))
+		return "opus";
+	else if (HasMagic(data, size, packet, "\x7f" "FLAC"))
+		return "oga";
+	else
+		return "ogg";
+}
+
+const char *
+decoder_sniff_suffix(const void *_data, size_t size) noexcept
+{
+	const uint8_t *data = (const uint8_t *)_data;
+
+	const size_t id3_size = GetId3v2Size(data, size);
+	if (id3_size > 0) {
+		if (id3_size >= size)
+			/* the tag is larger than the buffer; ID3v2 is
+			   used almost exclusively by MP3 */
+			return "mp3";
+
+		return decoder_sniff_suffix(data + id3_size, size - id3_size);
+	}
+
+	if (HasMagic(data, size, 0, "fLaC"))
+		return "flac";
+	else if (HasMagic(data, size, 0, "OggS"))
+		return SniffOgg(data, size);
+	else if (HasMagic(data, size, 0, "RIFF") &&
+		 HasMagic(data, size, 8, "WAVE"))
+		return "wav";
+	else if (HasMagic(data, size, 0, "FORM") &&
+		 (HasMagic(data, size, 8, "AIFF") ||
+		  HasMagic(data, size, 8, "AIFC")))
+		return "aiff";
+	else if (HasMagic(data, size, 0, ".snd"))
+		return "au";
+	else if (HasMagic(data, size, 0, "DSD "))
+		return "dsf";
+	else if (HasMagic(data, size, 0, "FRM8"))
+		return "dff";
+	else if (HasMagic(data, size, 0, "wvpk"))
+		return "wv";
+	else if (HasMagic(data, size, 0, "MPCK") ||
+		 HasMagic(data, size, 0, "MP+"))
+		return "mpc";
+	else if (HasMagic(data, size, 0, "MAC "))
+		return "ape";
+	else if (HasMagic(data, size, 0, "ADIF"))
+		return "aac";
+	else if (HasMagic(data, size, 4, "ftyp"))
+		return "m4a";
+	else if (HasMagic(data, size, 0, "\x1a\x45\xdf\xa3"))
+		return "mka";
+	else if (HasMagic(data, size, 0,
+			  "\x30\x26\xb2\x75\x8e\x66\xcf\x11"))
+		return "wma";
+	else if (HasMagic(data, size, 0, "MThd"))
+		return "mid";
+
+	/* no magic number; look for MPEG frame headers last, because
+	   their sync word is the least reliable signature */
+
+	if (FindFramePair(data, size, GetAdtsFrameLength))
+		return "aac";
+	else if (FindFramePair(data, size, GetMpegFrameLength))
+		return "mp3";
+
+	return nullptr;
+}
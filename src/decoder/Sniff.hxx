@@ -0,0 +1,47 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DECODER_SNIFF_HXX
+#define MPD_DECODER_SNIFF_HXX
+
+#include "util/Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * How many bytes at the beginning of a stream should be passed to
+ * decoder_sniff_suffix()?  This is small enough to be covered by the
+ * buffer of the "rewind" input stream, which makes rewinding a remote
+ * stream after sniffing cheap.
+ */
+static constexpr size_t DECODER_SNIFF_SIZE = 4096;
+
+/**
+ * Guess the format of a stream from its first bytes ("magic
+ * numbers").
+ *
+ * @return a file name suffix which can be passed to
+ * DecoderPlugin::SupportsSuffix(), or nullptr if the format was not
+ * recognized
+ */
+gcc_pure
+const char *
+decoder_sniff_suffix(const void *data, size_t size) noexcept;
+
+#endif
@@ -20,6 +20,9 @@
 #include "config.h"
 #include "Control.hxx"
 #include "Bridge.hxx"
+#include "Cache.hxx"
+#include "Sniff.hxx"
+#include "PluginCache.hxx"
 #include "DecoderPlugin.hxx"
 #include "song/DetachedSong.hxx"
 #include "MusicPipe.hxx"
@@ -35,14 +38,17 @@
 #include "util/RuntimeError.hxx"
 #include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
+#include "util/ChronoUtil.hxx"
 #include "thread/Name.hxx"
 #include "tag/ApeReplayGain.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
 #include <stdexcept>
-#include <functional>
 #include <memory>
 
+#include <string.h>
+
 static constexpr Domain decoder_thread_domain("decoder_thread");
 
 /**
@@ -122,6 +128,8 @@ decoder_stream_decode(const DecoderPlugin &plugin,
 		plugin.StreamDecode(bridge, input_stream);
 
 		SetThreadName("decoder");
+
+		bridge.input_eof = input_stream.LockIsEOF();
 	}
 
 	assert(bridge.dc.state == DecoderState::START ||
@@ -199,40 +207,111 @@ decoder_check_plugin(const DecoderPlugin &plugin, const InputStream &is,
 		 decoder_check_plugin_suffix(plugin, suffix));
 }
 
+/**
+ * Decode a stream with the given decoder plugin, and remember the
+ * plugin for this URI if it succeeds.
+ *
+ * Caller holds DecoderControl::mutex.
+ */
 static bool
 decoder_run_stream_plugin(DecoderBridge &bridge, InputStream &is,
-			  const char *suffix,
-			  const DecoderPlugin &plugin,
-			  bool &tried_r)
+			  const char *uri, const DecoderPlugin &plugin)
 {
-	if (!decoder_check_plugin(plugin, is, suffix))
-		return false;
-
 	bridge.error = std::exception_ptr();
 
-	tried_r = true;
-	return decoder_stream_decode(plugin, bridge, is);
+	if (!decoder_stream_decode(plugin, bridge, is))
+		return false;
+
+	decoder_plugin_cache_remember(uri, plugin);
+	return true;
 }
 
+/**
+ * Try the decoder plugins in the order of confidence: first the one
+ * which has decoded this very URI before, then all plugins matching
+ * the sniffed content, then all plugins matching the MIME type or
+ * the URI suffix.  If the content could not be identified, the plugin
+ * which has last decoded a stream from the same host is tried last
+ * (it may have failed on the MIME type check, e.g. if the server
+ * sends a wrong one).
+ *
+ * Caller holds DecoderControl::mutex.
+ *
+ * @param sniffed_suffix the return value of decoder_sniff_suffix()
+ * (may be nullptr)
+ * @param tried_r set to true if at least one plugin matched the
+ * content, the MIME type or the URI suffix
+ */
 static bool
 decoder_run_stream_locked(DecoderBridge &bridge, InputStream &is,
-			  const char *uri, bool &tried_r)
+			  const char *uri, const char *sniffed_suffix,
+			  bool &tried_r)
 {
+	const DecoderPlugin *const cached = decoder_plugin_cache_lookup_uri(uri);
+	if (cached != nullptr) {
+		if (decoder_run_stream_plugin(bridge, is, uri, *cached))
+			return true;
+
+		decoder_plugin_cache_forget(uri, *cached);
+	}
+
+	const auto sniffed = [sniffed_suffix](const DecoderPlugin &plugin){
+		return decoder_check_plugin_suffix(plugin, sniffed_suffix);
+	};
+
+	bool sniff_matched = false;
+	if (decoder_plugins_try([&](const DecoderPlugin &plugin){
+				if (plugin.stream_decode == nullptr ||
+				    !sniffed(plugin))
+					return false;
+
+				sniff_matched = tried_r = true;
+				return &plugin != cached &&
+					decoder_run_stream_plugin(bridge, is,
+								  uri, plugin);
+			}))
+		return true;
+
 	UriSuffixBuffer suffix_buffer;
 	const char *const suffix = uri_get_suffix(uri, suffix_buffer);
 
-	using namespace std::placeholders;
-	const auto f = std::bind(decoder_run_stream_plugin,
-				 std::ref(bridge), std::ref(is), suffix,
-				 _1, std::ref(tried_r));
-	return decoder_plugins_try(f);
+	if (decoder_plugins_try([&](const DecoderPlugin &plugin){
+				if (&plugin == cached ||
+				    !decoder_check_plugin(plugin, is, suffix) ||
+				    sniffed(plugin))
+					return false;
+
+				tried_r = true;
+				return decoder_run_stream_plugin(bridge, is,
+								 uri, plugin);
+			}))
+		return true;
+
+	if (sniff_matched)
+		/* the per-host record is only a guess; the content
+		   beats it */
+		return false;
+
+	const DecoderPlugin *const host_cached =
+		decoder_plugin_cache_lookup_host(uri);
+	if (host_cached == nullptr || host_cached == cached ||
+	    decoder_check_plugin(*host_cached, is, suffix))
+		/* nothing known, or it has been tried already */
+		return false;
+
+	if (decoder_run_stream_plugin(bridge, is, uri, *host_cached))
+		return true;
+
+	decoder_plugin_cache_forget(uri, *host_cached);
+	return false;
 }
 
 /**
  * Try decoding a stream, using the fallback plugin.
  */
 static bool
-decoder_run_stream_fallback(DecoderBridge &bridge, InputStream &is)
+decoder_run_stream_fallback(DecoderBridge &bridge, InputStream &is,
+			    const char *uri)
 {
 	const struct DecoderPlugin *plugin;
 
@@ -242,7 +321,47 @@ decoder_run_stream_fallback(DecoderBridge &bridge, InputStream &is)
 	plugin = decoder_plugin_from_name("mad");
 #endif
 	return plugin != nullptr && plugin->stream_decode != nullptr &&
-		decoder_stream_decode(*plugin, bridge, is);
+		decoder_run_stream_plugin(bridge, is, uri, *plugin);
+}
+
+/**
+ * Read the first bytes of the stream and guess its format with
+ * decoder_sniff_suffix().  Afterwards, the stream is rewound; remote
+ * streams keep the data in the buffer of the "rewind" input stream,
+ * so it is shared with the plugins instead of being downloaded again.
+ *
+ * DecoderControl::mutex is not locked by caller.
+ *
+ * @return the guessed suffix or nullptr
+ */
+static const char *
+decoder_sniff_stream(DecoderBridge &bridge, InputStream &is)
+{
+	try {
+		/* MaybeLoadReplayGain() may have moved the offset */
+		is.LockRewind();
+	} catch (...) {
+		return nullptr;
+	}
+
+	uint8_t buffer[DECODER_SNIFF_SIZE];
+	size_t size = 0;
+
+	while (size < sizeof(buffer)) {
+		size_t nbytes = decoder_read(bridge, is, buffer + size,
+					     sizeof(buffer) - size);
+		if (nbytes == 0)
+			break;
+
+		size += nbytes;
+	}
+
+	const char *suffix = decoder_sniff_suffix(buffer, size);
+	if (suffix != nullptr)
+		FormatDebug(decoder_thread_domain,
+			    "stream content looks like '%s'", suffix);
+
+	return suffix;
 }
 
 /**
@@ -266,8 +385,11 @@ MaybeLoadReplayGain(DecoderBridge &bridge, InputStream &is)
 {
 	{
 		const std::lock_guard<Mutex> protect(bridge.dc.mutex);
-		if (bridge.dc.replay_gain_mode == ReplayGainMode::OFF)
-			/* ReplayGain is disabled */
+		if (bridge.dc.replay_gain_mode == ReplayGainMode::OFF &&
+		    bridge.cache_writer == nullptr)
+			/* ReplayGain is disabled (but the cache entry
+			   must be complete, because the mode may be
+			   switched on later) */
 			return;
 	}
 
@@ -289,16 +411,19 @@ decoder_run_stream(DecoderBridge &bridge, const char *uri)
 
 	MaybeLoadReplayGain(bridge, *input_stream);
 
+	const char *const sniffed_suffix =
+		decoder_sniff_stream(bridge, *input_stream);
+
 	const std::lock_guard<Mutex> protect(dc.mutex);
 
 	bool tried = false;
 	return dc.command == DecoderCommand::STOP ||
 		decoder_run_stream_locked(bridge, *input_stream, uri,
-					  tried) ||
+					  sniffed_suffix, tried) ||
 		/* fallback to mp3: this is needed for bastard streams
 		   that don't have a suffix or set the mimeType */
 		(!tried &&
-		 decoder_run_stream_fallback(bridge, *input_stream));
+		 decoder_run_stream_fallback(bridge, *input_stream, uri));
 }
 
 /**
@@ -431,6 +556,161 @@ try {
 						  error_uri));
 }
 
+/**
+ * Play a song from the #DecoderCache, as if it were a decoder
+ * plugin.
+ *
+ * @param song_start the start time of the (sub-)song, which
+ * corresponds to the beginning of the cached data
+ */
+static void
+decoder_cache_decode(DecoderClient &client, const DecoderCacheFile &file,
+		     SongTime song_start)
+{
+	const auto &audio_format = file.audio_format;
+	const size_t frame_size = audio_format.GetFrameSize();
+	const uint64_t start_frame =
+		song_start.ToScale<uint64_t>(audio_format.sample_rate);
+
+	client.Ready(audio_format, true, file.duration);
+
+	if (file.has_replay_gain)
+		client.SubmitReplayGain(&file.replay_gain_info);
+
+	size_t position = 0;
+
+	DecoderCommand cmd = client.GetCommand();
+	while (true) {
+		if (cmd == DecoderCommand::SEEK) {
+			const uint64_t frame = client.GetSeekFrame();
+			const uint64_t offset = frame > start_frame
+				? (frame - start_frame) * frame_size
+				: 0;
+			if (offset <= file.pcm.size) {
+				position = offset;
+				client.CommandFinished();
+			} else
+				client.SeekError();
+		} else if (cmd != DecoderCommand::NONE)
+			break;
+
+		if (position >= file.pcm.size)
+			break;
+
+		const uint8_t *src = file.pcm.data + position;
+		const size_t remaining = file.pcm.size - position;
+
+		auto w = client.GetWriteBuffer(nullptr);
+		if (!w.empty()) {
+			const size_t n = std::min(w.size / frame_size,
+						  remaining / frame_size) * frame_size;
+			memcpy(w.data, src, n);
+			position += n;
+			cmd = client.CommitData(n, file.kbit_rate);
+		} else {
+			/* a command is pending, or the bridge needs to
+			   convert the data */
+			const size_t max_size = 65536 - 65536 % frame_size;
+			const size_t n = std::min(remaining, max_size);
+			cmd = client.SubmitData(nullptr, src, n,
+						file.kbit_rate);
+			if (cmd == DecoderCommand::NONE)
+				position += n;
+		}
+	}
+}
+
+static DecoderCacheKey
+MakeDecoderCacheKey(const DecoderControl &dc, const DetachedSong &song)
+{
+	return {
+		song.GetRealURI(),
+		song.GetLastModified(),
+		song.GetStartTime(),
+		song.GetEndTime(),
+		dc.configured_audio_format,
+	};
+}
+
+/**
+ * Try to play the song from the #DecoderCache.  If it is not cached
+ * yet, prepare DecoderBridge::cache_writer to record it.
+ *
+ * DecoderControl::mutex is not locked by caller.
+ *
+ * @return true if the song was played from the cache
+ */
+static bool
+DecoderUnlockedRunCache(DecoderBridge &bridge, const DetachedSong &song)
+{
+	auto *const cache = decoder_cache_get();
+	if (cache == nullptr || IsNegative(song.GetLastModified()))
+		return false;
+
+	auto key = MakeDecoderCacheKey(bridge.dc, song);
+	const auto file = cache->Open(key);
+	if (file == nullptr) {
+		/* record only if decoding begins at the start of the
+		   song, i.e. not after a seek */
+		if (bridge.dc.start_time == song.GetStartTime())
+			bridge.cache_writer = cache->Create(std::move(key));
+		return false;
+	}
+
+	FormatDebug(decoder_thread_domain, "playing %s from the cache",
+		    song.GetURI());
+
+	SetThreadName("decoder:cache");
+	decoder_cache_decode(bridge, *file, song.GetStartTime());
+	SetThreadName("decoder");
+	return true;
+}
+
+/**
+ * Add the song recorded by DecoderBridge::cache_writer to the
+ * #DecoderCache, but only if it is complete: decoding must not have
+ * been interrupted, and the recording must cover the whole song (or,
+ * if its duration is unknown, the plugin must have read the input
+ * until the end).  Decoder plugins may return early for many reasons
+ * (e.g. a read error), and a truncated entry would replace the song
+ * until it is evicted.
+ *
+ * DecoderControl::mutex is not locked by caller.
+ */
+static void
+CommitDecoderCache(DecoderBridge &bridge, const DetachedSong &song) noexcept
+{
+	const auto writer = std::move(bridge.cache_writer);
+	if (bridge.error || !writer->IsOpen())
+		return;
+
+	SignedSongTime end_time;
+
+	{
+		const std::lock_guard<Mutex> protect(bridge.dc.mutex);
+		if (bridge.dc.command == DecoderCommand::STOP)
+			return;
+
+		end_time = song.GetEndTime().IsPositive()
+			? SignedSongTime(song.GetEndTime())
+			: bridge.dc.total_time;
+	}
+
+	const SongTime start_time = song.GetStartTime();
+	const bool complete = end_time.IsNegative()
+		? bridge.input_eof
+		: (SongTime(end_time) >= start_time &&
+		   writer->IsComplete(SongTime(end_time) - start_time));
+	if (!complete) {
+		FormatDebug(decoder_thread_domain,
+			    "not caching incomplete song %s",
+			    song.GetURI());
+		return;
+	}
+
+	writer->Commit();
+}
+
 /**
  * Decode a song addressed by a #DetachedSong.
  *
@@ -455,14 +735,19 @@ decoder_run_song(DecoderControl &dc,
 	{
 		const ScopeUnlock unlock(dc.mutex);
 
-		AtScopeExit(&bridge) {
-			/* flush the last chunk */
-			if (bridge.current_chunk != nullptr)
-				bridge.FlushChunk();
-		};
+		{
+			AtScopeExit(&bridge) {
+				/* flush the last chunk */
+				if (bridge.current_chunk != nullptr)
+					bridge.FlushChunk();
+			};
 
-		success = DecoderUnlockedRunUri(bridge, uri, path_fs);
+			success = DecoderUnlockedRunCache(bridge, song) ||
+				DecoderUnlockedRunUri(bridge, uri, path_fs);
+		}
 
+		if (success && bridge.cache_writer != nullptr)
+			CommitDecoderCache(bridge, song);
 	}
 
 	if (bridge.error) {
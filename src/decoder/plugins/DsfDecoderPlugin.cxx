@@ -38,6 +38,8 @@
 #include "tag/Handler.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <string.h>
 
 static constexpr unsigned DSF_BLOCK_SIZE = 4096;
@@ -188,57 +190,103 @@ bit_reverse_buffer(uint8_t *p, uint8_t *end)
 		*p = bit_reverse(*p);
 }
 
+/**
+ * DSF data is build up of alternating 4096 blocks of DSD samples for
+ * each channel.  Convert the frames [start, start+n) of such a block
+ * to samples in normal PCM left/right order.
+ */
 static void
 InterleaveDsfBlockMono(uint8_t *gcc_restrict dest,
-		       const uint8_t *gcc_restrict src)
+		       const uint8_t *gcc_restrict src,
+		       size_t start, size_t n)
 {
-	memcpy(dest, src, DSF_BLOCK_SIZE);
+	memcpy(dest, src + start, n);
 }
 
-/**
- * DSF data is build up of alternating 4096 blocks of DSD samples for left and
- * right. Convert the buffer holding 1 block of 4096 DSD left samples and 1
- * block of 4096 DSD right samples to 8k of samples in normal PCM left/right
- * order.
- */
 static void
 InterleaveDsfBlockStereo(uint8_t *gcc_restrict dest,
-			 const uint8_t *gcc_restrict src)
+			 const uint8_t *gcc_restrict src,
+			 size_t start, size_t n)
 {
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i) {
-		dest[2 * i] = src[i];
-		dest[2 * i + 1] = src[DSF_BLOCK_SIZE + i];
+	const uint8_t *left = src + start;
+	const uint8_t *right = src + DSF_BLOCK_SIZE + start;
+
+	for (size_t i = 0; i < n; ++i) {
+		dest[2 * i] = left[i];
+		dest[2 * i + 1] = right[i];
 	}
 }
 
 static void
 InterleaveDsfBlockChannel(uint8_t *gcc_restrict dest,
 			  const uint8_t *gcc_restrict src,
-			  unsigned channels)
+			  size_t n, unsigned channels)
 {
-	for (size_t i = 0; i < DSF_BLOCK_SIZE; ++i, dest += channels, ++src)
+	for (size_t i = 0; i < n; ++i, dest += channels, ++src)
 		*dest = *src;
 }
 
 static void
 InterleaveDsfBlockGeneric(uint8_t *gcc_restrict dest,
 			  const uint8_t *gcc_restrict src,
+			  size_t start, size_t n,
 			  unsigned channels)
 {
+	src += start;
 	for (unsigned c = 0; c < channels; ++c, ++dest, src += DSF_BLOCK_SIZE)
-		InterleaveDsfBlockChannel(dest, src, channels);
+		InterleaveDsfBlockChannel(dest, src, n, channels);
 }
 
 static void
 InterleaveDsfBlock(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
+		   size_t start, size_t n,
 		   unsigned channels)
 {
 	if (channels == 1)
-		InterleaveDsfBlockMono(dest, src);
+		InterleaveDsfBlockMono(dest, src, start, n);
 	else if (channels == 2)
-		InterleaveDsfBlockStereo(dest, src);
+		InterleaveDsfBlockStereo(dest, src, start, n);
 	else
-		InterleaveDsfBlockGeneric(dest, src, channels);
+		InterleaveDsfBlockGeneric(dest, src, start, n, channels);
+}
+
+/**
+ * Interleave a DSF block and submit it to the #DecoderClient.  Where
+ * possible, the frames are interleaved directly into the buffer
+ * obtained from DecoderClient::GetWriteBuffer().
+ */
+static DecoderCommand
+SubmitDsfBlock(DecoderClient &client, InputStream &is,
+	       const uint8_t *src, unsigned channels,
+	       uint16_t kbit_rate)
+{
+	size_t start = 0;
+	while (start < DSF_BLOCK_SIZE) {
+		auto w = client.GetWriteBuffer(is);
+		if (w.empty())
+			break;
+
+		const size_t n = std::min(w.size / channels,
+					  DSF_BLOCK_SIZE - start);
+		InterleaveDsfBlock((uint8_t *)w.data, src, start, n,
+				   channels);
+		start += n;
+
+		const auto cmd = client.CommitData(n * channels, kbit_rate);
+		if (cmd != DecoderCommand::NONE)
+			return cmd;
+	}
+
+	if (start == DSF_BLOCK_SIZE)
+		return client.GetCommand();
+
+	/* fall back to copying */
+	uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
+	const size_t n = DSF_BLOCK_SIZE - start;
+	InterleaveDsfBlock(interleaved_buffer, src, start, n, channels);
+
+	return client.SubmitData(is, interleaved_buffer, n * channels,
+				 kbit_rate);
 }
 
 static offset_type
@@ -286,12 +334,8 @@ dsf_decode_chunk(DecoderClient &client, InputStream &is,
 		if (bitreverse)
 			bit_reverse_buffer(buffer, buffer + block_size);
 
-		uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		InterleaveDsfBlock(interleaved_buffer, buffer, channels);
-
-		cmd = client.SubmitData(is,
-					interleaved_buffer, block_size,
-					sample_rate / 1000);
+		cmd = SubmitDsfBlock(client, is, buffer, channels,
+				     sample_rate / 1000);
 		++i;
 	}
 
@@ -21,6 +21,7 @@
 #include "FaadDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
 #include "../DecoderBuffer.hxx"
+#include "../SeekIndex.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
 #include "tag/Handler.hxx"
@@ -31,8 +32,10 @@
 
 #include <neaacdec.h>
 
+#include <algorithm>
 #include <cmath>
 #include <exception>
+#include <memory>
 
 #include <assert.h>
 #include <string.h>
@@ -42,6 +45,11 @@ static const unsigned adts_sample_rates[] =
 	16000, 12000, 11025, 8000, 7350, 0, 0, 0
 };
 
+/**
+ * The number of samples per channel in one AAC raw data block.
+ */
+static constexpr unsigned ADTS_SAMPLES_PER_FRAME = 1024;
+
 static constexpr Domain faad_decoder_domain("faad_decoder");
 
 /**
@@ -109,8 +117,14 @@ adts_find_frame(DecoderBuffer &buffer)
 	}
 }
 
+/**
+ * @param index_r if not nullptr, then a #SeekIndex is built while
+ * reading all frames, and returned here (only if the duration is not
+ * an estimate)
+ */
 static SignedSongTime
-adts_song_duration(DecoderBuffer &buffer)
+adts_song_duration(DecoderBuffer &buffer,
+		   std::unique_ptr<SeekIndex> *index_r)
 {
 	const InputStream &is = buffer.GetStream();
 	const bool estimate = !is.CheapSeeking();
@@ -118,6 +132,7 @@ adts_song_duration(DecoderBuffer &buffer)
 		return SignedSongTime::Negative();
 
 	unsigned sample_rate = 0;
+	std::unique_ptr<SeekIndex> index;
 
 	/* Read all frames to ensure correct time and bitrate */
 	unsigned frames = 0;
@@ -134,6 +149,21 @@ adts_song_duration(DecoderBuffer &buffer)
 			sample_rate = adts_sample_rates[(data.data[2] & 0x3c) >> 2];
 			if (sample_rate == 0)
 				break;
+
+			if (index_r != nullptr && !estimate)
+				index = std::make_unique<SeekIndex>(sample_rate,
+								    ADTS_SAMPLES_PER_FRAME);
+		}
+
+		if (index != nullptr) {
+			auto data = ConstBuffer<uint8_t>::FromVoid(buffer.Read());
+			if ((data.data[6] & 0x3) != 0)
+				/* more than one raw data block in this
+				   frame; the index would not be
+				   accurate */
+				index.reset();
+			else
+				index->Append(is.GetOffset() - buffer.GetAvailable());
 		}
 
 		buffer.Consume(frame_length);
@@ -159,12 +189,21 @@ adts_song_duration(DecoderBuffer &buffer)
 	if (sample_rate == 0)
 		return SignedSongTime::Negative();
 
-	return SignedSongTime::FromScale<uint64_t>(frames * uint64_t(1024),
+	if (index != nullptr && !index->IsEmpty())
+		*index_r = std::move(index);
+
+	return SignedSongTime::FromScale<uint64_t>(frames * uint64_t(ADTS_SAMPLES_PER_FRAME),
 						   sample_rate);
 }
 
+/**
+ * @param index_r if not nullptr, then the #SeekIndex of an ADTS
+ * stream is loaded from the cache (or built and stored) and returned
+ * here
+ */
 static SignedSongTime
-faad_song_duration(DecoderBuffer &buffer, InputStream &is)
+faad_song_duration(DecoderBuffer &buffer, InputStream &is,
+		   std::unique_ptr<SeekIndex> *index_r)
 {
 	auto data = ConstBuffer<uint8_t>::FromVoid(buffer.Need(5));
 	if (data.IsNull())
@@ -193,7 +232,21 @@ faad_song_duration(DecoderBuffer &buffer, InputStream &is)
 		if (!is.IsSeekable())
 			return SignedSongTime::Negative();
 
-		auto song_length = adts_song_duration(buffer);
+		if (index_r != nullptr) {
+			auto index = SeekIndex::Load(is);
+			if (index != nullptr) {
+				/* no need to read all frames; the
+				   buffer is at the first frame
+				   already */
+				const SignedSongTime duration = index->GetDuration();
+				*index_r = std::move(index);
+				return duration;
+			}
+		}
+
+		auto song_length = adts_song_duration(buffer, index_r);
+		if (index_r != nullptr && *index_r != nullptr)
+			(*index_r)->Store(is);
 
 		try {
 			is.LockSeek(tagsize);
@@ -304,7 +357,11 @@ faad_get_file_time(InputStream &is)
 {
 	DecoderBuffer buffer(nullptr, is,
 			     FAAD_MIN_STREAMSIZE * MAX_CHANNELS);
-	auto duration = faad_song_duration(buffer, is);
+
+	/* reading all frames for the duration also builds the seek
+	   index, which will be used when the song is played */
+	std::unique_ptr<SeekIndex> index;
+	auto duration = faad_song_duration(buffer, is, &index);
 	bool recognized = !duration.IsNegative();
 
 	if (!recognized) {
@@ -324,11 +381,67 @@ faad_get_file_time(InputStream &is)
 	return std::make_pair(recognized, duration);
 }
 
+/**
+ * Seek with the #SeekIndex.  Decoding begins one frame before the
+ * target, to fill the decoder's overlap buffer; that frame's output
+ * must be discarded by the caller.
+ *
+ * @param discard_frames_r the number of decoded frames to be
+ * discarded
+ * @param skip_samples_r the number of samples (all channels) to be
+ * discarded from the frame after that
+ * @return false on error
+ */
+static bool
+faad_seek(DecoderClient &client, InputStream &is, DecoderBuffer &buffer,
+	  NeAACDecHandle decoder, const SeekIndex &index,
+	  const AudioFormat &audio_format,
+	  unsigned &discard_frames_r, size_t &skip_samples_r)
+{
+	/* the output sample rate may be different from the ADTS
+	   header's (implicit SBR) */
+	const uint64_t out_frame = client.GetSeekFrame();
+	const uint64_t sample = out_frame * index.GetSampleRate()
+		/ audio_format.sample_rate;
+	const uint64_t target = sample / index.GetSamplesPerFrame();
+	if (target >= index.GetFrameCount())
+		return false;
+
+	const uint64_t prime = target > 0 ? target - 1 : 0;
+	const auto position = index.Lookup(prime);
+
+	try {
+		is.LockSeek(position.offset);
+	} catch (...) {
+		return false;
+	}
+
+	buffer.Clear();
+
+	/* walk the frame headers up to the priming frame */
+	for (uint64_t i = position.frame; i < prime; ++i) {
+		const size_t frame_length = adts_find_frame(buffer);
+		if (frame_length == 0)
+			return false;
+
+		buffer.Consume(frame_length);
+	}
+
+	NeAACDecPostSeekReset(decoder, prime);
+
+	const uint64_t target_out_frame = target * index.GetSamplesPerFrame()
+		* audio_format.sample_rate / index.GetSampleRate();
+	discard_frames_r = target - prime;
+	skip_samples_r = (out_frame - target_out_frame) * audio_format.channels;
+	return true;
+}
+
 static void
 faad_stream_decode(DecoderClient &client, InputStream &is,
 		   DecoderBuffer &buffer, const NeAACDecHandle decoder)
 {
-	const auto total_time = faad_song_duration(buffer, is);
+	std::unique_ptr<SeekIndex> seek_index;
+	const auto total_time = faad_song_duration(buffer, is, &seek_index);
 
 	if (adts_find_frame(buffer) == 0)
 		return;
@@ -340,12 +453,14 @@ faad_stream_decode(DecoderClient &client, InputStream &is,
 
 	/* initialize the MPD core */
 
-	client.Ready(audio_format, false, total_time);
+	client.Ready(audio_format, seek_index != nullptr, total_time);
 
 	/* the decoder loop */
 
 	DecoderCommand cmd;
 	unsigned bit_rate = 0;
+	unsigned discard_frames = 0;
+	size_t skip_samples = 0;
 	do {
 		/* find the next frame */
 
@@ -394,9 +509,34 @@ faad_stream_decode(DecoderClient &client, InputStream &is,
 
 		/* send PCM samples to MPD */
 
-		cmd = client.SubmitData(is, decoded,
-					(size_t)frame_info.samples * 2,
-					bit_rate);
+		size_t n_samples = frame_info.samples;
+		const int16_t *samples = (const int16_t *)decoded;
+
+		if (discard_frames > 0) {
+			/* this is the priming frame after a seek */
+			--discard_frames;
+			n_samples = 0;
+		} else if (skip_samples > 0) {
+			const size_t n = std::min(skip_samples, n_samples);
+			samples += n;
+			n_samples -= n;
+			skip_samples -= n;
+		}
+
+		cmd = n_samples > 0
+			? client.SubmitData(is, samples, n_samples * 2,
+					    bit_rate)
+			: client.GetCommand();
+
+		if (cmd == DecoderCommand::SEEK) {
+			if (seek_index != nullptr &&
+			    faad_seek(client, is, buffer, decoder, *seek_index,
+				      audio_format,
+				      discard_frames, skip_samples))
+				client.CommandFinished();
+			else
+				client.SeekError();
+		}
 	} while (cmd != DecoderCommand::STOP);
 }
 
@@ -50,6 +50,8 @@ extern "C" {
 #include <libavutil/frame.h>
 }
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
@@ -240,8 +242,44 @@ PtsToPcmFrame(uint64_t pts, const AVStream &stream,
 }
 
 /**
- * Invoke DecoderClient::SubmitData() with the contents of an
- * #AVFrame.
+ * Copy PCM frames from an #AVFrame to the given buffer, interleaving
+ * planar samples.
+ *
+ * @param start the first PCM frame to be copied
+ * @param n the number of PCM frames to be copied
+ */
+static void
+FfmpegCopyFrames(void *dest, const AVCodecContext &codec_context,
+		 const AVFrame &frame, size_t start, size_t n) noexcept
+{
+	const size_t sample_size =
+		av_get_bytes_per_sample(codec_context.sample_fmt);
+	const unsigned channels = codec_context.channels;
+
+	if (av_sample_fmt_is_planar(codec_context.sample_fmt) &&
+	    channels > 1) {
+		assert(channels <= MAX_CHANNELS);
+
+		const void *planes[MAX_CHANNELS];
+		for (unsigned c = 0; c < channels; ++c)
+			planes[c] = frame.extended_data[c] + start * sample_size;
+
+		PcmInterleave(dest,
+			      ConstBuffer<const void *>(planes, channels),
+			      n, sample_size);
+	} else {
+		const size_t frame_size = sample_size * channels;
+		memcpy(dest, frame.extended_data[0] + start * frame_size,
+		       n * frame_size);
+	}
+}
+
+/**
+ * Pass the contents of an #AVFrame to the decoder client.  If
+ * possible, the samples are copied (and interleaved) directly into
+ * the music pipe with DecoderClient::GetWriteBuffer(); consecutive
+ * frames are collected in the same #MusicChunk this way.  Otherwise,
+ * DecoderClient::SubmitData() is invoked.
  */
 static DecoderCommand
 FfmpegSendFrame(DecoderClient &client, InputStream &is,
@@ -250,6 +288,46 @@ FfmpegSendFrame(DecoderClient &client, InputStream &is,
 		size_t &skip_bytes,
 		FfmpegBuffer &buffer)
 {
+	assert(frame.nb_samples > 0);
+
+	const size_t frame_size =
+		av_get_bytes_per_sample(codec_context.sample_fmt) *
+		codec_context.channels;
+	const size_t n_frames = frame.nb_samples;
+	const uint16_t kbit_rate = codec_context.bit_rate / 1000;
+
+	/* skip_bytes is a multiple of the frame size */
+	size_t start = skip_bytes / frame_size;
+	if (start >= n_frames) {
+		skip_bytes -= n_frames * frame_size;
+		return DecoderCommand::NONE;
+	}
+
+	skip_bytes = 0;
+
+	while (start < n_frames) {
+		const auto w = client.GetWriteBuffer(is);
+		const size_t n = std::min(w.size / frame_size,
+					  n_frames - start);
+		if (n == 0)
+			break;
+
+		FfmpegCopyFrames(w.data, codec_context, frame, start, n);
+		start += n;
+
+		const auto cmd = client.CommitData(n * frame_size, kbit_rate);
+		if (cmd != DecoderCommand::NONE)
+			/* discard the rest; the command will be
+			   handled by the decoder loop */
+			return cmd;
+	}
+
+	if (start == n_frames)
+		return DecoderCommand::NONE;
+
+	/* fall back to SubmitData() for the rest, e.g. because the
+	   data needs to be converted */
+
 	ConstBuffer<void> output_buffer;
 
 	try {
@@ -261,21 +339,13 @@ FfmpegSendFrame(DecoderClient &client, InputStream &is,
 		return DecoderCommand::STOP;
 	}
 
-	if (skip_bytes > 0) {
-		if (skip_bytes >= output_buffer.size) {
-			skip_bytes -= output_buffer.size;
-			return DecoderCommand::NONE;
-		}
-
-		output_buffer.data =
-			(const uint8_t *)output_buffer.data + skip_bytes;
-		output_buffer.size -= skip_bytes;
-		skip_bytes = 0;
-	}
+	output_buffer.data =
+		(const uint8_t *)output_buffer.data + start * frame_size;
+	output_buffer.size -= start * frame_size;
 
 	return client.SubmitData(is,
 				 output_buffer.data, output_buffer.size,
-				 codec_context.bit_rate / 1000);
+				 kbit_rate);
 }
 
 #if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(57, 37, 0)
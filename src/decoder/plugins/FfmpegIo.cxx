@@ -96,7 +96,9 @@ AvioStream::_Seek(void *opaque, int64_t pos, int whence)
 bool
 AvioStream::Open()
 {
-	constexpr size_t BUFFER_SIZE = 8192;
+	/* a large buffer reduces the number of decoder_read() calls
+	   (each of which locks the InputStream) */
+	constexpr size_t BUFFER_SIZE = 64 * 1024;
 	auto buffer = (unsigned char *)av_malloc(BUFFER_SIZE);
 	if (buffer == nullptr)
 		return false;
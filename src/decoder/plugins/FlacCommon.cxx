@@ -27,6 +27,7 @@
 #include "Log.hxx"
 #include "input/InputStream.hxx"
 
+#include <algorithm>
 #include <exception>
 
 bool
@@ -143,10 +144,46 @@ FlacDecoder::OnWrite(const FLAC__Frame &frame,
 	if (!initialized && !OnFirstFrame(frame.header))
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-	chunk = pcm_import.Import(buf, frame.header.blocksize);
-
 	kbit_rate = nbytes * 8 * frame.header.sample_rate /
 		(1000 * frame.header.blocksize);
 
+	const auto &audio_format = pcm_import.GetAudioFormat();
+	size_t n_frames = frame.header.blocksize;
+
+	const FLAC__int32 *src[FLAC__MAX_CHANNELS];
+	std::copy_n(buf, audio_format.channels, src);
+
+	if (tag.IsEmpty()) {
+		/* import directly into the music pipe; if there is a
+		   tag, it must be submitted first (see
+		   FlacSubmitToClient()) */
+
+		auto &decoder_client = *GetClient();
+		const size_t frame_size = audio_format.GetFrameSize();
+
+		while (n_frames > 0) {
+			auto w = decoder_client.GetWriteBuffer(GetInputStream());
+			const size_t n = std::min(w.size / frame_size,
+						  n_frames);
+			if (n == 0)
+				break;
+
+			pcm_import.Import(w.data, src, n);
+
+			for (unsigned c = 0; c < audio_format.channels; ++c)
+				src[c] += n;
+			n_frames -= n;
+
+			if (decoder_client.CommitData(n * frame_size,
+						      kbit_rate) != DecoderCommand::NONE)
+				/* discard the rest; the command will
+				   be handled by the decoder loop */
+				return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+		}
+	}
+
+	if (n_frames > 0)
+		chunk = pcm_import.Import(src, n_frames);
+
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
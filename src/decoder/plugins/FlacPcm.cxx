@@ -21,6 +21,7 @@
 #include "FlacPcm.hxx"
 #include "CheckAudioFormat.hxx"
 #include "lib/xiph/FlacAudioFormat.hxx"
+#include "pcm/Interleave.hxx"
 #include "util/RuntimeError.hxx"
 #include "util/ConstBuffer.hxx"
 
@@ -38,65 +39,29 @@ FlacPcmImport::Open(unsigned sample_rate, unsigned bits_per_sample,
 	audio_format = CheckAudioFormat(sample_rate, sample_format, channels);
 }
 
-template<typename T>
-static void
-FlacImportStereo(T *dest, const FLAC__int32 *const src[], size_t n_frames)
+void
+FlacPcmImport::Import(void *dest, const FLAC__int32 *const src[],
+		      size_t n_frames) const noexcept
 {
-	for (size_t i = 0; i != n_frames; ++i) {
-		*dest++ = (T)src[0][i];
-		*dest++ = (T)src[1][i];
-	}
-}
+	static_assert(sizeof(FLAC__int32) == sizeof(int32_t),
+		      "Unexpected FLAC__int32 size");
 
-template<typename T>
-static void
-FlacImportAny(T *dest, const FLAC__int32 *const src[], size_t n_frames,
-	      unsigned n_channels)
-{
-	for (size_t i = 0; i != n_frames; ++i)
-		for (unsigned c = 0; c != n_channels; ++c)
-			*dest++ = src[c][i];
-}
+	const ConstBuffer<const int32_t *> planes((const int32_t *const*)src,
+						  audio_format.channels);
 
-template<typename T>
-static void
-FlacImport(T *dest, const FLAC__int32 *const src[], size_t n_frames,
-	   unsigned n_channels)
-{
-	if (n_channels == 2)
-		FlacImportStereo(dest, src, n_frames);
-	else
-		FlacImportAny(dest, src, n_frames, n_channels);
-}
-
-template<typename T>
-static ConstBuffer<void>
-FlacImport(PcmBuffer &buffer, const FLAC__int32 *const src[], size_t n_frames,
-	   unsigned n_channels)
-{
-	size_t n_samples = n_frames * n_channels;
-	size_t dest_size = n_samples * sizeof(T);
-	T *dest = (T *)buffer.Get(dest_size);
-	FlacImport(dest, src, n_frames, n_channels);
-	return {dest, dest_size};
-}
-
-ConstBuffer<void>
-FlacPcmImport::Import(const FLAC__int32 *const src[], size_t n_frames)
-{
 	switch (audio_format.format) {
 	case SampleFormat::S16:
-		return FlacImport<int16_t>(buffer, src, n_frames,
-					   audio_format.channels);
+		PcmInterleaveNarrow16((int16_t *)dest, planes, n_frames);
+		return;
 
 	case SampleFormat::S24_P32:
 	case SampleFormat::S32:
-		return FlacImport<int32_t>(buffer, src, n_frames,
-					   audio_format.channels);
+		PcmInterleave32((int32_t *)dest, planes, n_frames);
+		return;
 
 	case SampleFormat::S8:
-		return FlacImport<int8_t>(buffer, src, n_frames,
-					  audio_format.channels);
+		PcmInterleaveNarrow8((int8_t *)dest, planes, n_frames);
+		return;
 
 	case SampleFormat::FLOAT:
 	case SampleFormat::DSD:
@@ -107,3 +72,12 @@ FlacPcmImport::Import(const FLAC__int32 *const src[], size_t n_frames)
 	assert(false);
 	gcc_unreachable();
 }
+
+ConstBuffer<void>
+FlacPcmImport::Import(const FLAC__int32 *const src[], size_t n_frames)
+{
+	const size_t dest_size = n_frames * audio_format.GetFrameSize();
+	void *dest = buffer.Get(dest_size);
+	Import(dest, src, n_frames);
+	return {dest, dest_size};
+}
@@ -50,6 +50,13 @@ public:
 
 	ConstBuffer<void> Import(const FLAC__int32 *const src[],
 				 size_t n_frames);
+
+	/**
+	 * Like Import(), but write to the given buffer, which must
+	 * be large enough for #n_frames.
+	 */
+	void Import(void *dest, const FLAC__int32 *const src[],
+		    size_t n_frames) const noexcept;
 };
 
 #endif
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "MadDecoderPlugin.hxx"
 #include "../DecoderAPI.hxx"
+#include "../SeekIndex.hxx"
 #include "input/InputStream.hxx"
 #include "config/Block.hxx"
 #include "tag/Id3Scan.hxx"
@@ -30,6 +31,7 @@
 #include "CheckAudioFormat.hxx"
 #include "util/StringCompare.hxx"
 #include "util/Domain.hxx"
+#include "util/ScopeExit.hxx"
 #include "Log.hxx"
 
 #include <mad.h>
@@ -38,6 +40,8 @@
 #include <id3tag.h>
 #endif
 
+#include <algorithm>
+#include <memory>
 #include <stdexcept>
 
 #include <assert.h>
@@ -57,7 +61,14 @@ enum mp3_action {
 enum muteframe {
 	MUTEFRAME_NONE,
 	MUTEFRAME_SKIP,
-	MUTEFRAME_SEEK
+	MUTEFRAME_SEEK,
+
+	/**
+	 * Decode and synthesize this frame, but discard the samples.
+	 * This fills the bit reservoir and the synthesis filter
+	 * after a #SeekIndex jump.
+	 */
+	MUTEFRAME_PRIME,
 };
 
 /* the number of samples of silence the decoder inserts at start */
@@ -128,6 +139,55 @@ struct MadDecoder {
 	SongTime elapsed_time;
 	SongTime seek_time;
 	enum muteframe mute_frame = MUTEFRAME_NONE;
+
+	/**
+	 * If this is set, then all frame offsets are known, and
+	 * #frame_offsets and #times are not used.
+	 */
+	std::unique_ptr<SeekIndex> seek_index;
+
+	/**
+	 * If there is no #seek_index yet, then a new one is built
+	 * from the frame headers while decoding.  It is stored when
+	 * the whole stream has been decoded, and discarded as soon as
+	 * decoding jumps.
+	 */
+	std::unique_ptr<SeekIndex> new_seek_index;
+
+	/**
+	 * The offset of the last frame added to #new_seek_index.
+	 */
+	offset_type new_seek_index_offset;
+
+	/**
+	 * The frame where #MUTEFRAME_SEEK ends (only used with
+	 * #seek_index).
+	 */
+	unsigned long seek_frame;
+
+	/**
+	 * The number of samples to discard from the next frame, to
+	 * make a #seek_index jump sample-accurate.
+	 */
+	unsigned skip_samples = 0;
+
+	/**
+	 * The number of samples removed from the beginning for
+	 * gapless playback (encoder delay and decoder delay).
+	 */
+	unsigned gapless_delay = 0;
+
+	/**
+	 * The number of the first frame containing audio; this is 1
+	 * if the first frame is a Xing/LAME header.
+	 */
+	unsigned first_audio_frame = 0;
+
+	/**
+	 * Was the number of frames obtained from the Xing header?
+	 */
+	bool xing_frames = false;
+
 	long *frame_offsets = nullptr;
 	mad_timer_t *times = nullptr;
 	unsigned long highest_frame = 0;
@@ -157,6 +217,9 @@ struct MadDecoder {
 	gcc_pure
 	offset_type ThisFrameOffset() const noexcept;
 
+	gcc_pure
+	offset_type NextFrameOffset() const noexcept;
+
 	gcc_pure
 	offset_type RestIncludingThisFrame() const noexcept;
 
@@ -167,6 +230,39 @@ struct MadDecoder {
 
 	bool DecodeFirstFrame(Tag **tag);
 
+	/**
+	 * Load the #SeekIndex from the cache, and take the exact song
+	 * duration from it.  Call after DecodeFirstFrame().
+	 */
+	void LoadSeekIndex();
+
+	/**
+	 * Begin building #new_seek_index, beginning with the current
+	 * frame.  Call after DecodeFirstFrame().
+	 */
+	void BeginSeekIndex();
+
+	/**
+	 * Add a frame to #new_seek_index, unless it has been added
+	 * already.
+	 */
+	void AppendSeekIndex(offset_type offset) noexcept;
+
+	/**
+	 * Scan the headers of the remaining frames (without decoding
+	 * them) and add them to #new_seek_index.
+	 *
+	 * @return false on error
+	 */
+	bool ScanSeekIndex(offset_type start);
+
+	/**
+	 * Call after decoding has finished: if the whole stream has
+	 * been decoded, complete #new_seek_index with the frames
+	 * libmad has not seen, and store it.
+	 */
+	void FinishSeekIndex();
+
 	void AllocateBuffers() {
 		assert(max_frames > 0);
 		assert(frame_offsets == nullptr);
@@ -181,6 +277,13 @@ struct MadDecoder {
 
 	void UpdateTimerNextFrame();
 
+	/**
+	 * Seek with the #seek_index.
+	 *
+	 * @return false on error
+	 */
+	bool SeekIndexed(SongTime t);
+
 	/**
 	 * Sends the synthesized current frame via
 	 * DecoderClient::SubmitData().
@@ -210,6 +313,9 @@ MadDecoder::MadDecoder(DecoderClient *_client,
 inline bool
 MadDecoder::Seek(long offset)
 {
+	/* the frames are not visited in order anymore */
+	new_seek_index.reset();
+
 	try {
 		input_stream.LockSeek(offset);
 	} catch (...) {
@@ -456,6 +562,10 @@ MadDecoder::DecodeNextFrameHeader(Tag **tag)
 		return DECODE_SKIP;
 	}
 
+	if (new_seek_index != nullptr &&
+	    frame.header.samplerate == new_seek_index->GetSampleRate())
+		AppendSeekIndex(ThisFrameOffset());
+
 	return DECODE_OK;
 }
 
@@ -718,6 +828,19 @@ MadDecoder::ThisFrameOffset() const noexcept
 	return offset;
 }
 
+inline offset_type
+MadDecoder::NextFrameOffset() const noexcept
+{
+	auto offset = input_stream.GetOffset();
+
+	if (stream.next_frame != nullptr)
+		offset -= stream.bufend - stream.next_frame;
+	else if (stream.buffer != nullptr)
+		offset -= stream.bufend - stream.buffer;
+
+	return offset;
+}
+
 inline offset_type
 MadDecoder::RestIncludingThisFrame() const noexcept
 {
@@ -779,12 +902,14 @@ MadDecoder::DecodeFirstFrame(Tag **tag)
 	 */
 	if (parse_xing(&xing, &ptr, &bitlen)) {
 		mute_frame = MUTEFRAME_SKIP;
+		first_audio_frame = 1;
 
 		if ((xing.flags & XING_FRAMES) && xing.frames) {
 			mad_timer_t duration = frame.header.duration;
 			mad_timer_multiply(&duration, xing.frames);
 			total_time = ToSongTime(duration);
 			max_frames = xing.frames;
+			xing_frames = true;
 		}
 
 		struct lame lame;
@@ -793,6 +918,7 @@ MadDecoder::DecodeFirstFrame(Tag **tag)
 				drop_start_samples = lame.encoder_delay +
 				                           DECODERDELAY;
 				drop_end_samples = lame.encoder_padding;
+				gapless_delay = drop_start_samples;
 			}
 
 			/* Album gain isn't currently used.  See comment in
@@ -821,6 +947,178 @@ MadDecoder::DecodeFirstFrame(Tag **tag)
 	return true;
 }
 
+void
+MadDecoder::AppendSeekIndex(offset_type offset) noexcept
+{
+	assert(new_seek_index != nullptr);
+
+	if (!new_seek_index->IsEmpty() && offset <= new_seek_index_offset)
+		/* libmad has decoded this header before */
+		return;
+
+	new_seek_index->Append(offset);
+	new_seek_index_offset = offset;
+}
+
+bool
+MadDecoder::ScanSeekIndex(offset_type start)
+{
+	assert(new_seek_index != nullptr);
+
+	if (start >= input_stream.GetSize())
+		return true;
+
+	try {
+		input_stream.LockSeek(start);
+	} catch (...) {
+		return false;
+	}
+
+	const unsigned sample_rate = new_seek_index->GetSampleRate();
+
+	std::unique_ptr<unsigned char[]> buffer(new unsigned char[READ_BUFFER_SIZE + MAD_BUFFER_GUARD]);
+
+	struct mad_stream s;
+	mad_stream_init(&s);
+	AtScopeExit(&s) { mad_stream_finish(&s); };
+
+	struct mad_header header;
+	mad_header_init(&header);
+
+	/* the file offset of the first byte in the buffer */
+	offset_type buffer_offset = start;
+	bool eof = false;
+
+	while (true) {
+		if (s.buffer == nullptr || s.error == MAD_ERROR_BUFLEN) {
+			if (eof)
+				break;
+
+			size_t remaining = 0;
+			if (s.next_frame != nullptr) {
+				remaining = s.bufend - s.next_frame;
+				buffer_offset += s.next_frame - s.buffer;
+				memmove(buffer.get(), s.next_frame, remaining);
+			}
+
+			size_t nbytes = decoder_read(client, input_stream,
+						     buffer.get() + remaining,
+						     READ_BUFFER_SIZE - remaining);
+			if (nbytes == 0) {
+				if (client != nullptr &&
+				    client->GetCommand() != DecoderCommand::NONE)
+					/* interrupted */
+					return false;
+
+				/* end of file: libmad needs some
+				   padding to see the last frame */
+				eof = true;
+				memset(buffer.get() + remaining, 0,
+				       MAD_BUFFER_GUARD);
+				nbytes = MAD_BUFFER_GUARD;
+			}
+
+			mad_stream_buffer(&s, buffer.get(), remaining + nbytes);
+			s.error = MAD_ERROR_NONE;
+		}
+
+		if (mad_header_decode(&header, &s) == 0) {
+			/* skip the same frames as DecodeNextFrameHeader() */
+			if (header.layer == layer &&
+			    header.samplerate == sample_rate)
+				AppendSeekIndex(buffer_offset +
+						(s.this_frame - s.buffer));
+			continue;
+		}
+
+		if (s.error == MAD_ERROR_BUFLEN)
+			continue;
+
+		if (s.error == MAD_ERROR_LOSTSYNC && s.this_frame != nullptr) {
+			signed long tagsize = id3_tag_query(s.this_frame,
+							    s.bufend - s.this_frame);
+			if (tagsize > 0) {
+				mad_stream_skip(&s, tagsize);
+				continue;
+			}
+		}
+
+		if (!MAD_RECOVERABLE(s.error))
+			break;
+	}
+
+	return true;
+}
+
+void
+MadDecoder::LoadSeekIndex()
+{
+	seek_index = SeekIndex::Load(input_stream);
+	if (seek_index == nullptr)
+		return;
+
+	if (seek_index->GetSampleRate() != frame.header.samplerate ||
+	    seek_index->GetSamplesPerFrame() != 32 * MAD_NSBSAMPLES(&frame.header) ||
+	    seek_index->GetFrameCount() <= first_audio_frame) {
+		seek_index.reset();
+		return;
+	}
+
+	if (!xing_frames) {
+		/* the index knows the exact number of frames; this is
+		   better than the estimate by
+		   FileSizeToSongLength() */
+		const uint64_t n_frames =
+			seek_index->GetFrameCount() - first_audio_frame;
+		max_frames = seek_index->GetFrameCount();
+		total_time = SongTime::FromScale<uint64_t>(n_frames * seek_index->GetSamplesPerFrame(),
+							   seek_index->GetSampleRate());
+	}
+}
+
+void
+MadDecoder::BeginSeekIndex()
+{
+	assert(seek_index == nullptr);
+
+	if (!SeekIndex::CanStore(input_stream))
+		return;
+
+	new_seek_index = std::make_unique<SeekIndex>(frame.header.samplerate,
+						     32 * MAD_NSBSAMPLES(&frame.header));
+	AppendSeekIndex(ThisFrameOffset());
+}
+
+void
+MadDecoder::FinishSeekIndex()
+{
+	/* if decoding stopped this far before the end of the file,
+	   it was not the end of the stream (e.g. the end of a CUE
+	   track) */
+	static constexpr offset_type MAX_SCAN = 64 * 1024;
+
+	if (new_seek_index == nullptr)
+		return;
+
+	AtScopeExit(this) { new_seek_index.reset(); };
+
+	if (client->GetCommand() != DecoderCommand::NONE)
+		/* interrupted */
+		return;
+
+	const offset_type offset = NextFrameOffset();
+	if (offset > input_stream.GetSize() ||
+	    input_stream.GetSize() - offset > MAX_SCAN)
+		return;
+
+	/* with gapless playback, the last frames are not decoded,
+	   and libmad never sees the last frame without padding;
+	   scan the rest of the file */
+	if (ScanSeekIndex(offset) &&
+	    new_seek_index->GetFrameCount() > first_audio_frame)
+		new_seek_index->Store(input_stream);
+}
+
 MadDecoder::~MadDecoder()
 {
 	mad_synth_finish(&synth);
@@ -848,7 +1146,10 @@ MadDecoder::TimeToFrame(SongTime t) const noexcept
 void
 MadDecoder::UpdateTimerNextFrame()
 {
-	if (current_frame >= highest_frame) {
+	if (seek_index != nullptr) {
+		bit_rate = frame.header.bitrate;
+		mad_timer_add(&timer, frame.header.duration);
+	} else if (current_frame >= highest_frame) {
 		/* record this frame's properties in frame_offsets
 		   (for seeking) and times */
 		bit_rate = frame.header.bitrate;
@@ -871,6 +1172,47 @@ MadDecoder::UpdateTimerNextFrame()
 	elapsed_time = ToSongTime(timer);
 }
 
+bool
+MadDecoder::SeekIndexed(SongTime t)
+{
+	const auto &index = *seek_index;
+	const unsigned samples_per_frame = index.GetSamplesPerFrame();
+
+	const uint64_t sample =
+		t.ToScale<uint64_t>(index.GetSampleRate()) + gapless_delay;
+	const uint64_t target = first_audio_frame + sample / samples_per_frame;
+	if (target >= index.GetFrameCount())
+		return false;
+
+	/* begin decoding one frame early, to fill the bit reservoir
+	   and the synthesis filter */
+	const uint64_t prime = target > first_audio_frame
+		? target - 1
+		: target;
+
+	const auto position = index.Lookup(prime);
+	if (!Seek(position.offset))
+		return false;
+
+	current_frame = position.frame;
+	timer = frame.header.duration;
+	mad_timer_multiply(&timer, position.frame);
+	elapsed_time = ToSongTime(timer);
+
+	skip_samples = sample % samples_per_frame;
+
+	if (position.frame < prime) {
+		/* walk the frame headers up to the priming frame */
+		seek_frame = prime;
+		mute_frame = MUTEFRAME_SEEK;
+	} else if (prime < target)
+		mute_frame = MUTEFRAME_PRIME;
+	else
+		mute_frame = MUTEFRAME_NONE;
+
+	return true;
+}
+
 DecoderCommand
 MadDecoder::SendPCM(unsigned i, unsigned pcm_length)
 {
@@ -930,6 +1272,12 @@ MadDecoder::SyncAndSend()
 		decoded_first_frame = true;
 	}
 
+	if (skip_samples > 0) {
+		/* the first frame after a SeekIndexed() */
+		i = std::min<unsigned>(skip_samples, synth.pcm.length);
+		skip_samples = 0;
+	}
+
 	unsigned pcm_length = synth.pcm.length;
 	if (drop_end_samples &&
 	    (current_frame == max_frames - drop_end_frames)) {
@@ -964,15 +1312,30 @@ MadDecoder::Read()
 		mute_frame = MUTEFRAME_NONE;
 		break;
 	case MUTEFRAME_SEEK:
-		if (elapsed_time >= seek_time)
+		if (seek_index != nullptr) {
+			if (current_frame >= seek_frame)
+				mute_frame = MUTEFRAME_PRIME;
+		} else if (elapsed_time >= seek_time)
 			mute_frame = MUTEFRAME_NONE;
 		break;
+	case MUTEFRAME_PRIME:
+		mad_synth_frame(&synth, &frame);
+		mute_frame = MUTEFRAME_NONE;
+		break;
 	case MUTEFRAME_NONE:
 		cmd = SyncAndSend();
 		if (cmd == DecoderCommand::SEEK) {
 			assert(input_stream.IsSeekable());
 
 			const auto t = client->GetSeekTime();
+			if (seek_index != nullptr) {
+				if (SeekIndexed(t))
+					client->CommandFinished();
+				else
+					client->SeekError();
+				break;
+			}
+
 			unsigned long j = TimeToFrame(t);
 			if (j < highest_frame) {
 				if (Seek(frame_offsets[j])) {
@@ -1007,12 +1370,23 @@ MadDecoder::Read()
 
 		const bool skip = ret == DECODE_SKIP;
 
-		if (mute_frame == MUTEFRAME_NONE) {
+		if (mute_frame != MUTEFRAME_SEEK) {
 			do {
 				ret = DecodeNextFrame();
 			} while (ret == DECODE_CONT);
 			if (ret == DECODE_BREAK)
 				return false;
+
+			if (!skip && ret == DECODE_SKIP &&
+			    mute_frame == MUTEFRAME_PRIME) {
+				/* the priming frame could not be
+				   decoded (its bit reservoir is
+				   missing); count it and output the
+				   next one */
+				UpdateTimerNextFrame();
+				mute_frame = MUTEFRAME_NONE;
+				continue;
+			}
 		}
 
 		if (!skip && ret == DECODE_OK)
@@ -1035,7 +1409,14 @@ mp3_decode(DecoderClient &client, InputStream &input_stream)
 		return;
 	}
 
-	data.AllocateBuffers();
+	if (input_stream.IsSeekable()) {
+		data.LoadSeekIndex();
+		if (data.seek_index == nullptr)
+			data.BeginSeekIndex();
+	}
+
+	if (data.seek_index == nullptr)
+		data.AllocateBuffers();
 
 	client.Ready(CheckAudioFormat(data.frame.header.samplerate,
 				      SampleFormat::S24_P32,
@@ -1049,6 +1430,8 @@ mp3_decode(DecoderClient &client, InputStream &input_stream)
 	}
 
 	while (data.Read()) {}
+
+	data.FinishSeekIndex();
 }
 
 static bool
@@ -1058,6 +1441,9 @@ mad_decoder_scan_stream(InputStream &is, TagHandler &handler) noexcept
 	if (!data.DecodeFirstFrame(nullptr))
 		return false;
 
+	if (is.IsSeekable())
+		data.LoadSeekIndex();
+
 	if (!data.total_time.IsNegative())
 		handler.OnDuration(SongTime(data.total_time));
 
@@ -161,33 +161,65 @@ pcm_stream_decode(DecoderClient &client, InputStream &is)
 
 	DecoderCommand cmd;
 	do {
-		if (!FillBuffer(client, is, buffer))
-			break;
-
-		auto r = buffer.Read();
-		/* round down to the nearest frame size, because we
-		   must not pass partial frames to
-		   DecoderClient::SubmitData() */
-		r.size -= r.size % in_frame_size;
-		buffer.Consume(r.size);
-
-		if (reverse_endian)
-			/* make sure we deliver samples in host byte order */
-			reverse_bytes_16((uint16_t *)r.data,
-					 (uint16_t *)r.data,
-					 (uint16_t *)(r.data + r.size));
-		else if (l24) {
-			/* convert big-endian packed 24 bit
-			   (audio/L24) to native-endian 24 bit (in 32
-			   bit integers) */
-			pcm_unpack_24be(unpack_buffer, r.begin(), r.end());
-			r.data = (uint8_t *)&unpack_buffer[0];
-			r.size = (r.size / 3) * 4;
+		/* if there is no leftover data, read directly into
+		   the music pipe */
+		const auto w = buffer.empty() && !l24
+			? client.GetWriteBuffer(is)
+			: nullptr;
+		if (!w.empty()) {
+			const size_t nbytes = decoder_read(client, is,
+							   w.data, w.size);
+			if (nbytes == 0 && is.LockIsEOF())
+				break;
+
+			/* keep the partial frame for the next
+			   iteration */
+			const size_t length = nbytes - nbytes % in_frame_size;
+			if (length < nbytes) {
+				memcpy(buffer.Write().data,
+				       (const uint8_t *)w.data + length,
+				       nbytes - length);
+				buffer.Append(nbytes - length);
+			}
+
+			if (reverse_endian)
+				reverse_bytes_16((uint16_t *)w.data,
+						 (uint16_t *)w.data,
+						 (uint16_t *)((uint8_t *)w.data + length));
+
+			cmd = client.CommitData(length, 0);
+		} else {
+			if (!FillBuffer(client, is, buffer))
+				break;
+
+			auto r = buffer.Read();
+			/* round down to the nearest frame size,
+			   because we must not pass partial frames to
+			   DecoderClient::SubmitData() */
+			r.size -= r.size % in_frame_size;
+			buffer.Consume(r.size);
+
+			if (reverse_endian)
+				/* make sure we deliver samples in host
+				   byte order */
+				reverse_bytes_16((uint16_t *)r.data,
+						 (uint16_t *)r.data,
+						 (uint16_t *)(r.data + r.size));
+			else if (l24) {
+				/* convert big-endian packed 24 bit
+				   (audio/L24) to native-endian 24 bit
+				   (in 32 bit integers) */
+				pcm_unpack_24be(unpack_buffer,
+						r.begin(), r.end());
+				r.data = (uint8_t *)&unpack_buffer[0];
+				r.size = (r.size / 3) * 4;
+			}
+
+			cmd = !r.empty()
+				? client.SubmitData(is, r.data, r.size, 0)
+				: client.GetCommand();
 		}
 
-		cmd = !r.empty()
-			? client.SubmitData(is, r.data, r.size, 0)
-			: client.GetCommand();
 		if (cmd == DecoderCommand::SEEK) {
 			uint64_t frame = client.GetSeekFrame();
 			offset_type offset = frame * in_frame_size;
@@ -25,19 +25,29 @@
 #include "util/WritableBuffer.hxx"
 #include "util/Domain.hxx"
 #include "util/RuntimeError.hxx"
+#include "util/ScopeExit.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 #include "Log.hxx"
 
 #include "sunvox.h"
 
-#include <stdlib.h>
-#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
 #include <assert.h>
 
-#define SUNVOX_PLAY_SLOT 0
-#define SUNVOX_SCAN_SLOT 1
+/**
+ * The number of slots supported by libsunvox.
+ */
+static constexpr unsigned SUNVOX_MAX_SLOTS = 16;
 
-int g_sv_channels_num = 2; //1 - mono; 2 - stereo
-int g_sv_buffer_size = 4096; //Audio buffer size (number of frames)
+static constexpr unsigned SUNVOX_CHANNELS = 2;
+
+/**
+ * The number of frames rendered by one sv_audio_callback() call.
+ */
+static constexpr size_t SUNVOX_BUFFER_FRAMES = 2048;
 
 static constexpr size_t SUNVOX_PREALLOC_BLOCK = 256 * 1024;
 static constexpr offset_type SUNVOX_FILE_LIMIT = 100 * 1024 * 1024;
@@ -45,6 +55,129 @@ static constexpr offset_type SUNVOX_FILE_LIMIT = 100 * 1024 * 1024;
 static constexpr Domain sun_domain("sunvox");
 static int sunvox_sample_rate = 44100;
 
+/**
+ * Manages the slots of the global SunVox engine.  Each decoder and
+ * each tag scanner leases a slot of its own, so they do not share
+ * state and may run in parallel.
+ */
+class SunvoxSlotPool {
+	Mutex mutex;
+
+	/**
+	 * Signalled when #playing is cleared.
+	 */
+	Cond cond;
+
+	unsigned n_slots = 0;
+
+	bool busy[SUNVOX_MAX_SLOTS] = {};
+
+	/**
+	 * Is a slot being played?  sv_audio_callback() renders the
+	 * output of the whole engine, i.e. of all playing slots mixed
+	 * together, therefore only one of them may be playing.
+	 */
+	bool playing = false;
+
+public:
+	void SetSize(unsigned _n_slots) noexcept {
+		assert(_n_slots >= 1 && _n_slots <= SUNVOX_MAX_SLOTS);
+
+		n_slots = _n_slots;
+	}
+
+	/**
+	 * Open a free slot.
+	 *
+	 * @return the slot number or -1 if all slots are in use
+	 */
+	int Open() noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+
+		for (unsigned i = 0; i < n_slots; ++i) {
+			if (busy[i])
+				continue;
+
+			if (sv_open_slot(i) < 0)
+				return -1;
+
+			busy[i] = true;
+			return i;
+		}
+
+		return -1;
+	}
+
+	void Close(int slot) noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+
+		assert(busy[slot]);
+
+		sv_close_slot(slot);
+		busy[slot] = false;
+	}
+
+	/**
+	 * Obtain the permission to play a slot.  If another slot is
+	 * being played (e.g. the current song while this one is
+	 * being decoded ahead, see "decoder_lookahead"), wait until
+	 * it is finished.
+	 *
+	 * @return false if the decoder was stopped while waiting
+	 */
+	bool StartPlaying(DecoderClient &client) noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+
+		while (playing) {
+			/* the #DecoderClient has no way to wake us up,
+			   so check for STOP periodically */
+			if (client.GetCommand() == DecoderCommand::STOP)
+				return false;
+
+			cond.timed_wait(mutex, std::chrono::milliseconds(100));
+		}
+
+		playing = true;
+		return true;
+	}
+
+	void StopPlaying() noexcept {
+		const std::lock_guard<Mutex> protect(mutex);
+
+		assert(playing);
+		playing = false;
+		cond.signal();
+	}
+};
+
+static SunvoxSlotPool sunvox_slots;
+
+/**
+ * A slot leased from #sunvox_slots for the lifetime of this object.
+ */
+class SunvoxSlot {
+	const int slot;
+
+public:
+	SunvoxSlot() noexcept:slot(sunvox_slots.Open()) {}
+
+	~SunvoxSlot() noexcept {
+		if (IsDefined())
+			sunvox_slots.Close(slot);
+	}
+
+	SunvoxSlot(const SunvoxSlot &) = delete;
+	SunvoxSlot &operator=(const SunvoxSlot &) = delete;
+
+	bool IsDefined() const noexcept {
+		return slot >= 0;
+	}
+
+	operator int() const noexcept {
+		return slot;
+	}
+};
+
 static bool
 sunvox_decoder_init(const ConfigBlock &block)
 {
@@ -56,7 +189,15 @@ sunvox_decoder_init(const ConfigBlock &block)
 	}*/
 	
 	sunvox_sample_rate = block.GetBlockValue("svsamplerate", sunvox_sample_rate);
-	const unsigned int flags = SV_INIT_FLAG_USER_AUDIO_CALLBACK | SV_INIT_FLAG_AUDIO_INT16;
+
+	const unsigned n_slots = block.GetBlockValue("slots", 4u);
+	if (n_slots < 1 || n_slots > SUNVOX_MAX_SLOTS)
+		throw FormatRuntimeError("Invalid number of SunVox slots: %u",
+					 n_slots);
+
+	sunvox_slots.SetSize(n_slots);
+
+	const unsigned int flags = SV_INIT_FLAG_USER_AUDIO_CALLBACK | SV_INIT_FLAG_AUDIO_FLOAT32;
 	 int ver = sv_init( 0, sunvox_sample_rate, 2, flags );
     if( ver >= 0 )
     {
@@ -72,6 +213,12 @@ sunvox_decoder_init(const ConfigBlock &block)
 	return true;
 }
 
+static void
+sunvox_decoder_finish() noexcept
+{
+	sv_deinit();
+}
+
 static WritableBuffer<uint8_t>
 sun_loadfile(DecoderClient *client, InputStream &is)
 {
@@ -147,93 +294,305 @@ LoadSunVoxFile(DecoderClient *client, InputStream &is, int slot)
 	return f;
 }
 
+/**
+ * The song's tempo, used to convert between line numbers and frames.
+ */
+class SunvoxTempo {
+	/**
+	 * The length of one line in frames, as a fraction.
+	 */
+	uint64_t line_num = 0, line_den = 1;
+
+	/**
+	 * Does the whole song play at the initial tempo?
+	 */
+	bool constant = false;
+
+public:
+	SunvoxTempo(int slot, unsigned sample_rate) noexcept {
+		const int bpm = sv_get_song_bpm(slot);
+		const int tpl = sv_get_song_tpl(slot);
+		if (bpm <= 0 || tpl <= 0)
+			return;
+
+		/* a line lasts "tpl" ticks, and there are bpm*24/60
+		   ticks per second */
+		line_num = uint64_t(sample_rate) * tpl * 5;
+		line_den = uint64_t(bpm) * 2;
+
+		/* if the length in frames calculated by libsunvox
+		   (which applies all tempo changes) matches the
+		   length in lines at the initial tempo, the tempo
+		   must be constant */
+		const uint64_t length_frames = sv_get_song_length_frames(slot);
+		const uint64_t expected =
+			LineToFrame(sv_get_song_length_lines(slot));
+		const uint64_t difference = length_frames > expected
+			? length_frames - expected
+			: expected - length_frames;
+		constant = difference <= LineToFrame(1);
+	}
+
+	bool IsConstant() const noexcept {
+		return constant;
+	}
+
+	uint64_t LineToFrame(uint64_t line) const noexcept {
+		return line * line_num / line_den;
+	}
+
+	uint64_t FrameToLine(uint64_t frame) const noexcept {
+		return frame * line_den / line_num;
+	}
+};
+
+/**
+ * The first frame of each line, learned while the song is being
+ * played from the beginning.  This is the tempo map for songs whose
+ * tempo changes (see SunvoxTempo::IsConstant()).
+ *
+ * libsunvox reports the current line only with a resolution of 1/32
+ * line (sv_get_current_line2()), and since each buffer is rendered
+ * with the current time as its output time, the report refers to the
+ * beginning of the buffer rendered last.  The frame of a line is
+ * interpolated between two such reports.
+ */
+class SunvoxLineMap {
+	/**
+	 * The first frame of each line which has been reached.
+	 */
+	std::vector<uint64_t> line_frames{0};
+
+	/**
+	 * The last report: the frame where the last buffer began and
+	 * the line number (27.5 fixed point) at this frame.
+	 */
+	uint64_t last_frame = 0;
+	int last_line2 = 0;
+
+	/**
+	 * Is the map still being extended?  This is only possible as
+	 * long as the position is exact, i.e. until it is rewound to
+	 * a line whose frame has been interpolated.
+	 */
+	bool recording = true;
+
+public:
+	struct Position {
+		unsigned line;
+		uint64_t frame;
+	};
+
+	/**
+	 * Record the line libsunvox reports after rendering a buffer
+	 * which began at the given frame.
+	 */
+	void Observe(uint64_t frame, int line2) noexcept {
+		if (!recording || frame <= last_frame)
+			return;
+
+		if (line2 < last_line2) {
+			/* the song has wrapped around */
+			recording = false;
+			return;
+		}
+
+		for (uint64_t line = line_frames.size();
+		     line * 32 <= uint64_t(line2); ++line) {
+			const uint64_t delta = line * 32 - last_line2;
+			line_frames.push_back(last_frame +
+					      delta * (frame - last_frame) /
+					      (line2 - last_line2));
+		}
+
+		last_frame = frame;
+		last_line2 = line2;
+	}
+
+	void StopRecording() noexcept {
+		recording = false;
+	}
+
+	/**
+	 * Find the last known line beginning at or before the given
+	 * frame.
+	 */
+	gcc_pure
+	Position Find(uint64_t frame) const noexcept {
+		const auto i = std::upper_bound(line_frames.begin(),
+						line_frames.end(), frame);
+		assert(i != line_frames.begin());
+
+		const unsigned line = std::distance(line_frames.begin(), i) - 1;
+		return {line, line_frames[line]};
+	}
+};
+
+/**
+ * Renders a SunVox song and keeps track of the position.
+ */
+class SunvoxPlayer {
+	const int slot;
+
+	const SunvoxTempo tempo;
+
+	SunvoxLineMap line_map;
+
+	/**
+	 * The current position in frames.
+	 */
+	uint64_t position = 0;
+
+public:
+	SunvoxPlayer(int _slot, unsigned sample_rate) noexcept
+		:slot(_slot), tempo(_slot, sample_rate) {}
+
+	uint64_t GetPosition() const noexcept {
+		return position;
+	}
+
+	void Render(float *dest, size_t n_frames) noexcept {
+		sv_audio_callback(dest, n_frames, 0, sv_get_ticks());
+
+		if (!tempo.IsConstant())
+			line_map.Observe(position, sv_get_current_line2(slot));
+
+		position += n_frames;
+	}
+
+	/**
+	 * Seek to the given frame: rewind to the beginning of the
+	 * line containing it (for songs with tempo changes, only for
+	 * backward seeks, and only to a line which has been played
+	 * already), and render and discard the frames up to the
+	 * target.
+	 *
+	 * The result is approximate: the frame of the line rewound to
+	 * is calculated from the initial tempo, or, for songs with
+	 * tempo changes, interpolated by #SunvoxLineMap.  Either may
+	 * be off by a few frames (up to #SUNVOX_BUFFER_FRAMES with
+	 * tempo changes), and #position is not corrected for that.
+	 *
+	 * @param buffer a buffer for #SUNVOX_BUFFER_FRAMES frames
+	 */
+	void Seek(uint64_t target, float *buffer) noexcept;
+};
+
+void
+SunvoxPlayer::Seek(uint64_t target, float *buffer) noexcept
+{
+	if (tempo.IsConstant()) {
+		const uint64_t line = tempo.FrameToLine(target);
+		sv_rewind(slot, line);
+		position = tempo.LineToFrame(line);
+	} else if (target < position) {
+		const auto p = line_map.Find(target);
+		sv_rewind(slot, p.line);
+		position = p.frame;
+
+		if (p.line > 0)
+			line_map.StopRecording();
+	}
+
+	/* resume after the end of the song has been reached */
+	sv_play(slot);
+
+	while (position < target)
+		Render(buffer, std::min<uint64_t>(SUNVOX_BUFFER_FRAMES,
+						  target - position));
+}
+
 static void
 sun_decode(DecoderClient &client, InputStream &is)
 {
-	signed int * audio_buffer = (signed int*)malloc( g_sv_buffer_size * 2 * sizeof( signed int ) ); ;
-	sv_open_slot( SUNVOX_PLAY_SLOT );
-	bool couldLoad = LoadSunVoxFile(&client, is, SUNVOX_PLAY_SLOT);
+	const SunvoxSlot slot;
+	if (!slot.IsDefined()) {
+		LogWarning(sun_domain, "No free SunVox slot");
+		return;
+	}
+
+	bool couldLoad = LoadSunVoxFile(&client, is, slot);
 	if(!couldLoad) {
 		LogWarning(sun_domain, "could not decode stream!");
-		sv_close_slot( SUNVOX_PLAY_SLOT );
 		return;
 	}
-	static AudioFormat audio_format(sunvox_sample_rate, SampleFormat::S16, 2);
+
+	if (!sunvox_slots.StartPlaying(client))
+		return;
+
+	AtScopeExit() { sunvox_slots.StopPlaying(); };
+
+	const AudioFormat audio_format(sunvox_sample_rate, SampleFormat::FLOAT,
+				       SUNVOX_CHANNELS);
 	assert(audio_format.IsValid());
-	
-	unsigned long frameCount = sv_get_song_length_frames( SUNVOX_PLAY_SLOT );
-	unsigned long msecs = ((frameCount*1000) / sunvox_sample_rate);
-	//printf("From %lu frames at %i Hz -> %lu msec\n", frameCount, sunvox_sample_rate, msecs);
-	client.Ready(audio_format, true /*canSeek*/,
-		     SongTime::FromMS(msecs));
-		     
-	sv_set_autostop(SUNVOX_PLAY_SLOT,1);
-	sv_play_from_beginning(SUNVOX_PLAY_SLOT);
-		     
+	const size_t frame_size = audio_format.GetFrameSize();
+
+	const uint64_t song_frames = sv_get_song_length_frames(slot);
+	client.Ready(audio_format, true,
+		     SongTime::FromScale<uint64_t>(song_frames,
+						   sunvox_sample_rate));
+
+	SunvoxPlayer player(slot, sunvox_sample_rate);
+
+	sv_set_autostop(slot, 1);
+	sv_play_from_beginning(slot);
+
+	float buffer[SUNVOX_BUFFER_FRAMES * SUNVOX_CHANNELS];
+
 	DecoderCommand cmd;
-	unsigned int t =0 ;
 	do {
-		
-		 t= sv_get_ticks();
-		sv_audio_callback( audio_buffer, g_sv_buffer_size/2, 0, t );
-		cmd = client.SubmitData(nullptr,
-					audio_buffer, g_sv_buffer_size*2,
-					0);
+		/* stop at the length announced by Ready(), even if
+		   libsunvox has more to render (e.g. the release of
+		   the last notes) */
+		const uint64_t position = player.GetPosition();
+		if (position >= song_frames)
+			break;
+
+		size_t n = std::min<uint64_t>(SUNVOX_BUFFER_FRAMES,
+					      song_frames - position);
+
+		/* render directly into the music pipe if possible */
+		const auto w = client.GetWriteBuffer(nullptr);
+		if (!w.empty()) {
+			n = std::min(n, w.size / frame_size);
+			player.Render((float *)w.data, n);
+
+			cmd = client.CommitData(n * frame_size, 0);
+		} else {
+			player.Render(buffer, n);
+
+			cmd = client.SubmitData(nullptr, buffer, n * frame_size,
+						0);
+		}
+
 		if (cmd == DecoderCommand::SEEK) {
-			
-			unsigned int seekpos =  client.GetSeekTime().ToMS()/1000;
-			printf("Want to seek at %u", seekpos);
-			unsigned int line_pos = 0;
-			
-			unsigned int ticks_per_sec = sv_get_ticks_per_second()/1000;
-			printf(" -> at %u TPS", ticks_per_sec);
-			unsigned int ticks_per_line = sv_get_song_tpl( SUNVOX_PLAY_SLOT );
-			printf(" and %u TPL", ticks_per_line);
-			
-			unsigned int lines_per_sec = ticks_per_sec / ticks_per_line;
-			printf(" -> LPS: %u", lines_per_sec);
-			
-			
-			line_pos = seekpos * lines_per_sec;
-			printf(" -> goto %u\n", line_pos);
-			
-			sv_rewind( SUNVOX_PLAY_SLOT, line_pos );
-			sv_play (SUNVOX_PLAY_SLOT);
-			
+			player.Seek(client.GetSeekFrame(), buffer);
 			client.CommandFinished();
-		} 
-		if(sv_end_of_song(SUNVOX_PLAY_SLOT) && t > 0) {
-				// there may be some buffer left
-				usleep( 500000 * g_sv_buffer_size / sunvox_sample_rate);
-			break;
+			cmd = DecoderCommand::NONE;
 		}
 	} while (cmd != DecoderCommand::STOP);
-	
-	sv_stop ( SUNVOX_PLAY_SLOT );
-	sv_close_slot( SUNVOX_PLAY_SLOT );
+
+	sv_stop(slot);
 }
 
 static bool
 sunvox_scan_stream(InputStream &is, TagHandler &handler) noexcept
 {
-	sv_open_slot(SUNVOX_SCAN_SLOT);
-	bool couldLoad = LoadSunVoxFile(nullptr, is, SUNVOX_SCAN_SLOT);
-	if (!couldLoad) {
-		sv_close_slot(SUNVOX_SCAN_SLOT);
+	const SunvoxSlot slot;
+	if (!slot.IsDefined())
 		return false;
-	}
-	
-	unsigned long frameCount = sv_get_song_length_frames( SUNVOX_SCAN_SLOT );
-	unsigned long msecs = ((frameCount*1000) / sunvox_sample_rate);
 
-	handler.OnDuration(SongTime::FromMS(msecs));
+	bool couldLoad = LoadSunVoxFile(nullptr, is, slot);
+	if (!couldLoad)
+		return false;
+	
+	handler.OnDuration(SongTime::FromScale<uint64_t>(sv_get_song_length_frames(slot),
+							 sunvox_sample_rate));
 
-	const char *title = sv_get_song_name( SUNVOX_SCAN_SLOT );
+	const char *title = sv_get_song_name( slot );
 	if (title != nullptr)
 		handler.OnTag(TAG_TITLE, title);
 
-	sv_close_slot( SUNVOX_SCAN_SLOT );
-
 	return true;
 }
 
@@ -245,7 +604,7 @@ static const char *const sun_suffixes[] = {
 const struct DecoderPlugin sunvox_decoder_plugin = {
 	"sunvox",
 	sunvox_decoder_init,
-	nullptr,
+	sunvox_decoder_finish,
 	sun_decode,
 	nullptr,
 	nullptr,
@@ -22,6 +22,7 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
+#include "pcm/Interleave.hxx"
 #include "tag/Handler.hxx"
 #include "fs/Path.hxx"
 #include "util/Macros.hxx"
@@ -141,6 +142,16 @@ format_samples_int(void *buffer, uint32_t count)
 	std::copy_n(src, count, dst);
 }
 
+/*
+ * Convert 16 bit samples; this is the most common format, and
+ * PcmNarrow16() has a SIMD implementation.
+ */
+static void
+format_samples_16(void *buffer, uint32_t count)
+{
+	PcmNarrow16((int16_t *)buffer, (const int32_t *)buffer, count);
+}
+
 /*
  * No conversion necessary.
  */
@@ -226,7 +237,7 @@ wavpack_decode(DecoderClient &client, WavpackContext *wpc, bool can_seek)
 			break;
 
 		case 2:
-			format_samples = format_samples_int<int16_t>;
+			format_samples = format_samples_16;
 			break;
 		}
 	}
@@ -239,6 +250,8 @@ wavpack_decode(DecoderClient &client, WavpackContext *wpc, bool can_seek)
 	int32_t chunk[1024];
 	const uint32_t samples_requested = ARRAY_SIZE(chunk) /
 		audio_format.channels;
+	const size_t unpack_frame_size =
+		sizeof(chunk[0]) * audio_format.channels;
 
 	DecoderCommand cmd = client.GetCommand();
 	while (cmd != DecoderCommand::STOP) {
@@ -262,18 +275,32 @@ wavpack_decode(DecoderClient &client, WavpackContext *wpc, bool can_seek)
 			}
 		}
 
-		uint32_t samples_got = WavpackUnpackSamples(wpc, chunk,
-							    samples_requested);
+		/* unpack directly into the music pipe if the buffer
+		   is suitably aligned for the 32 bit samples; they
+		   are narrowed in place */
+		auto w = client.GetWriteBuffer(nullptr);
+		const bool direct = w.size >= unpack_frame_size &&
+			uintptr_t(w.data) % alignof(int32_t) == 0;
+		int32_t *dest = direct ? (int32_t *)w.data : chunk;
+
+		uint32_t samples_got =
+			WavpackUnpackSamples(wpc, dest,
+					     direct
+					     ? w.size / unpack_frame_size
+					     : samples_requested);
 		if (samples_got == 0)
 			break;
 
 		int bitrate = (int)(WavpackGetInstantBitrate(wpc) / 1000 +
 				    0.5);
-		format_samples(chunk, samples_got * audio_format.channels);
-
-		cmd = client.SubmitData(nullptr, chunk,
-					samples_got * output_sample_size,
-					bitrate);
+		format_samples(dest, samples_got * audio_format.channels);
+
+		cmd = direct
+			? client.CommitData(samples_got * output_sample_size,
+					    bitrate)
+			: client.SubmitData(nullptr, chunk,
+					    samples_got * output_sample_size,
+					    bitrate);
 	}
 }
 
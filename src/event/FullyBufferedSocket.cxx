@@ -20,11 +20,17 @@
 #include "config.h"
 #include "FullyBufferedSocket.hxx"
 #include "net/SocketError.hxx"
+#include "system/FileDescriptor.hxx"
 #include "util/Compiler.h"
 
 #include <assert.h>
 #include <string.h>
 
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <errno.h>
+#endif
+
 FullyBufferedSocket::ssize_t
 FullyBufferedSocket::DirectWrite(const void *data, size_t length) noexcept
 {
@@ -72,6 +78,46 @@ FullyBufferedSocket::Flush() noexcept
 	return true;
 }
 
+#ifdef __linux__
+
+FullyBufferedSocket::ssize_t
+FullyBufferedSocket::SendFile(FileDescriptor file, off_t offset,
+			      size_t length) noexcept
+{
+	assert(IsDefined());
+
+	if (!output.empty()) {
+		/* the file contents must not overtake pending
+		   output */
+		if (!Flush())
+			return -1;
+
+		if (!output.empty())
+			return 0;
+	}
+
+	const auto nbytes = sendfile(GetSocket().Get(), file.Get(),
+				     &offset, length);
+	if (gcc_unlikely(nbytes < 0)) {
+		const int code = errno;
+		if (IsSocketErrorClosed(code)) {
+			IdleMonitor::Cancel();
+			BufferedSocket::Cancel();
+			OnSocketClosed();
+			return -1;
+		}
+
+		/* EAGAIN, or the file does not support sendfile()
+		   (EINVAL, ENOSYS); let the caller fall back to
+		   copying */
+		return 0;
+	}
+
+	return nbytes;
+}
+
+#endif
+
 bool
 FullyBufferedSocket::Write(const void *data, size_t length) noexcept
 {
@@ -101,6 +147,9 @@ FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 
 		if (!Flush())
 			return false;
+
+		if (output.empty())
+			OnSocketOutputDrained();
 	}
 
 	if (!BufferedSocket::OnSocketReady(flags))
@@ -112,6 +161,11 @@ FullyBufferedSocket::OnSocketReady(unsigned flags) noexcept
 void
 FullyBufferedSocket::OnIdle() noexcept
 {
-	if (Flush() && !output.empty())
+	if (!Flush())
+		return;
+
+	if (output.empty())
+		OnSocketOutputDrained();
+	else
 		ScheduleWrite();
 }
@@ -25,6 +25,10 @@
 #include "IdleMonitor.hxx"
 #include "util/PeakBuffer.hxx"
 
+#include <sys/types.h>
+
+class FileDescriptor;
+
 /**
  * A #BufferedSocket specialization that adds an output buffer.
  */
@@ -61,6 +65,31 @@ protected:
 	 */
 	bool Write(const void *data, size_t length) noexcept;
 
+#ifdef __linux__
+	/**
+	 * Send a portion of a file directly to the socket with
+	 * sendfile(), bypassing the output buffer.  Before that, the
+	 * output buffer is flushed; if that is not possible
+	 * completely, nothing is sent.
+	 *
+	 * @return the number of bytes sent (0 if the socket is not
+	 * ready or if sendfile() is not supported for this file), or
+	 * -1 if the socket has been closed
+	 */
+	ssize_t SendFile(FileDescriptor file, off_t offset,
+			 size_t length) noexcept;
+#endif
+
+	bool IsOutputEmpty() const noexcept {
+		return output.empty();
+	}
+
+	/**
+	 * The output buffer has been sent completely.  The method may
+	 * call Write(), but it must not destroy the object.
+	 */
+	virtual void OnSocketOutputDrained() noexcept {}
+
 	/* virtual methods from class SocketMonitor */
 	bool OnSocketReady(unsigned flags) noexcept override;
 
@@ -153,6 +153,10 @@ EventLoop::Run() noexcept
 		SocketMonitor::Cancel();
 	};
 
+	/* the time when the current iteration has started; that is
+	   when the loop was woken up */
+	auto busy_since = std::chrono::steady_clock::now();
+
 	do {
 		now = std::chrono::steady_clock::now();
 		again = false;
@@ -190,9 +194,11 @@ EventLoop::Run() noexcept
 
 		/* wait for new event */
 
+		busy_time.Add(std::chrono::steady_clock::now() - busy_since);
+
 		poll_group.ReadEvents(poll_result, ExportTimeoutMS(timeout));
 
-		now = std::chrono::steady_clock::now();
+		busy_since = now = std::chrono::steady_clock::now();
 
 		{
 			const std::lock_guard<Mutex> lock(mutex);
@@ -22,6 +22,7 @@
 
 #include "check.h"
 #include "thread/Id.hxx"
+#include "util/LatencyHistogram.hxx"
 #include "util/Compiler.h"
 
 #include "PollGroup.hxx"
@@ -110,6 +111,12 @@ class EventLoop final : SocketMonitor
 	PollGroup poll_group;
 	PollResult poll_result;
 
+	/**
+	 * The duration of each iteration of Run(), excluding the time
+	 * spent waiting for events.
+	 */
+	LatencyHistogram busy_time;
+
 	/**
 	 * A reference to the thread that is currently inside Run().
 	 */
@@ -125,6 +132,10 @@ public:
 
 	~EventLoop() noexcept;
 
+	const LatencyHistogram &GetBusyTime() const noexcept {
+		return busy_time;
+	}
+
 	/**
 	 * A caching wrapper for std::chrono::steady_clock::now().
 	 */
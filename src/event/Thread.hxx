@@ -47,6 +47,10 @@ public:
 		return event_loop;
 	}
 
+	const EventLoop &GetEventLoop() const noexcept {
+		return event_loop;
+	}
+
 	void Start();
 
 	void Stop() noexcept;
@@ -50,8 +50,11 @@ class GzipOutputStream final : public OutputStream {
 public:
 	/**
 	 * Construct the filter.
+	 *
+	 * @param level the zlib compression level
 	 */
-	explicit GzipOutputStream(OutputStream &_next);
+	explicit GzipOutputStream(OutputStream &_next,
+				  int level=Z_DEFAULT_COMPRESSION);
 	~GzipOutputStream();
 
 	/**
@@ -60,6 +63,13 @@ public:
 	 */
 	void Flush();
 
+	/**
+	 * Write all data remaining in zlib's output buffer, aligned
+	 * to a byte boundary, so the receiver can decompress
+	 * everything written so far.  The stream remains open.
+	 */
+	void SyncFlush();
+
 	/* virtual methods from class OutputStream */
 	void Write(const void *data, size_t size) override;
 };
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CancellableInputStream.hxx"
+
+#include <stdexcept>
+
+void
+CancellableInputStream::WaitReady()
+{
+	while (true) {
+		Check();
+
+		Update();
+		if (IsReady())
+			break;
+
+		cancellation.cond.wait(mutex);
+	}
+}
+
+void
+CancellableInputStream::Check()
+{
+	if (cancellation.cancelled)
+		throw std::runtime_error("Cancelled");
+
+	ProxyInputStream::Check();
+}
+
+void
+CancellableInputStream::Seek(offset_type new_offset)
+{
+	Check();
+
+	ProxyInputStream::Seek(new_offset);
+}
+
+size_t
+CancellableInputStream::Read(void *ptr, size_t read_size)
+{
+	while (true) {
+		Check();
+
+		if (input->IsAvailable())
+			break;
+
+		cancellation.cond.wait(mutex);
+	}
+
+	return ProxyInputStream::Read(ptr, read_size);
+}
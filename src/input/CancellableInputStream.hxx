@@ -0,0 +1,97 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CANCELLABLE_INPUT_STREAM_HXX
+#define MPD_CANCELLABLE_INPUT_STREAM_HXX
+
+#include "check.h"
+#include "ProxyInputStream.hxx"
+#include "thread/Cond.hxx"
+
+/**
+ * The cancellation state of one or more #CancellableInputStream
+ * instances.  It is owned by the caller, and thus remains valid
+ * while another thread destroys the stream.  All attributes are
+ * protected by the streams' mutex.
+ */
+struct InputStreamCancellation {
+	/**
+	 * Signalled when the stream becomes ready or available, or
+	 * when #cancelled is set.
+	 */
+	Cond cond;
+
+	bool cancelled = false;
+
+	/**
+	 * Wake up all threads waiting for the stream, and make all
+	 * further operations fail.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void Cancel() noexcept {
+		cancelled = true;
+		cond.broadcast();
+	}
+};
+
+/**
+ * A proxy whose blocking operations can be aborted by another
+ * thread: after InputStreamCancellation::Cancel(), WaitReady() and
+ * Read() throw instead of waiting for the inner stream.  It waits
+ * for data itself (with IsAvailable()), so the inner stream never
+ * blocks in Read().
+ */
+class CancellableInputStream final : public ProxyInputStream {
+	InputStreamCancellation &cancellation;
+
+public:
+	CancellableInputStream(InputStreamPtr _input,
+			       InputStreamCancellation &_cancellation) noexcept
+		:ProxyInputStream(std::move(_input)),
+		 cancellation(_cancellation) {}
+
+	/**
+	 * Wait until the stream becomes ready.
+	 *
+	 * Caller must lock the mutex.
+	 *
+	 * Throws on error or if the stream has been cancelled.
+	 */
+	void WaitReady();
+
+	/* virtual methods from class InputStream */
+	void Check() override;
+	void Seek(offset_type new_offset) override;
+	size_t Read(void *ptr, size_t read_size) override;
+
+protected:
+	/* virtual methods from class InputStreamHandler */
+	void OnInputStreamReady() noexcept override {
+		cancellation.cond.broadcast();
+		ProxyInputStream::OnInputStreamReady();
+	}
+
+	void OnInputStreamAvailable() noexcept override {
+		cancellation.cond.broadcast();
+		ProxyInputStream::OnInputStreamAvailable();
+	}
+};
+
+#endif
@@ -22,6 +22,8 @@
 
 #include <stdexcept>
 
+std::atomic<uint64_t> audio_output_underruns;
+
 void
 AudioOutput::SetAttribute(gcc_unused std::string &&name,
 			  gcc_unused std::string &&value)
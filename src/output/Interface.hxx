@@ -20,14 +20,22 @@
 #ifndef MPD_AUDIO_OUTPUT_INTERFACE_HXX
 #define MPD_AUDIO_OUTPUT_INTERFACE_HXX
 
+#include <atomic>
 #include <map>
 #include <string>
 #include <chrono>
 #include <stdexcept>
 
+#include <stdint.h>
+
 struct AudioFormat;
 struct Tag;
 
+/**
+ * The number of buffer underruns reported by output plugins.
+ */
+extern std::atomic<uint64_t> audio_output_underruns;
+
 class AudioOutput {
 	const unsigned flags;
 
@@ -666,6 +666,7 @@ inline int
 AlsaOutput::Recover(int err) noexcept
 {
 	if (err == -EPIPE) {
+		++audio_output_underruns;
 		FormatDebug(alsa_output_domain,
 			    "Underrun on ALSA device \"%s\"",
 			    GetDevice());
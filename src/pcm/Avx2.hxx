@@ -0,0 +1,141 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_AVX2_HXX
+#define MPD_PCM_AVX2_HXX
+
+#include "util/Compiler.h"
+
+#include <immintrin.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Most AVX2 instructions operate on the two 128 bit lanes separately;
+ * the results are put in order with _mm256_permute2x128_si256() or
+ * _mm256_permute4x64_epi64().
+ */
+
+/**
+ * Interleave two channels of 32 bit samples using AVX2.
+ */
+struct Avx2InterleaveStereo32 {
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	void InterleaveStereo(int32_t *gcc_restrict dest,
+			      const int32_t *gcc_restrict src1,
+			      const int32_t *gcc_restrict src2,
+			      size_t n_frames) const noexcept {
+		for (size_t i = 0; i < n_frames / BLOCK_SIZE;
+		     ++i, src1 += BLOCK_SIZE, src2 += BLOCK_SIZE,
+			     dest += 2 * BLOCK_SIZE) {
+			const __m256i a = _mm256_loadu_si256((const __m256i *)src1);
+			const __m256i b = _mm256_loadu_si256((const __m256i *)src2);
+
+			/* L0 R0 L1 R1 | L4 R4 L5 R5 */
+			const __m256i lo = _mm256_unpacklo_epi32(a, b);
+			/* L2 R2 L3 R3 | L6 R6 L7 R7 */
+			const __m256i hi = _mm256_unpackhi_epi32(a, b);
+
+			_mm256_storeu_si256((__m256i *)dest,
+					    _mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i *)dest + 1,
+					    _mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+	}
+};
+
+/**
+ * Interleave two channels of 16 bit samples using AVX2.
+ */
+struct Avx2InterleaveStereo16 {
+	static constexpr size_t BLOCK_SIZE = 16;
+
+	void InterleaveStereo(int16_t *gcc_restrict dest,
+			      const int16_t *gcc_restrict src1,
+			      const int16_t *gcc_restrict src2,
+			      size_t n_frames) const noexcept {
+		for (size_t i = 0; i < n_frames / BLOCK_SIZE;
+		     ++i, src1 += BLOCK_SIZE, src2 += BLOCK_SIZE,
+			     dest += 2 * BLOCK_SIZE) {
+			const __m256i a = _mm256_loadu_si256((const __m256i *)src1);
+			const __m256i b = _mm256_loadu_si256((const __m256i *)src2);
+
+			const __m256i lo = _mm256_unpacklo_epi16(a, b);
+			const __m256i hi = _mm256_unpackhi_epi16(a, b);
+
+			_mm256_storeu_si256((__m256i *)dest,
+					    _mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i *)dest + 1,
+					    _mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+	}
+};
+
+/**
+ * Interleave two channels of 32 bit samples which are known to be in
+ * the 16 bit range, and narrow them to 16 bit using AVX2.
+ */
+struct Avx2InterleaveNarrowStereo16 {
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	void InterleaveStereo(int16_t *gcc_restrict dest,
+			      const int32_t *gcc_restrict src1,
+			      const int32_t *gcc_restrict src2,
+			      size_t n_frames) const noexcept {
+		for (size_t i = 0; i < n_frames / BLOCK_SIZE;
+		     ++i, src1 += BLOCK_SIZE, src2 += BLOCK_SIZE,
+			     dest += 2 * BLOCK_SIZE) {
+			const __m256i a = _mm256_loadu_si256((const __m256i *)src1);
+			const __m256i b = _mm256_loadu_si256((const __m256i *)src2);
+
+			/* the lane-wise pack restores the frame
+			   order: L0 R0 .. L3 R3 | L4 R4 .. L7 R7 */
+			_mm256_storeu_si256((__m256i *)dest,
+					    _mm256_packs_epi32(_mm256_unpacklo_epi32(a, b),
+							       _mm256_unpackhi_epi32(a, b)));
+		}
+	}
+};
+
+/**
+ * Narrow 32 bit samples which are known to be in the 16 bit range to
+ * 16 bit using AVX2.  Each block is loaded completely before it is
+ * stored, therefore #dest may be equal to #src.
+ */
+struct Avx2Narrow16 {
+	static constexpr size_t BLOCK_SIZE = 16;
+
+	void Narrow(int16_t *dest, const int32_t *src,
+		    size_t n) const noexcept {
+		for (size_t i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+			const __m256i a = _mm256_loadu_si256((const __m256i *)src);
+			const __m256i b = _mm256_loadu_si256((const __m256i *)src + 1);
+
+			/* a0-3 b0-3 | a4-7 b4-7 -> a0-7 b0-7 */
+			const __m256i packed = _mm256_packs_epi32(a, b);
+			_mm256_storeu_si256((__m256i *)dest,
+					    _mm256_permute4x64_epi64(packed, 0xd8));
+		}
+	}
+};
+
+#endif
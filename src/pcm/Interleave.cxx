@@ -22,6 +22,25 @@
 
 #include <string.h>
 
+#if defined(__AVX2__)
+#include "Avx2.hxx"
+
+typedef Avx2InterleaveStereo16 OptimizedInterleaveStereo16;
+typedef Avx2InterleaveStereo32 OptimizedInterleaveStereo32;
+typedef Avx2InterleaveNarrowStereo16 OptimizedInterleaveNarrowStereo16;
+typedef Avx2Narrow16 OptimizedNarrow16;
+#define HAVE_OPTIMIZED_INTERLEAVE
+
+#elif defined(__SSE2__)
+#include "Sse2.hxx"
+
+typedef Sse2InterleaveStereo16 OptimizedInterleaveStereo16;
+typedef Sse2InterleaveStereo32 OptimizedInterleaveStereo32;
+typedef Sse2InterleaveNarrowStereo16 OptimizedInterleaveNarrowStereo16;
+typedef Sse2Narrow16 OptimizedNarrow16;
+#define HAVE_OPTIMIZED_INTERLEAVE
+#endif
+
 static void
 GenericPcmInterleave(uint8_t *gcc_restrict dest,
 		     ConstBuffer<const uint8_t *> src,
@@ -36,23 +55,86 @@ GenericPcmInterleave(uint8_t *gcc_restrict dest,
 	}
 }
 
-template<typename T>
+template<typename D, typename S>
 static void
-PcmInterleaveStereo(T *gcc_restrict dest,
-		    const T *gcc_restrict src1,
-		    const T *gcc_restrict src2,
-		    size_t n_frames) noexcept
+PortableInterleaveStereo(D *gcc_restrict dest,
+			 const S *gcc_restrict src1,
+			 const S *gcc_restrict src2,
+			 size_t n_frames) noexcept
 {
 	for (size_t i = 0; i != n_frames; ++i) {
-		*dest++ = *src1++;
-		*dest++ = *src2++;
+		*dest++ = D(*src1++);
+		*dest++ = D(*src2++);
 	}
 }
 
-template<typename T>
+#ifdef HAVE_OPTIMIZED_INTERLEAVE
+
+/**
+ * Interleave complete blocks with the #Optimized implementation and
+ * the trailing frames with the portable one.
+ */
+template<typename Optimized, typename D, typename S>
 static void
-PcmInterleaveT(T *gcc_restrict dest,
-	       const ConstBuffer<const T *> src,
+GlueInterleaveStereo(D *gcc_restrict dest,
+		     const S *gcc_restrict src1,
+		     const S *gcc_restrict src2,
+		     size_t n_frames) noexcept
+{
+	Optimized().InterleaveStereo(dest, src1, src2, n_frames);
+
+	const size_t done = n_frames - n_frames % Optimized::BLOCK_SIZE;
+	PortableInterleaveStereo(dest + 2 * done, src1 + done, src2 + done,
+				 n_frames - done);
+}
+
+static void
+PcmInterleaveStereo(int16_t *gcc_restrict dest,
+		    const int16_t *gcc_restrict src1,
+		    const int16_t *gcc_restrict src2,
+		    size_t n_frames) noexcept
+{
+	GlueInterleaveStereo<OptimizedInterleaveStereo16>(dest, src1, src2,
+							  n_frames);
+}
+
+static void
+PcmInterleaveStereo(int32_t *gcc_restrict dest,
+		    const int32_t *gcc_restrict src1,
+		    const int32_t *gcc_restrict src2,
+		    size_t n_frames) noexcept
+{
+	GlueInterleaveStereo<OptimizedInterleaveStereo32>(dest, src1, src2,
+							  n_frames);
+}
+
+static void
+PcmInterleaveStereo(int16_t *gcc_restrict dest,
+		    const int32_t *gcc_restrict src1,
+		    const int32_t *gcc_restrict src2,
+		    size_t n_frames) noexcept
+{
+	GlueInterleaveStereo<OptimizedInterleaveNarrowStereo16>(dest,
+								src1, src2,
+								n_frames);
+}
+
+#endif
+
+template<typename D, typename S>
+static void
+PcmInterleaveStereo(D *gcc_restrict dest,
+		    const S *gcc_restrict src1,
+		    const S *gcc_restrict src2,
+		    size_t n_frames) noexcept
+{
+	PortableInterleaveStereo(dest, src1, src2, n_frames);
+}
+
+template<typename D, typename S=D>
+static void
+PcmInterleaveT(D *gcc_restrict dest,
+	       const ConstBuffer<const S *> src,
 	       size_t n_frames) noexcept
 {
 	switch (src.size) {
@@ -66,7 +148,7 @@ PcmInterleaveT(T *gcc_restrict dest,
 
 		for (const auto *const s_end = s + n_frames;
 		     s != s_end; ++s, d += src.size)
-			*d = *s;
+			*d = D(*s);
 	}
 }
 
@@ -86,6 +168,40 @@ PcmInterleave32(int32_t *gcc_restrict dest,
 	PcmInterleaveT(dest, src, n_frames);
 }
 
+void
+PcmInterleaveNarrow16(int16_t *gcc_restrict dest,
+		      const ConstBuffer<const int32_t *> src,
+		      size_t n_frames) noexcept
+{
+	PcmInterleaveT(dest, src, n_frames);
+}
+
+void
+PcmInterleaveNarrow8(int8_t *gcc_restrict dest,
+		     const ConstBuffer<const int32_t *> src,
+		     size_t n_frames) noexcept
+{
+	PcmInterleaveT(dest, src, n_frames);
+}
+
+void
+PcmNarrow16(int16_t *dest, const int32_t *src, size_t n) noexcept
+{
+#ifdef HAVE_OPTIMIZED_INTERLEAVE
+	OptimizedNarrow16().Narrow(dest, src, n);
+
+	const size_t done = n - n % OptimizedNarrow16::BLOCK_SIZE;
+	dest += done;
+	src += done;
+	n -= done;
+#endif
+
+	/* forward copy; safe for dest==src because the destination
+	   samples are smaller */
+	for (size_t i = 0; i != n; ++i)
+		dest[i] = int16_t(src[i]);
+}
+
 void
 PcmInterleave(void *gcc_restrict dest,
 	      ConstBuffer<const void *> src,
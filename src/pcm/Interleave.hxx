@@ -41,6 +41,32 @@ void
 PcmInterleave32(int32_t *gcc_restrict dest, ConstBuffer<const int32_t *> src,
 		size_t n_frames) noexcept;
 
+/**
+ * Interleave planar 32 bit samples which are known to be in the 16
+ * bit range (e.g. decoded by libFLAC from a 16 bit file) and narrow
+ * them to 16 bit.
+ */
+void
+PcmInterleaveNarrow16(int16_t *gcc_restrict dest,
+		      ConstBuffer<const int32_t *> src,
+		      size_t n_frames) noexcept;
+
+/**
+ * Like PcmInterleaveNarrow16(), but narrow to 8 bit.
+ */
+void
+PcmInterleaveNarrow8(int8_t *gcc_restrict dest,
+		     ConstBuffer<const int32_t *> src,
+		     size_t n_frames) noexcept;
+
+/**
+ * Narrow interleaved 32 bit samples which are known to be in the 16
+ * bit range to 16 bit.  Unlike the functions above, this one may
+ * operate in-place (#dest == #src).
+ */
+void
+PcmNarrow16(int16_t *dest, const int32_t *src, size_t n) noexcept;
+
 static inline void
 PcmInterleaveFloat(float *gcc_restrict dest, ConstBuffer<const float *> src,
 		   size_t n_frames) noexcept
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_SSE2_HXX
+#define MPD_PCM_SSE2_HXX
+
+#include "util/Compiler.h"
+
+#include <emmintrin.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Interleave two channels of 32 bit samples using SSE2.
+ */
+struct Sse2InterleaveStereo32 {
+	static constexpr size_t BLOCK_SIZE = 4;
+
+	void InterleaveStereo(int32_t *gcc_restrict dest,
+			      const int32_t *gcc_restrict src1,
+			      const int32_t *gcc_restrict src2,
+			      size_t n_frames) const noexcept {
+		for (size_t i = 0; i < n_frames / BLOCK_SIZE;
+		     ++i, src1 += BLOCK_SIZE, src2 += BLOCK_SIZE,
+			     dest += 2 * BLOCK_SIZE) {
+			const __m128i a = _mm_loadu_si128((const __m128i *)src1);
+			const __m128i b = _mm_loadu_si128((const __m128i *)src2);
+
+			_mm_storeu_si128((__m128i *)dest,
+					 _mm_unpacklo_epi32(a, b));
+			_mm_storeu_si128((__m128i *)dest + 1,
+					 _mm_unpackhi_epi32(a, b));
+		}
+	}
+};
+
+/**
+ * Interleave two channels of 16 bit samples using SSE2.
+ */
+struct Sse2InterleaveStereo16 {
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	void InterleaveStereo(int16_t *gcc_restrict dest,
+			      const int16_t *gcc_restrict src1,
+			      const int16_t *gcc_restrict src2,
+			      size_t n_frames) const noexcept {
+		for (size_t i = 0; i < n_frames / BLOCK_SIZE;
+		     ++i, src1 += BLOCK_SIZE, src2 += BLOCK_SIZE,
+			     dest += 2 * BLOCK_SIZE) {
+			const __m128i a = _mm_loadu_si128((const __m128i *)src1);
+			const __m128i b = _mm_loadu_si128((const __m128i *)src2);
+
+			_mm_storeu_si128((__m128i *)dest,
+					 _mm_unpacklo_epi16(a, b));
+			_mm_storeu_si128((__m128i *)dest + 1,
+					 _mm_unpackhi_epi16(a, b));
+		}
+	}
+};
+
+/**
+ * Interleave two channels of 32 bit samples which are known to be in
+ * the 16 bit range, and narrow them to 16 bit using SSE2.
+ */
+struct Sse2InterleaveNarrowStereo16 {
+	static constexpr size_t BLOCK_SIZE = 4;
+
+	void InterleaveStereo(int16_t *gcc_restrict dest,
+			      const int32_t *gcc_restrict src1,
+			      const int32_t *gcc_restrict src2,
+			      size_t n_frames) const noexcept {
+		for (size_t i = 0; i < n_frames / BLOCK_SIZE;
+		     ++i, src1 += BLOCK_SIZE, src2 += BLOCK_SIZE,
+			     dest += 2 * BLOCK_SIZE) {
+			const __m128i a = _mm_loadu_si128((const __m128i *)src1);
+			const __m128i b = _mm_loadu_si128((const __m128i *)src2);
+
+			/* L0 R0 L1 R1 and L2 R2 L3 R3, packed to 16
+			   bit with saturation (which is a no-op for
+			   samples in range) */
+			_mm_storeu_si128((__m128i *)dest,
+					 _mm_packs_epi32(_mm_unpacklo_epi32(a, b),
+							 _mm_unpackhi_epi32(a, b)));
+		}
+	}
+};
+
+/**
+ * Narrow 32 bit samples which are known to be in the 16 bit range to
+ * 16 bit using SSE2.  Each block is loaded completely before it is
+ * stored, therefore #dest may be equal to #src.
+ */
+struct Sse2Narrow16 {
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	void Narrow(int16_t *dest, const int32_t *src,
+		    size_t n) const noexcept {
+		for (size_t i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dest += BLOCK_SIZE) {
+			const __m128i a = _mm_loadu_si128((const __m128i *)src);
+			const __m128i b = _mm_loadu_si128((const __m128i *)src + 1);
+
+			_mm_storeu_si128((__m128i *)dest,
+					 _mm_packs_epi32(a, b));
+		}
+	}
+};
+
+#endif
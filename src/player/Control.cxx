@@ -30,10 +30,12 @@
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     PlayerOutputs &_outputs,
 			     unsigned _buffer_chunks,
+			     FloatDuration _decoder_lookahead,
 			     AudioFormat _configured_audio_format,
 			     const ReplayGainConfig &_replay_gain_config) noexcept
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
+	 decoder_lookahead(_decoder_lookahead),
 	 configured_audio_format(_configured_audio_format),
 	 thread(BIND_THIS_METHOD(RunThread)),
 	 replay_gain_config(_replay_gain_config)
@@ -65,7 +67,7 @@ PlayerControl::Play(std::unique_ptr<DetachedSong> song)
 
 	assert(song != nullptr);
 
-	const std::lock_guard<Mutex> protect(mutex);
+	const MeteredLock protect(mutex, lock_wait);
 	SeekLocked(std::move(song), SongTime::zero());
 
 	if (state == PlayerState::PAUSE)
@@ -128,7 +130,7 @@ PlayerControl::PauseLocked() noexcept
 void
 PlayerControl::LockPause() noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const MeteredLock protect(mutex, lock_wait);
 	PauseLocked();
 }
 
@@ -138,7 +140,7 @@ PlayerControl::LockSetPause(bool pause_flag) noexcept
 	if (!thread.IsDefined())
 		return;
 
-	const std::lock_guard<Mutex> protect(mutex);
+	const MeteredLock protect(mutex, lock_wait);
 
 	switch (state) {
 	case PlayerState::STOP:
@@ -159,7 +161,7 @@ PlayerControl::LockSetPause(bool pause_flag) noexcept
 void
 PlayerControl::LockSetBorderPause(bool _border_pause) noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const MeteredLock protect(mutex, lock_wait);
 	border_pause = _border_pause;
 }
 
@@ -168,7 +170,7 @@ PlayerControl::LockGetStatus() noexcept
 {
 	PlayerStatus status;
 
-	const std::lock_guard<Mutex> protect(mutex);
+	const MeteredLock protect(mutex, lock_wait);
 	if (!occupied && thread.IsDefined())
 		SynchronousCommand(PlayerCommand::REFRESH);
 
@@ -197,14 +199,14 @@ PlayerControl::SetError(PlayerError type, std::exception_ptr &&_error) noexcept
 void
 PlayerControl::LockClearError() noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const MeteredLock protect(mutex, lock_wait);
 	ClearError();
 }
 
 void
 PlayerControl::LockSetTaggedSong(const DetachedSong &song) noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const MeteredLock protect(mutex, lock_wait);
 	tagged_song.reset();
 	tagged_song = std::make_unique<DetachedSong>(song);
 }
@@ -224,7 +226,7 @@ PlayerControl::ReadTaggedSong() noexcept
 std::unique_ptr<DetachedSong>
 PlayerControl::LockReadTaggedSong() noexcept
 {
-	const std::lock_guard<Mutex> protect(mutex);
+	const MeteredLock protect(mutex, lock_wait);
 	return ReadTaggedSong();
 }
 
@@ -234,7 +236,7 @@ PlayerControl::LockEnqueueSong(std::unique_ptr<DetachedSong> song) noexcept
 	assert(thread.IsDefined());
 	assert(song != nullptr);
 
-	const std::lock_guard<Mutex> protect(mutex);
+	const MeteredLock protect(mutex, lock_wait);
 	EnqueueSongLocked(std::move(song));
 }
 
@@ -292,7 +294,7 @@ PlayerControl::LockSeek(std::unique_ptr<DetachedSong> song, SongTime t)
 	assert(song != nullptr);
 
 	{
-		const std::lock_guard<Mutex> protect(mutex);
+		const MeteredLock protect(mutex, lock_wait);
 		SeekLocked(std::move(song), t);
 	}
 
@@ -25,12 +25,15 @@
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
+#include "thread/MeteredLock.hxx"
+#include "util/LatencyHistogram.hxx"
 #include "CrossFade.hxx"
 #include "Chrono.hxx"
 #include "ReplayGainConfig.hxx"
 #include "ReplayGainMode.hxx"
 #include "MusicChunkPtr.hxx"
 
+#include <atomic>
 #include <exception>
 #include <memory>
 
@@ -118,6 +121,13 @@ class PlayerControl final : public AudioOutputClient {
 
 	const unsigned buffer_chunks;
 
+	/**
+	 * The "decoder_lookahead" setting: if positive, a second
+	 * decoder decodes the queued song up to this duration ahead
+	 * of time.
+	 */
+	const FloatDuration decoder_lookahead;
+
 	/**
 	 * The "audio_output_format" setting.
 	 */
@@ -133,6 +143,17 @@ class PlayerControl final : public AudioOutputClient {
 	 */
 	mutable Mutex mutex;
 
+	/**
+	 * Time spent waiting for #mutex in the Lock*() methods.
+	 */
+	mutable LatencyHistogram lock_wait;
+
+	/**
+	 * The number of times the player ran out of decoded data
+	 * while playing (incremented by the player thread).
+	 */
+	std::atomic<uint64_t> decoder_underruns{0};
+
 	/**
 	 * Trigger this object after you have modified #command.
 	 */
@@ -235,6 +256,7 @@ public:
 	PlayerControl(PlayerListener &_listener,
 		      PlayerOutputs &_outputs,
 		      unsigned buffer_chunks,
+		      FloatDuration _decoder_lookahead,
 		      AudioFormat _configured_audio_format,
 		      const ReplayGainConfig &_replay_gain_config) noexcept;
 	~PlayerControl() noexcept;
@@ -245,7 +267,7 @@ public:
 	 * Like CheckRethrowError(), but locks and unlocks the object.
 	 */
 	void LockCheckRethrowError() const {
-		const std::lock_guard<Mutex> protect(mutex);
+		const MeteredLock protect(mutex, lock_wait);
 		CheckRethrowError();
 	}
 
@@ -314,7 +336,7 @@ public:
 	}
 
 	void LockSetReplayGainMode(ReplayGainMode _mode) noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
+		const MeteredLock protect(mutex, lock_wait);
 		replay_gain_mode = _mode;
 	}
 
@@ -337,7 +359,7 @@ public:
 
 	gcc_pure
 	SyncInfo LockGetSyncInfo() const noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
+		const MeteredLock protect(mutex, lock_wait);
 		return {state, next_song != nullptr};
 	}
 
@@ -345,6 +367,14 @@ public:
 		return total_play_time;
 	}
 
+	const LatencyHistogram &GetLockWait() const noexcept {
+		return lock_wait;
+	}
+
+	uint64_t GetDecoderUnderruns() const noexcept {
+		return decoder_underruns.load(std::memory_order_relaxed);
+	}
+
 private:
 	/**
 	 * Signals the object.  The object should be locked prior to
@@ -359,7 +389,7 @@ private:
 	 * this function.
 	 */
 	void LockSignal() noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
+		const MeteredLock protect(mutex, lock_wait);
 		Signal();
 	}
 
@@ -412,7 +442,7 @@ private:
 	}
 
 	void LockCommandFinished() noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
+		const MeteredLock protect(mutex, lock_wait);
 		CommandFinished();
 	}
 
@@ -429,7 +459,7 @@ private:
 	bool WaitOutputConsumed(unsigned threshold) noexcept;
 
 	bool LockWaitOutputConsumed(unsigned threshold) noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
+		const MeteredLock protect(mutex, lock_wait);
 		return WaitOutputConsumed(threshold);
 	}
 
@@ -467,7 +497,7 @@ private:
 	 * object.
 	 */
 	void LockSynchronousCommand(PlayerCommand cmd) noexcept {
-		const std::lock_guard<Mutex> protect(mutex);
+		const MeteredLock protect(mutex, lock_wait);
 		SynchronousCommand(cmd);
 	}
 
@@ -505,7 +535,7 @@ private:
 	}
 
 	void LockSetOutputError(std::exception_ptr &&_error) noexcept {
-		const std::lock_guard<Mutex> lock(mutex);
+		const MeteredLock lock(mutex, lock_wait);
 		SetOutputError(std::move(_error));
 	}
 
@@ -20,7 +20,6 @@
 #include "config.h"
 #include "CrossFade.hxx"
 #include "Chrono.hxx"
-#include "MusicChunk.hxx"
 #include "AudioFormat.hxx"
 #include "util/NumberParser.hxx"
 #include "util/Domain.hxx"
@@ -94,6 +93,7 @@ CrossFadeSettings::Calculate(SignedSongTime total_time,
 			     const char *mixramp_start, const char *mixramp_prev_end,
 			     const AudioFormat af,
 			     const AudioFormat old_format,
+			     size_t chunk_capacity,
 			     unsigned max_chunks) const noexcept
 {
 	unsigned int chunks = 0;
@@ -109,7 +109,7 @@ CrossFadeSettings::Calculate(SignedSongTime total_time,
 	assert(af.IsValid());
 
 	const auto chunk_duration =
-		af.SizeToTime<FloatDuration>(sizeof(MusicChunk::data));
+		af.SizeToTime<FloatDuration>(chunk_capacity);
 
 	if (mixramp_delay <= FloatDuration::zero() ||
 	    !mixramp_start || !mixramp_prev_end) {
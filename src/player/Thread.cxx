@@ -66,7 +66,20 @@ static constexpr auto buffer_before_play_duration = std::chrono::seconds(1);
 class Player {
 	PlayerControl &pc;
 
-	DecoderControl &dc;
+	/**
+	 * The decoder which is decoding the current song or (after
+	 * it has finished) the next song.
+	 */
+	DecoderControl *dc;
+
+	/**
+	 * The decoder which decodes the queued song ahead of time
+	 * while #dc is still busy with the current song (see
+	 * PlayerControl::decoder_lookahead).  At the song border, the
+	 * two are exchanged.  This is nullptr if decode-ahead is
+	 * disabled.
+	 */
+	DecoderControl *lookahead_dc;
 
 	MusicBuffer &buffer;
 
@@ -98,14 +111,24 @@ class Player {
 	 * It is calculated in a way which should prevent a wakeup
 	 * after each single consumed chunk; it is more efficient to
 	 * make the decoder decode a larger block at a time.
+	 *
+	 * It is updated by CheckDecoderStartup(), because the number
+	 * of chunks in the #MusicBuffer depends on the chunk size
+	 * chosen for the song.
 	 */
-	const unsigned decoder_wakeup_threshold;
+	unsigned decoder_wakeup_threshold;
 
 	/**
 	 * Are we waiting for #buffer_before_play?
 	 */
 	bool buffering = true;
 
+	/**
+	 * Has the pipe run empty while playing?  Used to count each
+	 * underrun only once in PlayerControl::decoder_underruns.
+	 */
+	bool underrun = false;
+
 	/**
 	 * true if the decoder is starting and did not provide data
 	 * yet
@@ -196,8 +219,10 @@ class Player {
 
 public:
 	Player(PlayerControl &_pc, DecoderControl &_dc,
+	       DecoderControl *_lookahead_dc,
 	       MusicBuffer &_buffer) noexcept
-		:pc(_pc), dc(_dc), buffer(_buffer),
+		:pc(_pc), dc(&_dc), lookahead_dc(_lookahead_dc),
+		 buffer(_buffer),
 		 decoder_wakeup_threshold(buffer.GetSize() * 3 / 4)
 	{
 	}
@@ -222,7 +247,44 @@ private:
 	 *
 	 * Caller must lock the mutex.
 	 */
-	void StartDecoder(std::shared_ptr<MusicPipe> pipe) noexcept;
+	void StartDecoder(DecoderControl &_dc,
+			  std::shared_ptr<MusicPipe> pipe) noexcept;
+
+	void StartDecoder(std::shared_ptr<MusicPipe> _pipe) noexcept {
+		StartDecoder(*dc, std::move(_pipe));
+	}
+
+	/**
+	 * Is #lookahead_dc busy with the queued song?
+	 */
+	gcc_pure
+	bool IsLookaheadActive() const noexcept {
+		return lookahead_dc != nullptr && lookahead_dc->pipe != nullptr;
+	}
+
+	/**
+	 * Start decoding the queued song with #lookahead_dc.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void StartLookahead() noexcept;
+
+	/**
+	 * Stop #lookahead_dc and free its music pipe.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void StopLookahead() noexcept;
+
+	/**
+	 * The current decoder has finished, and #lookahead_dc is
+	 * busy with the queued song: exchange the two, so the queued
+	 * song becomes the "next" song without having to start a
+	 * decoder.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void PromoteLookahead() noexcept;
 
 	/**
 	 * The decoder has acknowledged the "START" command (see
@@ -254,7 +316,7 @@ private:
 	bool IsDecoderAtCurrentSong() const noexcept {
 		assert(pipe != nullptr);
 
-		return dc.pipe == pipe;
+		return dc->pipe == pipe;
 	}
 
 	/**
@@ -264,7 +326,7 @@ private:
 	 */
 	gcc_pure
 	bool IsDecoderAtNextSong() const noexcept {
-		return dc.pipe != nullptr && !IsDecoderAtCurrentSong();
+		return dc->pipe != nullptr && !IsDecoderAtCurrentSong();
 	}
 
 	/**
@@ -363,19 +425,72 @@ public:
 };
 
 void
-Player::StartDecoder(std::shared_ptr<MusicPipe> _pipe) noexcept
+Player::StartDecoder(DecoderControl &_dc,
+		     std::shared_ptr<MusicPipe> _pipe) noexcept
 {
 	assert(queued || pc.command == PlayerCommand::SEEK);
 	assert(pc.next_song != nullptr);
 
 	/* copy ReplayGain parameters to the decoder */
-	dc.replay_gain_mode = pc.replay_gain_mode;
+	_dc.replay_gain_mode = pc.replay_gain_mode;
 
 	SongTime start_time = pc.next_song->GetStartTime() + pc.seek_time;
 
-	dc.Start(std::make_unique<DetachedSong>(*pc.next_song),
-		 start_time, pc.next_song->GetEndTime(),
-		 buffer, std::move(_pipe));
+	_dc.Start(std::make_unique<DetachedSong>(*pc.next_song),
+		  start_time, pc.next_song->GetEndTime(),
+		  buffer, std::move(_pipe));
+}
+
+void
+Player::StartLookahead() noexcept
+{
+	assert(queued);
+	assert(lookahead_dc != nullptr);
+	assert(lookahead_dc->IsIdle());
+	assert(!IsLookaheadActive());
+
+	FormatDebug(player_domain, "decoding ahead: \"%s\"",
+		    pc.next_song->GetURI());
+
+	lookahead_dc->lookahead = pc.decoder_lookahead;
+	StartDecoder(*lookahead_dc, std::make_shared<MusicPipe>());
+}
+
+void
+Player::StopLookahead() noexcept
+{
+	if (!IsLookaheadActive())
+		return;
+
+	{
+		const PlayerControl::ScopeOccupied occupied(pc);
+		lookahead_dc->Stop();
+	}
+
+	lookahead_dc->pipe->Clear();
+	lookahead_dc->pipe.reset();
+	lookahead_dc->lookahead = FloatDuration::zero();
+}
+
+void
+Player::PromoteLookahead() noexcept
+{
+	assert(queued);
+	assert(dc->IsIdle());
+	assert(IsLookaheadActive());
+
+	/* the "previous" song of the look-ahead decoder is the one
+	   which was decoded by the other decoder */
+	lookahead_dc->InheritPrevious(*dc);
+
+	/* lift the limit and wake it up */
+	lookahead_dc->lookahead = FloatDuration::zero();
+	lookahead_dc->Signal();
+
+	/* the pipe is still owned by #pipe */
+	dc->pipe.reset();
+
+	std::swap(dc, lookahead_dc);
 }
 
 void
@@ -383,13 +498,13 @@ Player::StopDecoder() noexcept
 {
 	const PlayerControl::ScopeOccupied occupied(pc);
 
-	dc.Stop();
+	dc->Stop();
 
-	if (dc.pipe != nullptr) {
+	if (dc->pipe != nullptr) {
 		/* clear and free the decoder pipe */
 
-		dc.pipe->Clear();
-		dc.pipe.reset();
+		dc->pipe->Clear();
+		dc->pipe.reset();
 
 		/* just in case we've been cross-fading: cancel it
 		   now, because we just deleted the new song's decoder
@@ -402,7 +517,7 @@ bool
 Player::ForwardDecoderError() noexcept
 {
 	try {
-		dc.CheckRethrowError();
+		dc->CheckRethrowError();
 	} catch (...) {
 		pc.SetError(PlayerError::DECODER, std::current_exception());
 		return false;
@@ -508,7 +623,7 @@ Player::CheckDecoderStartup() noexcept
 	if (!ForwardDecoderError()) {
 		/* the decoder failed */
 		return false;
-	} else if (!dc.IsStarting()) {
+	} else if (!dc->IsStarting()) {
 		/* the decoder is ready and ok */
 
 		if (output_open &&
@@ -517,17 +632,21 @@ Player::CheckDecoderStartup() noexcept
 			   all chunks yet - wait for that */
 			return true;
 
-		pc.total_time = real_song_duration(*dc.song,
-						   dc.total_time);
-		pc.audio_format = dc.in_audio_format;
-		play_audio_format = dc.out_audio_format;
+		pc.total_time = real_song_duration(*dc->song,
+						   dc->total_time);
+		pc.audio_format = dc->in_audio_format;
+		play_audio_format = dc->out_audio_format;
 		decoder_starting = false;
 
+		/* the decoder has chosen the chunk size in
+		   DecoderBridge::Ready() */
+		const size_t chunk_capacity = buffer.GetChunkCapacity();
 		const size_t buffer_before_play_size =
 			play_audio_format.TimeToSize(buffer_before_play_duration);
 		buffer_before_play =
-			(buffer_before_play_size + sizeof(MusicChunk::data) - 1)
-			/ sizeof(MusicChunk::data);
+			(buffer_before_play_size + chunk_capacity - 1)
+			/ chunk_capacity;
+		decoder_wakeup_threshold = buffer.GetSize() * 3 / 4;
 
 		idle_add(IDLE_PLAYER);
 
@@ -554,7 +673,7 @@ Player::CheckDecoderStartup() noexcept
 			FormatError(player_domain,
 				    "problems opening audio device "
 				    "while playing \"%s\"",
-				    dc.song->GetURI());
+				    dc->song->GetURI());
 			return true;
 		}
 
@@ -562,7 +681,7 @@ Player::CheckDecoderStartup() noexcept
 	} else {
 		/* the decoder is not yet ready; wait
 		   some more */
-		dc.WaitForDecoder();
+		dc->WaitForDecoder();
 
 		return true;
 	}
@@ -583,7 +702,7 @@ Player::SeekDecoder(SongTime seek_time) noexcept
 	try {
 		const PlayerControl::ScopeOccupied occupied(pc);
 
-		dc.Seek(song->GetStartTime() + seek_time);
+		dc->Seek(song->GetStartTime() + seek_time);
 	} catch (...) {
 		/* decoder failure */
 		pc.SetError(PlayerError::DECODER, std::current_exception());
@@ -601,12 +720,15 @@ Player::SeekDecoder() noexcept
 
 	CancelPendingSeek();
 
+	/* the seek target replaces the queued song */
+	StopLookahead();
+
 	{
 		const ScopeUnlock unlock(pc.mutex);
 		pc.outputs.Cancel();
 	}
 
-	if (!dc.IsSeekableCurrentSong(*pc.next_song)) {
+	if (!dc->IsSeekableCurrentSong(*pc.next_song)) {
 		/* the decoder is already decoding the "next" song -
 		   stop it and start the previous song again */
 
@@ -630,7 +752,7 @@ Player::SeekDecoder() noexcept
 		if (!IsDecoderAtCurrentSong()) {
 			/* the decoder is already decoding the "next" song,
 			   but it is the same song file; exchange the pipe */
-			ReplacePipe(dc.pipe);
+			ReplacePipe(dc->pipe);
 		}
 
 		pc.next_song.reset();
@@ -694,8 +816,14 @@ Player::ProcessCommand() noexcept
 		queued = true;
 		pc.CommandFinished();
 
-		if (dc.IsIdle())
+		if (dc->IsIdle())
 			StartDecoder(std::make_shared<MusicPipe>());
+		else if (lookahead_dc != nullptr)
+			/* the current song is still being decoded;
+			   open the queued song on the second decoder
+			   right now, so a slow start does not cause a
+			   gap at the song border */
+			StartLookahead();
 
 		break;
 
@@ -732,6 +860,8 @@ Player::ProcessCommand() noexcept
 			   stop it and reset the position */
 			StopDecoder();
 
+		StopLookahead();
+
 		pc.next_song.reset();
 		queued = false;
 		pc.CommandFinished();
@@ -829,7 +959,7 @@ Player::PlayNextChunk() noexcept
 		unsigned cross_fade_position = pipe->GetSize();
 		assert(cross_fade_position <= cross_fade_chunks);
 
-		auto other_chunk = dc.pipe->Shift();
+		auto other_chunk = dc->pipe->Shift();
 		if (other_chunk != nullptr) {
 			chunk = pipe->Shift();
 			assert(chunk != nullptr);
@@ -865,14 +995,14 @@ Player::PlayNextChunk() noexcept
 
 			const std::lock_guard<Mutex> lock(pc.mutex);
 
-			if (dc.IsIdle()) {
+			if (dc->IsIdle()) {
 				/* the decoder isn't running, abort
 				   cross fading */
 				xfade_state = CrossFadeState::DISABLED;
 			} else {
 				/* wait for the decoder */
-				dc.Signal();
-				dc.WaitForDecoder();
+				dc->Signal();
+				dc->WaitForDecoder();
 
 				return true;
 			}
@@ -918,10 +1048,10 @@ Player::PlayNextChunk() noexcept
 	/* this formula should prevent that the decoder gets woken up
 	   with each chunk; it is more efficient to make it decode a
 	   larger block at a time */
-	if (!dc.IsIdle() && dc.pipe->GetSize() <= decoder_wakeup_threshold) {
+	if (!dc->IsIdle() && dc->pipe->GetSize() <= decoder_wakeup_threshold) {
 		if (!decoder_woken) {
 			decoder_woken = true;
-			dc.Signal();
+			dc->Signal();
 		}
 	} else
 		decoder_woken = false;
@@ -937,7 +1067,7 @@ Player::SongBorder() noexcept
 
 		FormatDefault(player_domain, "played \"%s\"", song->GetURI());
 
-		ReplacePipe(dc.pipe);
+		ReplacePipe(dc->pipe);
 
 		pc.outputs.SongBorder();
 	}
@@ -974,10 +1104,10 @@ Player::Run() noexcept
 			   prevent stuttering on slow machines */
 
 			if (pipe->GetSize() < buffer_before_play &&
-			    !dc.IsIdle() && !buffer.IsFull()) {
+			    !dc->IsIdle() && !buffer.IsFull()) {
 				/* not enough decoded buffer space yet */
 
-				dc.WaitForDecoder();
+				dc->WaitForDecoder();
 				continue;
 			} else {
 				/* buffering is complete */
@@ -994,13 +1124,16 @@ Player::Run() noexcept
 			continue;
 		}
 
-		if (dc.IsIdle() && queued && dc.pipe == pipe) {
+		if (dc->IsIdle() && queued && dc->pipe == pipe) {
 			/* the decoder has finished the current song;
 			   make it decode the next song */
 
-			assert(dc.pipe == nullptr || dc.pipe == pipe);
+			assert(dc->pipe == nullptr || dc->pipe == pipe);
 
-			StartDecoder(std::make_shared<MusicPipe>());
+			if (IsLookaheadActive())
+				PromoteLookahead();
+			else
+				StartDecoder(std::make_shared<MusicPipe>());
 		}
 
 		if (/* no cross-fading if MPD is going to pause at the
@@ -1008,18 +1141,19 @@ Player::Run() noexcept
 		    !pc.border_pause &&
 		    IsDecoderAtNextSong() &&
 		    xfade_state == CrossFadeState::UNKNOWN &&
-		    !dc.IsStarting()) {
+		    !dc->IsStarting()) {
 			/* enable cross fading in this song?  if yes,
 			   calculate how many chunks will be required
 			   for it */
 			cross_fade_chunks =
-				pc.cross_fade.Calculate(dc.total_time,
-							dc.replay_gain_db,
-							dc.replay_gain_prev_db,
-							dc.GetMixRampStart(),
-							dc.GetMixRampPreviousEnd(),
-							dc.out_audio_format,
+				pc.cross_fade.Calculate(dc->total_time,
+							dc->replay_gain_db,
+							dc->replay_gain_prev_db,
+							dc->GetMixRampStart(),
+							dc->GetMixRampPreviousEnd(),
+							dc->out_audio_format,
 							play_audio_format,
+							buffer.GetChunkCapacity(),
 							buffer.GetSize() -
 							buffer_before_play);
 			if (cross_fade_chunks > 0)
@@ -1037,6 +1171,8 @@ Player::Run() noexcept
 			/* at least one music chunk is ready - send it
 			   to the audio output */
 
+			underrun = false;
+
 			const ScopeUnlock unlock(pc.mutex);
 			PlayNextChunk();
 		} else if (UnlockCheckOutputs() > 0) {
@@ -1048,14 +1184,14 @@ Player::Run() noexcept
 			   waiting for space in the MusicBuffer) and
 			   wait for it */
 			// TODO: eliminate this kludge
-			dc.Signal();
+			dc->Signal();
 
-			dc.WaitForDecoder();
+			dc->WaitForDecoder();
 		} else if (IsDecoderAtNextSong()) {
 			/* at the beginning of a new song */
 
 			SongBorder();
-		} else if (dc.IsIdle()) {
+		} else if (dc->IsIdle()) {
 			/* check the size of the pipe again, because
 			   the decoder thread may have added something
 			   since we last checked */
@@ -1071,18 +1207,24 @@ Player::Run() noexcept
 			   new PCM data in time: wait for the
 			   decoder */
 
+			if (!underrun) {
+				underrun = true;
+				++pc.decoder_underruns;
+			}
+
 			/* wake up the decoder (just in case it's
 			   waiting for space in the MusicBuffer) and
 			   wait for it */
 			// TODO: eliminate this kludge
-			dc.Signal();
+			dc->Signal();
 
-			dc.WaitForDecoder();
+			dc->WaitForDecoder();
 		}
 	}
 
 	CancelPendingSeek();
 	StopDecoder();
+	StopLookahead();
 
 	pipe.reset();
 
@@ -1105,9 +1247,10 @@ Player::Run() noexcept
 
 static void
 do_play(PlayerControl &pc, DecoderControl &dc,
+	DecoderControl *lookahead_dc,
 	MusicBuffer &buffer) noexcept
 {
-	Player player(pc, dc, buffer);
+	Player player(pc, dc, lookahead_dc, buffer);
 	player.Run();
 }
 
@@ -1121,6 +1264,15 @@ try {
 			  replay_gain_config);
 	dc.StartThread();
 
+	/* the second decoder for decode-ahead */
+	std::unique_ptr<DecoderControl> lookahead_dc;
+	if (decoder_lookahead > FloatDuration::zero()) {
+		lookahead_dc = std::make_unique<DecoderControl>(mutex, cond,
+								configured_audio_format,
+								replay_gain_config);
+		lookahead_dc->StartThread();
+	}
+
 	MusicBuffer buffer(buffer_chunks);
 
 	const std::lock_guard<Mutex> lock(mutex);
@@ -1133,7 +1285,8 @@ try {
 
 			{
 				const ScopeUnlock unlock(mutex);
-				do_play(*this, dc, buffer);
+				do_play(*this, dc, lookahead_dc.get(),
+					buffer);
 				listener.OnPlayerSync();
 			}
 
@@ -1178,6 +1331,8 @@ try {
 			{
 				const ScopeUnlock unlock(mutex);
 				dc.Quit();
+				if (lookahead_dc)
+					lookahead_dc->Quit();
 				outputs.Close();
 			}
 
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PlaylistLoadJob.hxx"
+#include "PlaylistRegistry.hxx"
+#include "PlaylistSong.hxx"
+#include "PlaylistError.hxx"
+#include "SongEnumerator.hxx"
+#include "input/InputStream.hxx"
+#include "SongLoader.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "BulkEdit.hxx"
+#include "fs/Traits.hxx"
+#include "thread/Name.hxx"
+#include "util/UriUtil.hxx"
+#include "util/ASCII.hxx"
+#include "util/Exception.hxx"
+#include "util/RuntimeError.hxx"
+#include "Log.hxx"
+
+#include <memory>
+
+/**
+ * Hand songs over to the main thread when this many have been
+ * parsed.
+ */
+static constexpr std::size_t BATCH_SIZE = 256;
+
+/**
+ * The parser pauses when the main thread has not yet consumed this
+ * many songs.  This limits the memory used for a huge playlist while
+ * the main thread is busy.
+ */
+static constexpr std::size_t MAX_PENDING = 4 * BATCH_SIZE;
+
+gcc_pure
+static bool
+IsFileURI(const char *uri) noexcept
+{
+	return StringStartsWithCaseASCII(uri, "file://");
+}
+
+PlaylistLoadJob::PlaylistLoadJob(Partition &_partition, const char *_uri,
+				 unsigned _start_index,
+				 unsigned _end_index) noexcept
+	:partition(_partition), uri(_uri),
+	 base_uri(PathTraitsUTF8::GetParent(_uri)),
+	 start_index(_start_index), end_index(_end_index),
+	 thread(BIND_THIS_METHOD(Run)),
+	 defer(partition.instance.event_loop, BIND_THIS_METHOD(OnDeferred))
+{
+}
+
+PlaylistLoadJob::~PlaylistLoadJob() noexcept
+{
+	if (thread.IsDefined()) {
+		Cancel();
+		thread.Join();
+	}
+}
+
+bool
+PlaylistLoadJob::IsSuitable(const char *uri) noexcept
+{
+	return uri_has_scheme(uri) && !IsFileURI(uri);
+}
+
+void
+PlaylistLoadJob::Start()
+{
+	thread.Start();
+}
+
+void
+PlaylistLoadJob::Cancel() noexcept
+{
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		cancel = true;
+		pending.clear();
+		cond.signal();
+	}
+
+	const std::lock_guard<Mutex> protect(input_mutex);
+	input_cancellation.Cancel();
+}
+
+void
+PlaylistLoadJob::AppendSongs(std::vector<DetachedSong> &&songs) noexcept
+{
+#ifdef ENABLE_DATABASE
+	const SongLoader loader(partition.GetDatabase(),
+				partition.instance.storage);
+#else
+	const SongLoader loader(nullptr, nullptr);
+#endif
+
+	const ScopeBulkEdit bulk_edit(partition);
+
+	try {
+		for (auto &song : songs) {
+			/* there is no client whose permissions could
+			   be checked, so a remote playlist must not
+			   refer to local files */
+			const char *song_uri = song.GetURI();
+			if (PathTraitsUTF8::IsAbsolute(song_uri) ||
+			    IsFileURI(song_uri))
+				continue;
+
+			if (!playlist_check_translate_song(song,
+							   base_uri.c_str(),
+							   loader))
+				continue;
+
+			partition.playlist.AppendSong(partition.pc,
+						      std::move(song));
+		}
+	} catch (...) {
+		/* probably the queue is full */
+		Cancel();
+		OnError(std::current_exception());
+	}
+}
+
+std::unique_ptr<SongEnumerator>
+PlaylistLoadJob::Open()
+{
+	/* plugins which handle the URI scheme themselves */
+	auto e = playlist_list_open_uri(uri.c_str(), input_mutex);
+	if (e != nullptr)
+		return e;
+
+	auto is = std::make_unique<CancellableInputStream>(InputStream::Open(uri.c_str(),
+									     input_mutex),
+							   input_cancellation);
+
+	{
+		const std::lock_guard<Mutex> protect(input_mutex);
+		is->WaitReady();
+	}
+
+	e = playlist_list_open_stream(InputStreamPtr(std::move(is)),
+				      uri.c_str());
+	if (e == nullptr)
+		throw PlaylistError(PlaylistResult::NO_SUCH_LIST,
+				    "Unsupported playlist format");
+
+	return e;
+}
+
+void
+PlaylistLoadJob::Run()
+{
+	SetThreadName("load");
+
+	try {
+		auto e = Open();
+
+		std::unique_ptr<DetachedSong> song;
+		for (unsigned i = 0;
+		     i < end_index && (song = e->NextSong()) != nullptr;
+		     ++i) {
+			if (i < start_index)
+				continue;
+
+			const std::lock_guard<Mutex> protect(mutex);
+			while (!cancel && pending.size() >= MAX_PENDING)
+				cond.wait(mutex);
+
+			if (cancel)
+				break;
+
+			pending.emplace_back(std::move(*song));
+			if (pending.size() % BATCH_SIZE == 0)
+				defer.Schedule();
+		}
+	} catch (...) {
+		const std::lock_guard<Mutex> protect(mutex);
+		if (!cancel)
+			error = std::current_exception();
+	}
+
+	const std::lock_guard<Mutex> protect(mutex);
+	finished = true;
+	defer.Schedule();
+}
+
+void
+PlaylistLoadJob::OnError(std::exception_ptr e) noexcept
+{
+	e = NestException(e, FormatRuntimeError("Failed to load playlist \"%s\"",
+						 uri.c_str()));
+	LogError(e);
+	partition.OnLoadJobError(e);
+}
+
+void
+PlaylistLoadJob::OnDeferred() noexcept
+{
+	std::vector<DetachedSong> songs;
+	bool _finished;
+	std::exception_ptr _error;
+
+	{
+		const std::lock_guard<Mutex> protect(mutex);
+		songs.swap(pending);
+		_finished = finished;
+		_error = std::move(error);
+		cond.signal();
+	}
+
+	if (!songs.empty())
+		AppendSongs(std::move(songs));
+
+	if (_error)
+		OnError(std::move(_error));
+
+	if (_finished) {
+		thread.Join();
+
+		/* this call destroys the object */
+		partition.OnLoadJobFinished(*this);
+	}
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PLAYLIST_LOAD_JOB_HXX
+#define MPD_PLAYLIST_LOAD_JOB_HXX
+
+#include "check.h"
+#include "song/DetachedSong.hxx"
+#include "event/DeferEvent.hxx"
+#include "input/CancellableInputStream.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "util/Compiler.h"
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <exception>
+
+struct Partition;
+class SongEnumerator;
+
+/**
+ * Loads a remote playlist into the queue in the background.  A
+ * dedicated thread downloads and parses the playlist, and hands the
+ * songs over to the main thread in batches, where they get resolved
+ * and appended to the queue.  Each batch is one "bulk edit", and
+ * thus emits one #IDLE_PLAYLIST event.
+ *
+ * The object is owned by its #Partition, and it calls
+ * Partition::OnLoadJobFinished() (which destroys it) when it is done.
+ * Errors are passed to Partition::OnLoadJobError().
+ */
+class PlaylistLoadJob final {
+	Partition &partition;
+
+	const std::string uri;
+
+	/**
+	 * The directory of #uri, used to resolve relative song URIs.
+	 */
+	const std::string base_uri;
+
+	const unsigned start_index, end_index;
+
+	Thread thread;
+
+	/**
+	 * Invokes OnDeferred() in the main thread after the parser
+	 * has produced a batch of songs, or has finished.
+	 */
+	DeferEvent defer;
+
+	/**
+	 * The mutex of the #InputStream being parsed.
+	 */
+	Mutex input_mutex;
+
+	/**
+	 * Allows Cancel() to wake up the thread while it is blocked
+	 * in a read.  Protected by #input_mutex.
+	 */
+	InputStreamCancellation input_cancellation;
+
+	/**
+	 * Protects #pending, #finished, #cancel and #error.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Signalled by the main thread when it has taken the
+	 * #pending songs, or when the job was cancelled.
+	 */
+	Cond cond;
+
+	/**
+	 * Songs which were parsed, but not yet appended to the queue.
+	 */
+	std::vector<DetachedSong> pending;
+
+	/**
+	 * Set by the thread when it is about to exit.
+	 */
+	bool finished = false;
+
+	/**
+	 * Set by the main thread to ask the parser to stop.
+	 */
+	bool cancel = false;
+
+	/**
+	 * The error which made the thread fail.
+	 */
+	std::exception_ptr error;
+
+public:
+	PlaylistLoadJob(Partition &_partition, const char *_uri,
+			unsigned _start_index, unsigned _end_index) noexcept;
+
+	/**
+	 * Cancels the job and waits for the thread to exit.
+	 */
+	~PlaylistLoadJob() noexcept;
+
+	PlaylistLoadJob(const PlaylistLoadJob &) = delete;
+	PlaylistLoadJob &operator=(const PlaylistLoadJob &) = delete;
+
+	/**
+	 * Should the given playlist URI be loaded by a
+	 * #PlaylistLoadJob?  This applies to playlists which need to
+	 * be downloaded; local playlists are loaded synchronously,
+	 * which allows reporting errors to the client.
+	 */
+	gcc_pure
+	static bool IsSuitable(const char *uri) noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	void Start();
+
+	/**
+	 * Stop appending songs to the queue, and abort the download.
+	 * This does not wait for the thread; the job remains until
+	 * the thread notices the cancellation.
+	 */
+	void Cancel() noexcept;
+
+private:
+	/**
+	 * Open the playlist with a #CancellableInputStream.
+	 *
+	 * Throws on error.
+	 */
+	std::unique_ptr<SongEnumerator> Open();
+
+	void AppendSongs(std::vector<DetachedSong> &&songs) noexcept;
+
+	/**
+	 * Log the error and pass it to the #Partition.
+	 */
+	void OnError(std::exception_ptr e) noexcept;
+
+	/* the Thread callback */
+	void Run();
+
+	/* DeferEvent callback */
+	void OnDeferred() noexcept;
+};
+
+#endif
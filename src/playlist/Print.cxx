@@ -23,7 +23,11 @@
 #include "PlaylistSong.hxx"
 #include "SongEnumerator.hxx"
 #include "SongPrint.hxx"
+#include "PlaylistFile.hxx"
+#include "PlaylistError.hxx"
+#include "Mapper.hxx"
 #include "song/DetachedSong.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
 #include "thread/Mutex.hxx"
 #include "Partition.hxx"
@@ -52,11 +56,45 @@ playlist_provider_print(Response &r,
 	}
 }
 
+/**
+ * Print a stored playlist from the playlist directory, using its
+ * cached in-memory copy.
+ *
+ * @return false if there is no such stored playlist
+ */
+static bool
+stored_playlist_print(Response &r, const SongLoader &loader,
+		      const char *name, bool detail)
+{
+	if (!spl_valid_name(name) || map_spl_path().IsNull())
+		return false;
+
+	try {
+		spl_visit(name, loader, detail,
+			  [&r](const DetachedSong &song, bool resolved){
+				  if (resolved)
+					  song_print_info(r, song);
+				  else
+					  song_print_uri(r, song);
+			  });
+	} catch (const PlaylistError &e) {
+		if (e.GetCode() == PlaylistResult::NO_SUCH_LIST ||
+		    e.GetCode() == PlaylistResult::BAD_NAME)
+			return false;
+		throw;
+	}
+
+	return true;
+}
+
 bool
 playlist_file_print(Response &r, Partition &partition,
 		    const SongLoader &loader,
 		    const char *uri, bool detail)
 {
+	if (stored_playlist_print(r, loader, uri, detail))
+		return true;
+
 	Mutex mutex;
 
 #ifndef ENABLE_DATABASE
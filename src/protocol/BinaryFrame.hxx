@@ -0,0 +1,147 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/** \file
+ *
+ * Definitions for the binary framed protocol mode, which is enabled
+ * with the "binarymode" command.
+ *
+ * Each frame begins with a #FrameHeader, followed by the payload.
+ * Clients send only #FrameType::COMMAND frames, whose payload is the
+ * command name and its arguments, each terminated with a null byte.
+ */
+
+#ifndef MPD_PROTOCOL_BINARY_FRAME_HXX
+#define MPD_PROTOCOL_BINARY_FRAME_HXX
+
+#include "system/ByteOrder.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum class FrameType : uint8_t {
+	/**
+	 * A command sent by the client.
+	 */
+	COMMAND = 1,
+
+	/**
+	 * The command has succeeded.  No payload.
+	 */
+	OK = 2,
+
+	/**
+	 * The command has failed.  The payload is the error line of
+	 * the text protocol (without the newline character).
+	 */
+	ACK = 3,
+
+	/**
+	 * Response lines in the format of the text protocol, used by
+	 * all responses which have no binary representation.
+	 */
+	TEXT = 4,
+
+	/**
+	 * A tag value.  FrameHeader::id is the #TagType.
+	 */
+	TAG = 5,
+
+	/**
+	 * A song or directory attribute.  FrameHeader::id is the
+	 * #FrameField.
+	 */
+	FIELD = 6,
+};
+
+/**
+ * Attributes which are sent as #FrameType::FIELD frames.
+ */
+enum class FrameField : uint8_t {
+	/**
+	 * The song URI ("file").
+	 */
+	SONG = 0,
+
+	/**
+	 * A directory URI ("directory").
+	 */
+	DIRECTORY = 1,
+
+	/**
+	 * A playlist URI ("playlist").
+	 */
+	PLAYLIST = 2,
+
+	/**
+	 * The modification time ("Last-Modified"), a 64 bit
+	 * big-endian number of seconds since the epoch.
+	 */
+	LAST_MODIFIED = 3,
+
+	/**
+	 * The duration ("Time" and "duration"), a 32 bit big-endian
+	 * number of milliseconds.
+	 */
+	DURATION = 4,
+
+	/**
+	 * The song range ("Range"), two 32 bit big-endian numbers of
+	 * milliseconds; an end of zero means "until the end of the
+	 * file".
+	 */
+	RANGE = 5,
+
+	/**
+	 * The audio format ("Format") as a string.
+	 */
+	FORMAT = 6,
+};
+
+struct FrameHeader {
+	/**
+	 * The payload length (big-endian), not including this
+	 * header.
+	 */
+	uint32_t length_be;
+
+	FrameType type;
+
+	/**
+	 * The tag or field id; zero for all other frame types.
+	 */
+	uint8_t id;
+
+	uint8_t reserved[2];
+
+	FrameHeader() = default;
+
+	constexpr FrameHeader(FrameType _type, uint8_t _id,
+			      uint32_t length) noexcept
+		:length_be(ToBE32(length)), type(_type), id(_id),
+		 reserved{0, 0} {}
+
+	constexpr uint32_t GetLength() const noexcept {
+		return FromBE32(length_be);
+	}
+};
+
+static_assert(sizeof(FrameHeader) == 8, "Wrong FrameHeader size");
+
+#endif
@@ -24,5 +24,8 @@
 void
 command_success(Client &client)
 {
-	client.Write("OK\n");
+	if (client.binary)
+		client.WriteFrame(FrameType::OK, 0, nullptr, 0);
+	else
+		client.Write("OK\n");
 }
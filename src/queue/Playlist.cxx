@@ -36,30 +36,28 @@ playlist::TagModified(DetachedSong &&song)
 
 	assert(current >= 0);
 
-	DetachedSong &current_song = queue.GetOrder(current);
+	const unsigned position = queue.OrderToPosition(current);
+	DetachedSong &current_song = queue.BeginModifySong(position);
 	if (song.IsSame(current_song))
 		current_song.MoveTagItemsFrom(std::move(song));
 
-	queue.ModifyAtOrder(current);
+	queue.EndModifySong(position);
 	OnModified();
 }
 
 void
 playlist::TagModified(const char *uri, const Tag &tag) noexcept
 {
-	bool modified = false;
-
-	for (unsigned i = 0; i < queue.length; ++i) {
-		auto &song = *queue.items[i].song;
-		if (song.IsURI(uri)) {
-			song.SetTag(tag);
-			queue.ModifyAtPosition(i);
-			modified = true;
-		}
+	const auto positions = queue.FindURI(uri);
+	if (positions.empty())
+		return;
+
+	for (unsigned i : positions) {
+		queue.BeginModifySong(i).SetTag(tag);
+		queue.EndModifySong(i);
 	}
 
-	if (modified)
-		OnModified();
+	OnModified();
 }
 
 inline void
@@ -317,9 +317,10 @@ playlist::StaleSong(PlayerControl &pc, const char *uri)
 		? GetCurrentPosition()
 		: -1;
 
-	for (int i = queue.GetLength() - 1; i >= 0; --i)
-		if (i != current_position && queue.Get(i).IsURI(uri))
-			DeletePosition(pc, i);
+	const auto positions = queue.FindURI(uri);
+	for (auto i = positions.rbegin(); i != positions.rend(); ++i)
+		if (int(*i) != current_position)
+			DeletePosition(pc, *i);
 }
 
 void
@@ -37,18 +37,19 @@ playlist::AddSongIdTag(unsigned id, TagType tag_type, const char *value)
 	if (position < 0)
 		throw PlaylistError::NoSuchSong();
 
-	DetachedSong &song = queue.Get(position);
-	if (song.IsFile())
+	if (queue.Get(position).IsFile())
 		throw PlaylistError(PlaylistResult::DENIED,
 				    "Cannot edit tags of local file");
 
+	DetachedSong &song = queue.BeginModifySong(position);
+
 	{
 		TagBuilder tag(std::move(song.WritableTag()));
 		tag.AddItem(tag_type, value);
 		song.SetTag(tag.Commit());
 	}
 
-	queue.ModifyAtPosition(position);
+	queue.EndModifySong(position);
 	OnModified();
 }
 
@@ -59,11 +60,12 @@ playlist::ClearSongIdTag(unsigned id, TagType tag_type)
 	if (position < 0)
 		throw PlaylistError::NoSuchSong();
 
-	DetachedSong &song = queue.Get(position);
-	if (song.IsFile())
+	if (queue.Get(position).IsFile())
 		throw PlaylistError(PlaylistResult::DENIED,
 				    "Cannot edit tags of local file");
 
+	DetachedSong &song = queue.BeginModifySong(position);
+
 	{
 		TagBuilder tag(std::move(song.WritableTag()));
 		if (tag_type == TAG_NUM_OF_ITEM_TYPES)
@@ -73,6 +75,6 @@ playlist::ClearSongIdTag(unsigned id, TagType tag_type)
 		song.SetTag(tag.Commit());
 	}
 
-	queue.ModifyAtPosition(position);
+	queue.EndModifySong(position);
 	OnModified();
 }
@@ -24,8 +24,9 @@
 #include "song/DetachedSong.hxx"
 
 static bool
-UpdatePlaylistSong(const Database &db, DetachedSong &song)
+UpdatePlaylistSong(const Database &db, Queue &queue, unsigned position)
 {
+	const DetachedSong &song = queue.Get(position);
 	if (!song.IsInDatabase() || !song.IsFile())
 		/* only update Songs instances that are "detached"
 		   from the Database */
@@ -49,8 +50,10 @@ UpdatePlaylistSong(const Database &db, DetachedSong &song)
 		return false;
 	}
 
-	song.SetLastModified(original->mtime);
-	song.SetTag(original->tag);
+	DetachedSong &modified_song = queue.BeginModifySong(position);
+	modified_song.SetLastModified(original->mtime);
+	modified_song.SetTag(original->tag);
+	queue.EndModifySong(position);
 
 	db.ReturnSong(original);
 	return true;
@@ -61,12 +64,9 @@ playlist::DatabaseModified(const Database &db)
 {
 	bool modified = false;
 
-	for (unsigned i = 0, n = queue.GetLength(); i != n; ++i) {
-		if (UpdatePlaylistSong(db, queue.Get(i))) {
-			queue.ModifyAtPosition(i);
+	for (unsigned i = 0, n = queue.GetLength(); i != n; ++i)
+		if (UpdatePlaylistSong(db, queue, i))
 			modified = true;
-		}
-	}
 
 	if (modified)
 		OnModified();
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PriorityTree.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+/**
+ * The minimum and maximum of an unused slot.  They are chosen so
+ * that no priority is ever found "equal".
+ */
+static constexpr uint8_t EMPTY_MIN = 0xff, EMPTY_MAX = 0;
+
+static constexpr unsigned
+RoundUpPowerOfTwo(unsigned n) noexcept
+{
+	unsigned result = 1;
+	while (result < n)
+		result <<= 1;
+	return result;
+}
+
+QueuePriorityTree::QueuePriorityTree(unsigned max_length) noexcept
+	:capacity(RoundUpPowerOfTwo(max_length)),
+	 min(new uint8_t[2 * capacity]),
+	 max(new uint8_t[2 * capacity])
+{
+	std::fill_n(min.get(), 2 * capacity, EMPTY_MIN);
+	std::fill_n(max.get(), 2 * capacity, EMPTY_MAX);
+}
+
+inline void
+QueuePriorityTree::UpdateNode(unsigned node) noexcept
+{
+	min[node] = std::min(min[2 * node], min[2 * node + 1]);
+	max[node] = std::max(max[2 * node], max[2 * node + 1]);
+}
+
+void
+QueuePriorityTree::Set(unsigned i, uint8_t priority) noexcept
+{
+	assert(i < capacity);
+
+	Assign(i, priority);
+
+	for (unsigned node = (capacity + i) / 2; node > 0; node /= 2)
+		UpdateNode(node);
+}
+
+void
+QueuePriorityTree::Erase(unsigned start, unsigned end) noexcept
+{
+	assert(start <= end);
+	assert(end <= capacity);
+
+	std::fill(min.get() + capacity + start, min.get() + capacity + end,
+		  EMPTY_MIN);
+	std::fill(max.get() + capacity + start, max.get() + capacity + end,
+		  EMPTY_MAX);
+
+	Update(start, end);
+}
+
+void
+QueuePriorityTree::Update(unsigned start, unsigned end) noexcept
+{
+	assert(start <= end);
+	assert(end <= capacity);
+
+	if (start == end)
+		return;
+
+	/* walk up level by level, updating only the nodes which
+	   cover the range */
+	unsigned first = capacity + start, last = capacity + end - 1;
+	while (first > 1) {
+		first /= 2;
+		last /= 2;
+
+		for (unsigned node = first; node <= last; ++node)
+			UpdateNode(node);
+	}
+}
+
+template<typename P>
+unsigned
+QueuePriorityTree::Find(unsigned node, unsigned left, unsigned right,
+			unsigned start, P p) const noexcept
+{
+	if (right <= start || !p(min[node], max[node]))
+		return capacity;
+
+	if (right - left == 1)
+		return left;
+
+	const unsigned middle = (left + right) / 2;
+	const unsigned result = Find(2 * node, left, middle, start, p);
+	if (result != capacity)
+		return result;
+
+	return Find(2 * node + 1, middle, right, start, p);
+}
+
+unsigned
+QueuePriorityTree::FindAtMost(unsigned start,
+			      uint8_t priority) const noexcept
+{
+	return Find(1, 0, capacity, start,
+		    [priority](uint8_t _min, uint8_t){
+			    return _min <= priority;
+		    });
+}
+
+unsigned
+QueuePriorityTree::FindNotEqual(unsigned start,
+				uint8_t priority) const noexcept
+{
+	return Find(1, 0, capacity, start,
+		    [priority](uint8_t _min, uint8_t _max){
+			    return _min != priority || _max != priority;
+		    });
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_PRIORITY_TREE_HXX
+#define MPD_QUEUE_PRIORITY_TREE_HXX
+
+#include "util/Compiler.h"
+
+#include <memory>
+
+#include <stdint.h>
+
+/**
+ * A segment tree over the order numbers of a #Queue which stores the
+ * minimum and the maximum priority of each subtree.  This allows
+ * finding the next order number with a certain priority in O(log n)
+ * instead of walking the "order" array.
+ *
+ * Unused slots have the minimum 255 and the maximum 0, which makes
+ * FindAtMost(255) and FindNotEqual() return the first unused slot,
+ * i.e. the queue length.
+ */
+class QueuePriorityTree {
+	/**
+	 * The number of leaves; a power of two.
+	 */
+	const unsigned capacity;
+
+	/**
+	 * The nodes in heap layout: node 1 is the root, the children
+	 * of node n are 2n and 2n+1, and the leaves start at
+	 * #capacity.
+	 */
+	const std::unique_ptr<uint8_t[]> min, max;
+
+public:
+	explicit QueuePriorityTree(unsigned max_length) noexcept;
+
+	/**
+	 * Set the priority of one slot and update its ancestors.
+	 */
+	void Set(unsigned i, uint8_t priority) noexcept;
+
+	/**
+	 * Set the priority of one slot, but do not update its
+	 * ancestors.  After a series of Assign() calls, call
+	 * Update().
+	 */
+	void Assign(unsigned i, uint8_t priority) noexcept {
+		min[capacity + i] = max[capacity + i] = priority;
+	}
+
+	/**
+	 * Mark a range of slots as unused.
+	 */
+	void Erase(unsigned start, unsigned end) noexcept;
+
+	/**
+	 * Update the ancestors of the given range of slots.
+	 */
+	void Update(unsigned start, unsigned end) noexcept;
+
+	/**
+	 * Find the first slot at or after #start with a priority
+	 * which is not bigger than the given one.
+	 *
+	 * @return the slot number or a number beyond the last used
+	 * slot if there is none
+	 */
+	gcc_pure
+	unsigned FindAtMost(unsigned start, uint8_t priority) const noexcept;
+
+	/**
+	 * Find the first slot at or after #start with a priority
+	 * different from the given one.
+	 */
+	gcc_pure
+	unsigned FindNotEqual(unsigned start, uint8_t priority) const noexcept;
+
+private:
+	void UpdateNode(unsigned node) noexcept;
+
+	/**
+	 * Find the first leaf at or after #start in the subtree of
+	 * #node (which covers the slots [#left, #right)) for which
+	 * #p returns true.  #p is called with the minimum and maximum
+	 * of each node, and must return true if the node may contain
+	 * a matching slot.
+	 */
+	template<typename P>
+	unsigned Find(unsigned node, unsigned left, unsigned right,
+		      unsigned start, P p) const noexcept;
+};
+
+#endif
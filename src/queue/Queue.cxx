@@ -25,6 +25,8 @@ Queue::Queue(unsigned _max_length) noexcept
 	:max_length(_max_length),
 	 items(new Item[max_length]),
 	 order(new unsigned[max_length]),
+	 position_order(new unsigned[max_length]),
+	 priority_tree(max_length),
 	 id_table(max_length * HASH_MULT)
 {
 }
@@ -35,6 +37,7 @@ Queue::~Queue() noexcept
 
 	delete[] items;
 	delete[] order;
+	delete[] position_order;
 }
 
 int
@@ -93,6 +96,9 @@ Queue::Append(DetachedSong &&song, uint8_t priority) noexcept
 	item.priority = priority;
 
 	order[position] = position;
+	OrderChanged(position);
+
+	search_index.Add(id, *item.song);
 
 	return id;
 }
@@ -110,6 +116,13 @@ Queue::SwapPositions(unsigned position1, unsigned position2) noexcept
 
 	id_table.Move(id1, position2);
 	id_table.Move(id2, position1);
+
+	/* the order numbers still refer to the same positions, but
+	   the items (and their priorities) have been swapped */
+	priority_tree.Set(PositionToOrder(position1),
+			  items[position1].priority);
+	priority_tree.Set(PositionToOrder(position2),
+			  items[position2].priority);
 }
 
 void
@@ -146,6 +159,8 @@ Queue::MovePostion(unsigned from, unsigned to) noexcept
 				order[i] = to;
 		}
 	}
+
+	OrderRangeChanged(0, length);
 }
 
 void
@@ -188,6 +203,8 @@ Queue::MoveRange(unsigned start, unsigned end, unsigned to) noexcept
 				order[i] += to - start;
 		}
 	}
+
+	OrderRangeChanged(0, length);
 }
 
 unsigned
@@ -207,6 +224,9 @@ Queue::MoveOrder(unsigned from_order, unsigned to_order) noexcept
 	}
 
 	order[to_order] = from_position;
+
+	OrderRangeChanged(std::min(from_order, to_order),
+			  std::max(from_order, to_order) + 1);
 	return to_order;
 }
 
@@ -233,6 +253,7 @@ Queue::DeletePosition(unsigned position) noexcept
 {
 	assert(position < length);
 
+	search_index.Remove(items[position].id, *items[position].song);
 	delete items[position].song;
 
 	const unsigned id = PositionToId(position);
@@ -259,6 +280,9 @@ Queue::DeletePosition(unsigned position) noexcept
 	for (unsigned i = 0; i < length; i++)
 		if (order[i] > position)
 			--order[i];
+
+	priority_tree.Erase(length, length + 1);
+	OrderRangeChanged(0, length);
 }
 
 void
@@ -272,9 +296,78 @@ Queue::Clear() noexcept
 		id_table.Erase(item->id);
 	}
 
+	search_index.Clear();
+	priority_tree.Erase(0, length);
+
 	length = 0;
 }
 
+/**
+ * Convert a list of song ids (which may contain duplicates) to a
+ * sorted list of positions.
+ */
+static std::vector<unsigned>
+IdsToPositions(const IdTable &id_table, std::vector<unsigned> &&ids) noexcept
+{
+	for (auto &i : ids) {
+		const int position = id_table.IdToPosition(i);
+		assert(position >= 0);
+		i = position;
+	}
+
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+	return std::move(ids);
+}
+
+std::vector<unsigned>
+Queue::FindURI(const char *uri) const noexcept
+{
+	std::vector<unsigned> ids;
+	search_index.FindURI(uri, ids);
+
+	auto positions = IdsToPositions(id_table, std::move(ids));
+
+	/* eliminate hash collisions */
+	positions.erase(std::remove_if(positions.begin(), positions.end(),
+				       [this, uri](unsigned i){
+					       return !Get(i).IsURI(uri);
+				       }),
+			positions.end());
+	return positions;
+}
+
+std::vector<unsigned>
+Queue::FindTagCandidates(TagType type, const char *value) const noexcept
+{
+	if (!search_index.IsTagEnabled(type)) {
+		search_index.EnableTag(type);
+
+		for (unsigned i = 0; i < length; ++i)
+			search_index.AddTag(type, items[i].id,
+					    *items[i].song);
+	}
+
+	std::vector<unsigned> ids;
+	search_index.FindTag(type, value, ids);
+	return IdsToPositions(id_table, std::move(ids));
+}
+
+void
+Queue::OrderRangeChanged(unsigned start, unsigned end) noexcept
+{
+	assert(start <= end);
+	assert(end <= length);
+
+	for (unsigned i = start; i < end; ++i) {
+		const unsigned position = order[i];
+		position_order[position] = i;
+		priority_tree.Assign(i, items[position].priority);
+	}
+
+	priority_tree.Update(start, end);
+}
+
 static void
 queue_sort_order_by_priority(Queue *queue,
 			     unsigned start, unsigned end) noexcept
@@ -303,6 +396,8 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end) noexcept
 
 	rand.AutoCreate();
 	std::shuffle(order + start, order + end, rand);
+
+	OrderRangeChanged(start, end);
 }
 
 /**
@@ -319,7 +414,9 @@ Queue::ShuffleOrderRangeWithPriority(unsigned start, unsigned end) noexcept
 	if (start == end)
 		return;
 
-	/* first group the range by priority */
+	/* first group the range by priority; this doesn't need to
+	   call OrderRangeChanged(), because ShuffleOrderRange() does
+	   it for each group */
 	queue_sort_order_by_priority(this, start, end);
 
 	/* now shuffle each priority group */
@@ -366,12 +463,12 @@ Queue::ShuffleOrderLastWithPriority(unsigned start, unsigned end) noexcept
 
 	/* skip all items at the start which have a higher priority,
 	   because the last item shall only be shuffled within its
-	   priority group */
+	   priority group; the range is sorted by descending priority,
+	   so the first item which is not higher has the same
+	   priority */
 	const auto last_priority = items[OrderToPosition(end - 1)].priority;
-	while (items[OrderToPosition(start)].priority != last_priority) {
-		++start;
-		assert(start < end);
-	}
+	start = priority_tree.FindAtMost(start, last_priority);
+	assert(start < end);
 
 	rand.AutoCreate();
 
@@ -402,14 +499,11 @@ Queue::FindPriorityOrder(unsigned start_order, uint8_t priority,
 	assert(random);
 	assert(start_order <= length);
 
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority <= priority && i != exclude_order)
-			return i;
-	}
+	unsigned i = priority_tree.FindAtMost(start_order, priority);
+	if (i == exclude_order)
+		i = priority_tree.FindAtMost(i + 1, priority);
 
-	return length;
+	return std::min(i, length);
 }
 
 unsigned
@@ -418,14 +512,8 @@ Queue::CountSamePriority(unsigned start_order, uint8_t priority) const noexcept
 	assert(random);
 	assert(start_order <= length);
 
-	for (unsigned i = start_order; i < length; ++i) {
-		const unsigned position = OrderToPosition(i);
-		const Item *item = &items[position];
-		if (item->priority != priority)
-			return i - start_order;
-	}
-
-	return length - start_order;
+	const unsigned i = priority_tree.FindNotEqual(start_order, priority);
+	return std::min(i, length) - start_order;
 }
 
 bool
@@ -441,6 +529,7 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 
 	item->version = version;
 	item->priority = priority;
+	priority_tree.Set(PositionToOrder(position), priority);
 
 	if (!random || !reorder)
 		/* don't reorder if not in random mode */
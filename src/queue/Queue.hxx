@@ -22,10 +22,13 @@
 
 #include "util/Compiler.h"
 #include "IdTable.hxx"
+#include "SearchIndex.hxx"
+#include "PriorityTree.hxx"
 #include "SingleMode.hxx"
 #include "util/LazyRandomEngine.hxx"
 
 #include <algorithm>
+#include <vector>
 
 #include <assert.h>
 #include <stdint.h>
@@ -85,9 +88,26 @@ struct Queue {
 	/** map order numbers to positions */
 	unsigned *const order;
 
+	/** map positions to order numbers (the inverse of #order) */
+	unsigned *const position_order;
+
+	/**
+	 * The priorities of all items, indexed by order number.  This
+	 * must be updated whenever #order or an item's priority
+	 * changes.
+	 */
+	QueuePriorityTree priority_tree;
+
 	/** map song ids to positions */
 	IdTable id_table;
 
+	/**
+	 * Look up songs by URI or tag value.  This is "mutable"
+	 * because tag indexes are created on demand by const
+	 * methods.
+	 */
+	mutable QueueSearchIndex search_index;
+
 	/** repeat playback when the end of the queue has been
 	    reached? */
 	bool repeat = false;
@@ -172,12 +192,7 @@ struct Queue {
 	unsigned PositionToOrder(unsigned position) const noexcept {
 		assert(position < length);
 
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
-
-			if (order[i] == position)
-				return i;
-		}
+		return position_order[position];
 	}
 
 	gcc_pure
@@ -259,6 +274,52 @@ struct Queue {
 	 */
 	void ModifyAtOrder(unsigned order) noexcept;
 
+	/**
+	 * Prepare for modifying the URI or the tags of the song at
+	 * the specified position: this removes it from the search
+	 * index.  After the modification, EndModifySong() must be
+	 * called.
+	 */
+	DetachedSong &BeginModifySong(unsigned position) noexcept {
+		assert(position < length);
+
+		const auto &item = items[position];
+		search_index.Remove(item.id, *item.song);
+		return *item.song;
+	}
+
+	/**
+	 * Finish a modification started by BeginModifySong(): add the
+	 * song to the search index again and mark it as "modified"
+	 * (see ModifyAtPosition()).
+	 */
+	void EndModifySong(unsigned position) noexcept {
+		assert(position < length);
+
+		const auto &item = items[position];
+		search_index.Add(item.id, *item.song);
+		ModifyAtPosition(position);
+	}
+
+	/**
+	 * Determine the positions of all songs with the given URI.
+	 *
+	 * @return a sorted list of positions
+	 */
+	gcc_pure
+	std::vector<unsigned> FindURI(const char *uri) const noexcept;
+
+	/**
+	 * Determine the positions of all songs which may have the
+	 * given tag value; the index for this tag type is created if
+	 * it does not exist yet.  The result may contain false
+	 * positives, and the caller must check each song.
+	 *
+	 * @return a sorted list of positions
+	 */
+	std::vector<unsigned> FindTagCandidates(TagType type,
+						const char *value) const noexcept;
+
 	/**
 	 * Appends a song to the queue and returns its position.  Prior to
 	 * that, the caller must check if the queue is already full.
@@ -281,6 +342,8 @@ struct Queue {
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) noexcept {
 		std::swap(order[order1], order[order2]);
+		OrderChanged(order1);
+		OrderChanged(order2);
 	}
 
 	/**
@@ -334,6 +397,8 @@ struct Queue {
 	void RestoreOrder() noexcept {
 		for (unsigned i = 0; i < length; ++i)
 			order[i] = i;
+
+		OrderRangeChanged(0, length);
 	}
 
 	/**
@@ -378,6 +443,23 @@ struct Queue {
 			      uint8_t priority, int after_order) noexcept;
 
 private:
+	/**
+	 * Update #position_order and #priority_tree after the given
+	 * #order element has been modified.
+	 */
+	void OrderChanged(unsigned _order) noexcept {
+		const unsigned position = order[_order];
+		position_order[position] = _order;
+		priority_tree.Set(_order, items[position].priority);
+	}
+
+	/**
+	 * Like OrderChanged(), but for a range of order numbers.
+	 * This must also be called after items have been moved to
+	 * other positions.
+	 */
+	void OrderRangeChanged(unsigned start, unsigned end) noexcept;
+
 	void MoveItemTo(unsigned from, unsigned to) noexcept {
 		unsigned from_id = items[from].id;
 
@@ -388,7 +470,7 @@ private:
 
 	/**
 	 * Find the first item that has this specified priority or
-	 * higher.
+	 * lower.
 	 */
 	gcc_pure
 	unsigned FindPriorityOrder(unsigned start_order, uint8_t priority,
@@ -21,6 +21,8 @@
 #include "QueuePrint.hxx"
 #include "Queue.hxx"
 #include "song/Filter.hxx"
+#include "song/TagSongFilter.hxx"
+#include "song/UriSongFilter.hxx"
 #include "SongPrint.hxx"
 #include "song/DetachedSong.hxx"
 #include "song/LightSong.hxx"
@@ -108,10 +110,63 @@ queue_print_changes_position(Response &r, const Queue &queue,
 				 i, queue.PositionToId(i));
 }
 
+/**
+ * Use the queue's search index to find the songs which may match the
+ * filter.  This is only possible if the filter contains a
+ * case-sensitive equality check for the URI or a tag.
+ *
+ * @return true if #positions was filled with candidates, false if
+ * all songs need to be checked
+ */
+static bool
+queue_find_candidates(const Queue &queue, const SongFilter &filter,
+		      std::vector<unsigned> &positions) noexcept
+{
+	const TagSongFilter *best_tag = nullptr;
+
+	for (const auto &i : filter.GetItems()) {
+		const auto *uri = dynamic_cast<const UriSongFilter *>(i.get());
+		if (uri != nullptr && !uri->IsNegated() &&
+		    !uri->GetFoldCase()) {
+			positions = queue.FindURI(uri->GetValue().c_str());
+			return true;
+		}
+
+		const auto *tag = dynamic_cast<const TagSongFilter *>(i.get());
+		if (tag != nullptr && best_tag == nullptr &&
+		    !tag->IsNegated() && !tag->GetFoldCase() &&
+		    tag->GetTagType() < TAG_NUM_OF_ITEM_TYPES &&
+		    /* an empty value matches songs which don't
+		       have this tag at all; they are not in the
+		       index */
+		    !tag->GetValue().empty())
+			best_tag = tag;
+	}
+
+	if (best_tag == nullptr)
+		return false;
+
+	positions = queue.FindTagCandidates(best_tag->GetTagType(),
+					    best_tag->GetValue().c_str());
+	return true;
+}
+
 void
 queue_find(Response &r, const Queue &queue,
 	   const SongFilter &filter)
 {
+	std::vector<unsigned> positions;
+	if (queue_find_candidates(queue, filter, positions)) {
+		for (unsigned i : positions) {
+			const LightSong song{queue.Get(i)};
+
+			if (filter.Match(song))
+				queue_print_song_info(r, queue, i);
+		}
+
+		return;
+	}
+
 	for (unsigned i = 0; i < queue.GetLength(); i++) {
 		const LightSong song{queue.Get(i)};
 
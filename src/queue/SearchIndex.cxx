@@ -0,0 +1,167 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SearchIndex.hxx"
+#include "song/DetachedSong.hxx"
+#include "tag/Tag.hxx"
+#include "util/Fnv1aHash.hxx"
+
+#include <assert.h>
+#include <string.h>
+
+/**
+ * Invoke a function for each value of the given tag type which shall
+ * be indexed.  This mimics the "albumartist" fallback of
+ * #TagSongFilter: if a song has no "albumartist", it is found by its
+ * "artist".
+ */
+template<typename F>
+static void
+ForEachTagValue(TagType type, const Tag &tag, F &&f) noexcept
+{
+	bool found = false;
+
+	for (const auto &item : tag) {
+		if (item.type == type) {
+			f(item.value);
+			found = true;
+		}
+	}
+
+	if (!found && type == TAG_ALBUM_ARTIST)
+		for (const auto &item : tag)
+			if (item.type == TAG_ARTIST)
+				f(item.value);
+}
+
+template<typename M>
+static void
+EraseOne(M &map, size_t hash, unsigned id) noexcept
+{
+	auto i = map.find(hash);
+	if (i != map.end()) {
+		auto &ids = i->second;
+		auto j = ids.find(id);
+		if (j != ids.end()) {
+			ids.erase(j);
+			if (ids.empty())
+				map.erase(i);
+			return;
+		}
+	}
+
+	/* the song was not indexed with this value - this means
+	   somebody has modified it without calling
+	   Queue::BeginModifySong() */
+	assert(false);
+}
+
+template<typename M>
+static void
+CollectIds(const M &map, size_t hash, std::vector<unsigned> &ids)
+{
+	const auto i = map.find(hash);
+	if (i != map.end())
+		ids.insert(ids.end(), i->second.begin(), i->second.end());
+}
+
+QueueSearchIndex::QueueSearchIndex() noexcept = default;
+QueueSearchIndex::~QueueSearchIndex() noexcept = default;
+
+size_t
+QueueSearchIndex::Hash(const char *value) noexcept
+{
+	Fnv1aHash hash;
+	hash.Update(value, strlen(value));
+	return size_t(hash.Get());
+}
+
+void
+QueueSearchIndex::Add(unsigned id, const DetachedSong &song) noexcept
+{
+	uris[Hash(song.GetURI())].insert(id);
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (tags[i] != nullptr)
+			AddTag(TagType(i), id, song);
+}
+
+void
+QueueSearchIndex::Remove(unsigned id, const DetachedSong &song) noexcept
+{
+	EraseOne(uris, Hash(song.GetURI()), id);
+
+	const Tag &tag = song.GetTag();
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		auto *map = tags[i].get();
+		if (map == nullptr)
+			continue;
+
+		ForEachTagValue(TagType(i), tag, [map, id](const char *value){
+				EraseOne(*map, Hash(value), id);
+			});
+	}
+}
+
+void
+QueueSearchIndex::Clear() noexcept
+{
+	uris.clear();
+
+	for (auto &i : tags)
+		if (i != nullptr)
+			i->clear();
+}
+
+void
+QueueSearchIndex::EnableTag(TagType type) noexcept
+{
+	assert(type < TAG_NUM_OF_ITEM_TYPES);
+	assert(tags[type] == nullptr);
+
+	tags[type] = std::make_unique<Map>();
+}
+
+void
+QueueSearchIndex::AddTag(TagType type, unsigned id,
+			 const DetachedSong &song) noexcept
+{
+	auto *map = tags[type].get();
+	assert(map != nullptr);
+
+	ForEachTagValue(type, song.GetTag(), [map, id](const char *value){
+			(*map)[Hash(value)].insert(id);
+		});
+}
+
+void
+QueueSearchIndex::FindURI(const char *uri, std::vector<unsigned> &ids) const
+{
+	CollectIds(uris, Hash(uri), ids);
+}
+
+void
+QueueSearchIndex::FindTag(TagType type, const char *value,
+			  std::vector<unsigned> &ids) const
+{
+	assert(IsTagEnabled(type));
+
+	CollectIds(*tags[type], Hash(value), ids);
+}
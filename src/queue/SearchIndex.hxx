@@ -0,0 +1,125 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_SEARCH_INDEX_HXX
+#define MPD_QUEUE_SEARCH_INDEX_HXX
+
+#include "tag/Type.h"
+#include "util/Compiler.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <vector>
+
+#include <stddef.h>
+
+class DetachedSong;
+
+/**
+ * A hash index over the songs in a #Queue, which allows looking up
+ * songs by their URI or by a tag value without iterating the whole
+ * queue.  Songs are referenced by their queue id, which does not
+ * change when songs are moved.
+ *
+ * The index stores only hashes, not the strings.  Therefore, a
+ * lookup returns candidates which may be false positives, and the
+ * caller has to verify each one.
+ *
+ * The URI index is always maintained; an index for a tag type gets
+ * built on demand (see EnableTag()), because most of them are never
+ * used for searching.
+ */
+class QueueSearchIndex {
+	/**
+	 * Maps a value hash to the ids of all songs which have this
+	 * value.  The ids are kept in a hashed (multi)set, so removing
+	 * one does not need to scan all songs with the same value; a
+	 * song may be in it more than once if it has the same tag
+	 * value twice.
+	 */
+	typedef std::unordered_map<size_t, std::unordered_multiset<unsigned>> Map;
+
+	Map uris;
+
+	/**
+	 * Per-tag indexes; nullptr if the index for that tag type is
+	 * not enabled.
+	 */
+	std::unique_ptr<Map> tags[TAG_NUM_OF_ITEM_TYPES];
+
+public:
+	QueueSearchIndex() noexcept;
+	~QueueSearchIndex() noexcept;
+
+	QueueSearchIndex(const QueueSearchIndex &) = delete;
+	QueueSearchIndex &operator=(const QueueSearchIndex &) = delete;
+
+	gcc_pure
+	static size_t Hash(const char *value) noexcept;
+
+	/**
+	 * Add a song to the index.
+	 */
+	void Add(unsigned id, const DetachedSong &song) noexcept;
+
+	/**
+	 * Remove a song from the index.  The song must have the same
+	 * URI and tags as when it was added.
+	 */
+	void Remove(unsigned id, const DetachedSong &song) noexcept;
+
+	/**
+	 * Remove all songs from the index.
+	 */
+	void Clear() noexcept;
+
+	bool IsTagEnabled(TagType type) const noexcept {
+		return tags[type] != nullptr;
+	}
+
+	/**
+	 * Create an (empty) index for the given tag type.  After
+	 * that, the caller must Add() all songs to it with
+	 * AddTag().
+	 */
+	void EnableTag(TagType type) noexcept;
+
+	/**
+	 * Add a song to the given tag index.  This is only used
+	 * while populating a new tag index after EnableTag().
+	 */
+	void AddTag(TagType type, unsigned id,
+		    const DetachedSong &song) noexcept;
+
+	/**
+	 * Append the ids of all songs which may have the given URI
+	 * to the vector.
+	 */
+	void FindURI(const char *uri, std::vector<unsigned> &ids) const;
+
+	/**
+	 * Append the ids of all songs which may have the given tag
+	 * value to the vector.  The tag index must be enabled.
+	 */
+	void FindTag(TagType type, const char *value,
+		     std::vector<unsigned> &ids) const;
+};
+
+#endif
@@ -22,8 +22,26 @@
 #include "song/LightSong.hxx"
 #include "util/UriUtil.hxx"
 #include "fs/Traits.hxx"
+#include "thread/Mutex.hxx"
 
-DetachedSong::DetachedSong(const LightSong &other)
+#include <unordered_map>
+
+#include <assert.h>
+
+struct DetachedSong::InternTable {
+	/**
+	 * Protects #map and the last reference of interned bodies.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Interned bodies of database songs, indexed by their URI.
+	 * An entry is removed when its body is freed.
+	 */
+	std::unordered_map<std::string, Body *> map;
+};
+
+DetachedSong::Body::Body(const LightSong &other)
 	:uri(other.GetURI()),
 	 real_uri(other.real_uri != nullptr ? other.real_uri : ""),
 	 tag(other.tag),
@@ -31,14 +49,68 @@ DetachedSong::DetachedSong(const LightSong &other)
 	 start_time(other.start_time),
 	 end_time(other.end_time) {}
 
+DetachedSong::DetachedSong(const LightSong &other)
+	:body(new Body(other)) {}
+
+DetachedSong::Body DetachedSong::empty_body;
+DetachedSong::InternTable DetachedSong::intern_table;
+
+DetachedSong
+DetachedSong::Intern(DetachedSong &&src)
+{
+	assert(!src.IsShared());
+
+	const std::lock_guard<Mutex> protect(intern_table.mutex);
+
+	auto &slot = intern_table.map[src.body->uri];
+	if (slot != nullptr && slot->IsSameVersion(*src.body))
+		return DetachedSong(Ref(slot));
+
+	/* a stale body (from before a database update) stays alive
+	   as long as somebody refers to it, but it gets replaced in
+	   the table */
+	src.body->interned = true;
+	slot = src.body;
+	return std::move(src);
+}
+
+void
+DetachedSong::UnrefInterned(Body *b) noexcept
+{
+	assert(b->interned);
+
+	{
+		const std::lock_guard<Mutex> protect(intern_table.mutex);
+
+		if (b->ref.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		auto i = intern_table.map.find(b->uri);
+		if (i != intern_table.map.end() && i->second == b)
+			intern_table.map.erase(i);
+	}
+
+	delete b;
+}
+
+void
+DetachedSong::Unshare()
+{
+	Body *copy = new Body(*body);
+	Unref(body);
+	body = copy;
+}
+
 DetachedSong::operator LightSong() const noexcept
 {
-	LightSong result(uri.c_str(), tag);
+	LightSong result(body->uri.c_str(), body->tag);
 	result.directory = nullptr;
-	result.real_uri = real_uri.empty() ? nullptr : real_uri.c_str();
-	result.mtime = mtime;
-	result.start_time = start_time;
-	result.end_time = end_time;
+	result.real_uri = body->real_uri.empty()
+		? nullptr
+		: body->real_uri.c_str();
+	result.mtime = body->mtime;
+	result.start_time = body->start_time;
+	result.end_time = body->end_time;
 	return result;
 }
 
@@ -67,7 +139,8 @@ DetachedSong::IsInDatabase() const noexcept
 SignedSongTime
 DetachedSong::GetDuration() const noexcept
 {
-	SongTime a = start_time, b = end_time;
+	const Tag &tag = body->tag;
+	SongTime a = body->start_time, b = body->end_time;
 	if (!b.IsPositive()) {
 		if (tag.duration.IsNegative())
 			return tag.duration;
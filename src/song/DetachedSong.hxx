@@ -25,6 +25,7 @@
 #include "Chrono.hxx"
 #include "util/Compiler.h"
 
+#include <atomic>
 #include <chrono>
 #include <string>
 #include <utility>
@@ -33,67 +34,137 @@ struct LightSong;
 class Storage;
 class Path;
 
+/**
+ * A song which is not attached to the database.
+ *
+ * The actual data lives in a reference-counted #Body which is shared
+ * between copies and gets duplicated only when one of them is
+ * modified ("copy-on-write").  This makes copying (e.g. from the
+ * queue to the player) cheap, and it avoids locking the tag pool.
+ * Since the reference counter is atomic, copies may be passed to
+ * other threads, but a single instance must not be accessed
+ * concurrently.
+ */
 class DetachedSong {
 	friend DetachedSong DatabaseDetachSong(const Storage &db,
 					       const LightSong &song);
 
-	/**
-	 * An UTF-8-encoded URI referring to the song file.  This can
-	 * be one of:
-	 *
-	 * - an absolute URL with a scheme
-	 *   (e.g. "http://example.com/foo.mp3")
-	 *
-	 * - an absolute file name
-	 *
-	 * - a file name relative to the music directory
-	 */
-	std::string uri;
-
-	/**
-	 * The "real" URI, the one to be used for opening the
-	 * resource.  If this attribute is empty, then #uri shall be
-	 * used.
-	 *
-	 * This attribute is used for songs from the database which
-	 * have a relative URI.
-	 */
-	std::string real_uri;
-
-	Tag tag;
-
-	/**
-	 * The time stamp of the last file modification.  A negative
-	 * value means that this is unknown/unavailable.
-	 */
-	std::chrono::system_clock::time_point mtime =
-		std::chrono::system_clock::time_point::min();
-
-	/**
-	 * Start of this sub-song within the file.
-	 */
-	SongTime start_time = SongTime::zero();
+	struct Body {
+		std::atomic_uint ref{1};
+
+		/**
+		 * Is this body registered in the table of database
+		 * songs (see Intern())?  Such a body is never
+		 * modified, and its last reference is released with
+		 * the table's mutex held.
+		 */
+		bool interned = false;
+
+		/**
+		 * An UTF-8-encoded URI referring to the song file.
+		 * This can be one of:
+		 *
+		 * - an absolute URL with a scheme
+		 *   (e.g. "http://example.com/foo.mp3")
+		 *
+		 * - an absolute file name
+		 *
+		 * - a file name relative to the music directory
+		 */
+		std::string uri;
+
+		/**
+		 * The "real" URI, the one to be used for opening the
+		 * resource.  If this attribute is empty, then #uri
+		 * shall be used.
+		 *
+		 * This attribute is used for songs from the database
+		 * which have a relative URI.
+		 */
+		std::string real_uri;
+
+		Tag tag;
+
+		/**
+		 * The time stamp of the last file modification.  A
+		 * negative value means that this is
+		 * unknown/unavailable.
+		 */
+		std::chrono::system_clock::time_point mtime =
+			std::chrono::system_clock::time_point::min();
+
+		/**
+		 * Start of this sub-song within the file.
+		 */
+		SongTime start_time = SongTime::zero();
+
+		/**
+		 * End of this sub-song within the file.
+		 * Unused if zero.
+		 */
+		SongTime end_time = SongTime::zero();
+
+		Body() = default;
+
+		explicit Body(const char *_uri)
+			:uri(_uri) {}
+
+		explicit Body(const std::string &_uri)
+			:uri(_uri) {}
+
+		explicit Body(std::string &&_uri)
+			:uri(std::move(_uri)) {}
+
+		template<typename U>
+		Body(U &&_uri, Tag &&_tag)
+			:uri(std::forward<U>(_uri)), tag(std::move(_tag)) {}
+
+		explicit Body(const LightSong &other);
+
+		Body(const Body &src)
+			:uri(src.uri), real_uri(src.real_uri),
+			 tag(src.tag), mtime(src.mtime),
+			 start_time(src.start_time),
+			 end_time(src.end_time) {}
+
+		Body &operator=(const Body &) = delete;
+
+		/**
+		 * Does this body describe the same version of the
+		 * same song?  The tag is compared, too, because a
+		 * rescan (e.g. with a different "metadata_to_use")
+		 * may change it without touching #mtime.
+		 */
+		gcc_pure
+		bool IsSameVersion(const Body &other) const noexcept {
+			return uri == other.uri &&
+				real_uri == other.real_uri &&
+				mtime == other.mtime &&
+				start_time == other.start_time &&
+				end_time == other.end_time &&
+				tag.IsSame(other.tag);
+		}
+	};
 
 	/**
-	 * End of this sub-song within the file.
-	 * Unused if zero.
+	 * Never nullptr.  A moved-from instance refers to a shared
+	 * empty body.
 	 */
-	SongTime end_time = SongTime::zero();
+	Body *body;
 
 public:
 	explicit DetachedSong(const char *_uri)
-		:uri(_uri) {}
+		:body(new Body(_uri)) {}
 
 	explicit DetachedSong(const std::string &_uri)
-		:uri(_uri) {}
+		:body(new Body(_uri)) {}
 
 	explicit DetachedSong(std::string &&_uri)
-		:uri(std::move(_uri)) {}
+		:body(new Body(std::move(_uri))) {}
 
 	template<typename U>
 	DetachedSong(U &&_uri, Tag &&_tag)
-		:uri(std::forward<U>(_uri)),
-		 tag(std::move(_tag)) {}
+		:body(new Body(std::forward<U>(_uri), std::move(_tag))) {}
 
 	/**
 	 * Copy data from a #LightSong instance.  Usually, you should
@@ -102,26 +173,51 @@ public:
 	 */
 	explicit DetachedSong(const LightSong &other);
 
+	/**
+	 * Share the #Body with other instances describing the same
+	 * version of the same song (see Body::IsSameVersion()), or
+	 * register this one for sharing.  This is used for songs
+	 * from the database, so all queues and players referring to
+	 * one database song share one #Body.
+	 *
+	 * @param src a new instance which is not shared
+	 */
+	static DetachedSong Intern(DetachedSong &&src);
+
 	gcc_noinline
-	~DetachedSong() = default;
+	~DetachedSong() noexcept {
+		Unref(body);
+	}
+
+	/**
+	 * Copying shares the #Body.
+	 */
+	explicit DetachedSong(const DetachedSong &src) noexcept
+		:body(Ref(src.body)) {}
+
+	DetachedSong(DetachedSong &&src) noexcept
+		:body(std::exchange(src.body, GetEmptyBody())) {}
+
+	DetachedSong &operator=(DetachedSong &&src) noexcept {
+		if (this != &src) {
+			Unref(body);
+			body = std::exchange(src.body, GetEmptyBody());
+		}
 
-	/* these are declared because the user-defined destructor
-	   above prevents them from being generated implicitly */
-	explicit DetachedSong(const DetachedSong &) = default;
-	DetachedSong(DetachedSong &&) = default;
-	DetachedSong &operator=(DetachedSong &&) = default;
+		return *this;
+	}
 
 	gcc_pure
 	explicit operator LightSong() const noexcept;
 
 	gcc_pure
 	const char *GetURI() const noexcept {
-		return uri.c_str();
+		return body->uri.c_str();
 	}
 
 	template<typename T>
 	void SetURI(T &&_uri) {
-		uri = std::forward<T>(_uri);
+		Mutate().uri = std::forward<T>(_uri);
 	}
 
 	/**
@@ -130,7 +226,7 @@ public:
 	 */
 	gcc_pure
 	bool HasRealURI() const noexcept {
-		return !real_uri.empty();
+		return !body->real_uri.empty();
 	}
 
 	/**
@@ -139,12 +235,12 @@ public:
 	 */
 	gcc_pure
 	const char *GetRealURI() const noexcept {
-		return (HasRealURI() ? real_uri : uri).c_str();
+		return (HasRealURI() ? body->real_uri : body->uri).c_str();
 	}
 
 	template<typename T>
 	void SetRealURI(T &&_uri) {
-		real_uri = std::forward<T>(_uri);
+		Mutate().real_uri = std::forward<T>(_uri);
 	}
 
 	/**
@@ -153,14 +249,15 @@ public:
 	 */
 	gcc_pure
 	bool IsSame(const DetachedSong &other) const noexcept {
-		return uri == other.uri &&
-			start_time == other.start_time &&
-			end_time == other.end_time;
+		return body == other.body ||
+			(body->uri == other.body->uri &&
+			 body->start_time == other.body->start_time &&
+			 body->end_time == other.body->end_time);
 	}
 
 	gcc_pure gcc_nonnull_all
 	bool IsURI(const char *other_uri) const noexcept {
-		return uri == other_uri;
+		return body->uri == other_uri;
 	}
 
 	gcc_pure
@@ -178,23 +275,31 @@ public:
 	bool IsInDatabase() const noexcept;
 
 	const Tag &GetTag() const noexcept {
-		return tag;
+		return body->tag;
 	}
 
-	Tag &WritableTag() noexcept {
-		return tag;
+	/**
+	 * Obtain a writable reference to the tag.  This unshares the
+	 * #Body; the reference is invalidated by copying this
+	 * object.
+	 */
+	Tag &WritableTag() {
+		return Mutate().tag;
 	}
 
 	void SetTag(const Tag &_tag) {
-		tag = Tag(_tag);
+		Mutate().tag = Tag(_tag);
 	}
 
 	void SetTag(Tag &&_tag) {
-		tag = std::move(_tag);
+		Mutate().tag = std::move(_tag);
 	}
 
 	void MoveTagFrom(DetachedSong &&other) {
-		tag = std::move(other.tag);
+		if (other.IsShared())
+			SetTag(other.GetTag());
+		else
+			SetTag(std::move(other.body->tag));
 	}
 
 	/**
@@ -202,31 +307,35 @@ public:
 	 * array.
 	 */
 	void MoveTagItemsFrom(DetachedSong &&other) {
-		tag.MoveItemsFrom(std::move(other.tag));
+		if (other.IsShared()) {
+			Tag tmp(other.GetTag());
+			Mutate().tag.MoveItemsFrom(std::move(tmp));
+		} else
+			Mutate().tag.MoveItemsFrom(std::move(other.body->tag));
 	}
 
 	std::chrono::system_clock::time_point GetLastModified() const {
-		return mtime;
+		return body->mtime;
 	}
 
 	void SetLastModified(std::chrono::system_clock::time_point _value) {
-		mtime = _value;
+		Mutate().mtime = _value;
 	}
 
 	SongTime GetStartTime() const {
-		return start_time;
+		return body->start_time;
 	}
 
 	void SetStartTime(SongTime _value) {
-		start_time = _value;
+		Mutate().start_time = _value;
 	}
 
 	SongTime GetEndTime() const {
-		return end_time;
+		return body->end_time;
 	}
 
 	void SetEndTime(SongTime _value) {
-		end_time = _value;
+		Mutate().end_time = _value;
 	}
 
 	gcc_pure
@@ -243,6 +352,68 @@ public:
 	 * Load #tag and #mtime from a local file.
 	 */
 	bool LoadFile(Path path) noexcept;
+
+private:
+	/**
+	 * The shared empty #Body which is used by moved-from
+	 * instances.  Its reference counter is not used, and it is
+	 * never freed.
+	 */
+	static Body empty_body;
+
+	/**
+	 * The table of interned bodies, see Intern().
+	 */
+	struct InternTable;
+	static InternTable intern_table;
+
+	explicit DetachedSong(Body *_body) noexcept
+		:body(_body) {}
+
+	static Body *GetEmptyBody() noexcept {
+		return &empty_body;
+	}
+
+	static Body *Ref(Body *b) noexcept {
+		if (b != &empty_body)
+			b->ref.fetch_add(1, std::memory_order_relaxed);
+		return b;
+	}
+
+	static void Unref(Body *b) noexcept {
+		if (b == &empty_body)
+			return;
+
+		if (b->interned)
+			UnrefInterned(b);
+		else if (b->ref.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete b;
+	}
+
+	static void UnrefInterned(Body *b) noexcept;
+
+	/**
+	 * May the #Body be referenced by another instance?  The
+	 * empty body and interned bodies are always treated as
+	 * shared, i.e. they are never modified.
+	 */
+	gcc_pure
+	bool IsShared() const noexcept {
+		return body == &empty_body || body->interned ||
+			body->ref.load(std::memory_order_acquire) > 1;
+	}
+
+	/**
+	 * Make sure this object is the only owner of its #Body, and
+	 * return it for modification.
+	 */
+	Body &Mutate() {
+		if (IsShared())
+			Unshare();
+		return *body;
+	}
+
+	void Unshare();
 };
 
 #endif
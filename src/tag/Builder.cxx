@@ -23,6 +23,7 @@
 #include "Pool.hxx"
 #include "FixString.hxx"
 #include "Tag.hxx"
+#include "thread/MeteredLock.hxx"
 #include "util/WritableBuffer.hxx"
 #include "util/StringView.hxx"
 
@@ -36,7 +37,7 @@ TagBuilder::TagBuilder(const Tag &other) noexcept
 {
 	items.reserve(other.num_items);
 
-	const std::lock_guard<Mutex> protect(tag_pool_lock);
+	const MeteredLock protect(tag_pool_lock, tag_pool_lock_wait);
 
 	for (unsigned i = 0, n = other.num_items; i != n; ++i)
 		items.push_back(tag_pool_dup_item(other.items[i]));
@@ -66,7 +67,7 @@ TagBuilder::operator=(const TagBuilder &other) noexcept
 	items = other.items;
 
 	/* increment the tag pool refcounters */
-	const std::lock_guard<Mutex> protect(tag_pool_lock);
+	const MeteredLock protect(tag_pool_lock, tag_pool_lock_wait);
 	for (auto i : items)
 		tag_pool_dup_item(i);
 
@@ -178,7 +179,7 @@ TagBuilder::Complement(const Tag &other) noexcept
 
 	items.reserve(items.size() + other.num_items);
 
-	const std::lock_guard<Mutex> protect(tag_pool_lock);
+	const MeteredLock protect(tag_pool_lock, tag_pool_lock_wait);
 	for (unsigned i = 0, n = other.num_items; i != n; ++i) {
 		TagItem *item = other.items[i];
 		if (!present[item->type])
@@ -197,7 +198,7 @@ TagBuilder::AddItemInternal(TagType type, StringView value) noexcept
 
 	TagItem *i;
 	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
+		const MeteredLock protect(tag_pool_lock, tag_pool_lock_wait);
 		i = tag_pool_get_item(type, value);
 	}
 
@@ -231,7 +232,7 @@ TagBuilder::AddEmptyItem(TagType type) noexcept
 {
 	TagItem *i;
 	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
+		const MeteredLock protect(tag_pool_lock, tag_pool_lock_wait);
 		i = tag_pool_get_item(type, "");
 	}
 
@@ -242,7 +243,7 @@ void
 TagBuilder::RemoveAll() noexcept
 {
 	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
+		const MeteredLock protect(tag_pool_lock, tag_pool_lock_wait);
 		for (auto i : items)
 			tag_pool_put_item(i);
 	}
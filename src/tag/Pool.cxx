@@ -32,6 +32,7 @@
 #include <stdint.h>
 
 Mutex tag_pool_lock;
+LatencyHistogram tag_pool_lock_wait;
 
 static constexpr size_t NUM_SLOTS = 4093;
 
@@ -22,9 +22,15 @@
 
 #include "Type.h"
 #include "thread/Mutex.hxx"
+#include "util/LatencyHistogram.hxx"
 
 extern Mutex tag_pool_lock;
 
+/**
+ * Time spent waiting for a contended #tag_pool_lock.
+ */
+extern LatencyHistogram tag_pool_lock_wait;
+
 struct TagItem;
 struct StringView;
 
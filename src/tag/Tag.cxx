@@ -21,8 +21,10 @@
 #include "Tag.hxx"
 #include "Pool.hxx"
 #include "Builder.hxx"
+#include "thread/MeteredLock.hxx"
 
 #include <assert.h>
+#include <string.h>
 
 void
 Tag::Clear() noexcept
@@ -31,7 +33,7 @@ Tag::Clear() noexcept
 	has_playlist = false;
 
 	{
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
+		const MeteredLock protect(tag_pool_lock, tag_pool_lock_wait);
 		for (unsigned i = 0; i < num_items; ++i)
 			tag_pool_put_item(items[i]);
 	}
@@ -49,7 +51,7 @@ Tag::Tag(const Tag &other) noexcept
 	if (num_items > 0) {
 		items = new TagItem *[num_items];
 
-		const std::lock_guard<Mutex> protect(tag_pool_lock);
+		const MeteredLock protect(tag_pool_lock, tag_pool_lock_wait);
 		for (unsigned i = 0; i < num_items; i++)
 			items[i] = tag_pool_dup_item(other.items[i]);
 	}
@@ -75,6 +77,26 @@ Tag::Merge(std::unique_ptr<Tag> base, std::unique_ptr<Tag> add) noexcept
 	return Merge(*base, *add);
 }
 
+bool
+Tag::IsSame(const Tag &other) const noexcept
+{
+	if (duration != other.duration ||
+	    has_playlist != other.has_playlist ||
+	    num_items != other.num_items)
+		return false;
+
+	for (unsigned i = 0; i < num_items; ++i) {
+		const TagItem &a = *items[i], &b = *other.items[i];
+		/* items are usually shared by the #TagPool, which
+		   makes the pointer comparison a shortcut */
+		if (&a != &b &&
+		    (a.type != b.type || strcmp(a.value, b.value) != 0))
+			return false;
+	}
+
+	return true;
+}
+
 const char *
 Tag::GetValue(TagType type) const noexcept
 {
@@ -128,6 +128,13 @@ struct Tag {
 	static std::unique_ptr<Tag> Merge(std::unique_ptr<Tag> base,
 					  std::unique_ptr<Tag> add) noexcept;
 
+	/**
+	 * Do both tags contain the same duration, flags and items (in
+	 * the same order)?
+	 */
+	gcc_pure
+	bool IsSame(const Tag &other) const noexcept;
+
 	/**
 	 * Returns the first value of the specified tag type, or
 	 * nullptr if none is present in this tag object.
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_METERED_LOCK_HXX
+#define MPD_METERED_LOCK_HXX
+
+#include "Mutex.hxx"
+#include "util/LatencyHistogram.hxx"
+
+#include <chrono>
+
+/**
+ * Like std::lock_guard, but records the time spent waiting for a
+ * contended mutex in a #LatencyHistogram.  The uncontended case costs
+ * only a try_lock() and is not recorded.
+ */
+class MeteredLock {
+	Mutex &mutex;
+
+public:
+	MeteredLock(Mutex &_mutex, LatencyHistogram &histogram) noexcept
+		:mutex(_mutex) {
+		if (!mutex.try_lock()) {
+			const auto start = std::chrono::steady_clock::now();
+			mutex.lock();
+			histogram.Add(std::chrono::steady_clock::now() - start);
+		}
+	}
+
+	~MeteredLock() noexcept {
+		mutex.unlock();
+	}
+
+	MeteredLock(const MeteredLock &) = delete;
+	MeteredLock &operator=(const MeteredLock &) = delete;
+};
+
+#endif
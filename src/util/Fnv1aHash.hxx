@@ -0,0 +1,48 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_FNV1A_HASH_HXX
+#define MPD_FNV1A_HASH_HXX
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The 64 bit FNV-1a hash function.  Unlike std::hash, its result is
+ * stable, so it may be used for file names.
+ */
+class Fnv1aHash {
+	uint64_t value = 0xcbf29ce484222325ULL;
+
+public:
+	void Update(const void *_data, size_t size) noexcept {
+		const uint8_t *data = (const uint8_t *)_data;
+		for (size_t i = 0; i < size; ++i) {
+			value ^= data[i];
+			value *= 0x100000001b3ULL;
+		}
+	}
+
+	constexpr uint64_t Get() const noexcept {
+		return value;
+	}
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "LatencyHistogram.hxx"
+
+#include <algorithm>
+
+LatencyHistogram::LatencyHistogram() noexcept
+	:count(0), sum(0), max(0)
+{
+	for (auto &i : buckets)
+		i.store(0, std::memory_order_relaxed);
+}
+
+unsigned
+LatencyHistogram::ValueToBucket(uint64_t value) noexcept
+{
+	if (value < SUB_BUCKETS)
+		/* the first buckets are exact */
+		return value;
+
+	/* the position of the most significant bit */
+	const unsigned msb = 63 - __builtin_clzll(value);
+	if (msb >= MAX_BITS)
+		return N_BUCKETS - 1;
+
+	/* the sub-bucket is selected by the SUB_BITS bits below the
+	   most significant one */
+	const unsigned shift = msb - SUB_BITS;
+	return ((msb - SUB_BITS + 1) << SUB_BITS) +
+		unsigned((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t
+LatencyHistogram::BucketUpperBound(unsigned bucket) noexcept
+{
+	if (bucket < SUB_BUCKETS)
+		return bucket;
+
+	if (bucket >= N_BUCKETS - 1)
+		return UINT64_MAX;
+
+	const unsigned shift = (bucket >> SUB_BITS) - 1;
+	const uint64_t sub = SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1));
+	return ((sub + 1) << shift) - 1;
+}
+
+void
+LatencyHistogram::Add(uint64_t value) noexcept
+{
+	buckets[ValueToBucket(value)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(value, std::memory_order_relaxed);
+
+	uint64_t old_max = max.load(std::memory_order_relaxed);
+	while (value > old_max &&
+	       !max.compare_exchange_weak(old_max, value,
+					  std::memory_order_relaxed)) {}
+}
+
+uint64_t
+LatencyHistogram::GetPercentile(double fraction) const noexcept
+{
+	/* the buckets are not read atomically with the total, so
+	   count them again */
+	uint64_t total = 0;
+	for (const auto &i : buckets)
+		total += i.load(std::memory_order_relaxed);
+
+	if (total == 0)
+		return 0;
+
+	const uint64_t threshold =
+		std::max<uint64_t>(1, uint64_t(fraction * total + 0.5));
+
+	uint64_t n = 0;
+	for (unsigned i = 0; i < N_BUCKETS; ++i) {
+		n += buckets[i].load(std::memory_order_relaxed);
+		if (n >= threshold)
+			return std::min(BucketUpperBound(i), GetMax());
+	}
+
+	return GetMax();
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2003-2017 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LATENCY_HISTOGRAM_HXX
+#define MPD_LATENCY_HISTOGRAM_HXX
+
+#include "Compiler.h"
+
+#include <atomic>
+#include <chrono>
+
+#include <stdint.h>
+
+/**
+ * A lock-free histogram of durations, with a resolution of one
+ * microsecond.  Similar to HdrHistogram, the buckets are
+ * logarithmic: each power of two is split into 4 linear sub-buckets,
+ * which limits the relative error of a percentile to 25%.
+ *
+ * Add() may be called from any thread at any time; the readers get
+ * an approximate snapshot.
+ */
+class LatencyHistogram {
+	static constexpr unsigned SUB_BITS = 2;
+	static constexpr unsigned SUB_BUCKETS = 1u << SUB_BITS;
+
+	/**
+	 * Values up to 2^40 microseconds (12 days) are distinguished;
+	 * larger values are counted in the last bucket.
+	 */
+	static constexpr unsigned MAX_BITS = 40;
+
+	static constexpr unsigned N_BUCKETS =
+		(MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+	std::atomic<uint64_t> buckets[N_BUCKETS];
+	std::atomic<uint64_t> count, sum, max;
+
+public:
+	typedef std::chrono::microseconds Duration;
+
+	LatencyHistogram() noexcept;
+
+	LatencyHistogram(const LatencyHistogram &) = delete;
+	LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+	void Add(uint64_t us) noexcept;
+
+	template<typename D>
+	void Add(D d) noexcept {
+		const auto us = std::chrono::duration_cast<Duration>(d).count();
+		Add(us > 0 ? uint64_t(us) : 0);
+	}
+
+	gcc_pure
+	uint64_t GetCount() const noexcept {
+		return count.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @return the sum of all values [microseconds]
+	 */
+	gcc_pure
+	uint64_t GetSum() const noexcept {
+		return sum.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @return the largest value [microseconds]
+	 */
+	gcc_pure
+	uint64_t GetMax() const noexcept {
+		return max.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Determine the value below which the given fraction of all
+	 * values lies.  Returns the upper bound of the bucket, but
+	 * never more than GetMax().
+	 *
+	 * @param fraction a number between 0 and 1
+	 * @return the value [microseconds], or 0 if the histogram is
+	 * empty
+	 */
+	gcc_pure
+	uint64_t GetPercentile(double fraction) const noexcept;
+
+	gcc_const
+	static unsigned ValueToBucket(uint64_t value) noexcept;
+
+	/**
+	 * @return the largest value which is counted in the given
+	 * bucket
+	 */
+	gcc_const
+	static uint64_t BucketUpperBound(unsigned bucket) noexcept;
+};
+
+#endif
@@ -39,6 +39,7 @@ DumpDecoderClient::Ready(const AudioFormat audio_format,
 		ToString(audio_format).c_str(),
 		duration.ToDoubleS());
 
+	frame_size = audio_format.GetFrameSize();
 	initialized = true;
 }
 
@@ -105,6 +106,19 @@ DumpDecoderClient::SubmitData(gcc_unused InputStream *is,
 	return DecoderCommand::NONE;
 }
 
+WritableBuffer<void>
+DumpDecoderClient::GetWriteBuffer(gcc_unused InputStream *is)
+{
+	return {write_buffer,
+		sizeof(write_buffer) - sizeof(write_buffer) % frame_size};
+}
+
+DecoderCommand
+DumpDecoderClient::CommitData(size_t length, uint16_t kbit_rate)
+{
+	return SubmitData(nullptr, write_buffer, length, kbit_rate);
+}
+
 DecoderCommand
 DumpDecoderClient::SubmitTag(gcc_unused InputStream *is,
 			     Tag &&tag)
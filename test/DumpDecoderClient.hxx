@@ -33,6 +33,13 @@ class DumpDecoderClient final : public DecoderClient {
 
 	uint16_t prev_kbit_rate = 0;
 
+	size_t frame_size = 1;
+
+	/**
+	 * The buffer returned by GetWriteBuffer().
+	 */
+	alignas(8) uint8_t write_buffer[16384];
+
 public:
 	Mutex mutex;
 
@@ -54,6 +61,8 @@ public:
 	DecoderCommand SubmitData(InputStream *is,
 				  const void *data, size_t length,
 				  uint16_t kbit_rate) override;
+	WritableBuffer<void> GetWriteBuffer(InputStream *is) override;
+	DecoderCommand CommitData(size_t length, uint16_t kbit_rate) override;
 	DecoderCommand SubmitTag(InputStream *is, Tag &&tag) override ;
 	void SubmitReplayGain(const ReplayGainInfo *replay_gain_info) override;
 	void SubmitMixRamp(MixRampInfo &&mix_ramp) override;
@@ -0,0 +1,56 @@
+/*
+ * Unit tests for class LatencyHistogram.
+ */
+
+#include "check.h"
+#include "util/LatencyHistogram.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+class TestLatencyHistogram : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestLatencyHistogram);
+	CPPUNIT_TEST(TestBuckets);
+	CPPUNIT_TEST(TestPercentile);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestBuckets() {
+		for (uint64_t i = 0; i < 4; ++i) {
+			CPPUNIT_ASSERT_EQUAL(unsigned(i),
+					     LatencyHistogram::ValueToBucket(i));
+			CPPUNIT_ASSERT_EQUAL(i,
+					     LatencyHistogram::BucketUpperBound(i));
+		}
+
+		/* each value must be within its bucket, and the
+		   buckets must be contiguous */
+		for (uint64_t i = 1; i < 100000; ++i) {
+			const unsigned bucket = LatencyHistogram::ValueToBucket(i);
+			CPPUNIT_ASSERT(i <= LatencyHistogram::BucketUpperBound(bucket));
+			CPPUNIT_ASSERT(i > LatencyHistogram::BucketUpperBound(bucket - 1));
+		}
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(9),
+				     LatencyHistogram::BucketUpperBound(LatencyHistogram::ValueToBucket(8)));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1279),
+				     LatencyHistogram::BucketUpperBound(LatencyHistogram::ValueToBucket(1100)));
+	}
+
+	void TestPercentile() {
+		LatencyHistogram h;
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), h.GetPercentile(0.5));
+
+		for (unsigned i = 0; i < 90; ++i)
+			h.Add(std::chrono::microseconds(10));
+		for (unsigned i = 0; i < 10; ++i)
+			h.Add(std::chrono::milliseconds(5));
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(100), h.GetCount());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(90 * 10 + 10 * 5000), h.GetSum());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(5000), h.GetMax());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(11), h.GetPercentile(0.5));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(11), h.GetPercentile(0.9));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(5000), h.GetPercentile(0.99));
+	}
+};
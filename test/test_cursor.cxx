@@ -0,0 +1,226 @@
+/*
+ * Unit tests for class ResponseCursor and class CursorTable.
+ */
+
+#include "config.h"
+#include "client/Cursor.hxx"
+#include "protocol/Ack.hxx"
+#include "util/Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+/**
+ * A fake replacing the real class, which would need a #Client; the
+ * cursor code only passes it through to Produce().
+ */
+class Response {
+public:
+	std::string output;
+};
+
+class VectorCursor final : public ResponseCursor {
+	const std::vector<std::string> items;
+
+public:
+	unsigned n_produce = 0;
+
+	VectorCursor(std::vector<std::string> &&_items,
+		     bool _binary=false) noexcept
+		:ResponseCursor(_binary), items(std::move(_items)) {}
+
+protected:
+	bool Produce(Response &r, unsigned offset, unsigned count) override {
+		++n_produce;
+
+		for (unsigned i = offset;
+		     i < items.size() && i < offset + count; ++i)
+			r.output += items[i];
+
+		return offset + count < items.size();
+	}
+};
+
+static std::unique_ptr<ResponseCursor>
+MakeCursor(bool binary=false)
+{
+	return std::make_unique<VectorCursor>(std::vector<std::string>{"a"},
+					      binary);
+}
+
+static std::string
+ReadPage(ResponseCursor &cursor, unsigned n, bool &more)
+{
+	Response r;
+	more = cursor.Read(r, n);
+	return r.output;
+}
+
+class CursorTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(CursorTest);
+	CPPUNIT_TEST(TestRead);
+	CPPUNIT_TEST(TestReadExact);
+	CPPUNIT_TEST(TestReadEmpty);
+	CPPUNIT_TEST(TestTable);
+	CPPUNIT_TEST(TestTableLimit);
+	CPPUNIT_TEST(TestGlobalLimit);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestRead() {
+		VectorCursor cursor({"a", "b", "c", "d", "e"});
+		bool more;
+
+		CPPUNIT_ASSERT_EQUAL(std::string("ab"),
+				     ReadPage(cursor, 2, more));
+		CPPUNIT_ASSERT(more);
+		CPPUNIT_ASSERT_EQUAL(2u, cursor.GetPosition());
+
+		CPPUNIT_ASSERT_EQUAL(std::string("cd"),
+				     ReadPage(cursor, 2, more));
+		CPPUNIT_ASSERT(more);
+
+		CPPUNIT_ASSERT_EQUAL(std::string("e"),
+				     ReadPage(cursor, 2, more));
+		CPPUNIT_ASSERT(!more);
+
+		/* only the requested pages were produced */
+		CPPUNIT_ASSERT_EQUAL(3u, cursor.n_produce);
+	}
+
+	void TestReadExact() {
+		VectorCursor cursor({"a", "b", "c", "d"});
+		bool more;
+
+		CPPUNIT_ASSERT_EQUAL(std::string("ab"),
+				     ReadPage(cursor, 2, more));
+		CPPUNIT_ASSERT(more);
+
+		/* the last page is full, but no empty page follows */
+		CPPUNIT_ASSERT_EQUAL(std::string("cd"),
+				     ReadPage(cursor, 2, more));
+		CPPUNIT_ASSERT(!more);
+	}
+
+	void TestReadEmpty() {
+		VectorCursor cursor({});
+		bool more;
+
+		CPPUNIT_ASSERT_EQUAL(std::string(),
+				     ReadPage(cursor, 10, more));
+		CPPUNIT_ASSERT(!more);
+	}
+
+	void TestTable() {
+		CursorTable table;
+
+		const unsigned id = table.Add(MakeCursor());
+		CPPUNIT_ASSERT(id != 0);
+
+		auto cursor = table.Take(id, false);
+		CPPUNIT_ASSERT(cursor);
+
+		/* a borrowed cursor can't be taken again */
+		try {
+			table.Take(id, false);
+			CPPUNIT_FAIL("ProtocolError expected");
+		} catch (const ProtocolError &e) {
+			CPPUNIT_ASSERT_EQUAL(ACK_ERROR_ARG, e.GetCode());
+		}
+
+		table.Return(id, std::move(cursor));
+
+		/* the protocol mode must match */
+		try {
+			table.Take(id, true);
+			CPPUNIT_FAIL("ProtocolError expected");
+		} catch (const ProtocolError &e) {
+			CPPUNIT_ASSERT_EQUAL(ACK_ERROR_ARG, e.GetCode());
+		}
+
+		/* returning nullptr deletes the cursor */
+		cursor = table.Take(id, false);
+		table.Return(id, nullptr);
+
+		try {
+			table.Take(id, false);
+			CPPUNIT_FAIL("ProtocolError expected");
+		} catch (const ProtocolError &e) {
+			CPPUNIT_ASSERT_EQUAL(ACK_ERROR_NO_EXIST, e.GetCode());
+		}
+
+		/* a cursor removed while borrowed stays removed */
+		const unsigned id2 = table.Add(MakeCursor());
+		CPPUNIT_ASSERT(id2 != id);
+		cursor = table.Take(id2, false);
+		table.Remove(id2);
+		table.Return(id2, std::move(cursor));
+
+		try {
+			table.Remove(id2);
+			CPPUNIT_FAIL("ProtocolError expected");
+		} catch (const ProtocolError &e) {
+			CPPUNIT_ASSERT_EQUAL(ACK_ERROR_NO_EXIST, e.GetCode());
+		}
+	}
+
+	void TestTableLimit() {
+		CursorTable table;
+
+		std::vector<unsigned> ids;
+		for (unsigned i = 0; i < 16; ++i)
+			ids.push_back(table.Add(MakeCursor()));
+
+		try {
+			table.Add(MakeCursor());
+			CPPUNIT_FAIL("ProtocolError expected");
+		} catch (const ProtocolError &e) {
+			CPPUNIT_ASSERT_EQUAL(ACK_ERROR_ARG, e.GetCode());
+		}
+
+		table.Remove(ids.front());
+		table.Add(MakeCursor());
+	}
+
+	void TestGlobalLimit() {
+		{
+			std::vector<std::unique_ptr<CursorTable>> tables;
+			for (unsigned i = 0; i < 64; ++i) {
+				tables.emplace_back(new CursorTable());
+				for (unsigned j = 0; j < 16; ++j)
+					tables.back()->Add(MakeCursor());
+			}
+
+			CursorTable table;
+			try {
+				table.Add(MakeCursor());
+				CPPUNIT_FAIL("ProtocolError expected");
+			} catch (const ProtocolError &e) {
+				CPPUNIT_ASSERT_EQUAL(ACK_ERROR_ARG,
+						     e.GetCode());
+			}
+		}
+
+		/* destroying the tables has released their cursors */
+		CursorTable table;
+		table.Add(MakeCursor());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CursorTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
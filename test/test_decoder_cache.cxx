@@ -0,0 +1,227 @@
+/*
+ * Unit tests for class DecoderCache.
+ */
+
+#include "config.h"
+#include "decoder/Cache.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "util/Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static constexpr AudioFormat test_audio_format(44100, SampleFormat::S16, 2);
+
+static DecoderCacheKey
+MakeKey(const char *uri)
+{
+	return {
+		uri,
+		std::chrono::system_clock::from_time_t(1000),
+		SongTime::zero(),
+		SongTime::zero(),
+		AudioFormat::Undefined(),
+	};
+}
+
+/**
+ * Record a song consisting of the given number of bytes.
+ *
+ * @return false if the cache refused the recording
+ */
+static bool
+Record(DecoderCache &cache, const char *uri, size_t size,
+       bool commit=true)
+{
+	auto writer = cache.Create(MakeKey(uri));
+	CPPUNIT_ASSERT(writer != nullptr);
+
+	if (!writer->Open(test_audio_format, SignedSongTime::FromS(1)))
+		return false;
+
+	std::vector<uint8_t> data(size, 0x42);
+	if (!writer->Append({data.data(), data.size()}))
+		return false;
+
+	if (commit)
+		writer->Commit();
+	return true;
+}
+
+class DecoderCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DecoderCacheTest);
+	CPPUNIT_TEST(TestRoundTrip);
+	CPPUNIT_TEST(TestDiscard);
+	CPPUNIT_TEST(TestIsComplete);
+	CPPUNIT_TEST(TestSizeLimit);
+	CPPUNIT_TEST(TestRecordingSize);
+	CPPUNIT_TEST(TestReload);
+	CPPUNIT_TEST_SUITE_END();
+
+	std::string directory;
+
+	gcc_pure
+	unsigned CountFiles() const {
+		unsigned n = 0;
+		DIR *dir = opendir(directory.c_str());
+		CPPUNIT_ASSERT(dir != nullptr);
+		while (const auto *e = readdir(dir))
+			if (e->d_name[0] != '.')
+				++n;
+		closedir(dir);
+		return n;
+	}
+
+public:
+	void setUp() {
+		char buffer[] = "/tmp/test_decoder_cache.XXXXXX";
+		CPPUNIT_ASSERT(mkdtemp(buffer) != nullptr);
+		directory = buffer;
+	}
+
+	void tearDown() {
+		DIR *dir = opendir(directory.c_str());
+		while (const auto *e = readdir(dir))
+			if (e->d_name[0] != '.')
+				unlink((directory + "/" + e->d_name).c_str());
+		closedir(dir);
+		rmdir(directory.c_str());
+	}
+
+	void TestRoundTrip() {
+		DecoderCache cache(AllocatedPath::FromFS(directory.c_str()),
+				   1024 * 1024);
+
+		CPPUNIT_ASSERT(cache.Open(MakeKey("a.flac")) == nullptr);
+		CPPUNIT_ASSERT(Record(cache, "a.flac", 4000));
+
+		const auto file = cache.Open(MakeKey("a.flac"));
+		CPPUNIT_ASSERT(file != nullptr);
+		CPPUNIT_ASSERT(file->audio_format == test_audio_format);
+		CPPUNIT_ASSERT_EQUAL(size_t(4000), file->pcm.size);
+		CPPUNIT_ASSERT_EQUAL(uint8_t(0x42), file->pcm.data[3999]);
+
+		/* a different modification time is a cache miss */
+		auto key = MakeKey("a.flac");
+		key.mtime = std::chrono::system_clock::from_time_t(2000);
+		CPPUNIT_ASSERT(cache.Open(key) == nullptr);
+	}
+
+	void TestDiscard() {
+		DecoderCache cache(AllocatedPath::FromFS(directory.c_str()),
+				   64 * 1024);
+
+		/* an uncommitted recording leaves nothing behind, and
+		   its reservation is released */
+		CPPUNIT_ASSERT(Record(cache, "a.flac", 20000, false));
+		CPPUNIT_ASSERT(cache.Open(MakeKey("a.flac")) == nullptr);
+		CPPUNIT_ASSERT_EQUAL(0u, CountFiles());
+
+		CPPUNIT_ASSERT(Record(cache, "b.flac", 20000, false));
+		CPPUNIT_ASSERT(Record(cache, "c.flac", 20000, false));
+	}
+
+	void TestIsComplete() {
+		DecoderCache cache(AllocatedPath::FromFS(directory.c_str()),
+				   16 * 1024 * 1024);
+
+		auto writer = cache.Create(MakeKey("a.flac"));
+		CPPUNIT_ASSERT(writer != nullptr);
+		CPPUNIT_ASSERT(writer->Open(test_audio_format,
+					    SignedSongTime::FromS(1)));
+
+		/* one second */
+		std::vector<uint8_t> data(test_audio_format.TimeToSize(std::chrono::seconds(1)));
+		CPPUNIT_ASSERT(writer->Append({data.data(), data.size()}));
+
+		CPPUNIT_ASSERT(writer->IsComplete(SongTime::FromS(1u)));
+		CPPUNIT_ASSERT(writer->IsComplete(SongTime::FromMS(1050)));
+		CPPUNIT_ASSERT(writer->IsComplete(SongTime::FromMS(950)));
+		CPPUNIT_ASSERT(!writer->IsComplete(SongTime::FromS(2u)));
+		CPPUNIT_ASSERT(!writer->IsComplete(SongTime::FromMS(500)));
+	}
+
+	void TestSizeLimit() {
+		DecoderCache cache(AllocatedPath::FromFS(directory.c_str()),
+				   64 * 1024);
+
+		CPPUNIT_ASSERT(Record(cache, "a.flac", 20000));
+		CPPUNIT_ASSERT(Record(cache, "b.flac", 20000));
+		CPPUNIT_ASSERT(cache.Open(MakeKey("a.flac")) != nullptr);
+
+		/* "a" was used more recently than "b" */
+		CPPUNIT_ASSERT(Record(cache, "c.flac", 20000));
+		CPPUNIT_ASSERT(cache.Open(MakeKey("a.flac")) != nullptr);
+		CPPUNIT_ASSERT(cache.Open(MakeKey("b.flac")) == nullptr);
+		CPPUNIT_ASSERT(cache.Open(MakeKey("c.flac")) != nullptr);
+		CPPUNIT_ASSERT_EQUAL(2u, CountFiles());
+
+		/* a song larger than half of the cache is refused */
+		CPPUNIT_ASSERT(!Record(cache, "d.flac", 40000));
+	}
+
+	void TestRecordingSize() {
+		DecoderCache cache(AllocatedPath::FromFS(directory.c_str()),
+				   64 * 1024);
+
+		CPPUNIT_ASSERT(Record(cache, "a.flac", 20000));
+		CPPUNIT_ASSERT(Record(cache, "b.flac", 20000));
+
+		/* a recording in progress evicts committed entries */
+		auto writer = cache.Create(MakeKey("c.flac"));
+		CPPUNIT_ASSERT(writer != nullptr);
+		CPPUNIT_ASSERT(writer->Open(test_audio_format,
+					    SignedSongTime::FromS(1)));
+		std::vector<uint8_t> data(30000);
+		CPPUNIT_ASSERT(writer->Append({data.data(), data.size()}));
+
+		CPPUNIT_ASSERT(cache.Open(MakeKey("a.flac")) == nullptr);
+		CPPUNIT_ASSERT(cache.Open(MakeKey("b.flac")) != nullptr);
+
+		/* there is no room for a second recording */
+		CPPUNIT_ASSERT(!Record(cache, "d.flac", 20000));
+		CPPUNIT_ASSERT(cache.Open(MakeKey("b.flac")) == nullptr);
+
+		/* committing converts the reservation */
+		writer->Commit();
+		writer.reset();
+		CPPUNIT_ASSERT(cache.Open(MakeKey("c.flac")) != nullptr);
+		CPPUNIT_ASSERT(Record(cache, "d.flac", 20000));
+		CPPUNIT_ASSERT(cache.Open(MakeKey("d.flac")) != nullptr);
+	}
+
+	void TestReload() {
+		{
+			DecoderCache cache(AllocatedPath::FromFS(directory.c_str()),
+					   1024 * 1024);
+			CPPUNIT_ASSERT(Record(cache, "a.flac", 4000));
+		}
+
+		DecoderCache cache(AllocatedPath::FromFS(directory.c_str()),
+				   1024 * 1024);
+		const auto file = cache.Open(MakeKey("a.flac"));
+		CPPUNIT_ASSERT(file != nullptr);
+		CPPUNIT_ASSERT_EQUAL(size_t(4000), file->pcm.size);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DecoderCacheTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,164 @@
+/*
+ * Unit tests for decoder_sniff_suffix()
+ */
+
+#include "config.h"
+#include "decoder/Sniff.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdint.h>
+#include <string.h>
+
+static std::string
+Sniff(const std::string &data)
+{
+	const char *suffix = decoder_sniff_suffix(data.data(), data.size());
+	return suffix != nullptr ? suffix : "(null)";
+}
+
+/**
+ * Build a stream of MPEG-1 layer III frames (128 kbit/s, 44.1 kHz,
+ * 417 bytes each).
+ */
+static std::string
+MakeMp3Frames(unsigned n)
+{
+	std::string frame(417, '\0');
+	frame[0] = '\xff';
+	frame[1] = '\xfb';
+	frame[2] = '\x90';
+	frame[3] = '\x00';
+
+	std::string result;
+	for (unsigned i = 0; i < n; ++i)
+		result += frame;
+	return result;
+}
+
+/**
+ * Build a stream of AAC ADTS frames (100 bytes each).
+ */
+static std::string
+MakeAdtsFrames(unsigned n)
+{
+	std::string frame(100, '\0');
+	frame[0] = '\xff';
+	frame[1] = '\xf1';
+	frame[2] = '\x50';
+	frame[3] = '\x80';
+	frame[4] = '\x0c';
+	frame[5] = '\x9f';
+	frame[6] = '\xfc';
+
+	std::string result;
+	for (unsigned i = 0; i < n; ++i)
+		result += frame;
+	return result;
+}
+
+static std::string
+MakeId3v2(unsigned size)
+{
+	std::string tag("ID3\x04\x00\x00", 6);
+	tag += char((size >> 21) & 0x7f);
+	tag += char((size >> 14) & 0x7f);
+	tag += char((size >> 7) & 0x7f);
+	tag += char(size & 0x7f);
+	tag.append(size, '\0');
+	return tag;
+}
+
+class SniffTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SniffTest);
+	CPPUNIT_TEST(TestMagic);
+	CPPUNIT_TEST(TestOgg);
+	CPPUNIT_TEST(TestMpeg);
+	CPPUNIT_TEST(TestUnknown);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestMagic() {
+		CPPUNIT_ASSERT_EQUAL(std::string("flac"),
+				     Sniff(std::string("fLaC\0\0\0\x22", 8)));
+		CPPUNIT_ASSERT_EQUAL(std::string("wav"),
+				     Sniff(std::string("RIFF\x24\x08\0\0WAVEfmt ", 16)));
+		CPPUNIT_ASSERT_EQUAL(std::string("aiff"),
+				     Sniff(std::string("FORM\0\0\0\0AIFFCOMM", 16)));
+		CPPUNIT_ASSERT_EQUAL(std::string("dsf"),
+				     Sniff(std::string("DSD \x1c\0\0\0", 8)));
+		CPPUNIT_ASSERT_EQUAL(std::string("m4a"),
+				     Sniff(std::string("\0\0\0\x20" "ftypM4A ", 12)));
+
+		/* ID3v2 is skipped */
+		CPPUNIT_ASSERT_EQUAL(std::string("flac"),
+				     Sniff(MakeId3v2(100) + "fLaC"));
+
+		/* the tag covers the whole buffer */
+		CPPUNIT_ASSERT_EQUAL(std::string("mp3"),
+				     Sniff(MakeId3v2(8000)));
+	}
+
+	void TestOgg() {
+		std::string page("OggS", 4);
+		page.append(22, '\0');
+		page += '\x01'; /* one segment */
+		page += '\x13'; /* of 19 bytes */
+
+		CPPUNIT_ASSERT_EQUAL(std::string("opus"),
+				     Sniff(page + "OpusHead\x01\x02"));
+		CPPUNIT_ASSERT_EQUAL(std::string("oga"),
+				     Sniff(page + "\x7f" "FLAC\x01\x00"));
+		CPPUNIT_ASSERT_EQUAL(std::string("ogg"),
+				     Sniff(page + "\x01vorbis"));
+	}
+
+	void TestMpeg() {
+		CPPUNIT_ASSERT_EQUAL(std::string("mp3"),
+				     Sniff(MakeMp3Frames(3)));
+		CPPUNIT_ASSERT_EQUAL(std::string("aac"),
+				     Sniff(MakeAdtsFrames(3)));
+
+		/* a stream which starts in the middle of a frame */
+		CPPUNIT_ASSERT_EQUAL(std::string("mp3"),
+				     Sniff(MakeMp3Frames(3).substr(200)));
+		CPPUNIT_ASSERT_EQUAL(std::string("aac"),
+				     Sniff(MakeAdtsFrames(3).substr(42)));
+
+		/* garbage with a false sync (320 kbit/s, 32 kHz: 1440
+		   bytes) which runs past the end of the buffer,
+		   followed by a valid frame pair */
+		std::string garbage("\xff\xfb\xe8\x00", 4);
+		garbage.append(100, '\x55');
+		CPPUNIT_ASSERT_EQUAL(std::string("mp3"),
+				     Sniff(garbage + MakeMp3Frames(2)));
+
+		/* a single frame header is not enough */
+		CPPUNIT_ASSERT_EQUAL(std::string("(null)"),
+				     Sniff(MakeMp3Frames(1)));
+	}
+
+	void TestUnknown() {
+		CPPUNIT_ASSERT_EQUAL(std::string("(null)"), Sniff(std::string()));
+		CPPUNIT_ASSERT_EQUAL(std::string("(null)"),
+				     Sniff(std::string(4096, '\xff')));
+		CPPUNIT_ASSERT_EQUAL(std::string("(null)"),
+				     Sniff("<html><body>Not found</body></html>"));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SniffTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,156 @@
+/*
+ * Unit tests for the copy-on-write body of class DetachedSong.
+ */
+
+#include "config.h"
+#include "song/DetachedSong.hxx"
+#include "tag/Builder.hxx"
+#include "tag/Tag.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+class DetachedSongTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(DetachedSongTest);
+	CPPUNIT_TEST(TestCopyShares);
+	CPPUNIT_TEST(TestCopyOnWrite);
+	CPPUNIT_TEST(TestMove);
+	CPPUNIT_TEST(TestIntern);
+	CPPUNIT_TEST(TestInternStale);
+	CPPUNIT_TEST(TestInternMutate);
+	CPPUNIT_TEST(TestInternTag);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestCopyShares() {
+		const DetachedSong a("foo/bar.ogg");
+		const DetachedSong b(a);
+
+		/* the copy refers to the same strings */
+		CPPUNIT_ASSERT_EQUAL(a.GetURI(), b.GetURI());
+		CPPUNIT_ASSERT(a.IsSame(b));
+	}
+
+	void TestCopyOnWrite() {
+		DetachedSong a("foo/bar.ogg");
+		a.SetStartTime(SongTime::FromS(1u));
+
+		DetachedSong b(a);
+		b.SetURI("foo/baz.ogg");
+		b.SetStartTime(SongTime::FromS(2u));
+
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(a.GetURI(), "foo/bar.ogg"));
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(b.GetURI(), "foo/baz.ogg"));
+		CPPUNIT_ASSERT(a.GetStartTime() == SongTime::FromS(1u));
+		CPPUNIT_ASSERT(b.GetStartTime() == SongTime::FromS(2u));
+
+		/* modifying an unshared instance doesn't copy */
+		const char *uri = b.GetURI();
+		b.SetEndTime(SongTime::FromS(3u));
+		CPPUNIT_ASSERT_EQUAL(uri, b.GetURI());
+	}
+
+	void TestMove() {
+		DetachedSong a("foo/bar.ogg");
+		DetachedSong b(std::move(a));
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(b.GetURI(), "foo/bar.ogg"));
+
+		/* the moved-from instance is empty, but usable */
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(a.GetURI(), ""));
+		a.SetURI("foo/new.ogg");
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(a.GetURI(), "foo/new.ogg"));
+
+		DetachedSong c("x");
+		DetachedSong d(std::move(c));
+		DetachedSong e(std::move(c));
+		c = std::move(d);
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(c.GetURI(), "x"));
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(d.GetURI(), ""));
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(e.GetURI(), ""));
+	}
+
+	void TestIntern() {
+		auto a = DetachedSong::Intern(DetachedSong("db/song.flac"));
+		auto b = DetachedSong::Intern(DetachedSong("db/song.flac"));
+		auto c = DetachedSong::Intern(DetachedSong("db/other.flac"));
+
+		CPPUNIT_ASSERT_EQUAL(a.GetURI(), b.GetURI());
+		CPPUNIT_ASSERT(a.GetURI() != c.GetURI());
+	}
+
+	static DetachedSong MakeTagged(const char *title) {
+		TagBuilder builder;
+		builder.AddItem(TAG_TITLE, title);
+		return DetachedSong("db/song.flac", builder.Commit());
+	}
+
+	void TestInternTag() {
+		auto a = DetachedSong::Intern(MakeTagged("foo"));
+		auto b = DetachedSong::Intern(MakeTagged("foo"));
+		CPPUNIT_ASSERT_EQUAL(a.GetURI(), b.GetURI());
+
+		/* a rescan has changed the tag, but not the mtime */
+		auto c = DetachedSong::Intern(MakeTagged("bar"));
+		CPPUNIT_ASSERT(a.GetURI() != c.GetURI());
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(c.GetTag().GetValue(TAG_TITLE),
+					       "bar"));
+	}
+
+	void TestInternStale() {
+		DetachedSong tmp("db/song.flac");
+		tmp.SetLastModified(std::chrono::system_clock::from_time_t(1000));
+		auto a = DetachedSong::Intern(std::move(tmp));
+
+		/* the file has been modified: a new body */
+		tmp = DetachedSong("db/song.flac");
+		tmp.SetLastModified(std::chrono::system_clock::from_time_t(2000));
+		auto b = DetachedSong::Intern(std::move(tmp));
+		CPPUNIT_ASSERT(a.GetURI() != b.GetURI());
+
+		/* the new version replaces the old one in the
+		   table */
+		tmp = DetachedSong("db/song.flac");
+		tmp.SetLastModified(std::chrono::system_clock::from_time_t(2000));
+		auto c = DetachedSong::Intern(std::move(tmp));
+		CPPUNIT_ASSERT_EQUAL(b.GetURI(), c.GetURI());
+
+		/* freeing the stale body must not remove the current
+		   one from the table */
+		a = DetachedSong("unrelated");
+		tmp = DetachedSong("db/song.flac");
+		tmp.SetLastModified(std::chrono::system_clock::from_time_t(2000));
+		auto d = DetachedSong::Intern(std::move(tmp));
+		CPPUNIT_ASSERT_EQUAL(b.GetURI(), d.GetURI());
+	}
+
+	void TestInternMutate() {
+		auto a = DetachedSong::Intern(DetachedSong("db/song.flac"));
+		auto b = DetachedSong::Intern(DetachedSong("db/song.flac"));
+
+		/* modifying an interned song makes a private copy;
+		   the interned body remains unchanged */
+		a.SetStartTime(SongTime::FromS(5u));
+		CPPUNIT_ASSERT(a.GetStartTime() == SongTime::FromS(5u));
+		CPPUNIT_ASSERT(b.GetStartTime() == SongTime::zero());
+
+		auto c = DetachedSong::Intern(DetachedSong("db/song.flac"));
+		CPPUNIT_ASSERT_EQUAL(b.GetURI(), c.GetURI());
+		CPPUNIT_ASSERT(a.GetURI() != c.GetURI());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DetachedSongTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
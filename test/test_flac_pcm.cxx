@@ -0,0 +1,120 @@
+/*
+ * Unit tests for class FlacPcmImport.
+ */
+
+#include "config.h"
+#include "decoder/plugins/FlacPcm.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+class FlacPcmTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(FlacPcmTest);
+	CPPUNIT_TEST(TestS16);
+	CPPUNIT_TEST(TestS24);
+	CPPUNIT_TEST(TestS8);
+	CPPUNIT_TEST(TestSplit);
+	CPPUNIT_TEST_SUITE_END();
+
+	template<typename T, size_t N>
+	static void CheckImport(FlacPcmImport &import,
+				const FLAC__int32 *const src[],
+				const T (&expected)[N]) {
+		const size_t n_frames = N / import.GetAudioFormat().channels;
+
+		/* the buffer-less overload used by the direct
+		   write path */
+		T dest[N];
+		import.Import(dest, src, n_frames);
+		CPPUNIT_ASSERT_EQUAL(0, memcmp(dest, expected, sizeof(dest)));
+
+		/* the buffered overload must produce the same */
+		const auto b = import.Import(src, n_frames);
+		CPPUNIT_ASSERT_EQUAL(sizeof(expected), b.size);
+		CPPUNIT_ASSERT_EQUAL(0, memcmp(b.data, expected, b.size));
+	}
+
+public:
+	void TestS16() {
+		FlacPcmImport import;
+		import.Open(44100, 16, 2);
+
+		static constexpr FLAC__int32 left[] = { 1, -32768, 32767 };
+		static constexpr FLAC__int32 right[] = { -2, 0, 100 };
+		const FLAC__int32 *const src[] = { left, right };
+
+		static constexpr int16_t expected[] = {
+			1, -2, -32768, 0, 32767, 100,
+		};
+		CheckImport(import, src, expected);
+	}
+
+	void TestS24() {
+		FlacPcmImport import;
+		import.Open(96000, 24, 3);
+
+		static constexpr FLAC__int32 c0[] = { 0x7fffff, 1 };
+		static constexpr FLAC__int32 c1[] = { -0x800000, 2 };
+		static constexpr FLAC__int32 c2[] = { 0, 3 };
+		const FLAC__int32 *const src[] = { c0, c1, c2 };
+
+		static constexpr int32_t expected[] = {
+			0x7fffff, -0x800000, 0, 1, 2, 3,
+		};
+		CheckImport(import, src, expected);
+	}
+
+	void TestS8() {
+		FlacPcmImport import;
+		import.Open(8000, 8, 1);
+
+		static constexpr FLAC__int32 mono[] = { 127, -128, 0, 5 };
+		const FLAC__int32 *const src[] = { mono };
+
+		static constexpr int8_t expected[] = { 127, -128, 0, 5 };
+		CheckImport(import, src, expected);
+	}
+
+	/**
+	 * FlacDecoder::OnWrite() imports a FLAC block in pieces when
+	 * it does not fit into one MusicChunk; the pieces must add up
+	 * to the whole block.
+	 */
+	void TestSplit() {
+		FlacPcmImport import;
+		import.Open(44100, 16, 2);
+
+		static constexpr FLAC__int32 left[] = { 1, 2, 3, 4, 5 };
+		static constexpr FLAC__int32 right[] = { -1, -2, -3, -4, -5 };
+		const FLAC__int32 *src[] = { left, right };
+
+		int16_t dest[10];
+		import.Import(dest, src, 2);
+		src[0] += 2;
+		src[1] += 2;
+		import.Import(dest + 4, src, 3);
+
+		static constexpr int16_t expected[] = {
+			1, -1, 2, -2, 3, -3, 4, -4, 5, -5,
+		};
+		CPPUNIT_ASSERT_EQUAL(0, memcmp(dest, expected, sizeof(dest)));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FlacPcmTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,268 @@
+/*
+ * Unit tests for seeking in MP3 files with the "mad" decoder plugin
+ * and a #SeekIndex.
+ */
+
+#include "config.h"
+#include "decoder/plugins/MadDecoderPlugin.hxx"
+#include "decoder/DecoderPlugin.hxx"
+#include "decoder/Client.hxx"
+#include "decoder/SeekIndex.hxx"
+#include "input/InputStream.hxx"
+#include "input/LocalOpen.hxx"
+#include "config/Block.hxx"
+#include "config/Data.hxx"
+#include "config/Param.hxx"
+#include "config/Option.hxx"
+#include "fs/Path.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+#include "AudioFormat.hxx"
+#include "MixRampInfo.hxx"
+#include "util/Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static constexpr unsigned N_FRAMES = 200;
+static constexpr unsigned SAMPLE_RATE = 44100;
+static constexpr unsigned SAMPLES_PER_FRAME = 1152;
+
+/**
+ * Write a MP3 file consisting of silent MPEG-1 layer III frames
+ * (128 kbit/s, 44.1 kHz, stereo, 417 bytes each).  The side
+ * information is all zero, i.e. each frame has no main data and does
+ * not refer to the bit reservoir.
+ */
+static void
+WriteSilentMp3(const std::string &path)
+{
+	std::string frame(417, '\0');
+	frame[0] = '\xff';
+	frame[1] = '\xfb';
+	frame[2] = '\x90';
+	frame[3] = '\x00';
+
+	std::ofstream f(path, std::ios::binary);
+	for (unsigned i = 0; i < N_FRAMES; ++i)
+		f << frame;
+}
+
+/**
+ * A #DecoderClient which counts the decoded frames and seeks once
+ * after the first chunk of data.
+ */
+class SeekDecoderClient final : public DecoderClient {
+	DecoderCommand command = DecoderCommand::NONE;
+
+	size_t frame_size = 1;
+
+	bool seek_pending;
+	SongTime seek_time;
+
+public:
+	Mutex mutex;
+
+	SignedSongTime duration = SignedSongTime::Negative();
+
+	/**
+	 * The number of frames submitted in total and since the
+	 * seek.
+	 */
+	uint64_t n_frames = 0, n_frames_after_seek = 0;
+
+	bool seek_finished = false, seek_failed = false;
+
+	explicit SeekDecoderClient(SongTime _seek_time=SongTime::zero(),
+				   bool _seek=false)
+		:seek_pending(_seek), seek_time(_seek_time) {}
+
+	/* virtual methods from DecoderClient */
+	void Ready(AudioFormat audio_format,
+		   gcc_unused bool seekable,
+		   SignedSongTime _duration) override {
+		CPPUNIT_ASSERT_EQUAL(SAMPLE_RATE, audio_format.sample_rate);
+		frame_size = audio_format.GetFrameSize();
+		duration = _duration;
+	}
+
+	DecoderCommand GetCommand() noexcept override {
+		return command;
+	}
+
+	void CommandFinished() override {
+		CPPUNIT_ASSERT(command == DecoderCommand::SEEK);
+		command = DecoderCommand::NONE;
+		seek_finished = true;
+	}
+
+	SongTime GetSeekTime() noexcept override {
+		return seek_time;
+	}
+
+	uint64_t GetSeekFrame() noexcept override {
+		return seek_time.ToScale<uint64_t>(SAMPLE_RATE);
+	}
+
+	void SeekError() override {
+		command = DecoderCommand::NONE;
+		seek_failed = true;
+	}
+
+	InputStreamPtr OpenUri(gcc_unused const char *uri) override {
+		throw std::runtime_error("Not implemented");
+	}
+
+	size_t Read(InputStream &is, void *buffer, size_t length) override {
+		try {
+			return is.LockRead(buffer, length);
+		} catch (...) {
+			return 0;
+		}
+	}
+
+	void SubmitTimestamp(gcc_unused FloatDuration t) override {}
+
+	DecoderCommand SubmitData(gcc_unused InputStream *is,
+				  gcc_unused const void *data, size_t length,
+				  gcc_unused uint16_t kbit_rate) override {
+		const uint64_t n = length / frame_size;
+		n_frames += n;
+		if (seek_finished)
+			n_frames_after_seek += n;
+
+		if (seek_pending) {
+			seek_pending = false;
+			command = DecoderCommand::SEEK;
+		}
+
+		return command;
+	}
+
+	WritableBuffer<void> GetWriteBuffer(gcc_unused InputStream *is) override {
+		return nullptr;
+	}
+
+	DecoderCommand CommitData(size_t length, uint16_t kbit_rate) override {
+		return SubmitData(nullptr, nullptr, length, kbit_rate);
+	}
+
+	DecoderCommand SubmitTag(gcc_unused InputStream *is,
+				 gcc_unused Tag &&tag) override {
+		return command;
+	}
+
+	void SubmitReplayGain(gcc_unused const ReplayGainInfo *rgi) override {}
+	void SubmitMixRamp(gcc_unused MixRampInfo &&mix_ramp) override {}
+};
+
+class MadSeekTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MadSeekTest);
+	CPPUNIT_TEST(TestBuildIndex);
+	CPPUNIT_TEST(TestSeekIndexed);
+	CPPUNIT_TEST_SUITE_END();
+
+	std::string directory, path;
+
+	void Decode(SeekDecoderClient &client) {
+		auto is = OpenLocalInputStream(Path::FromFS(path.c_str()),
+					       client.mutex);
+		mad_decoder_plugin.StreamDecode(client, *is);
+	}
+
+public:
+	void setUp() {
+		char buffer[] = "/tmp/test_mad_seek.XXXXXX";
+		CPPUNIT_ASSERT(mkdtemp(buffer) != nullptr);
+		directory = buffer;
+		path = directory + "/silence.mp3";
+		WriteSilentMp3(path);
+
+		ConfigData config;
+		config.AddParam(ConfigOption::SEEK_INDEX_DIRECTORY,
+				ConfigParam(directory.c_str()));
+		seek_index_global_init(config);
+
+		mad_decoder_plugin.Init(ConfigBlock());
+	}
+
+	void tearDown() {
+		seek_index_global_finish();
+
+		DIR *dir = opendir(directory.c_str());
+		while (const auto *e = readdir(dir))
+			if (e->d_name[0] != '.')
+				unlink((directory + "/" + e->d_name).c_str());
+		closedir(dir);
+		rmdir(directory.c_str());
+	}
+
+	void TestBuildIndex() {
+		SeekDecoderClient first;
+		Decode(first);
+		CPPUNIT_ASSERT(first.n_frames > 0);
+
+		/* the second run loads the index built by the first
+		   one, knows the exact duration, and decodes the
+		   same samples */
+		SeekDecoderClient second;
+		Decode(second);
+		CPPUNIT_ASSERT_EQUAL(first.n_frames, second.n_frames);
+		CPPUNIT_ASSERT_EQUAL(SongTime::FromScale<uint64_t>(N_FRAMES * SAMPLES_PER_FRAME,
+								   SAMPLE_RATE).count(),
+				     second.duration.count());
+	}
+
+	void CheckSeek(uint64_t total, SongTime t) {
+		SeekDecoderClient client(t, true);
+		Decode(client);
+
+		CPPUNIT_ASSERT(client.seek_finished);
+		CPPUNIT_ASSERT(!client.seek_failed);
+
+		/* exactly the samples after the seek position are
+		   submitted */
+		CPPUNIT_ASSERT_EQUAL(total - t.ToScale<uint64_t>(SAMPLE_RATE),
+				     client.n_frames_after_seek);
+	}
+
+	void TestSeekIndexed() {
+		/* build the index */
+		SeekDecoderClient first;
+		Decode(first);
+		const uint64_t total = first.n_frames;
+
+		/* near a frame boundary (frame 75) */
+		CheckSeek(total,
+			  SongTime::FromScale<uint64_t>(75 * SAMPLES_PER_FRAME,
+							SAMPLE_RATE));
+
+		/* in the middle of a frame, and not at a multiple of
+		   SeekIndex::STRIDE */
+		CheckSeek(total, SongTime::FromS(2.5));
+
+		/* within the first frame */
+		CheckSeek(total, SongTime::FromMS(10));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MadSeekTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -114,6 +114,9 @@ class PcmInterleaveTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestInterleave24);
 	CPPUNIT_TEST(TestInterleave32);
 	CPPUNIT_TEST(TestInterleave64);
+	CPPUNIT_TEST(TestInterleaveStereo);
+	CPPUNIT_TEST(TestInterleaveNarrow16);
+	CPPUNIT_TEST(TestNarrow16);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -122,6 +125,9 @@ public:
 	void TestInterleave24();
 	void TestInterleave32();
 	void TestInterleave64();
+	void TestInterleaveStereo();
+	void TestInterleaveNarrow16();
+	void TestNarrow16();
 };
 
 class PcmExportTest : public CppUnit::TestFixture {
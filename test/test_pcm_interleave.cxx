@@ -124,3 +124,92 @@ PcmInterleaveTest::TestInterleave64()
 {
 	TestInterleaveN<uint64_t>();
 }
+
+/**
+ * Test the stereo special case with a number of frames which is not
+ * a multiple of any SIMD block size.
+ */
+template<typename T>
+static void
+TestInterleaveStereoN()
+{
+	static constexpr size_t n_frames = 37;
+
+	T src1[n_frames], src2[n_frames];
+	for (size_t i = 0; i < n_frames; ++i) {
+		src1[i] = T(i * 2);
+		src2[i] = T(i * 2 + 1);
+	}
+
+	const T *const src_all[] = { src1, src2 };
+	const ConstBuffer<const void *> src((const void *const*)src_all, 2);
+
+	static constexpr T poison = T(0xdeadbeef);
+	T dest[n_frames * 2 + 1];
+	std::fill_n(dest, ARRAY_SIZE(dest), poison);
+
+	PcmInterleave(dest, src, n_frames, sizeof(T));
+
+	for (size_t i = 0; i < n_frames * 2; ++i)
+		CPPUNIT_ASSERT_EQUAL(T(i), dest[i]);
+	CPPUNIT_ASSERT_EQUAL(poison, dest[n_frames * 2]);
+}
+
+void
+PcmInterleaveTest::TestInterleaveStereo()
+{
+	TestInterleaveStereoN<uint16_t>();
+	TestInterleaveStereoN<uint32_t>();
+}
+
+void
+PcmInterleaveTest::TestInterleaveNarrow16()
+{
+	static constexpr size_t n_frames = 37;
+
+	int32_t src1[n_frames], src2[n_frames], src3[n_frames];
+	for (size_t i = 0; i < n_frames; ++i) {
+		src1[i] = -32768 + int32_t(i) * 3;
+		src2[i] = 32767 - int32_t(i) * 3;
+		src3[i] = int32_t(i);
+	}
+
+	const int32_t *const src_all[] = { src1, src2, src3 };
+
+	static constexpr int16_t poison = 0x5a5a;
+	int16_t dest[n_frames * 3 + 1];
+
+	for (size_t channels = 1; channels <= 3; ++channels) {
+		std::fill_n(dest, ARRAY_SIZE(dest), poison);
+
+		PcmInterleaveNarrow16(dest,
+				      ConstBuffer<const int32_t *>(src_all,
+								   channels),
+				      n_frames);
+
+		for (size_t i = 0; i < n_frames; ++i)
+			for (size_t c = 0; c < channels; ++c)
+				CPPUNIT_ASSERT_EQUAL(int16_t(src_all[c][i]),
+						     dest[i * channels + c]);
+		CPPUNIT_ASSERT_EQUAL(poison, dest[n_frames * channels]);
+	}
+}
+
+void
+PcmInterleaveTest::TestNarrow16()
+{
+	static constexpr size_t n = 77;
+
+	int32_t buffer[n];
+	for (size_t i = 0; i < n; ++i)
+		buffer[i] = int32_t(i * 851) - 32768;
+
+	int16_t expected[n];
+	std::copy_n(buffer, n, expected);
+
+	/* in-place */
+	PcmNarrow16((int16_t *)buffer, buffer, n);
+
+	for (size_t i = 0; i < n; ++i)
+		CPPUNIT_ASSERT_EQUAL(expected[i], ((const int16_t *)buffer)[i]);
+}
@@ -0,0 +1,241 @@
+/*
+ * Unit tests for class PlaylistFileCache.
+ */
+
+#include "config.h"
+#include "PlaylistFileCache.hxx"
+#include "PlaylistSave.hxx"
+#include "PlaylistError.hxx"
+#include "playlist/PlaylistSong.hxx"
+#include "Mapper.hxx"
+#include "event/Loop.hxx"
+#include "fs/Path.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <fstream>
+#include <sstream>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+void
+playlist_print_uri(BufferedOutputStream &os, const char *uri)
+{
+	os.Format("%s\n", uri);
+}
+
+bool
+playlist_check_translate_song(gcc_unused DetachedSong &song,
+			      gcc_unused const char *base_uri,
+			      gcc_unused const SongLoader &loader) noexcept
+{
+	return false;
+}
+
+#ifdef ENABLE_DATABASE
+
+std::string
+map_fs_to_utf8(gcc_unused Path path_fs) noexcept
+{
+	return std::string();
+}
+
+#endif
+
+static void
+WriteText(const std::string &path, const char *text)
+{
+	std::ofstream f(path, std::ios::trunc);
+	f << text;
+}
+
+static std::string
+ReadText(const std::string &path)
+{
+	std::ifstream f(path);
+	std::stringstream s;
+	s << f.rdbuf();
+	return s.str();
+}
+
+class PlaylistFileCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PlaylistFileCacheTest);
+	CPPUNIT_TEST(TestLoad);
+	CPPUNIT_TEST(TestNoSuchList);
+	CPPUNIT_TEST(TestJournal);
+	CPPUNIT_TEST(TestReplay);
+	CPPUNIT_TEST(TestExternalModification);
+	CPPUNIT_TEST(TestStaleJournal);
+	CPPUNIT_TEST_SUITE_END();
+
+	EventLoop event_loop;
+
+	std::string directory, path, journal_path;
+
+public:
+	void setUp() {
+		char buffer[] = "/tmp/test_playlist_file_cache.XXXXXX";
+		CPPUNIT_ASSERT(mkdtemp(buffer) != nullptr);
+		directory = buffer;
+		path = directory + "/foo.m3u";
+		journal_path = path + ".journal";
+
+		WriteText(path,
+			  "#EXTM3U\n"
+			  "http://example.com/a.mp3\n"
+			  "\n"
+			  "http://example.com/b.mp3\n"
+			  "http://example.com/c.mp3\n");
+	}
+
+	void tearDown() {
+		unlink(journal_path.c_str());
+		unlink(path.c_str());
+		rmdir(directory.c_str());
+	}
+
+	void TestLoad() {
+		PlaylistFileCache cache(event_loop, 16);
+
+		const auto &entry = cache.Get("foo", Path::FromFS(path.c_str()));
+		CPPUNIT_ASSERT_EQUAL(std::size_t(3), entry.contents.size());
+		CPPUNIT_ASSERT_EQUAL(std::string("http://example.com/a.mp3"),
+				     entry.contents[0]);
+		CPPUNIT_ASSERT_EQUAL(std::string("http://example.com/c.mp3"),
+				     entry.contents[2]);
+
+		/* the second lookup returns the cached copy */
+		CPPUNIT_ASSERT(cache.Find("foo", Path::FromFS(path.c_str())) == &entry);
+	}
+
+	void TestNoSuchList() {
+		PlaylistFileCache cache(event_loop, 16);
+
+		const std::string missing = directory + "/missing.m3u";
+		try {
+			cache.Get("missing", Path::FromFS(missing.c_str()));
+			CPPUNIT_FAIL("PlaylistError expected");
+		} catch (const PlaylistError &e) {
+			CPPUNIT_ASSERT(e.GetCode() == PlaylistResult::NO_SUCH_LIST);
+		}
+	}
+
+	void TestJournal() {
+		const auto path_fs = Path::FromFS(path.c_str());
+		const std::string original = ReadText(path);
+
+		PlaylistFileCache cache(event_loop, 16);
+		auto &entry = cache.Get("foo", path_fs);
+		cache.Delete(entry, 0);
+		cache.Move(entry, 1, 0);
+
+		/* the edits were journaled, but the m3u file is still
+		   untouched */
+		CPPUNIT_ASSERT_EQUAL(original, ReadText(path));
+		CPPUNIT_ASSERT(access(journal_path.c_str(), F_OK) == 0);
+		CPPUNIT_ASSERT(entry.dirty);
+		CPPUNIT_ASSERT(cache.Find("foo", path_fs) == &entry);
+
+		cache.FlushAll();
+
+		CPPUNIT_ASSERT_EQUAL(std::string("http://example.com/c.mp3\n"
+						 "http://example.com/b.mp3\n"),
+				     ReadText(path));
+		CPPUNIT_ASSERT(access(journal_path.c_str(), F_OK) != 0);
+		CPPUNIT_ASSERT(!entry.dirty);
+
+		/* the cached copy is still valid after our own
+		   write */
+		CPPUNIT_ASSERT(cache.Find("foo", path_fs) == &entry);
+	}
+
+	void TestReplay() {
+		const auto path_fs = Path::FromFS(path.c_str());
+
+		{
+			PlaylistFileCache cache(event_loop, 16);
+			auto &entry = cache.Get("foo", path_fs);
+			cache.Move(entry, 0, 2);
+			cache.Delete(entry, 0);
+
+			/* simulate a crash: the cache is destroyed
+			   without FlushAll() */
+		}
+
+		/* a truncated record at the end is ignored */
+		std::ofstream(journal_path, std::ios::app) << "m 1";
+
+		PlaylistFileCache cache(event_loop, 16);
+		const auto &entry = cache.Get("foo", path_fs);
+		CPPUNIT_ASSERT_EQUAL(std::size_t(2), entry.contents.size());
+		CPPUNIT_ASSERT_EQUAL(std::string("http://example.com/c.mp3"),
+				     entry.contents[0]);
+		CPPUNIT_ASSERT_EQUAL(std::string("http://example.com/a.mp3"),
+				     entry.contents[1]);
+
+		/* the replayed edits were written to the m3u file */
+		CPPUNIT_ASSERT(!entry.dirty);
+		CPPUNIT_ASSERT(access(journal_path.c_str(), F_OK) != 0);
+		CPPUNIT_ASSERT_EQUAL(std::string("http://example.com/c.mp3\n"
+						 "http://example.com/a.mp3\n"),
+				     ReadText(path));
+	}
+
+	void TestExternalModification() {
+		const auto path_fs = Path::FromFS(path.c_str());
+
+		PlaylistFileCache cache(event_loop, 16);
+		cache.Get("foo", path_fs);
+
+		WriteText(path, "http://example.com/x.mp3\n");
+
+		CPPUNIT_ASSERT(cache.Find("foo", path_fs) == nullptr);
+
+		const auto &entry = cache.Get("foo", path_fs);
+		CPPUNIT_ASSERT_EQUAL(std::size_t(1), entry.contents.size());
+		CPPUNIT_ASSERT_EQUAL(std::string("http://example.com/x.mp3"),
+				     entry.contents[0]);
+	}
+
+	void TestStaleJournal() {
+		const auto path_fs = Path::FromFS(path.c_str());
+
+		{
+			PlaylistFileCache cache(event_loop, 16);
+			auto &entry = cache.Get("foo", path_fs);
+			cache.Delete(entry, 0);
+		}
+
+		/* the m3u file was replaced while the journal was
+		   pending; the journal must not be applied to the new
+		   contents */
+		WriteText(path,
+			  "http://example.com/x.mp3\n"
+			  "http://example.com/y.mp3\n");
+
+		PlaylistFileCache cache(event_loop, 16);
+		const auto &entry = cache.Get("foo", path_fs);
+		CPPUNIT_ASSERT_EQUAL(std::size_t(2), entry.contents.size());
+		CPPUNIT_ASSERT_EQUAL(std::string("http://example.com/x.mp3"),
+				     entry.contents[0]);
+		CPPUNIT_ASSERT(access(journal_path.c_str(), F_OK) != 0);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PlaylistFileCacheTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
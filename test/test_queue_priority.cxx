@@ -1,5 +1,6 @@
 #include "config.h"
 #include "queue/Queue.hxx"
+#include "queue/PriorityTree.hxx"
 #include "song/DetachedSong.hxx"
 #include "util/Macros.hxx"
 
@@ -8,8 +9,13 @@
 #include <cppunit/ui/text/TestRunner.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <random>
+
+#include <stdio.h>
+
 Tag::Tag(const Tag &) noexcept {}
 void Tag::Clear() noexcept {}
+bool Tag::IsSame(const Tag &) const noexcept { return true; }
 
 static void
 check_descending_priority(const Queue *queue,
@@ -27,13 +33,59 @@ check_descending_priority(const Queue *queue,
 	}
 }
 
+/**
+ * Compare QueuePriorityTree::FindAtMost() and FindNotEqual() with a
+ * linear search in #priorities.
+ */
+static void
+check_priority_tree(const QueuePriorityTree &tree,
+		    const uint8_t *priorities, unsigned length)
+{
+	static constexpr uint8_t test_priorities[] = { 0, 1, 7, 8, 100, 255 };
+
+	for (unsigned start = 0; start <= length; ++start) {
+		for (const uint8_t p : test_priorities) {
+			unsigned expected = start;
+			while (expected < length && priorities[expected] > p)
+				++expected;
+
+			CPPUNIT_ASSERT_EQUAL(expected,
+					     std::min(tree.FindAtMost(start, p),
+						      length));
+
+			expected = start;
+			while (expected < length && priorities[expected] == p)
+				++expected;
+
+			CPPUNIT_ASSERT_EQUAL(expected,
+					     std::min(tree.FindNotEqual(start, p),
+						      length));
+		}
+	}
+}
+
+/**
+ * Check that #Queue::position_order is the inverse of #Queue::order.
+ */
+static void
+check_position_order(const Queue &queue)
+{
+	for (unsigned order = 0; order < queue.GetLength(); ++order)
+		CPPUNIT_ASSERT_EQUAL(order,
+				     queue.PositionToOrder(queue.OrderToPosition(order)));
+}
+
 class QueuePriorityTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(QueuePriorityTest);
 	CPPUNIT_TEST(TestPriority);
+	CPPUNIT_TEST(TestPriorityTree);
+	CPPUNIT_TEST(TestPositionOrder);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestPriority();
+	void TestPriorityTree();
+	void TestPositionOrder();
 };
 
 void
@@ -178,6 +230,90 @@ QueuePriorityTest::TestPriority()
 	CPPUNIT_ASSERT_EQUAL(6u, a_order);
 }
 
+void
+QueuePriorityTest::TestPriorityTree()
+{
+	static constexpr unsigned N = 100;
+	QueuePriorityTree tree(N);
+
+	std::mt19937 rng(42);
+	std::uniform_int_distribution<unsigned> small(0, 8);
+
+	uint8_t priorities[N];
+	for (unsigned i = 0; i < N; ++i) {
+		priorities[i] = small(rng) * small(rng);
+		tree.Set(i, priorities[i]);
+	}
+
+	check_priority_tree(tree, priorities, N);
+
+	/* update single slots */
+	for (unsigned i = 0; i < N; i += 7) {
+		priorities[i] = 255 - i;
+		tree.Set(i, priorities[i]);
+	}
+
+	check_priority_tree(tree, priorities, N);
+
+	/* update a range */
+	for (unsigned i = 20; i < 60; ++i) {
+		priorities[i] = 8;
+		tree.Assign(i, priorities[i]);
+	}
+
+	tree.Update(20, 60);
+	check_priority_tree(tree, priorities, N);
+
+	/* shrink */
+	tree.Erase(50, N);
+	check_priority_tree(tree, priorities, 50);
+	CPPUNIT_ASSERT(tree.FindAtMost(50, 255) >= 50);
+
+	/* unused slots are found only by FindAtMost(255) */
+	tree.Erase(0, 50);
+	CPPUNIT_ASSERT(tree.FindAtMost(0, 254) >= N);
+	CPPUNIT_ASSERT_EQUAL(0u, tree.FindAtMost(0, 255));
+}
+
+void
+QueuePriorityTest::TestPositionOrder()
+{
+	Queue queue(64);
+	for (unsigned i = 0; i < 40; ++i) {
+		char uri[16];
+		snprintf(uri, sizeof(uri), "%u.ogg", i);
+		queue.Append(DetachedSong(uri), 0);
+	}
+
+	queue.random = true;
+	queue.ShuffleOrder();
+	check_position_order(queue);
+
+	queue.SetPriorityRange(10, 20, 30, -1);
+	check_position_order(queue);
+	check_descending_priority(&queue, 0);
+
+	queue.SwapPositions(3, 15);
+	check_position_order(queue);
+
+	queue.MoveRange(5, 12, 20);
+	check_position_order(queue);
+
+	queue.MovePostion(0, 39);
+	check_position_order(queue);
+
+	queue.DeletePosition(7);
+	check_position_order(queue);
+	CPPUNIT_ASSERT_EQUAL(39u, queue.GetLength());
+
+	queue.ShuffleOrder();
+	check_position_order(queue);
+	check_descending_priority(&queue, 0);
+
+	queue.Clear();
+	CPPUNIT_ASSERT_EQUAL(0u, queue.GetLength());
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(QueuePriorityTest);
 
 int
@@ -0,0 +1,233 @@
+/*
+ * Unit tests for class SeekIndex.
+ */
+
+#include "config.h"
+#include "decoder/SeekIndex.hxx"
+#include "input/InputStream.hxx"
+#include "config/Data.hxx"
+#include "config/Param.hxx"
+#include "config/Option.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Compiler.h"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <fstream>
+#include <string>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Pretends to be a local file of the given size.  SeekIndex only
+ * looks at the URI and the size; the data is never read.
+ */
+class FakeFileInputStream final : public InputStream {
+public:
+	FakeFileInputStream(const char *_uri, Mutex &_mutex,
+			    offset_type _size)
+		:InputStream(_uri, _mutex) {
+		size = _size;
+		seekable = true;
+		SetReady();
+	}
+
+	/* virtual methods from InputStream */
+	bool IsEOF() noexcept override {
+		return offset >= size;
+	}
+
+	size_t Read(gcc_unused void *ptr, gcc_unused size_t read_size) override {
+		return 0;
+	}
+};
+
+static SeekIndex
+MakeIndex(unsigned n_frames)
+{
+	SeekIndex index(44100, 1152);
+	for (unsigned i = 0; i < n_frames; ++i)
+		index.Append(1000 + i * 417);
+	return index;
+}
+
+class SeekIndexTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(SeekIndexTest);
+	CPPUNIT_TEST(TestLookup);
+	CPPUNIT_TEST(TestDuration);
+	CPPUNIT_TEST(TestStoreLoad);
+	CPPUNIT_TEST(TestStale);
+	CPPUNIT_TEST(TestPrune);
+	CPPUNIT_TEST_SUITE_END();
+
+	std::string directory, path;
+
+public:
+	void Init(const char *size=nullptr) {
+		ConfigData config;
+		config.AddParam(ConfigOption::SEEK_INDEX_DIRECTORY,
+				ConfigParam(directory.c_str()));
+		if (size != nullptr)
+			config.AddParam(ConfigOption::SEEK_INDEX_SIZE,
+					ConfigParam(size));
+		seek_index_global_init(config);
+	}
+
+	unsigned CountIndexFiles() const {
+		unsigned n = 0;
+		DIR *dir = opendir(directory.c_str());
+		while (const auto *e = readdir(dir))
+			if (strstr(e->d_name, ".idx") != nullptr)
+				++n;
+		closedir(dir);
+		return n;
+	}
+
+	void setUp() {
+		char buffer[] = "/tmp/test_seek_index.XXXXXX";
+		CPPUNIT_ASSERT(mkdtemp(buffer) != nullptr);
+		directory = buffer;
+		path = directory + "/song.mp3";
+
+		std::ofstream f(path);
+		f << std::string(100000, 'x');
+		f.close();
+
+		Init();
+	}
+
+	void tearDown() {
+		seek_index_global_finish();
+
+		DIR *dir = opendir(directory.c_str());
+		while (const auto *e = readdir(dir))
+			if (e->d_name[0] != '.')
+				unlink((directory + "/" + e->d_name).c_str());
+		closedir(dir);
+		rmdir(directory.c_str());
+	}
+
+	void TestLookup() {
+		const auto index = MakeIndex(10);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(10), index.GetFrameCount());
+
+		/* indexed frames are returned exactly */
+		for (unsigned i = 0; i < 10; i += SeekIndex::STRIDE) {
+			const auto p = index.Lookup(i);
+			CPPUNIT_ASSERT_EQUAL(uint64_t(i), p.frame);
+			CPPUNIT_ASSERT_EQUAL(offset_type(1000 + i * 417),
+					     p.offset);
+		}
+
+		/* frames in between return the preceding indexed
+		   frame */
+		for (unsigned i = 0; i < 10; ++i) {
+			const auto p = index.Lookup(i);
+			CPPUNIT_ASSERT(p.frame <= i);
+			CPPUNIT_ASSERT(i - p.frame < SeekIndex::STRIDE);
+			CPPUNIT_ASSERT_EQUAL(offset_type(1000 + p.frame * 417),
+					     p.offset);
+		}
+
+		/* past the end: the last indexed frame */
+		const auto p = index.Lookup(1000);
+		CPPUNIT_ASSERT_EQUAL(uint64_t(9 - 9 % SeekIndex::STRIDE),
+				     p.frame);
+	}
+
+	void TestDuration() {
+		CPPUNIT_ASSERT(MakeIndex(0).IsEmpty());
+
+		/* 1152 samples per frame at 44.1 kHz */
+		const auto index = MakeIndex(3828);
+		CPPUNIT_ASSERT_EQUAL(SongTime::FromMS(99996).count(),
+				     index.GetDuration().count());
+	}
+
+	void TestStoreLoad() {
+		Mutex mutex;
+		FakeFileInputStream is(path.c_str(), mutex, 100000);
+		CPPUNIT_ASSERT(SeekIndex::CanStore(is));
+		CPPUNIT_ASSERT(SeekIndex::Load(is) == nullptr);
+
+		const auto index = MakeIndex(37);
+		index.Store(is);
+
+		const auto loaded = SeekIndex::Load(is);
+		CPPUNIT_ASSERT(loaded != nullptr);
+		CPPUNIT_ASSERT_EQUAL(44100u, loaded->GetSampleRate());
+		CPPUNIT_ASSERT_EQUAL(1152u, loaded->GetSamplesPerFrame());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(37), loaded->GetFrameCount());
+
+		for (unsigned i = 0; i < 40; ++i) {
+			const auto a = index.Lookup(i), b = loaded->Lookup(i);
+			CPPUNIT_ASSERT_EQUAL(a.frame, b.frame);
+			CPPUNIT_ASSERT_EQUAL(a.offset, b.offset);
+		}
+
+		/* remote streams are not stored */
+		FakeFileInputStream remote("http://example.com/song.mp3",
+					   mutex, 100000);
+		CPPUNIT_ASSERT(!SeekIndex::CanStore(remote));
+	}
+
+	void TestStale() {
+		Mutex mutex;
+
+		{
+			FakeFileInputStream is(path.c_str(), mutex, 100000);
+			MakeIndex(37).Store(is);
+		}
+
+		/* the file has been modified */
+		std::ofstream f(path, std::ios::app);
+		f << "y";
+		f.close();
+
+		FakeFileInputStream is(path.c_str(), mutex, 100001);
+		CPPUNIT_ASSERT(SeekIndex::Load(is) == nullptr);
+	}
+
+	void TestPrune() {
+		/* 1 kB: room for only a few index files */
+		seek_index_global_finish();
+		Init("1");
+
+		Mutex mutex;
+		std::string last;
+		for (unsigned i = 0; i < 10; ++i) {
+			last = directory + "/song" + std::to_string(i) + ".mp3";
+			std::ofstream f(last);
+			f << "x";
+			f.close();
+
+			FakeFileInputStream is(last.c_str(), mutex, 1);
+			MakeIndex(37).Store(is);
+		}
+
+		const unsigned n = CountIndexFiles();
+		CPPUNIT_ASSERT(n > 0);
+		CPPUNIT_ASSERT(n < 10);
+
+		/* the most recent one survives */
+		FakeFileInputStream is(last.c_str(), mutex, 1);
+		CPPUNIT_ASSERT(SeekIndex::Load(is) != nullptr);
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SeekIndexTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}